@@ -110,6 +110,15 @@ extern uint32_t SystemCoreClock;
 #define configUSE_MALLOC_FAILED_HOOK 1
 #define configUSE_APPLICATION_TASK_TAG 0
 #define configUSE_COUNTING_SEMAPHORES 1
+
+#ifdef TICKLESS_IDLE
+/* The idle task sleeps with the tick stopped, see hal::LowPower. Sleeps
+   shorter than configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks aren't worth it. */
+#define configUSE_TICKLESS_IDLE 1
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP 2
+void vApplicationSuppressTicksAndSleep(uint32_t xExpectedIdleTime);
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) vApplicationSuppressTicksAndSleep(xExpectedIdleTime)
+#endif
 #define configGENERATE_RUN_TIME_STATS 0
 
 /* Co-routine definitions. */
@@ -17,6 +17,8 @@
 #include <string>
 
 #include "os_Task.h"
+#include "TaskEndless.h"
+#include "WorkQueue.h"
 #include "cpp_overrides.h"
 #include "trace.h"
 
@@ -40,6 +42,7 @@
 #include "CRC.h"
 #include "I2c.h"
 #include "Comp.h"
+#include "LowPower.h"
 
 /* DEV LAYER INLCUDES */
 #include "TimSensorBldc.h"
@@ -100,12 +103,25 @@ int main(void)
     hal::initFactory<hal::Factory<hal::Crc> >();
     hal::initFactory<hal::Factory<hal::I2c> >();
     hal::initFactory<hal::Factory<hal::Comp> >();
+#ifdef TICKLESS_IDLE
+    hal::LowPower::initialize();
+#endif
 
     TraceInit();
     Trace(ZONE_INFO, "Version: %s \r\n", VERSION.c_str());
 
     const bool isMaster = hal::Factory<hal::Gpio>::get<hal::Gpio::CONFIG>();
 
+    /* bottom halves of the motor control interrupts, run above the controller tasks */
+    static os::StaticWorkQueue<4> deferredWork;
+    [[gnu::unused]] auto deferredWorker = new os::TaskEndless("0DeferredWork", 512, os::Task::Priority::VERY_HIGH,
+                                                              [](const bool&) {
+        while (true) {
+            deferredWork.dispatch();
+        }
+    });
+    hal::Factory<hal::PhaseCurrentSensor>::get<hal::PhaseCurrentSensor::I_TOTAL_FB>().registerWorkQueue(&deferredWork);
+
     g_Mpu = new app::Mpu();
 
     auto battery = new dev::Battery();
@@ -8,6 +8,7 @@
 
 #define USB_LP_CAN1_RX0_INTERRUPT_ENABLED true
 #define CAN1_RX1_INTERRUPT_ENABLED true
+#define USB_HP_CAN1_TX_INTERRUPT_ENABLED true
 
 #endif /* SOURCES_CAN_INTERRUPTS_H_ */
 
@@ -25,9 +26,10 @@ enum Description {
 
 static constexpr const std::array<const Can, Can::__ENUM__SIZE + 1> Container =
 { {
+      // TTCM stamps received frames with the bit time counter, see CanFrame::mTimestamp
       Can(Can::MAINCAN,
           CAN1_BASE,
-          CAN_InitTypeDef { 9, CAN_Mode_Normal, CAN_SJW_1tq, CAN_BS1_13tq, CAN_BS2_2tq, DISABLE, DISABLE,
+          CAN_InitTypeDef { 9, CAN_Mode_Normal, CAN_SJW_1tq, CAN_BS1_13tq, CAN_BS2_2tq, ENABLE, DISABLE,
                             DISABLE, DISABLE, DISABLE, DISABLE}),
       Can(Can::__ENUM__SIZE, 0, CAN_InitTypeDef { 0, 0, 0, 0, 0, DISABLE, DISABLE,
                                                   DISABLE, DISABLE, DISABLE, DISABLE})
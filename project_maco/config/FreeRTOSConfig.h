@@ -98,7 +98,7 @@ extern uint32_t SystemCoreClock;
 #define configMINIMAL_STACK_SIZE ((unsigned short)128)
 #define configTOTAL_HEAP_SIZE ((size_t)(32 * 1024))
 #define configMAX_TASK_NAME_LEN (16)
-#ifdef SYSVIEW
+#if defined(SYSVIEW) || defined(TELEMETRY)
 #define configUSE_TRACE_FACILITY 1
 #else
 #define configUSE_TRACE_FACILITY 0
@@ -112,7 +112,24 @@ extern uint32_t SystemCoreClock;
 #define configUSE_MALLOC_FAILED_HOOK 1
 #define configUSE_APPLICATION_TASK_TAG 0
 #define configUSE_COUNTING_SEMAPHORES 1
+#ifdef TELEMETRY
+/* run time stats clocked by the DWT cycle counter divided by 64. The cycle
+   counter wraps every minute, the tick hook counts its wraps into the upper
+   bits (see os::RunTimeCounter). So the run time counter wraps at 2^32 like
+   FreeRTOS assumes, after about an hour at 72 MHz. */
+#define configGENERATE_RUN_TIME_STATS 1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() do { \
+        *(volatile uint32_t*)0xE000EDFC |= (1UL << 24); /* DEMCR.TRCENA */ \
+        *(volatile uint32_t*)0xE0001004 = 0;            /* DWT_CYCCNT */ \
+        *(volatile uint32_t*)0xE0001000 |= 1UL;         /* DWT_CTRL.CYCCNTENA */ \
+} while (0)
+#define portGET_CYCLE_COUNTER_VALUE() (*(volatile uint32_t*)0xE0001004)
+#define configRUN_TIME_COUNTER_SHIFT 6
+uint32_t ulGetRunTimeCounterValue(void);
+#define portGET_RUN_TIME_COUNTER_VALUE() ulGetRunTimeCounterValue()
+#else
 #define configGENERATE_RUN_TIME_STATS 0
+#endif
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 0
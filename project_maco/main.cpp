@@ -38,6 +38,11 @@
 #include "CommandMultiplexer.h"
 #include "DemoExecuter.h"
 
+#if defined(TELEMETRY)
+#include "Telemetry.h"
+#include "SEGGER_RTT.h"
+#endif
+
 /* GLOBAL VARIABLES */
 static const int __attribute__((used)) g_DebugZones = ZONE_ERROR | ZONE_WARNING |
                                                       ZONE_VERBOSE | ZONE_INFO;
@@ -57,21 +62,32 @@ int main(void)
     TraceInit();
     Trace(ZONE_INFO, "Version: %s \r\n", VERSION.c_str());
 
-    auto modem = new app::ModemDriver(hal::Factory<hal::UsartWithDma>::get<hal::Usart::
-                                                                           MODEM_COM>(),
-                                      hal::Factory<hal::Gpio>::get<hal::Gpio::MODEM_RESET>(),
-                                      hal::Factory<hal::Gpio>::get<hal::Gpio::MODEM_POWER>(),
-                                      hal::Factory<hal::Gpio>::get<hal::Gpio::MODEM_SUPPLY>());
-
-    auto controlsocket = modem->getSocket(app::Socket::Protocol::TCP, "xxx.xxx.xxx.xxx", "xxxxx");
-    auto datasocket = modem->getSocket(app::Socket::Protocol::TCP, "xxx.xxx.xxx.xxx", "xxxxx");
-
-    auto can = new app::CanController(hal::Factory<hal::UsartWithDma>::get<hal::Usart::SECCO_COM>(),
-                                      hal::Factory<hal::Gpio>::get<hal::Gpio::SECCO_PWR>(),
-                                      hal::Factory<hal::Gpio>::getAlternateFunctionGpio<hal::Gpio::USART2_TX>());
-
-    auto demo = new app::DemoExecuter(*can);
-    auto __attribute__((used)) mux = new app::CommandMultiplexer(controlsocket, datasocket, *can, *demo);
+    // static storage keeps the long living objects and their task stacks out of the heap
+    static app::ModemDriver modem(hal::Factory<hal::UsartWithDma>::get<hal::Usart::
+                                                                       MODEM_COM>(),
+                                  hal::Factory<hal::Gpio>::get<hal::Gpio::MODEM_RESET>(),
+                                  hal::Factory<hal::Gpio>::get<hal::Gpio::MODEM_POWER>(),
+                                  hal::Factory<hal::Gpio>::get<hal::Gpio::MODEM_SUPPLY>());
+
+    auto controlsocket = modem.getSocket(app::Socket::Protocol::TCP, "xxx.xxx.xxx.xxx", "xxxxx");
+    auto datasocket = modem.getSocket(app::Socket::Protocol::TCP, "xxx.xxx.xxx.xxx", "xxxxx");
+
+    static app::CanController can(hal::Factory<hal::UsartWithDma>::get<hal::Usart::SECCO_COM>(),
+                                  hal::Factory<hal::Gpio>::get<hal::Gpio::SECCO_PWR>(),
+                                  hal::Factory<hal::Gpio>::getAlternateFunctionGpio<hal::Gpio::USART2_TX>());
+
+    static app::DemoExecuter demo(can);
+    static app::CommandMultiplexer __attribute__((used)) mux(controlsocket, datasocket, can, demo);
+
+#if defined(TELEMETRY)
+    // binary records on RTT up channel 2, SystemView uses channel 1
+    static char telemetryBuffer[512];
+    SEGGER_RTT_ConfigUpBuffer(2, "Telemetry", telemetryBuffer, sizeof(telemetryBuffer),
+                              SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    static os::Telemetry __attribute__((used)) telemetry([](uint8_t const* record, size_t length) {
+        SEGGER_RTT_Write(2, record, length);
+    }, std::chrono::milliseconds(1000));
+#endif
 
     os::Task::startScheduler();
     Trace(ZONE_ERROR, "This shouldn't happen!\r\n");
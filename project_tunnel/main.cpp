@@ -26,6 +26,7 @@
 #include "Usart.h"
 #include "Dma.h"
 #include "UsartWithDma.h"
+#include "LowPower.h"
 
 /* DEV LAYER INLCUDES */
 
@@ -48,6 +49,9 @@ int main(void)
     hal::initFactory<hal::Factory<hal::Usart> >();
     hal::initFactory<hal::Factory<hal::Dma> >();
     hal::initFactory<hal::Factory<hal::UsartWithDma> >();
+#ifdef TICKLESS_IDLE
+    hal::LowPower::initialize();
+#endif
 
     static constexpr const bool DEBUG_2_MODEM_TUNNEL = false;
 
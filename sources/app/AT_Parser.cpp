@@ -9,6 +9,7 @@
 #include "LockGuard.h"
 #include "os_Task.h"
 #include <cstring>
+#include <algorithm>
 
 using app::AT;
 using app::ATCmd;
@@ -28,61 +29,79 @@ using app::ATCmdUSOSO;
 using app::ATCmdUSOST;
 using app::ATCmdUSOWR;
 using app::ATParser;
+using app::ATResponseMatcher;
 
 static constexpr const int __attribute__((unused)) g_DebugZones = 0; //ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
 //------------------------ATCmd---------------------------------
 
 AT::Return_t ATCmd::send(AT::SendFunction& sendFunction, const std::chrono::milliseconds timeout)
+{
+    mSendResult.reset();
+
+    const Return_t queued = sendAsync(sendFunction, timeout, [this](const bool success) {
+        mSendResult.overwrite(success);
+    });
+    if (queued != Return_t::WAITING) {
+        return queued;
+    }
+
+    // the parser completes every queued command, at the latest when it times out
+    bool commandSuccess = false;
+    mSendResult.receive(commandSuccess, portMAX_DELAY);
+    Trace(ZONE_VERBOSE, "done %d\r\n", commandSuccess);
+    return commandSuccess ? Return_t::FINISHED : Return_t::ERROR;
+}
+
+AT::Return_t ATCmd::sendAsync(AT::SendFunction&               sendFunction,
+                              const std::chrono::milliseconds timeout,
+                              const Completion&               completion)
 {
     if (!mParser) {
         Trace(ZONE_ERROR, "Parser not set\n");
         return Return_t::ERROR;
     }
 
-    mSendResult.reset();
-
-    {
-        os::LockGuard<os::Mutex> lock(mParser->mWaitingCmdMutex);
+    os::LockGuard<os::Mutex> lock(mParser->mWaitingCmdMutex);
 
-        if (mParser->mWaitingCmd) {
-            Trace(ZONE_VERBOSE, "Parser not ready\n");
-            return Return_t::TRY_AGAIN;
-        }
-        Trace(ZONE_VERBOSE, "sending: %s\r\n", mRequest.data());
+    if (mPending || (mParser->mNumberOfPendingCmds >= ATParser::MAXPENDINGCMDS)) {
+        Trace(ZONE_VERBOSE, "Parser not ready\n");
+        return Return_t::TRY_AGAIN;
+    }
 
-        mParser->mWaitingCmd = this;
+    mPendingSend = &sendFunction;
+    mTimeout = timeout;
+    mCompletion = completion;
 
-        if (sendFunction(mRequest, timeout) != mRequest.length()) {
-            Trace(ZONE_ERROR, "Couldn't send\n");
-            mParser->mWaitingCmd = nullptr;
-            return Return_t::ERROR;
-        }
-        Trace(ZONE_VERBOSE, "waiting\r\n");
-    }
-    bool commandSuccess = false;
-    if (mSendResult.receive(commandSuccess, timeout)) {
-        Trace(ZONE_VERBOSE, "done %d\r\n", commandSuccess);
-        return commandSuccess ? Return_t::FINISHED : Return_t::ERROR;
-    }
-    {
-        os::LockGuard<os::Mutex> lock(mParser->mWaitingCmdMutex);
-        Trace(ZONE_VERBOSE, "Timeout: %s\r\n", mRequest.data());
-        mParser->mWaitingCmd = nullptr;
+    if (mParser->mNumberOfQueuedCmds || !mParser->canWrite()) {
+        const size_t last = (mParser->mFirstQueuedCmd + mParser->mNumberOfQueuedCmds) % ATParser::MAXPENDINGCMDS;
+        mParser->mQueuedCmds[last] = this;
+        mParser->mNumberOfQueuedCmds++;
+        Trace(ZONE_VERBOSE, "queued: %s\r\n", mName.data());
+    } else if (!mParser->write(this)) {
         return Return_t::ERROR;
     }
+
+    mPending = true;
+    mParser->mNumberOfPendingCmds++;
+    return Return_t::WAITING;
+}
+
+bool ATCmd::isPending(void) const
+{
+    return mPending;
 }
 
 void ATCmd::okReceived(void)
 {
     Trace(ZONE_INFO, "ATCMD: %s OK\n", mName.data());
-    mSendResult.overwrite(true);
+    mParser->finish(this, true);
 }
 
 void ATCmd::errorReceived(void)
 {
     Trace(ZONE_INFO, "ATCMD: %s ERROR\n", mName.data());
-    mSendResult.overwrite(false);
+    mParser->finish(this, false);
 }
 
 AT::Return_t ATCmd::onResponseMatch(void)
@@ -110,11 +129,34 @@ AT::Return_t ATCmdCGATT::onResponseMatch(void)
 
 //------------------------ATCmdTX---------------------------------
 
+std::array<char, ATCmd::MAXDATALENGTH> ATCmdTX::TransmitBuffer;
+
+void ATCmdTX::setData(const std::string_view data)
+{
+    mData = data;
+    mDataSource = nullptr;
+}
+
+void ATCmdTX::setData(const DataSource& source)
+{
+    mData = std::string_view();
+    mDataSource = source;
+}
+
 AT::Return_t ATCmdTX::onResponseMatch(void)
 {
     Trace(ZONE_INFO, "Sleep for the Modem \r\n");
     os::ThisTask::sleep(std::chrono::milliseconds(50));
-    if (mSendFunction(mData, ATParser::defaultTimeout) != mData.length()) {
+
+    std::string_view data = mData;
+    if (mDataSource) {
+        data = std::string_view(TransmitBuffer.data(), mDataSource(TransmitBuffer.data(), mDataLength));
+    }
+    if (data.length() != mDataLength) {
+        Trace(ZONE_ERROR, "Payload incomplete %d %d\n", data.length(), mDataLength);
+        return Return_t::ERROR;
+    }
+    if (mSendFunction(data, ATParser::defaultTimeout) != data.length()) {
         Trace(ZONE_ERROR, "Couldn't send data\n");
         return Return_t::ERROR;
     }
@@ -129,15 +171,61 @@ AT::Return_t ATCmdUSOST::send(const size_t                    socket,
                               const std::string_view          data,
                               const std::chrono::milliseconds timeout)
 {
-    if (data.length() == 0) {
-        Trace(ZONE_WARNING, "Nodata %d\r\n", data.length());
+    const Return_t prepared = prepare(socket, ip, port, data.length());
+    if (prepared != Return_t::WAITING) {
+        return prepared;
+    }
+    setData(data);
+    return ATCmd::send(mSendFunction, timeout);
+}
+
+AT::Return_t ATCmdUSOST::sendAsync(const size_t                    socket,
+                                   const std::string_view          ip,
+                                   const std::string_view          port,
+                                   const std::string_view          data,
+                                   const std::chrono::milliseconds timeout,
+                                   const Completion&               completion)
+{
+    const Return_t prepared = prepare(socket, ip, port, data.length());
+    if (prepared != Return_t::WAITING) {
+        return prepared;
+    }
+    setData(data);
+    return ATCmd::sendAsync(mSendFunction, timeout, completion);
+}
+
+AT::Return_t ATCmdUSOST::sendAsync(const size_t                    socket,
+                                   const std::string_view          ip,
+                                   const std::string_view          port,
+                                   const size_t                    length,
+                                   const DataSource&               source,
+                                   const std::chrono::milliseconds timeout,
+                                   const Completion&               completion)
+{
+    const Return_t prepared = prepare(socket, ip, port, length);
+    if (prepared != Return_t::WAITING) {
+        return prepared;
+    }
+    setData(source);
+    return ATCmd::sendAsync(mSendFunction, timeout, completion);
+}
+
+AT::Return_t ATCmdUSOST::prepare(const size_t           socket,
+                                 const std::string_view ip,
+                                 const std::string_view port,
+                                 const size_t           length)
+{
+    if (isPending()) {
+        return AT::Return_t::TRY_AGAIN;
+    }
+    if (length == 0) {
+        Trace(ZONE_WARNING, "Nodata %d\r\n", length);
         return AT::Return_t::FINISHED;
     }
-    if (data.length() > 1024) {
+    if (length > MAXDATALENGTH) {
         Trace(ZONE_WARNING, "Maximum data length exceeded\r\n");
         return AT::Return_t::ERROR;
     }
-    mData = data;
     const size_t reqLen = std::snprintf(
                                         mRequestBuffer.data(),
                                         mRequestBuffer.size(),
@@ -145,15 +233,15 @@ AT::Return_t ATCmdUSOST::send(const size_t                    socket,
                                         socket,
                                         ip.data(),
                                         port.data(),
-                                        data.length());
+                                        length);
     if (reqLen >= mRequestBuffer.size()) {
         Trace(ZONE_ERROR, "snprintf failed\r\n");
         return AT::Return_t::ERROR;
     }
 
+    mDataLength = length;
     mRequest = std::string_view(mRequestBuffer.data(), reqLen);
-
-    return ATCmd::send(mSendFunction, timeout);
+    return AT::Return_t::WAITING;
 }
 
 //------------------------ATCmdUSOWR---------------------------------
@@ -162,29 +250,68 @@ AT::Return_t ATCmdUSOWR::send(const size_t                    socket,
                               const std::string_view          data,
                               const std::chrono::milliseconds timeout)
 {
-    if (data.length() == 0) {
-        Trace(ZONE_WARNING, "Nodata %d\r\n", data.length());
+    const Return_t prepared = prepare(socket, data.length());
+    if (prepared != Return_t::WAITING) {
+        return prepared;
+    }
+    setData(data);
+    return ATCmd::send(mSendFunction, timeout);
+}
+
+AT::Return_t ATCmdUSOWR::sendAsync(const size_t                    socket,
+                                   const std::string_view          data,
+                                   const std::chrono::milliseconds timeout,
+                                   const Completion&               completion)
+{
+    const Return_t prepared = prepare(socket, data.length());
+    if (prepared != Return_t::WAITING) {
+        return prepared;
+    }
+    setData(data);
+    return ATCmd::sendAsync(mSendFunction, timeout, completion);
+}
+
+AT::Return_t ATCmdUSOWR::sendAsync(const size_t                    socket,
+                                   const size_t                    length,
+                                   const DataSource&               source,
+                                   const std::chrono::milliseconds timeout,
+                                   const Completion&               completion)
+{
+    const Return_t prepared = prepare(socket, length);
+    if (prepared != Return_t::WAITING) {
+        return prepared;
+    }
+    setData(source);
+    return ATCmd::sendAsync(mSendFunction, timeout, completion);
+}
+
+AT::Return_t ATCmdUSOWR::prepare(const size_t socket, const size_t length)
+{
+    if (isPending()) {
+        return AT::Return_t::TRY_AGAIN;
+    }
+    if (length == 0) {
+        Trace(ZONE_WARNING, "Nodata %d\r\n", length);
         return AT::Return_t::FINISHED;
     }
-    if (data.length() > 1024) {
+    if (length > MAXDATALENGTH) {
         Trace(ZONE_WARNING, "Maximum data length exceeded\r\n");
         return AT::Return_t::ERROR;
     }
-    mData = data;
     const size_t reqLen = std::snprintf(
                                         mRequestBuffer.data(),
                                         mRequestBuffer.size(),
                                         "AT+USOWR=%d,%d\r",
                                         socket,
-                                        data.length());
+                                        length);
     if (reqLen >= mRequestBuffer.size()) {
         Trace(ZONE_ERROR, "snprintf failed\r\n");
         return AT::Return_t::ERROR;
     }
 
+    mDataLength = length;
     mRequest = std::string_view(mRequestBuffer.data(), reqLen);
-
-    return ATCmd::send(mSendFunction, timeout);
+    return AT::Return_t::WAITING;
 }
 
 //------------------------ATCmdRXData---------------------------------
@@ -194,42 +321,56 @@ std::string_view ATCmdRXData::getData(void) const
     return mData;
 }
 
+void ATCmdRXData::setDataSink(const DataSink& sink)
+{
+    mDataSink = sink;
+}
+
 AT::Return_t ATCmdRXData::getDataFromParser(const size_t bytesAvailable)
 {
     const std::string_view datastring = mParser->getBytesFromInput(bytesAvailable + 2);
-    if (datastring.length() < bytesAvailable) {
+    if (datastring.length() != bytesAvailable + 2) {
         Trace(ZONE_ERROR, "datastringLength %d %d\r\n", datastring.length(), bytesAvailable);
         return Return_t::ERROR;
     }
 
-    auto first = datastring.find_first_of('"') + 1;
-    auto last = datastring.find_last_of('"');
+    // the payload may contain quotes itself
+    if ((bytesAvailable == 0) || (datastring.front() != '"') || (datastring.back() != '"')) {
+        Trace(ZONE_ERROR, "data length\r\n");
+        return AT::Return_t::ERROR;
+    }
+    const std::string_view payload = datastring.substr(1, bytesAvailable);
 
-    mData = std::string_view(mDataBuffer.data(), last - first);
+    if (mDataSink) {
+        mData = std::string_view();
+        mDataSink(payload);
+        return AT::Return_t::FINISHED;
+    }
 
-    if ((mData.length() == 0) || (mData.length() > mDataBuffer.size())) {
+    if (payload.length() > mDataBuffer.size()) {
         Trace(ZONE_ERROR, "data length\r\n");
         return AT::Return_t::ERROR;
     }
-
-    std::memcpy(mDataBuffer.data(), datastring.data() + first, mData.length());
+    std::memcpy(mDataBuffer.data(), payload.data(), payload.length());
+    mData = std::string_view(mDataBuffer.data(), payload.length());
     return AT::Return_t::FINISHED;
 }
 
-//------------------------ATCmdUSORF---------------------------------
-
-AT::Return_t ATCmdUSORF::send(const size_t                    socket,
-                              size_t                          bytesToRead,
-                              const std::chrono::milliseconds timeout)
+AT::Return_t ATCmdRXData::prepare(const size_t socket, size_t bytesToRead)
 {
-    if (bytesToRead > sizeof(mDataBuffer) - 2) {
+    if (isPending()) {
+        return AT::Return_t::TRY_AGAIN;
+    }
+    const size_t maxBytesToRead = mDataSink ? MAXREADLENGTH : mDataBuffer.size() - 2;
+    if (bytesToRead > maxBytesToRead) {
         Trace(ZONE_INFO, "More bytes available than readable\r\n");
-        bytesToRead = sizeof(mDataBuffer) - 2;
+        bytesToRead = maxBytesToRead;
     }
     const size_t reqLen = std::snprintf(
                                         mRequestBuffer.data(),
                                         mRequestBuffer.size(),
-                                        "AT+USORF=%d,%d\r",
+                                        "%s=%d,%d\r",
+                                        mName.data(),
                                         socket, bytesToRead);
 
     if (reqLen >= mRequestBuffer.size()) {
@@ -238,7 +379,26 @@ AT::Return_t ATCmdUSORF::send(const size_t                    socket,
     }
 
     mRequest = std::string_view(mRequestBuffer.data(), reqLen);
-    return ATCmd::send(mSendFunction, timeout);
+    return AT::Return_t::WAITING;
+}
+
+//------------------------ATCmdUSORF---------------------------------
+
+AT::Return_t ATCmdUSORF::send(const size_t                    socket,
+                              size_t                          bytesToRead,
+                              const std::chrono::milliseconds timeout)
+{
+    const Return_t prepared = prepare(socket, bytesToRead);
+    return prepared == Return_t::WAITING ? ATCmd::send(mSendFunction, timeout) : prepared;
+}
+
+AT::Return_t ATCmdUSORF::sendAsync(const size_t                    socket,
+                                   size_t                          bytesToRead,
+                                   const std::chrono::milliseconds timeout,
+                                   const Completion&               completion)
+{
+    const Return_t prepared = prepare(socket, bytesToRead);
+    return prepared == Return_t::WAITING ? ATCmd::sendAsync(mSendFunction, timeout, completion) : prepared;
 }
 
 AT::Return_t ATCmdUSORF::onResponseMatch(void)
@@ -277,7 +437,7 @@ AT::Return_t ATCmdUSORF::onResponseMatch(void)
             return AT::Return_t::ERROR;
         }
 
-        std::memcpy(mPortBuffer.data(), portstring.data(), mData.length());
+        std::memcpy(mPortBuffer.data(), portstring.data(), mPort.length());
         // ---------------- BYTES AVAILABLE ----------------------
         size_t bytesAvailable = 0;
         if (mParser->getNumberFromInput(bytesAvailable) != Return_t::FINISHED) {
@@ -305,22 +465,17 @@ AT::Return_t ATCmdUSORF::onResponseMatch(void)
 
 AT::Return_t ATCmdUSORD::send(const size_t socket, size_t bytesToRead, const std::chrono::milliseconds timeout)
 {
-    if (bytesToRead > sizeof(mDataBuffer) - 2) {
-        Trace(ZONE_INFO, "More bytes available than readable\r\n");
-        bytesToRead = sizeof(mDataBuffer) - 2;
-    }
-    const size_t reqLen = std::snprintf(
-                                        mRequestBuffer.data(),
-                                        mRequestBuffer.size(),
-                                        "AT+USORD=%d,%d\r",
-                                        socket, bytesToRead);
-    if (reqLen >= mRequestBuffer.size()) {
-        Trace(ZONE_ERROR, "snprintf failed\r\n");
-        return AT::Return_t::ERROR;
-    }
+    const Return_t prepared = prepare(socket, bytesToRead);
+    return prepared == Return_t::WAITING ? ATCmd::send(mSendFunction, timeout) : prepared;
+}
 
-    mRequest = std::string_view(mRequestBuffer.data(), reqLen);
-    return ATCmd::send(mSendFunction, timeout);
+AT::Return_t ATCmdUSORD::sendAsync(const size_t                    socket,
+                                   size_t                          bytesToRead,
+                                   const std::chrono::milliseconds timeout,
+                                   const Completion&               completion)
+{
+    const Return_t prepared = prepare(socket, bytesToRead);
+    return prepared == Return_t::WAITING ? ATCmd::sendAsync(mSendFunction, timeout, completion) : prepared;
 }
 
 AT::Return_t ATCmdUSORD::onResponseMatch(void)
@@ -600,8 +755,9 @@ void ATCmdOK::errorReceived(void)
 AT::Return_t ATCmdOK::onResponseMatch(void)
 {
     if (mParser->mWaitingCmd) {
-        mParser->mWaitingCmd->okReceived();
+        AT* const cmd = mParser->mWaitingCmd;
         mParser->mWaitingCmd = nullptr;
+        cmd->okReceived();
         return Return_t::FINISHED;
     }
     return Return_t::ERROR;
@@ -623,30 +779,278 @@ void ATCmdERROR::errorReceived(void)
 AT::Return_t ATCmdERROR::onResponseMatch(void)
 {
     if (mParser->mWaitingCmd) {
-        mParser->mWaitingCmd->errorReceived();
+        AT* const cmd = mParser->mWaitingCmd;
         mParser->mWaitingCmd = nullptr;
+        cmd->errorReceived();
         return Return_t::FINISHED;
     }
     return Return_t::ERROR;
 }
 
-//------------------------ATParser---------------------------------
+//------------------------ATResponseMatcher---------------------------------
+
+ATResponseMatcher::ATResponseMatcher(void)
+{
+    mNodes.fill(Entry {0, 0, ROOT, ROOT, nullptr});
+}
+
+bool ATResponseMatcher::insert(AT* cmd)
+{
+    const std::string_view response = cmd->mResponse;
+
+    // an empty response never matches
+    if (response.empty()) {
+        return true;
+    }
+
+    size_t depth = 0;
+    for (Node node = ROOT; depth < response.length(); depth++) {
+        node = advance(node, response[depth]);
+        if (node == ROOT) {
+            break;
+        }
+    }
+    if (mNumberOfNodes + response.length() - depth > MAXNODES) {
+        return false;
+    }
+
+    Node node = ROOT;
+    for (const char c : response) {
+        Node next = advance(node, c);
+        if (next == ROOT) {
+            next = static_cast<Node>(mNumberOfNodes++);
+            mNodes[next] = Entry {c, 0, ROOT, mNodes[node].mChild, nullptr};
+            mNodes[node].mChild = next;
+        }
+        node = next;
+        mNodes[node].mCount++;
+    }
+    if (!mNodes[node].mMatch) {
+        mNodes[node].mMatch = cmd;
+    }
+    return true;
+}
+
+ATResponseMatcher::Node ATResponseMatcher::advance(const Node node, const char c) const
+{
+    for (Node child = mNodes[node].mChild; child != ROOT; child = mNodes[child].mSibling) {
+        if (mNodes[child].mChar == c) {
+            return child;
+        }
+    }
+    return ROOT;
+}
 
-std::array<char, ATParser::BUFFERSIZE> ATParser::ReceiveBuffer;
+size_t ATResponseMatcher::getCount(const Node node) const
+{
+    return mNodes[node].mCount;
+}
+
+AT* ATResponseMatcher::getMatch(const Node node) const
+{
+    return mNodes[node].mMatch;
+}
+
+//------------------------ATParser---------------------------------
 
 ATParser::ATParser(const AT::ReceiveFunction& receive) :
     mReceive(receive), mWaitingCmd(nullptr), mWaitingCmdMutex()
 {
-    mRegisteredATCommands.fill(nullptr);
+    mWrittenCmds.fill(nullptr);
+    mQueuedCmds.fill(nullptr);
+    mFinishedCmds.fill(nullptr);
 }
 
 void ATParser::reset(void)
 {
-    if (mWaitingCmd) {
+    {
         os::LockGuard<os::Mutex> lock(mWaitingCmdMutex);
-        Trace(ZONE_INFO, "Toogle Error on waiting cmd\r\n");
-        mWaitingCmd->errorReceived();
+        if (mWaitingCmd || mNumberOfWrittenCmds || mNumberOfQueuedCmds) {
+            Trace(ZONE_INFO, "Toogle Error on waiting cmd\r\n");
+        }
         mWaitingCmd = nullptr;
+
+        // failing the written commands writes the next ones, drop the queue before
+        while (mNumberOfQueuedCmds) {
+            mFinishedCmds[mNumberOfFinishedCmds++] = mQueuedCmds[mFirstQueuedCmd];
+            mQueuedCmds[mFirstQueuedCmd]->mSuccess = false;
+            mFirstQueuedCmd = (mFirstQueuedCmd + 1) % MAXPENDINGCMDS;
+            mNumberOfQueuedCmds--;
+        }
+        failWrittenCmds();
+    }
+    runCompletions();
+}
+
+void ATParser::setPipelineDepth(const size_t depth)
+{
+    os::LockGuard<os::Mutex> lock(mWaitingCmdMutex);
+    mPipelineDepth = std::min(std::max<size_t>(depth, 1), MAXPENDINGCMDS);
+    writeNextCmd();
+}
+
+size_t ATParser::getNumberOfPendingCmds(void) const
+{
+    return mNumberOfPendingCmds;
+}
+
+bool ATParser::receiveByte(uint8_t& data, std::chrono::milliseconds timeout)
+{
+    if (mChunkBegin == mChunkEnd) {
+        mChunkBegin = 0;
+        mChunkEnd = mReceive(mChunk.data(), mChunk.size(), timeout);
+        if (!mChunkEnd) {
+            return false;
+        }
+    }
+    data = mChunk[mChunkBegin++];
+    return true;
+}
+
+/* the following are called with mWaitingCmdMutex taken */
+bool ATParser::canWrite(void) const
+{
+    return (mNumberOfWrittenCmds < mPipelineDepth) && !mPromptCmd;
+}
+
+ATCmd* ATParser::getFirstWrittenCmd(void) const
+{
+    return mNumberOfWrittenCmds ? mWrittenCmds[mFirstWrittenCmd] : nullptr;
+}
+
+bool ATParser::write(ATCmd* cmd)
+{
+    Trace(ZONE_VERBOSE, "sending: %s\r\n", cmd->mRequest.data());
+
+    mWrittenCmds[(mFirstWrittenCmd + mNumberOfWrittenCmds) % MAXPENDINGCMDS] = cmd;
+    mNumberOfWrittenCmds++;
+    if (mNumberOfWrittenCmds == 1) {
+        startNextWrittenCmd();
+    }
+    if (cmd->mWaitsForPrompt) {
+        mPromptCmd = cmd;
+    }
+
+    if ((*cmd->mPendingSend)(cmd->mRequest, cmd->mTimeout) != cmd->mRequest.length()) {
+        Trace(ZONE_ERROR, "Couldn't send\n");
+        mNumberOfWrittenCmds--;
+        if (mPromptCmd == cmd) {
+            mPromptCmd = nullptr;
+        }
+        if (!mNumberOfWrittenCmds) {
+            mWaitingCmd = nullptr;
+        }
+        return false;
+    }
+    return true;
+}
+
+void ATParser::writeNextCmd(void)
+{
+    while (mNumberOfQueuedCmds && canWrite()) {
+        ATCmd* const cmd = mQueuedCmds[mFirstQueuedCmd];
+        mFirstQueuedCmd = (mFirstQueuedCmd + 1) % MAXPENDINGCMDS;
+        mNumberOfQueuedCmds--;
+
+        if (!write(cmd)) {
+            cmd->mSuccess = false;
+            mFinishedCmds[mNumberOfFinishedCmds++] = cmd;
+        }
+    }
+}
+
+/* the modem works on the first written command now, its timeout starts */
+void ATParser::startNextWrittenCmd(void)
+{
+    ATCmd* const cmd = getFirstWrittenCmd();
+    mWaitingCmd = cmd;
+    if (cmd) {
+        cmd->mDeadline = os::Task::getTickCount() + cmd->mTimeout.count();
+    }
+}
+
+/* the modem answers in order, a final result belongs to the first written command */
+void ATParser::finish(ATCmd* cmd, const bool success)
+{
+    if (cmd != getFirstWrittenCmd()) {
+        Trace(ZONE_WARNING, "%s wasn't written\r\n", cmd->mName.data());
+        mWaitingCmd = getFirstWrittenCmd();
+        return;
+    }
+    mFirstWrittenCmd = (mFirstWrittenCmd + 1) % MAXPENDINGCMDS;
+    mNumberOfWrittenCmds--;
+    if (mPromptCmd == cmd) {
+        mPromptCmd = nullptr;
+    }
+    cmd->mSuccess = success;
+    mFinishedCmds[mNumberOfFinishedCmds++] = cmd;
+    startNextWrittenCmd();
+    writeNextCmd();
+}
+
+/* late responses couldn't be told apart, none of the written commands gets one */
+void ATParser::failWrittenCmds(void)
+{
+    while (mNumberOfWrittenCmds) {
+        ATCmd* const cmd = mWrittenCmds[mFirstWrittenCmd];
+        mFirstWrittenCmd = (mFirstWrittenCmd + 1) % MAXPENDINGCMDS;
+        mNumberOfWrittenCmds--;
+        cmd->mSuccess = false;
+        mFinishedCmds[mNumberOfFinishedCmds++] = cmd;
+    }
+    mPromptCmd = nullptr;
+    mWaitingCmd = nullptr;
+    writeNextCmd();
+}
+
+bool ATParser::expireWrittenCmd(void)
+{
+    os::LockGuard<os::Mutex> lock(mWaitingCmdMutex);
+
+    ATCmd* const cmd = getFirstWrittenCmd();
+    if (!cmd || (static_cast<int32_t>(os::Task::getTickCount() - cmd->mDeadline) < 0)) {
+        return false;
+    }
+    Trace(ZONE_VERBOSE, "Timeout: %s\r\n", cmd->mRequest.data());
+    failWrittenCmds();
+    return true;
+}
+
+std::chrono::milliseconds ATParser::getTimeUntilDeadline(void)
+{
+    os::LockGuard<os::Mutex> lock(mWaitingCmdMutex);
+
+    const ATCmd* const cmd = getFirstWrittenCmd();
+    if (!cmd) {
+        return std::chrono::milliseconds::max();
+    }
+    const int32_t remaining = cmd->mDeadline - os::Task::getTickCount();
+    return std::chrono::milliseconds(std::max<int32_t>(remaining, 0));
+}
+
+/* completions may queue commands, they run without mWaitingCmdMutex */
+void ATParser::runCompletions(void)
+{
+    while (true) {
+        ATCmd::Completion completion;
+        bool success;
+        {
+            os::LockGuard<os::Mutex> lock(mWaitingCmdMutex);
+            if (!mNumberOfFinishedCmds) {
+                return;
+            }
+            ATCmd* const cmd = mFinishedCmds[0];
+            std::copy(mFinishedCmds.begin() + 1, mFinishedCmds.begin() + mNumberOfFinishedCmds, mFinishedCmds.begin());
+            mNumberOfFinishedCmds--;
+
+            completion = cmd->mCompletion;
+            success = cmd->mSuccess;
+            cmd->mPending = false;
+            mNumberOfPendingCmds--;
+        }
+        if (completion) {
+            completion(success);
+        }
     }
 }
 
@@ -655,6 +1059,11 @@ void ATParser::triggerMatch(AT* match)
     switch (match->onResponseMatch()) {
     case AT::Return_t::WAITING:
         mWaitingCmd = match;
+        if (match == mPromptCmd) {
+            // its data is sent, the modem takes commands again
+            mPromptCmd = nullptr;
+            writeNextCmd();
+        }
         break;
 
     case AT::Return_t::ERROR:
@@ -673,24 +1082,42 @@ void ATParser::triggerMatch(AT* match)
 bool ATParser::parse(std::chrono::milliseconds timeout)
 {
     size_t currentPos = 0;
-    std::array<AT*, MAXATCMDS> possibleResponses;
-    size_t possibleResponsesCount = 0;
+    ATResponseMatcher::Node node = ATResponseMatcher::ROOT;
 
     auto resetPossibleResponses = [&] {
                                       currentPos = 0;
-                                      possibleResponsesCount = possibleResponses.size();
-                                      possibleResponses.fill(nullptr);
-                                      std::copy(mRegisteredATCommands.begin(),
-                                                mRegisteredATCommands.end(),
-                                                possibleResponses.begin());
+                                      node = ATResponseMatcher::ROOT;
                                   };
 
     Trace(ZONE_INFO, "Start Parser\r\n");
 
     resetPossibleResponses();
 
-    while (1 == mReceive(reinterpret_cast<uint8_t*>(ReceiveBuffer.data() + currentPos++), 1, timeout)) {
-        std::string_view currentData(ReceiveBuffer.data(), currentPos);
+    while (true) {
+        // between chunks only, the bytes of a chunk are parsed without delay
+        std::chrono::milliseconds wait = timeout;
+        if (mChunkBegin == mChunkEnd) {
+            runCompletions();
+
+            if (expireWrittenCmd()) {
+                resetPossibleResponses();
+                continue;
+            }
+
+            // wake up for the deadline of the written command, too
+            wait = std::min(timeout, getTimeUntilDeadline());
+        }
+
+        uint8_t data;
+        if (!receiveByte(data, wait)) {
+            if (wait < timeout) {
+                continue;
+            }
+            break;
+        }
+        mReceiveBuffer[currentPos++] = data;
+
+        std::string_view currentData(mReceiveBuffer.data(), currentPos);
         //Trace(ZONE_VERBOSE, "parse: %s\n", std::string(currentData.data(), currentData.length()).c_str());
 
         {
@@ -703,25 +1130,17 @@ bool ATParser::parse(std::chrono::milliseconds timeout)
                 continue;
             }
 
-            size_t stillMatchingCount = 0;
-            for (size_t i = 0; i < possibleResponsesCount; ++i) {
-                const auto next = possibleResponses[i];
-                if (next && (currentData == next->mResponse.substr(0, currentPos))) {
-                    possibleResponses[stillMatchingCount++] = next;
-                }
-            }
-            possibleResponsesCount = stillMatchingCount;
-
-            if (possibleResponsesCount > 1) { continue; }
+            node = mMatcher.advance(node, data);
 
-            if (possibleResponsesCount == 1) {
-                const auto matchIt = possibleResponses.begin();
+            if (node != ATResponseMatcher::ROOT) {
+                if (mMatcher.getCount(node) > 1) { continue; }
 
-                if (currentData != (*matchIt)->mResponse) {
+                AT* const match = mMatcher.getMatch(node);
+                if (!match) {
                     continue;
                 }
-                Trace(ZONE_INFO, "MATCH: %s\n", (*matchIt)->mName.data());
-                triggerMatch(*matchIt);
+                Trace(ZONE_INFO, "MATCH: %s\n", match->mName.data());
+                triggerMatch(match);
             }
         }
         resetPossibleResponses();
@@ -734,24 +1153,26 @@ bool ATParser::parse(std::chrono::milliseconds timeout)
 
 void ATParser::registerAtCommand(AT* cmd)
 {
-    if (mNumberOfRegisteredATCommands < MAXATCMDS) {
+    os::LockGuard<os::Mutex> lock(mWaitingCmdMutex);
+
+    if ((mNumberOfRegisteredATCommands < MAXATCMDS) && mMatcher.insert(cmd)) {
         cmd->mParser = this;
-        mRegisteredATCommands[mNumberOfRegisteredATCommands++] = cmd;
+        mNumberOfRegisteredATCommands++;
     } else {
         Trace(ZONE_ERROR, "Can't register more AT commands");
     }
 }
 
-std::string_view ATParser::getLineFromInput(std::chrono::milliseconds timeout) const
+std::string_view ATParser::getLineFromInput(std::chrono::milliseconds timeout)
 {
     uint8_t data;
     size_t currentPos = 0;
 
-    while (mReceive(&data, 1, timeout)) {
-        ReceiveBuffer[currentPos++] = data;
+    while (receiveByte(data, timeout)) {
+        mReceiveBuffer[currentPos++] = data;
 
         if (isLineTermination(data)) {
-            return std::string_view(ReceiveBuffer.data(), currentPos);
+            return std::string_view(mReceiveBuffer.data(), currentPos);
         }
 
         if (currentPos >= BUFFERSIZE) {
@@ -763,19 +1184,19 @@ std::string_view ATParser::getLineFromInput(std::chrono::milliseconds timeout) c
     return "";
 }
 
-std::string_view ATParser::getInputUntilComma(char* const termination, std::chrono::milliseconds timeout) const
+std::string_view ATParser::getInputUntilComma(char* const termination, std::chrono::milliseconds timeout)
 {
     uint8_t data;
     size_t currentPos = 0;
 
-    while (mReceive(&data, 1, timeout)) {
+    while (receiveByte(data, timeout)) {
         if (isValueTermination(data)) {
             if (termination != nullptr) {
                 *termination = data;
             }
-            return std::string_view(ReceiveBuffer.data(), currentPos);
+            return std::string_view(mReceiveBuffer.data(), currentPos);
         }
-        ReceiveBuffer[currentPos++] = data;
+        mReceiveBuffer[currentPos++] = data;
 
         if (currentPos >= BUFFERSIZE) {
             Trace(ZONE_ERROR, "ReceiveBufferOverflow\r\n");
@@ -786,29 +1207,36 @@ std::string_view ATParser::getInputUntilComma(char* const termination, std::chro
     return "";
 }
 
-std::string_view ATParser::getBytesFromInput(size_t numberOfBytes, std::chrono::milliseconds timeout) const
+std::string_view ATParser::getBytesFromInput(size_t numberOfBytes, std::chrono::milliseconds timeout)
 {
-    uint8_t data;
     size_t currentPos = 0;
 
     if (numberOfBytes >= BUFFERSIZE) {
         return "";
     }
 
-    while (mReceive(&data, 1, timeout)) {
-        ReceiveBuffer[currentPos++] = data;
-
-        const bool terminationFound = currentPos >= numberOfBytes;
-        if (terminationFound) {
-            return std::string_view(ReceiveBuffer.data(), currentPos);
+    // take what is left of the chunk at once, larger payloads are read directly
+    while (currentPos < numberOfBytes) {
+        if (mChunkBegin == mChunkEnd) {
+            const size_t received = mReceive(reinterpret_cast<uint8_t*>(mReceiveBuffer.data() + currentPos),
+                                              numberOfBytes - currentPos, timeout);
+            if (!received) {
+                Trace(ZONE_ERROR, "Timeout\r\n");
+                return "";
+            }
+            currentPos += received;
+            continue;
         }
+        const size_t length = std::min(numberOfBytes - currentPos, mChunkEnd - mChunkBegin);
+        std::memcpy(mReceiveBuffer.data() + currentPos, mChunk.data() + mChunkBegin, length);
+        mChunkBegin += length;
+        currentPos += length;
     }
-    Trace(ZONE_ERROR, "Timeout\r\n");
-    return "";
+    return std::string_view(mReceiveBuffer.data(), currentPos);
 }
 
 AT::Return_t ATParser::getSocketFromInput(size_t& socket, char* const termination,
-                                          std::chrono::milliseconds timeout) const
+                                          std::chrono::milliseconds timeout)
 {
     if (getNumberFromInput(socket, termination, timeout) != AT::Return_t::FINISHED) {
         return AT::Return_t::ERROR;
@@ -822,7 +1250,7 @@ AT::Return_t ATParser::getSocketFromInput(size_t& socket, char* const terminatio
 
 AT::Return_t ATParser::getNumberFromInput(size_t&                   number,
                                           char* const               termination,
-                                          std::chrono::milliseconds timeout) const
+                                          std::chrono::milliseconds timeout)
 {
     const std::string_view numstring = getInputUntilComma(termination, timeout);
     return strToNum(number, numstring);
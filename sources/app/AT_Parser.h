@@ -11,6 +11,7 @@
 #include <chrono>
 #include "os_Queue.h"
 #include "Mutex.h"
+#include "InplaceFunction.h"
 
 namespace app
 {
@@ -55,22 +56,64 @@ protected:
     friend class ATCmdERROR;
 };
 
+/*
+ * A command is a transaction on the AT channel: the request is written, the
+ * response lines are parsed and OK or ERROR ends it.
+ *
+ * sendAsync() queues the transaction at the parser and returns WAITING at
+ * once. The parser task writes the queued commands one after another and
+ * calls the completion with the result, so one task keeps the commands of
+ * many sockets in flight. The completion runs in the parser task once the
+ * next queued command is written, it may queue follow-up commands itself.
+ * send() blocks the calling task until the completion ran.
+ *
+ * The completion is only called if sendAsync() returned WAITING. The timeout
+ * is counted from the moment the modem works on the command, which is when
+ * the request is written unless it was pipelined behind others. A command is
+ * pending from sendAsync() until its completion was called. Commands failed
+ * by ATParser::reset() complete in the task calling it.
+ */
 struct ATCmd :
     AT {
+    using Completion = util::InplaceFunction<void(const bool)>;
+
+    // the modem takes at most MAXDATALENGTH bytes of socket data per write. A
+    // read returns at most MAXREADLENGTH, every parser and multiplexer channel
+    // buffers a whole one, so reads are kept smaller to save RAM
+    static constexpr const size_t MAXDATALENGTH = 1024;
+    static constexpr const size_t MAXREADLENGTH = 512;
+
     ATCmd(const std::string_view name, const std::string_view request, const std::string_view response) :
         AT(name, response),
         mRequest(request), mSendResult() {};
     virtual ~ATCmd(void){};
 
     Return_t send(SendFunction& sendFunction, const std::chrono::milliseconds timeout);
+    Return_t sendAsync(SendFunction&                   sendFunction,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
+    bool isPending(void) const;
 
 protected:
     std::string_view mRequest;
     os::Queue<bool, 1> mSendResult;
 
+    // the modem reads raw data after the prompt, nothing may be written behind the request
+    bool mWaitsForPrompt = false;
+
     virtual void okReceived(void) override;
     virtual void errorReceived(void) override;
     virtual Return_t onResponseMatch(void) override;
+
+private:
+    SendFunction* mPendingSend = nullptr;
+    std::chrono::milliseconds mTimeout = std::chrono::milliseconds(0);
+    uint32_t mDeadline = 0;
+    Completion mCompletion;
+    bool mPending = false;
+    bool mSuccess = false;
+
+    friend class ATParser;
 };
 
 struct ATCmdCGATT final :
@@ -85,16 +128,35 @@ private:
     virtual Return_t onResponseMatch(void) override;
 };
 
+/*
+ * The payload is written raw after the "@" prompt, it needs no escaping. A
+ * DataSource copies it from its owner only once the modem prompts for it,
+ * until then it stays where it is. The modem prompts for one payload at a
+ * time, so all commands share TransmitBuffer and the uart reads it in place.
+ */
 struct ATCmdTX :
     ATCmd {
+    /* copies length bytes of the payload to data, returns the number of bytes copied */
+    using DataSource = util::InplaceFunction<size_t(char*, const size_t)>;
+
 protected:
+    static std::array<char, MAXDATALENGTH> TransmitBuffer;
+
     std::array<char, 64> mRequestBuffer;
     std::string_view mData;
+    DataSource mDataSource;
+    size_t mDataLength = 0;
     SendFunction& mSendFunction;
     virtual Return_t onResponseMatch(void) override;
 
+    void setData(const std::string_view data);
+    void setData(const DataSource& source);
+
     ATCmdTX(const std::string_view name, SendFunction& send) :
-        ATCmd(name, "", "@"), mSendFunction(send){}
+        ATCmd(name, "", "@"), mSendFunction(send)
+    {
+        mWaitsForPrompt = true;
+    }
 };
 
 struct ATCmdUSOST final :
@@ -107,6 +169,23 @@ struct ATCmdUSOST final :
                   const std::string_view          port,
                   const std::string_view          data,
                   const std::chrono::milliseconds timeout);
+    Return_t sendAsync(const size_t                    socket,
+                       const std::string_view          ip,
+                       const std::string_view          port,
+                       const std::string_view          data,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
+    Return_t sendAsync(const size_t                    socket,
+                       const std::string_view          ip,
+                       const std::string_view          port,
+                       const size_t                    length,
+                       const DataSource&               source,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
+
+private:
+    Return_t prepare(const size_t socket, const std::string_view ip, const std::string_view port,
+                     const size_t length);
 };
 
 struct ATCmdUSOWR final :
@@ -117,21 +196,45 @@ struct ATCmdUSOWR final :
     Return_t send(const size_t                    socket,
                   const std::string_view          data,
                   const std::chrono::milliseconds timeout);
+    Return_t sendAsync(const size_t                    socket,
+                       const std::string_view          data,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
+    Return_t sendAsync(const size_t                    socket,
+                       const size_t                    length,
+                       const DataSource&               source,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
+
+private:
+    Return_t prepare(const size_t socket, const size_t length);
 };
 
+/*
+ * The modem returns the payload raw between quotes, its length tells where
+ * it ends. Without a DataSink up to 254 bytes are kept for getData(). A
+ * DataSink takes up to MAXREADLENGTH bytes straight from the receive buffer
+ * of the parser instead, it runs in the parser task while the response is
+ * parsed and mustn't send AT commands.
+ */
 struct ATCmdRXData :
     ATCmd {
+    using DataSink = util::InplaceFunction<void(const std::string_view)>;
+
     std::string_view getData(void) const;
+    void setDataSink(const DataSink& sink);
 
 protected:
     std::array<char, 24> mRequestBuffer;
     std::array<char, 256> mDataBuffer;
     std::string_view mData;
+    DataSink mDataSink;
     size_t mSocket = 0;
     SendFunction& mSendFunction;
     const std::function<void(const size_t, const size_t)>& mUrcReceivedCallback;
 
     AT::Return_t getDataFromParser(const size_t bytesAvailable);
+    AT::Return_t prepare(const size_t socket, size_t bytesToRead);
 
     ATCmdRXData(const std::string_view name,
                 const std::string_view response,
@@ -148,6 +251,10 @@ struct ATCmdUSORF final :
         ATCmdRXData("AT+USORF", "+USORF:", send, callback){}
 
     Return_t send(const size_t socket, size_t bytesToRead, const std::chrono::milliseconds timeout);
+    Return_t sendAsync(const size_t                    socket,
+                       size_t                          bytesToRead,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
 
 private:
 
@@ -166,6 +273,10 @@ struct ATCmdUSORD final :
         ATCmdRXData("AT+USORD", "+USORD:", send, callback){}
 
     Return_t send(const size_t socket, size_t bytesToRead, const std::chrono::milliseconds timeout);
+    Return_t sendAsync(const size_t                    socket,
+                       size_t                          bytesToRead,
+                       const std::chrono::milliseconds timeout,
+                       const Completion&               completion);
 
 private:
     virtual Return_t onResponseMatch(void) override;
@@ -293,9 +404,54 @@ private:
     virtual Return_t onResponseMatch(void) override;
 };
 
+/*
+ * Prefix tree over the responses of the registered commands. The parser
+ * advances it by one node per received character instead of comparing the
+ * received line with every registered response again. Children are linked
+ * as siblings, a character only walks the responses diverging at its
+ * position. Every node counts the responses sharing its prefix, a response
+ * registered twice never matches without its command waiting for it.
+ */
+struct ATResponseMatcher final {
+    using Node = uint8_t;
+    static constexpr const size_t MAXNODES = 128;
+    static constexpr const Node ROOT = 0;
+
+    ATResponseMatcher(void);
+
+    ATResponseMatcher(const ATResponseMatcher&) = delete;
+    ATResponseMatcher(ATResponseMatcher&&) = delete;
+    ATResponseMatcher& operator=(const ATResponseMatcher&) = delete;
+    ATResponseMatcher& operator=(ATResponseMatcher&&) = delete;
+
+    /* false if the nodes ran out, the tree is left unchanged then */
+    bool insert(AT* cmd);
+    /* ROOT if no response continues with c */
+    Node advance(const Node node, const char c) const;
+    /* number of responses starting with the prefix of node */
+    size_t getCount(const Node node) const;
+    /* the command whose response ends at node, nullptr if none */
+    AT* getMatch(const Node node) const;
+
+private:
+    struct Entry {
+        char mChar;
+        uint8_t mCount;
+        Node mChild;
+        Node mSibling;
+        AT* mMatch;
+    };
+
+    std::array<Entry, MAXNODES> mNodes;
+    size_t mNumberOfNodes = 1;
+};
+
 struct ATParser final {
-    static constexpr const size_t BUFFERSIZE = 512;
-    static constexpr const size_t MAXATCMDS = 32;
+    // holds a whole socket payload of a read with its quotes
+    static constexpr const size_t BUFFERSIZE = ATCmd::MAXREADLENGTH + 64;
+    static constexpr const size_t CHUNKSIZE = 64;
+    static constexpr const size_t MAXATCMDS = 64;
+    static constexpr const size_t MAXPENDINGCMDS = 8;
     static constexpr const std::chrono::milliseconds defaultTimeout = std::chrono::milliseconds(300);
     static constexpr const std::chrono::milliseconds defaultParseTimeout = std::chrono::milliseconds(45000);
 
@@ -304,33 +460,73 @@ struct ATParser final {
 
     ATParser(const AT::ReceiveFunction& receive);
 
+    /* fails the written and all queued commands */
     void reset(void);
+    /*
+     * Number of commands written back-to-back without waiting for the final
+     * result of the previous ones, 1 by default. Only for modems that queue
+     * commands, their responses are matched to the written commands in order.
+     */
+    void setPipelineDepth(const size_t depth);
     void triggerMatch(AT* match);
     bool parse(std::chrono::milliseconds timeout = defaultParseTimeout);
     void registerAtCommand(AT* cmd);
-    std::string_view getLineFromInput(std::chrono::milliseconds timeout = defaultTimeout) const;
+    size_t getNumberOfPendingCmds(void) const;
+    std::string_view getLineFromInput(std::chrono::milliseconds timeout = defaultTimeout);
     std::string_view getInputUntilComma(char* const               termination = nullptr,
-                                        std::chrono::milliseconds timeout = defaultTimeout) const;
+                                        std::chrono::milliseconds timeout = defaultTimeout);
     std::string_view getBytesFromInput(size_t                    numberOfBytes,
-                                       std::chrono::milliseconds timeout = defaultTimeout) const;
+                                       std::chrono::milliseconds timeout = defaultTimeout);
     AT::Return_t getSocketFromInput(size_t&                   socket,
                                     char* const               termination = nullptr,
-                                    std::chrono::milliseconds timeout = defaultTimeout) const;
+                                    std::chrono::milliseconds timeout = defaultTimeout);
     AT::Return_t getNumberFromInput(size_t&                   number,
                                     char* const               termination = nullptr,
-                                    std::chrono::milliseconds timeout = defaultTimeout) const;
+                                    std::chrono::milliseconds timeout = defaultTimeout);
     AT::Return_t strToNum(size_t&                number,
                           const std::string_view numstring) const;
 
 private:
-    static std::array<char, BUFFERSIZE> ReceiveBuffer;
+    // every parser owns its buffer, one runs per channel of a multiplexed modem
+    std::array<char, BUFFERSIZE> mReceiveBuffer;
 
     const AT::ReceiveFunction& mReceive;
-    std::array<AT*, MAXATCMDS> mRegisteredATCommands;
     size_t mNumberOfRegisteredATCommands = 0;
+    ATResponseMatcher mMatcher;
+
+    // the receive function is read in chunks, the parser consumes them bytewise
+    std::array<uint8_t, CHUNKSIZE> mChunk;
+    size_t mChunkBegin = 0;
+    size_t mChunkEnd = 0;
     AT* mWaitingCmd;
     os::Mutex mWaitingCmdMutex;
 
+    // guarded by mWaitingCmdMutex, a pending command is either written, queued or finished.
+    // The first written command is the one the modem works on, mWaitingCmd follows it.
+    std::array<ATCmd*, MAXPENDINGCMDS> mWrittenCmds;
+    size_t mFirstWrittenCmd = 0;
+    size_t mNumberOfWrittenCmds = 0;
+    size_t mPipelineDepth = 1;
+    ATCmd* mPromptCmd = nullptr;
+    std::array<ATCmd*, MAXPENDINGCMDS> mQueuedCmds;
+    size_t mFirstQueuedCmd = 0;
+    size_t mNumberOfQueuedCmds = 0;
+    std::array<ATCmd*, MAXPENDINGCMDS> mFinishedCmds;
+    size_t mNumberOfFinishedCmds = 0;
+    size_t mNumberOfPendingCmds = 0;
+
+    bool receiveByte(uint8_t& data, std::chrono::milliseconds timeout);
+    bool canWrite(void) const;
+    ATCmd* getFirstWrittenCmd(void) const;
+    bool write(ATCmd* cmd);
+    void writeNextCmd(void);
+    void startNextWrittenCmd(void);
+    void finish(ATCmd* cmd, const bool success);
+    void failWrittenCmds(void);
+    bool expireWrittenCmd(void);
+    std::chrono::milliseconds getTimeUntilDeadline(void);
+    void runCompletions(void);
+
     friend class ATCmdOK;
     friend class ATCmdERROR;
     friend class ATCmd;
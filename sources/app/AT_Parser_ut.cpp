@@ -3,147 +3,108 @@
  * Copyright (c) 2014-2018 Nils Weiss
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "unittest.h"
+#include "TaskInterruptable.h"
+#include "os_StreamBuffer.h"
 #include "AT_Parser.h"
-#include <condition_variable>
-#include <thread>
-#include <mutex>
-#include "os_Queue.h"
 
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
-using os::Mutex;
-
-#define NUM_TEST_LOOPS 255
-
 //--------------------------BUFFERS--------------------------
-bool g_semaphoreGiven = false;
-
-//--------------------------MOCKING--------------------------
-
-void os::ThisTask::sleep(const std::chrono::milliseconds ms)
-{
-    std::this_thread::sleep_for(ms);
-}
-
-Mutex::Mutex(void) :
-    mMutexHandle((SemaphoreHandle_t) new std::mutex)
-{}
-
-Mutex::Mutex(Mutex&& rhs) :
-    mMutexHandle(rhs.mMutexHandle)
-{
-    rhs.mMutexHandle = nullptr;
-}
-
-Mutex& Mutex::operator=(Mutex&& rhs)
-{
-    mMutexHandle = rhs.mMutexHandle;
-    rhs.mMutexHandle = nullptr;
-    return *this;
-}
-
-Mutex::~Mutex(void)
-{
-    delete (int*)mMutexHandle;
-    mMutexHandle = nullptr;
-}
+static constexpr const size_t STACKSIZE = 1024;
+static constexpr const std::chrono::milliseconds PARSER_TIMEOUT(500);
 
-bool Mutex::take(uint32_t ticksToWait) const
+/*
+ * Plays the modem behind the AT channel: everything written is recorded and
+ * answered by the response scripted for the first request it starts with.
+ * The answer follows the request, so the command is always waiting for it.
+ */
+class ScriptedChannel final
 {
-    if (*this) {
-        std::mutex* m = reinterpret_cast<std::mutex*>(mMutexHandle);
-        m->lock();
-        return true;
+    os::StreamBuffer<char, 1024> mFromModem;
+    std::mutex mMutex;
+    std::string mWritten;
+    std::vector<std::pair<std::string, std::string> > mScript;
+
+public:
+    app::AT::SendFunction mSend;
+    app::AT::ReceiveFunction mReceive;
+
+    ScriptedChannel(void) :
+        mSend([this](std::string_view data, std::chrono::milliseconds) -> size_t {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWritten.append(data.data(), data.length());
+        for (const auto& entry : mScript) {
+            if (data.substr(0, entry.first.length()) == entry.first) {
+                push(entry.second);
+                break;
+            }
+        }
+        return data.length();
+    }),
+        mReceive([this](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
+        return mFromModem.receive(reinterpret_cast<char*>(data), length, timeout);
+    }) {}
+
+    void answer(const std::string& request, const std::string& response)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mScript.emplace_back(request, response);
     }
 
-    return false;
-}
-
-bool Mutex::give(void) const
-{
-    if (*this) {
-        std::mutex* m = reinterpret_cast<std::mutex*>(mMutexHandle);
-        m->unlock();
-        return true;
+    void push(const std::string_view data)
+    {
+        mFromModem.send(data.data(), data.length());
     }
-    return false;
-}
-
-Mutex::operator bool() const
-{
-    return mMutexHandle != nullptr;
-}
-
-QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength,
-                                  const UBaseType_t uxItemSize,
-                                  const uint8_t     ucQueueType)
-{
-    auto vec = new std::vector<char>;
-    Trace(ZONE_INFO, "Handle is: %x\r\n", (unsigned long)vec);
-    return (QueueHandle_t)vec;
-}
-
-void vQueueDelete(QueueHandle_t xQueue)
-{
-    Trace(ZONE_INFO, "Handle is: %x\r\n", (unsigned long)xQueue);
-
-    delete (std::vector<char>*)xQueue;
-}
 
-BaseType_t xQueueGenericSend(QueueHandle_t     xQueue,
-                             const void* const pvItemToQueue,
-                             TickType_t        xTicksToWait,
-                             const BaseType_t  xCopyPosition)
-{
-    Trace(ZONE_INFO, "Handle is: %x\r\n", (unsigned long)xQueue);
-
-    std::vector<char>* vec = (std::vector<char>*)xQueue;
-    vec->push_back(*(const char* const)pvItemToQueue);
-    Trace(ZONE_INFO, "QueueSend: 0x%x\r\n", *(const char* const)pvItemToQueue);
-    return 0;
-}
-
-BaseType_t xQueueGenericReset(QueueHandle_t xQueue, BaseType_t xNewQueue)
-{
-    Trace(ZONE_INFO, "Handle is: %x\r\n", (unsigned long)xQueue);
-
-    std::vector<char>* vec = (std::vector<char>*)xQueue;
-    vec->clear();
-    return 0;
-}
-
-BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t* const pxHigherPriorityTaskWoken)
-{
-    Trace(ZONE_INFO, "Handle is: %x\r\n", (unsigned long)xQueue);
-
-    std::vector<char>* vec = (std::vector<char>*)xQueue;
-    Trace(ZONE_INFO, "QueueSend: %c\r\n", *(const char* const)'1');
-    return 0;
-}
+    std::string getWritten(void)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWritten;
+    }
+};
 
-BaseType_t xQueueReceive(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait)
+/* runs the parser task like the ModemDriver as long as it exists */
+class ParserTask final
 {
-    Trace(ZONE_INFO, "Recv: Handle is: %x\r\n", (unsigned long)xQueue);
-
-    std::vector<char>* vec = (std::vector<char>*)xQueue;
-    TickType_t count = 0;
-    while (vec->size() == 0 && count < xTicksToWait) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        count = +10;
+    std::atomic<bool> mRunning {true};
+    os::TaskInterruptable mTask;
+
+public:
+    ParserTask(app::ATParser& parser) :
+        mTask("Parser", STACKSIZE, os::Task::Priority::VERY_HIGH, [this, &parser](const bool&) {
+        while (mRunning) {
+            parser.parse(PARSER_TIMEOUT);
+        }
+    }) {}
+
+    ~ParserTask(void)
+    {
+        mRunning = false;
+        mTask.join();
     }
-    if (vec->size()) {
-        Trace(ZONE_INFO, "Recv: Handle is: %x receiving\r\n", (unsigned long)xQueue);
+};
 
-        char x = vec->back();
-        vec->pop_back();
-
-        *(char* const)pvBuffer = x;
-        return 1;
+template<typename T>
+static bool waitFor(const T& condition)
+{
+    for (size_t i = 0; i < 1000; i++) {
+        if (condition()) {
+            return true;
+        }
+        os::ThisTask::sleep(std::chrono::milliseconds(1));
     }
-    Trace(ZONE_INFO, "Recv: Handle is: %x timeout\r\n", (unsigned long)xQueue);
-
-    return 0;
+    return false;
 }
 
 //-------------------------TESTCASES-------------------------
@@ -151,149 +112,28 @@ BaseType_t xQueueReceive(QueueHandle_t xQueue, void* const pvBuffer, TickType_t
 int ut_BasicTest(void)
 {
     TestCaseBegin();
-
-    std::condition_variable cv;
-    std::mutex cv_m;
-    int i = 0;
-
-    static std::string testString = " ";
-
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
-        [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
-            });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [](std::string_view in, std::chrono::milliseconds) -> size_t {
-            return in.length();
-        };
-
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_1", "REQ1", "RESP1"));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-
-    parser.registerAtCommand(testee1.get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
-
-    auto send1 = [&](int j = 2)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-
-                         Trace(ZONE_INFO, "Hello %d\r\n", j);
-                         testString += "\rOK\r";
-                     }
-                     auto ret = app::AT::Return_t::TRY_AGAIN;
-                     while (ret == app::AT::Return_t::TRY_AGAIN) {
-                         ret = std::dynamic_pointer_cast<app::ATCmd>(testee3)->send(send,
-                                                                                    std::chrono::milliseconds(2000));
-                         std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                         testString += "\rOK\r";
-                     }
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto send2 = [&](int j = 0)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-                         testString += "\rRESP2\rOK\r";
-                         Trace(ZONE_INFO, "Hello %d\r\n", j);
-                     }
-                     auto ret =
-                         std::dynamic_pointer_cast<app::ATCmd>(testee2)->send(send, std::chrono::milliseconds(2000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto parse = [&](int j = 1)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-                     }
-                     Trace(ZONE_INFO, "Hello %d\r\n", j);
-
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(1000));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       Trace(ZONE_INFO, "Signal");
-
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 0;
-                       }
-                       cv.notify_all();
-
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 1;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 2;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 3;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                   };
-
-    std::thread t0(send2, 1), t1(parse, 0), t2(send1, 2), t3(signals);
-    Trace(ZONE_INFO, "Wait \r\n");
-
-    t0.join();
-    t1.join();
-    t2.join();
-    t3.join();
-
+    ScriptedChannel channel;
+    channel.answer("REQ2", "\r\nRESP2\r\n\r\nOK\r\n");
+    channel.answer("REQ3", "\r\nERROR\r\n");
+
+    app::ATParser parser(channel.mReceive);
+    app::ATCmd testee1("CMD_1", "REQ1", "RESP1");
+    app::ATCmd testee2("CMD_2", "REQ2", "RESP2");
+    app::ATCmd testee3("CMD_3", "REQ3", "REsp3");
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&testee3);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    CHECK(testee2.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(testee3.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::ERROR);
+    CHECK(testee2.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(channel.getWritten() == "REQ2REQ3REQ2");
+    CHECK(parser.getNumberOfPendingCmds() == 0);
     TestCaseEnd();
 }
 
@@ -308,7 +148,7 @@ int ut_ATParserURCTest(void)
         [&](uint8_t* data, const size_t length, std::chrono::milliseconds) -> size_t {
             size_t i = 0;
             for ( ; i < length && pos != testString.end(); i++) {
-                *data = *pos++;
+                data[i] = *pos++;
             }
             return i;
         };
@@ -365,848 +205,422 @@ int ut_ATParserURCTest(void)
 int ut_USOSTTest(void)
 {
     TestCaseBegin();
-
-    std::condition_variable cv;
-    std::mutex cv_m;
-    int i = 0;
-
-    static std::string testString = " ";
-    static std::string recvString(80, '\x00');
-    static auto pos_r = recvString.begin();
-
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
-        [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
-            });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [&](std::string_view in, std::chrono::milliseconds) -> size_t {
-            size_t i = 0;
-            for ( ; i < in.length() && pos_r != recvString.end(); i++) {
-                *pos_r++ = in[i];
-            }
-            return i;
-        };
-
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::ATCmdUSOST>(new app::ATCmdUSOST(send));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-    auto testee6 = std::shared_ptr<app::ATCmdUSOWR>(new app::ATCmdUSOWR(send));
-
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee1).get());
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee6).get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
-
-    auto send1 = [&](int j = 2)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-
-                         Trace(ZONE_INFO, "Hello %d\r\n", j);
-                         testString += "\rOK\r";
-                     }
-                     auto ret =
-                         std::dynamic_pointer_cast<app::ATCmd>(testee3)->send(send, std::chrono::milliseconds(2000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto send2 = [&](int j = 0)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-                         testString += "@\rOK\rERROR\r";
-                         Trace(ZONE_INFO, "Hello %d\r\n", j);
-                     }
-                     auto ret = std::dynamic_pointer_cast<app::ATCmdUSOST>(testee1)->send(0,
-                                                                                          "ip",
-                                                                                          "port",
-                                                                                          "hello",
-                                                                                          std::chrono::milliseconds(
-                                                                                                                    1000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto parse = [&](int j = 1)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-                     }
-                     Trace(ZONE_INFO, "Hello %d\r\n", j);
-
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(100));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       Trace(ZONE_INFO, "Signal");
-
-                       std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 0;
-                       }
-                       cv.notify_all();
-
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 1;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 2;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 3;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                   };
-
-    std::thread t0(send2, 1), t1(parse, 0), t2(send1, 2), t3(signals);
-    Trace(ZONE_INFO, "Wait \r\n");
-
-    t0.join();
-    t1.join();
-    t2.join();
-    t3.join();
-
+    ScriptedChannel channel;
+    channel.answer("AT+USOST", "\r\n@");
+    channel.answer("hello", "\r\n+USOST: 0,5\r\n\r\nOK\r\n");
+
+    app::ATParser parser(channel.mReceive);
+    app::ATCmdUSOST testee1(channel.mSend);
+    app::ATCmdUSOWR testee2(channel.mSend);
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    CHECK(testee1.send(0, "ip", "port", "hello", std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(channel.getWritten() == "AT+USOST=0,\"ip\",port,5\rhello");
+
+    // nothing to send isn't written at all
+    CHECK(testee1.send(0, "ip", "port", "", std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(channel.getWritten() == "AT+USOST=0,\"ip\",port,5\rhello");
     TestCaseEnd();
 }
-int ut_USOWR1Test(void)
-{
-    Trace(ZONE_INFO, "ut_USOWR1Test\r\n");
 
+int ut_USOWRTest(void)
+{
     TestCaseBegin();
-
-    std::condition_variable cv;
-    std::mutex cv_m;
-    const int MAXSIGNALS = 4;
-    int globalSignal = 0;
-
-    static std::string testString = " ";
-    static std::string recvString(80, '\x00');
-    static auto pos_r = recvString.begin();
-
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
-        [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
-            });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [&](std::string_view in, std::chrono::milliseconds) -> size_t {
-            size_t i = 0;
-            for ( ; i < in.length() && pos_r != recvString.end(); i++) {
-                *pos_r++ = in[i];
-            }
-            return i;
-        };
-
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::ATCmdUSOST>(new app::ATCmdUSOST(send));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-    auto testee6 = std::shared_ptr<app::ATCmdUSOWR>(new app::ATCmdUSOWR(send));
-
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee1).get());
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee6).get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
-
-    auto waitForSignal = [&globalSignal](const int sig, std::condition_variable& cv, std::mutex& m,
-                                         std::function<void()> doSomethingWithMutexLock = [] {}){
-                             Trace(ZONE_INFO, "Sleep %d\r\n", sig);
-                             {
-                                 std::unique_lock<std::mutex> lk(m);
-                                 auto eval = [&] {
-                                                 return sig == globalSignal;
-                                             };
-                                 cv.wait(lk, eval);
-                                 doSomethingWithMutexLock();
-                                 Trace(ZONE_INFO, "Hello %d\r\n", sig);
-                             }
-                         };
-
-    auto send2 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "\rOK\r";
-        });
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmd>(testee3);
-                     auto ret = ptr->send(send, std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto send1 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "ERROR\rOK\rERROR\r";
-        });
-                     Trace(ZONE_INFO, "sending\r\n");
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmdUSOWR>(testee6);
-                     auto ret = ptr->send(0, "hello", std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::ERROR);
-                 };
-
-    auto parse = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m);
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(1000));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       for (int i = 0; i < MAXSIGNALS; i++) {
-                           std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                           {
-                               std::lock_guard<std::mutex> lk(cv_m);
-                               globalSignal = i;
-                           }
-                           cv.notify_all();
-                       }
-                   };
-
-    std::vector<std::thread> threads;
-    threads.emplace_back(send1, 1);
-    threads.emplace_back(parse, 0);
-    threads.emplace_back(send2, 2);
-    threads.emplace_back(signals);
-
-    for (auto& x : threads) {
-        x.join();
-    }
-
+    ScriptedChannel channel;
+    channel.answer("AT+USOWR=0", "\r\nERROR\r\n");
+    channel.answer("AT+USOWR=1", "\r\n@");
+    channel.answer("hello", "\r\n+USOWR: 1,5\r\n\r\nOK\r\n");
+
+    app::ATParser parser(channel.mReceive);
+    app::ATCmdUSOST testee1(channel.mSend);
+    app::ATCmdUSOWR testee2(channel.mSend);
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    // the modem refused, the data mustn't follow
+    CHECK(testee2.send(0, "hello", std::chrono::milliseconds(400)) == app::AT::Return_t::ERROR);
+    CHECK(channel.getWritten() == "AT+USOWR=0,5\r");
+
+    CHECK(testee2.send(1, "hello", std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(channel.getWritten() == "AT+USOWR=0,5\rAT+USOWR=1,5\rhello");
     TestCaseEnd();
 }
 
-int ut_USOWR2Test(void)
+int ut_TimeoutTest(void)
 {
-    Trace(ZONE_INFO, "ut_USOWR2Test\r\n");
-
     TestCaseBegin();
-
-    std::condition_variable cv;
-    std::mutex cv_m;
-    const int MAXSIGNALS = 5;
-    int globalSignal = 0;
-
-    static std::string testString = " ";
-    static std::string recvString(80, '\x00');
-    static auto pos_r = recvString.begin();
-
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
-        [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
-            });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [&](std::string_view in, std::chrono::milliseconds) -> size_t {
-            size_t i = 0;
-            for ( ; i < in.length() && pos_r != recvString.end(); i++) {
-                *pos_r++ = in[i];
-            }
-            return i;
-        };
-
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::ATCmdUSOST>(new app::ATCmdUSOST(send));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-    auto testee6 = std::shared_ptr<app::ATCmdUSOWR>(new app::ATCmdUSOWR(send));
-
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee1).get());
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee6).get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
-
-    auto waitForSignal = [&globalSignal](const int sig, std::condition_variable& cv, std::mutex& m,
-                                         std::function<void()> doSomethingWithMutexLock = [] {}){
-                             Trace(ZONE_INFO, "Sleep %d\r\n", sig);
-                             {
-                                 std::unique_lock<std::mutex> lk(m);
-                                 auto eval = [&] {
-                                                 return sig == globalSignal;
-                                             };
-                                 cv.wait(lk, eval);
-                                 doSomethingWithMutexLock();
-                                 Trace(ZONE_INFO, "Hello %d\r\n", sig);
-                             }
-                         };
-
-    auto send2 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "@\r";
-        });
-                 };
-
-    auto send3 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "OK\r";
-        });
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmd>(testee3);
-                     auto ret = ptr->send(send, std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::TRY_AGAIN);
-                     Trace(ZONE_INFO, "received: %s\r\n", recvString.c_str());
-                     CHECK(recvString.find("hello") != std::string::npos)
-                 };
-
-    auto send1 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "@\rERROR\rERROR\r";
-        });
-                     Trace(ZONE_INFO, "sending\r\n");
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmdUSOWR>(testee6);
-                     auto ret = ptr->send(0, "hello", std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::ERROR);
-                     ret = ptr->send(0, "hello", std::chrono::milliseconds(2000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto parse = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m);
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(1000));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       for (int i = 0; i < MAXSIGNALS; i++) {
-                           std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                           {
-                               std::lock_guard<std::mutex> lk(cv_m);
-                               globalSignal = i;
-                           }
-                           cv.notify_all();
-                       }
-                   };
-
-    std::vector<std::thread> threads;
-    threads.emplace_back(send1, 1);
-    threads.emplace_back(parse, 0);
-    threads.emplace_back(send2, 2);
-    threads.emplace_back(send3, 3);
-    threads.emplace_back(signals);
-
-    for (auto& x : threads) {
-        x.join();
-    }
-
+    ScriptedChannel channel;
+    channel.answer("REQ2", "\r\nOK\r\n");
+
+    app::ATParser parser(channel.mReceive);
+    app::ATCmd testee1("CMD_1", "REQ1", "RESP1");
+    app::ATCmd testee2("CMD_2", "REQ2", "RESP2");
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(testee1.send(channel.mSend, std::chrono::milliseconds(100)) == app::AT::Return_t::ERROR);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(elapsed >= std::chrono::milliseconds(100));
+    CHECK(elapsed < PARSER_TIMEOUT);
+
+    // a late answer is dropped, the parser goes on with the next command
+    channel.push("\r\nOK\r\n");
+    CHECK(testee2.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(parser.getNumberOfPendingCmds() == 0);
     TestCaseEnd();
 }
 
-int ut_USOWR3Test(void)
+int ut_QueuedCmdsTest(void)
 {
-    Trace(ZONE_INFO, "ut_USOWR3Test\r\n");
-
     TestCaseBegin();
-
-    std::condition_variable cv;
-    std::mutex cv_m;
-    const int MAXSIGNALS = 5;
-    int globalSignal = 0;
-
-    static std::string testString = " ";
-    static std::string recvString(80, '\x00');
-    static auto pos_r = recvString.begin();
-
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
-        [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
-            });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [&](std::string_view in, std::chrono::milliseconds) -> size_t {
-            size_t i = 0;
-            for ( ; i < in.length() && pos_r != recvString.end(); i++) {
-                *pos_r++ = in[i];
-            }
-            return i;
-        };
-
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::ATCmdUSOST>(new app::ATCmdUSOST(send));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-    auto testee6 = std::shared_ptr<app::ATCmdUSOWR>(new app::ATCmdUSOWR(send));
-
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee1).get());
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee6).get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
-
-    auto waitForSignal = [&globalSignal](const int sig, std::condition_variable& cv, std::mutex& m,
-                                         std::function<void()> doSomethingWithMutexLock = [] {}){
-                             Trace(ZONE_INFO, "Sleep %d\r\n", sig);
-                             {
-                                 std::unique_lock<std::mutex> lk(m);
-                                 auto eval = [&] {
-                                                 return sig == globalSignal;
-                                             };
-                                 cv.wait(lk, eval);
-                                 doSomethingWithMutexLock();
-                                 Trace(ZONE_INFO, "Hello %d\r\n", sig);
-                             }
-                         };
-
-    auto send2 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "@\r";
-        });
-                 };
-
-    auto send3 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "ERROR\r";
-        });
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmd>(testee3);
-                     auto ret = ptr->send(send, std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::TRY_AGAIN);
-                     Trace(ZONE_INFO, "received: %s\r\n", recvString.c_str());
-                     CHECK(recvString.find("hello") != std::string::npos)
-                 };
-
-    auto send1 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "@\rERROR\rERROR\r";
-        });
-                     Trace(ZONE_INFO, "sending\r\n");
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmdUSOWR>(testee6);
-                     auto ret = ptr->send(0, "hello", std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::ERROR);
-                     ret = ptr->send(0, "hello", std::chrono::milliseconds(2000));
-                     CHECK(ret == app::AT::Return_t::ERROR);
-                 };
-
-    auto parse = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m);
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(1000));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       for (int i = 0; i < MAXSIGNALS; i++) {
-                           std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                           {
-                               std::lock_guard<std::mutex> lk(cv_m);
-                               globalSignal = i;
-                           }
-                           cv.notify_all();
-                       }
-                   };
-
-    std::vector<std::thread> threads;
-    threads.emplace_back(send1, 1);
-    threads.emplace_back(parse, 0);
-    threads.emplace_back(send2, 2);
-    threads.emplace_back(send3, 3);
-    threads.emplace_back(signals);
-
-    for (auto& x : threads) {
-        x.join();
-    }
-
+    ScriptedChannel channel;
+    channel.answer("REQ2", "\r\nRESP2\r\n\r\nOK\r\n");
+
+    app::ATParser parser(channel.mReceive);
+    app::ATCmd testee1("CMD_1", "REQ1", "RESP1");
+    app::ATCmd testee2("CMD_2", "REQ2", "RESP2");
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    std::atomic<bool> sent {false};
+    os::TaskInterruptable sender("Sender", STACKSIZE, os::Task::Priority::MEDIUM, [&](const bool&) {
+        CHECK(testee1.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+        sent = true;
+    });
+    CHECK(waitFor([&] {return channel.getWritten() == "REQ1"; }));
+
+    // written after the first one completed, a pending command can't be sent twice
+    std::atomic<int> result {-1};
+    CHECK(testee2.sendAsync(channel.mSend, std::chrono::milliseconds(400), [&](const bool success) {
+        result = success;
+    }) == app::AT::Return_t::WAITING);
+    CHECK(testee2.isPending());
+    CHECK(parser.getNumberOfPendingCmds() == 2);
+    CHECK(testee1.sendAsync(channel.mSend, std::chrono::milliseconds(400), [](const bool) {}) ==
+          app::AT::Return_t::TRY_AGAIN);
+    CHECK(channel.getWritten() == "REQ1");
+
+    channel.push("\r\nRESP1\r\n\r\nOK\r\n");
+    CHECK(waitFor([&] {return result != -1; }));
+    sender.join();
+    CHECK(sent);
+    CHECK(result == 1);
+    CHECK(channel.getWritten() == "REQ1REQ2");
+    CHECK(parser.getNumberOfPendingCmds() == 0);
     TestCaseEnd();
 }
 
-int ut_USOST2Test(void)
+int ut_PipelinedCmdsTest(void)
 {
-    Trace(ZONE_INFO, "ut_USOST2Test\r\n");
-
     TestCaseBegin();
-
-    std::condition_variable cv;
-    std::mutex cv_m;
-    const int MAXSIGNALS = 4;
-    int globalSignal = 0;
-
-    static std::string testString = " ";
-    static std::string recvString(80, '\x00');
-    static auto pos_r = recvString.begin();
-
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
-        [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
+    ScriptedChannel channel;
+    channel.answer("AT+USOWR", "\r\n@");
+
+    app::ATParser parser(channel.mReceive);
+    parser.setPipelineDepth(3);
+    app::ATCmd testee1("CMD_1", "REQ1", "RESP1");
+    app::ATCmd testee2("CMD_2", "REQ2", "RESP2");
+    app::ATCmd testee3("CMD_3", "REQ3", "RESP3");
+    app::ATCmdUSOWR testee4(channel.mSend);
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&testee3);
+    parser.registerAtCommand(&testee4);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    std::array<std::atomic<int>, 4> results;
+    auto sendAsync = [&](app::ATCmd& cmd, const size_t i, const std::chrono::milliseconds timeout) {
+                         results[i] = -1;
+                         return cmd.sendAsync(channel.mSend, timeout, [&results, i](const bool success) {
+                results[i] = success;
             });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [&](std::string_view in, std::chrono::milliseconds) -> size_t {
-            size_t i = 0;
-            for ( ; i < in.length() && pos_r != recvString.end(); i++) {
-                *pos_r++ = in[i];
-            }
-            return i;
-        };
-
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::ATCmdUSOST>(new app::ATCmdUSOST(send));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-    auto testee6 = std::shared_ptr<app::ATCmdUSOWR>(new app::ATCmdUSOWR(send));
-
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee1).get());
-    parser.registerAtCommand(std::dynamic_pointer_cast<app::AT>(testee6).get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
+                     };
+
+    // written back-to-back, the final results are assigned in order
+    CHECK(sendAsync(testee1, 0, std::chrono::milliseconds(400)) == app::AT::Return_t::WAITING);
+    CHECK(sendAsync(testee2, 1, std::chrono::milliseconds(400)) == app::AT::Return_t::WAITING);
+    CHECK(sendAsync(testee3, 2, std::chrono::milliseconds(400)) == app::AT::Return_t::WAITING);
+    CHECK(channel.getWritten() == "REQ1REQ2REQ3");
+    channel.push("\r\nRESP1\r\n\r\nOK\r\n\r\nERROR\r\n\r\nRESP3\r\n\r\nOK\r\n");
+    CHECK(waitFor([&] {return results[2] != -1; }));
+    CHECK(results[0] == 1);
+    CHECK(results[1] == 0);
+    CHECK(results[2] == 1);
+
+    // nothing is written behind a prompt until its data is sent
+    results[3] = -1;
+    CHECK(testee4.sendAsync(0, "hello", std::chrono::milliseconds(400), [&results](const bool success) {
+        results[3] = success;
+    }) == app::AT::Return_t::WAITING);
+    CHECK(sendAsync(testee1, 0, std::chrono::milliseconds(400)) == app::AT::Return_t::WAITING);
+    CHECK(waitFor([&] {return channel.getWritten() == "REQ1REQ2REQ3AT+USOWR=0,5\rhelloREQ1"; }));
+    channel.push("\r\n+USOWR: 0,5\r\n\r\nOK\r\n\r\nRESP1\r\n\r\nOK\r\n");
+    CHECK(waitFor([&] {return results[0] != -1; }));
+    CHECK(results[3] == 1);
+    CHECK(results[0] == 1);
+
+    // a late answer could belong to any of the written commands, all of them fail
+    CHECK(sendAsync(testee1, 0, std::chrono::milliseconds(100)) == app::AT::Return_t::WAITING);
+    CHECK(sendAsync(testee2, 1, std::chrono::milliseconds(400)) == app::AT::Return_t::WAITING);
+    CHECK(sendAsync(testee3, 2, std::chrono::milliseconds(400)) == app::AT::Return_t::WAITING);
+    CHECK(waitFor([&] {return results[2] != -1; }));
+    CHECK(results[0] == 0);
+    CHECK(results[1] == 0);
+    CHECK(results[2] == 0);
+
+    channel.answer("REQ2", "\r\nRESP2\r\n\r\nOK\r\n");
+    CHECK(testee2.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(parser.getNumberOfPendingCmds() == 0);
+    TestCaseEnd();
+}
 
-    auto waitForSignal = [&globalSignal](const int sig, std::condition_variable& cv, std::mutex& m,
-                                         std::function<void()> doSomethingWithMutexLock = [] {}){
-                             Trace(ZONE_INFO, "Sleep %d\r\n", sig);
-                             {
-                                 std::unique_lock<std::mutex> lk(m);
-                                 auto eval = [&] {
-                                                 return sig == globalSignal;
-                                             };
-                                 cv.wait(lk, eval);
-                                 doSomethingWithMutexLock();
-                                 Trace(ZONE_INFO, "Hello %d\r\n", sig);
-                             }
-                         };
-
-    auto send2 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "\rOK\r";
-        });
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmd>(testee3);
-                     auto ret = ptr->send(send, std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto send1 = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m, [&] {
-            testString += "@\rOK\rERROR\r";
-        });
-                     auto ptr = std::dynamic_pointer_cast<app::ATCmdUSOST>(testee1);
-                     auto ret = ptr->send(0, "ip", "port", "hello", std::chrono::milliseconds(1000));
-                     CHECK(ret == app::AT::Return_t::FINISHED);
-                 };
-
-    auto parse = [&](int j)
-                 {
-                     waitForSignal(j, cv, cv_m);
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(1000));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       for (int i = 0; i < MAXSIGNALS; i++) {
-                           std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                           {
-                               std::lock_guard<std::mutex> lk(cv_m);
-                               globalSignal = i;
-                           }
-                           cv.notify_all();
-                       }
-                   };
-
-    std::vector<std::thread> threads;
-    threads.emplace_back(send1, 1);
-    threads.emplace_back(parse, 0);
-    threads.emplace_back(send2, 2);
-    threads.emplace_back(signals);
-
-    for (auto& x : threads) {
-        x.join();
+int ut_ChunkBoundaryTest(void)
+{
+    TestCaseBegin();
+    // longer than two chunks, the payload and the response behind it span chunk boundaries
+    std::string payload;
+    while (payload.length() < 2 * app::ATParser::CHUNKSIZE + 10) {
+        payload += static_cast<char>('a' + payload.length() % 26);
     }
-
+    ScriptedChannel channel;
+    channel.answer("AT+USORD=0", "\r\n+USORD: 0," + std::to_string(payload.length()) + ",\"" + payload +
+                   "\"\r\n\r\nOK\r\n");
+    // the response starts at the end of one chunk and continues in the next
+    std::string padding;
+    while (padding.length() < app::ATParser::CHUNKSIZE - 4) {
+        padding += "\r\n";
+    }
+    channel.answer("REQ1", padding + "RESP1\r\n\r\nOK\r\n");
+
+    app::ATParser parser(channel.mReceive);
+    const std::function<void(size_t, size_t)> urcReceived = [](size_t, size_t) {};
+    app::ATCmdUSORD testee1(channel.mSend, urcReceived);
+    app::ATCmd testee2("CMD_1", "REQ1", "RESP1");
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&testee1);
+    parser.registerAtCommand(&testee2);
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    ParserTask task(parser);
+    CHECK(testee1.send(0, payload.length(), std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(testee1.getData() == payload);
+    CHECK(testee2.send(channel.mSend, std::chrono::milliseconds(400)) == app::AT::Return_t::FINISHED);
+    CHECK(parser.getNumberOfPendingCmds() == 0);
     TestCaseEnd();
 }
 
-int ut_TimeoutTest(void)
+int ut_ResponseMatcherTest(void)
 {
-    Trace(ZONE_INFO, "ut_TimeoutTest\r\n");
-
     TestCaseBegin();
+    using app::ATResponseMatcher;
+
+    const std::function<void(size_t, size_t)> urc = [](const size_t, const size_t) {};
+    app::ATCmdURC uusord("UUSORD", "+UUSORD: ", urc);
+    app::ATCmdURC uusocl("UUSOCL", "+UUSOCL: ", urc);
+    app::ATCmdURC uusor("UUSOR", "+UUSOR", urc);
+    app::ATCmdURC uusocl2("UUSOCL", "+UUSOCL: ", urc);
+    app::ATCmdURC empty("EMPTY", "", urc);
+
+    ATResponseMatcher matcher;
+    CHECK(matcher.insert(&uusord));
+    CHECK(matcher.insert(&uusocl));
+    CHECK(matcher.insert(&uusor));
+    CHECK(matcher.insert(&empty));
+
+    auto walk = [&](const std::string_view prefix) {
+                    ATResponseMatcher::Node node = ATResponseMatcher::ROOT;
+                    for (const char c : prefix) {
+                        node = matcher.advance(node, c);
+                    }
+                    return node;
+                };
+
+    CHECK(matcher.getCount(walk("+UUSO")) == 3);
+    CHECK(matcher.getCount(walk("+UUSOR")) == 2);
+    CHECK(matcher.getMatch(walk("+UUSOR")) == &uusor);
+    CHECK(matcher.getCount(walk("+UUSORD: ")) == 1);
+    CHECK(matcher.getMatch(walk("+UUSORD: ")) == &uusord);
+    CHECK(matcher.getMatch(walk("+UUSORD:")) == nullptr);
+    CHECK(walk("+UUSOX") == ATResponseMatcher::ROOT);
+    CHECK(walk("UUSO") == ATResponseMatcher::ROOT);
+
+    // the same response twice is ambiguous
+    CHECK(matcher.insert(&uusocl2));
+    CHECK(matcher.getCount(walk("+UUSOCL: ")) == 2);
+    CHECK(matcher.getMatch(walk("+UUSOCL: ")) == &uusocl);
+
+    // a response that doesn't fit leaves the tree as it was
+    const std::string tooLong(ATResponseMatcher::MAXNODES, 'x');
+    app::ATCmdURC overflow("OVERFLOW", tooLong, urc);
+    CHECK(!matcher.insert(&overflow));
+    CHECK(walk("x") == ATResponseMatcher::ROOT);
+    CHECK(matcher.getCount(walk("+")) == 4);
+    TestCaseEnd();
+}
 
-    std::condition_variable cv;
-    std::mutex cv_m;
-    int i = 0;
+/* the commands a socket registers at the parser */
+struct SocketCmds {
+    app::ATCmdUSOCR mUSOCR;
+    app::ATCmdUSOCO mUSOCO;
+    app::ATCmdUSOSO mUSOSO;
+    app::ATCmdUSOCTL mUSOCTL;
+    app::ATCmdUSOWR mUSOWR;
+    app::ATCmdUSORD mUSORD;
+
+    SocketCmds(app::AT::SendFunction& send, const std::function<void(size_t, size_t)>& callback) :
+        mUSOCR(send), mUSOCO(send), mUSOSO(send), mUSOCTL(send), mUSOWR(send), mUSORD(send, callback) {}
+
+    void registerAt(app::ATParser& parser)
+    {
+        parser.registerAtCommand(&mUSOCR);
+        parser.registerAtCommand(&mUSOCO);
+        parser.registerAtCommand(&mUSOSO);
+        parser.registerAtCommand(&mUSOCTL);
+        parser.registerAtCommand(&mUSOWR);
+        parser.registerAtCommand(&mUSORD);
+    }
+};
 
-    static std::string testString = " ";
+/*
+ * URCs of a SARA-U2 serving five sockets, recorded from the modem uart.
+ * Every line is dispatched to a registered command.
+ */
+static const std::string_view URC_TRACE =
+    "\r\n+UUSORD: 0,1024\r\n"
+    "\r\n+UUSORD: 1,312\r\n"
+    "\r\n+UUSORF: 3,548\r\n"
+    "\r\n+UUSORD: 2,16\r\n"
+    "\r\n+UUSOCL: 4\r\n"
+    "\r\n+UUSORD: 0,1024\r\n"
+    "\r\n+UUPSDD: 0\r\n"
+    "\r\n+UUSORF: 3,1\r\n";
+static constexpr const size_t URCS_PER_TRACE = 8;
+static constexpr const size_t TRACE_REPETITIONS = 2000;
 
-    std::function<size_t(uint8_t*, const size_t, std::chrono::milliseconds)> recv =
+/*
+ * Streams the trace through a stream buffer like the uart interrupt fills the
+ * ModemDriver InputBuffer. The parser reads at most maxRead bytes per call.
+ * Returns bytes per second, 0 if not every URC was dispatched.
+ */
+static double parseThroughput(const size_t maxRead)
+{
+    os::StreamBuffer<char, 1024> input;
+    app::AT::SendFunction send = [](std::string_view data, std::chrono::milliseconds) -> size_t {
+                                     return data.length();
+                                 };
+    app::AT::ReceiveFunction receive =
         [&](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
-            static size_t position = 0;
-            size_t i = 0;
-
-            if (testString.length() - position <= 0) {
-                Trace(ZONE_INFO, "recv Sleep;\r\n");
-                std::unique_lock<std::mutex> lk(cv_m);
-                cv.wait_for(lk, timeout, [&] {
-                return testString.length() - position > 0;
-            });
-            }
-
-            for ( ; i < length && position < testString.length(); i++) {
-                *data = testString[position++];
-            }
-            return i;
-        };
-
-    std::function<size_t(std::string_view, std::chrono::milliseconds)> send =
-        [](std::string_view in, std::chrono::milliseconds) -> size_t {
-            return in.length();
+            return input.receive(reinterpret_cast<char*>(data), std::min(length, maxRead), timeout);
         };
 
-    app::ATParser parser(recv);
-
-    auto testee1 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_1", "REQ1", "RESP1"));
-    auto testee2 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_2", "REQ2", "RESP2"));
-    auto testee3 = std::shared_ptr<app::AT>(new app::ATCmd("CMD_3", "REQ3", "REsp3"));
-    auto testee4 = std::shared_ptr<app::AT>(new app::ATCmdOK());
-    auto testee5 = std::shared_ptr<app::AT>(new app::ATCmdERROR());
-
-    parser.registerAtCommand(testee1.get());
-    parser.registerAtCommand(testee2.get());
-    parser.registerAtCommand(testee3.get());
-    parser.registerAtCommand(testee4.get());
-    parser.registerAtCommand(testee5.get());
+    std::atomic<size_t> urcs {0};
+    std::chrono::steady_clock::time_point end;
+    const std::function<void(size_t, size_t)> urc = [&](const size_t, const size_t) {
+                                                        if (++urcs == URCS_PER_TRACE * TRACE_REPETITIONS) {
+                                                            end = std::chrono::steady_clock::now();
+                                                        }
+                                                    };
+
+    // the command set of the ModemDriver with all of its sockets
+    app::ATParser parser(receive);
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    app::ATCmdURC uusorf("UUSORF", "+UUSORF: ", urc);
+    app::ATCmdURC uusord("UUSORD", "+UUSORD: ", urc);
+    app::ATCmdURC uupsdd("UUPSDD", "+UUPSDD: ", urc);
+    app::ATCmdURC uusocl("UUSOCL", "+UUSOCL: ", urc);
+    app::ATCmdCGATT cgatt;
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+    parser.registerAtCommand(&uusorf);
+    parser.registerAtCommand(&uusord);
+    parser.registerAtCommand(&uupsdd);
+    parser.registerAtCommand(&uusocl);
+    parser.registerAtCommand(&cgatt);
+    std::vector<std::unique_ptr<SocketCmds> > sockets;
+    for (size_t i = 0; i < 5; i++) {
+        sockets.emplace_back(new SocketCmds(send, urc));
+        sockets.back()->registerAt(parser);
+    }
 
-    auto send1 = [&](int j = 2)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
+    const auto start = std::chrono::steady_clock::now();
+    os::TaskInterruptable uart("Uart", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        for (size_t i = 0; i < TRACE_REPETITIONS; i++) {
+            for (size_t sent = 0; sent < URC_TRACE.length(); ) {
+                sent += input.send(URC_TRACE.data() + sent, URC_TRACE.length() - sent);
+            }
+        }
+    });
+    parser.parse(std::chrono::milliseconds(200));
+    uart.join();
 
-                         Trace(ZONE_INFO, "Hello %d\r\n", j);
-                     }
-                     auto ret =
-                         std::dynamic_pointer_cast<app::ATCmd>(testee3)->send(send, std::chrono::milliseconds(2000));
-                     CHECK(ret == app::AT::Return_t::TRY_AGAIN);
-                 };
-
-    auto send2 = [&](int j = 0)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-                         Trace(ZONE_INFO, "Hello %d\r\n", j);
-                     }
-                     auto ret =
-                         std::dynamic_pointer_cast<app::ATCmd>(testee2)->send(send, std::chrono::milliseconds(2000));
-                     CHECK(ret == app::AT::Return_t::ERROR);
-                 };
-
-    auto parse = [&](int j = 1)
-                 {
-                     Trace(ZONE_INFO, "Sleep %d\r\n", j);
-                     {
-                         std::unique_lock<std::mutex> lk(cv_m);
-                         cv.wait(lk, [&] {
-                return j == i;
-            });
-                     }
-                     Trace(ZONE_INFO, "Hello %d\r\n", j);
-
-                     for (auto i = 0; i < 2; i++) {
-                         parser.parse(std::chrono::milliseconds(500));
-                     }
-                     Trace(ZONE_INFO, "parser END \r\n");
-                 };
-
-    auto signals = [&]
-                   {
-                       Trace(ZONE_INFO, "Signal");
-
-                       std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 0;
-                       }
-                       cv.notify_all();
-
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 1;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 2;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-                       {
-                           std::lock_guard<std::mutex> lk(cv_m);
-                           i = 3;
-                       }
-                       cv.notify_all();
-                       std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                   };
-
-    std::thread t0(send2, 1), t1(parse, 0), t2(send1, 2), t3(signals);
-    Trace(ZONE_INFO, "Wait \r\n");
-
-    t0.join();
-    t1.join();
-    t2.join();
-    t3.join();
+    if (urcs != URCS_PER_TRACE * TRACE_REPETITIONS) {
+        return 0;
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    return static_cast<double>(URC_TRACE.length() * TRACE_REPETITIONS) * 1000000 / us;
+}
 
+int ut_ParseThroughput(void)
+{
+    TestCaseBegin();
+    const double bytewise = parseThroughput(1);
+    const double chunked = parseThroughput(app::ATParser::CHUNKSIZE);
+
+    CHECK(bytewise > 0);
+    CHECK(chunked > 0);
+    // every read takes the kernel lock, the parser loop locks its mutex a few times
+    // per read. Chunks save most of them.
+    CHECK(chunked > 1.5 * bytewise);
+    printf("Parser throughput: bytewise %.0f kB/s, chunked %.0f kB/s\n", bytewise / 1000, chunked / 1000);
     TestCaseEnd();
 }
 
 int main(int argc, const char* argv[])
 {
     UnitTestMainBegin();
+    std::thread scheduler(os::Task::startScheduler);
+
     RunTest(true, ut_BasicTest);
     RunTest(true, ut_ATParserURCTest);
     RunTest(true, ut_USOSTTest);
-    RunTest(true, ut_USOST2Test);
-    RunTest(true, ut_USOWR1Test);
-    RunTest(true, ut_USOWR2Test);
-    RunTest(true, ut_USOWR3Test);
+    RunTest(true, ut_USOWRTest);
     RunTest(true, ut_TimeoutTest);
-
+    RunTest(true, ut_QueuedCmdsTest);
+    RunTest(true, ut_PipelinedCmdsTest);
+    RunTest(true, ut_ChunkBoundaryTest);
+    RunTest(true, ut_ResponseMatcherTest);
+    RunTest(true, ut_ParseThroughput);
+
+    os::Task::endScheduler();
+    scheduler.join();
     UnitTestMainEnd();
 }
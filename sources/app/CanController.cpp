@@ -29,7 +29,6 @@ CanController::CanController(const hal::UsartWithDma& interface,
                              const hal::Gpio&         supplyPin,
                              const hal::Gpio&         usartTxPin) :
     mTask("CanTask",
-          CanController::STACKSIZE,
           os::Task::Priority::HIGH,
           [&](const bool& join)
 {
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "TaskInterruptable.h"
+#include "StaticTask.h"
 #include "os_StreamBuffer.h"
 #include "UsartWithDma.h"
 #include "Gpio.h"
@@ -25,7 +26,7 @@ class CanController final
     static os::StreamBuffer<char, BUFFERSIZE> ReceiveBuffer;
     std::array<char, MAXCHUNKSIZE> mTempReceiveCallbackBuffer;
 
-    os::TaskInterruptable mTask;
+    os::StaticTask<STACKSIZE, os::TaskInterruptable> mTask;
 
     const hal::UsartWithDma& mInterface;
     const hal::Gpio& mCanSupplyVoltage;
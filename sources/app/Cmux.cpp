@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "Cmux.h"
+#include "trace.h"
+#include "LockGuard.h"
+#include <algorithm>
+#include <cstring>
+
+using app::Cmux;
+using app::CmuxDecoder;
+
+static constexpr const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING;
+
+static constexpr const uint8_t EA = 0x01;
+static constexpr const uint8_t CR = 0x02;
+
+//------------------------CmuxDecoder---------------------------------
+
+bool CmuxDecoder::feed(const uint8_t c)
+{
+    switch (mState) {
+    case State::FLAG:
+        if (c == Cmux::FLAG) {
+            mState = State::ADDRESS;
+        }
+        return false;
+
+    case State::ADDRESS:
+        // flags may repeat between frames
+        if (c == Cmux::FLAG) {
+            return false;
+        }
+        mHeader[0] = c;
+        mState = (c & EA) ? State::CONTROL : State::FLAG;
+        return false;
+
+    case State::CONTROL:
+        mHeader[1] = c;
+        mState = State::LENGTH;
+        return false;
+
+    case State::LENGTH:
+        mHeader[2] = c;
+        mLength = c >> 1;
+        mReceived = 0;
+        // two byte lengths exceed MAXINFOLENGTH
+        if (!(c & EA)) {
+            mState = State::FLAG;
+            return false;
+        }
+        mState = mLength ? State::INFO : State::FCS;
+        return false;
+
+    case State::INFO:
+        mInfo[mReceived++] = c;
+        if (mReceived == mLength) {
+            mState = State::FCS;
+        }
+        return false;
+
+    case State::FCS:
+        mFcs = c;
+        mState = State::CLOSINGFLAG;
+        return false;
+
+    case State::CLOSINGFLAG: {
+        if (c != Cmux::FLAG) {
+            Trace(ZONE_WARNING, "Closing flag missing\r\n");
+            mState = State::FLAG;
+            return false;
+        }
+        // the flag may open the next frame as well
+        mState = State::ADDRESS;
+
+        uint8_t fcs = Cmux::calculateFcs(mHeader.data(), HEADERLENGTH);
+        if (getControl() == Cmux::UI) {
+            std::array<uint8_t, HEADERLENGTH + MAXINFOLENGTH> covered;
+            std::memcpy(covered.data(), mHeader.data(), HEADERLENGTH);
+            std::memcpy(covered.data() + HEADERLENGTH, mInfo.data(), mLength);
+            fcs = Cmux::calculateFcs(covered.data(), HEADERLENGTH + mLength);
+        }
+        if (fcs != mFcs) {
+            Trace(ZONE_WARNING, "FCS mismatch\r\n");
+            return false;
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+void CmuxDecoder::reset(void)
+{
+    mState = State::FLAG;
+}
+
+uint8_t CmuxDecoder::getDlci(void) const
+{
+    return mHeader[0] >> 2;
+}
+
+uint8_t CmuxDecoder::getControl(void) const
+{
+    return mHeader[1] & ~Cmux::PF;
+}
+
+std::string_view CmuxDecoder::getInfo(void) const
+{
+    return std::string_view(mInfo.data(), mLength);
+}
+
+//------------------------Cmux---------------------------------
+
+/* CRC-8 of 27.010, polynomial x^8 + x^2 + x + 1 processed lsb first */
+uint8_t Cmux::calculateFcs(uint8_t const* data, const size_t length)
+{
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (size_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+        }
+    }
+    return 0xFF - crc;
+}
+
+size_t Cmux::encode(std::array<uint8_t, MAXFRAMELENGTH>& frame,
+                    const uint8_t                        dlci,
+                    const uint8_t                        control,
+                    const std::string_view               info)
+{
+    const size_t length = std::min(info.length(), FRAMESIZE);
+
+    // the multiplexer is always opened by us, our commands carry C/R
+    frame[0] = FLAG;
+    frame[1] = (dlci << 2) | CR | EA;
+    frame[2] = control;
+    frame[3] = (length << 1) | EA;
+    std::memcpy(frame.data() + 4, info.data(), length);
+
+    const bool coversInfo = (control & ~PF) == UI;
+    frame[4 + length] = calculateFcs(frame.data() + 1, coversInfo ? 3 + length : 3);
+    frame[5 + length] = FLAG;
+    return 6 + length;
+}
+
+Cmux::Cmux(const AT::SendFunction& send, const AT::ReceiveFunction& receive) :
+    mUartSend(send), mUartReceive(receive)
+{
+    for (size_t i = 0; i < MAXCHANNELS; i++) {
+        mChannels[i].mSend = [this, i](std::string_view data, std::chrono::milliseconds timeout) -> size_t {
+            if (!mOpen && (i == 0)) {
+                return mUartSend(data, timeout);
+            }
+            return this->send(i + 1, data, timeout);
+        };
+        mChannels[i].mReceive = [this, i](uint8_t* data, const size_t length,
+                                          std::chrono::milliseconds timeout) -> size_t {
+            return mChannels[i].mInput.receive(reinterpret_cast<char*>(data), length, timeout);
+        };
+    }
+}
+
+bool Cmux::open(const std::chrono::milliseconds timeout)
+{
+    mDecoder.reset();
+    mEstablished.clear(0xFF | (0xFF << REFUSED));
+    mOpen = true;
+
+    for (uint8_t dlci = 0; dlci <= MAXCHANNELS; dlci++) {
+        const EventBits_t established = 1 << dlci;
+        const EventBits_t refused = 1 << (dlci + REFUSED);
+        if (!sendFrame(dlci, SABM | PF, "", timeout) ||
+            !(mEstablished.waitAny(established | refused, timeout) & established))
+        {
+            Trace(ZONE_ERROR, "DLCI %d not established\r\n", dlci);
+            mOpen = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+void Cmux::reset(void)
+{
+    mOpen = false;
+    for (auto& channel : mChannels) {
+        channel.mInput.reset();
+    }
+}
+
+bool Cmux::isOpen(void) const
+{
+    return mOpen;
+}
+
+void Cmux::demux(const std::chrono::milliseconds timeout)
+{
+    const size_t received = mUartReceive(mChunk.data(), mChunk.size(), timeout);
+
+    // decided once the input is there, open() switches before it sends the first frame
+    if (!mOpen) {
+        if (received && (mChannels[0].mInput.send(reinterpret_cast<const char*>(mChunk.data()), received,
+                                                  std::chrono::milliseconds(100)) != received))
+        {
+            Trace(ZONE_ERROR, "Input overflow\r\n");
+        }
+        return;
+    }
+
+    for (size_t i = 0; (i < received) && mOpen; i++) {
+        if (mDecoder.feed(mChunk[i])) {
+            dispatch();
+        }
+    }
+}
+
+app::AT::SendFunction& Cmux::getSend(const size_t channel)
+{
+    return mChannels[channel].mSend;
+}
+
+app::AT::ReceiveFunction& Cmux::getReceive(const size_t channel)
+{
+    return mChannels[channel].mReceive;
+}
+
+size_t Cmux::send(const uint8_t dlci, std::string_view data, const std::chrono::milliseconds timeout)
+{
+    size_t sent = 0;
+    while (sent < data.length()) {
+        const std::string_view info = data.substr(sent, FRAMESIZE);
+        if (!sendFrame(dlci, UIH, info, timeout)) {
+            break;
+        }
+        sent += info.length();
+    }
+    return sent;
+}
+
+bool Cmux::sendFrame(const uint8_t dlci, const uint8_t control, const std::string_view info,
+                     const std::chrono::milliseconds timeout)
+{
+    os::LockGuard<os::Mutex> lock(mSendMutex);
+
+    const size_t length = encode(mFrame, dlci, control, info);
+    const std::string_view frame(reinterpret_cast<const char*>(mFrame.data()), length);
+    return mUartSend(frame, timeout) == length;
+}
+
+void Cmux::dispatch(void)
+{
+    const uint8_t dlci = mDecoder.getDlci();
+    const uint8_t control = mDecoder.getControl();
+
+    switch (control) {
+    case UA:
+        mEstablished.set(1 << dlci);
+        break;
+
+    case DM:
+        Trace(ZONE_WARNING, "DLCI %d refused\r\n", dlci);
+        mEstablished.set(1 << (dlci + REFUSED));
+        break;
+
+    case UIH:
+    case UI:
+        if (dlci == 0) {
+            answerControlMessage(mDecoder.getInfo());
+        } else if (dlci <= MAXCHANNELS) {
+            const std::string_view info = mDecoder.getInfo();
+            if (mChannels[dlci - 1].mInput.send(info.data(), info.length(),
+                                                std::chrono::milliseconds(100)) != info.length())
+            {
+                Trace(ZONE_ERROR, "DLCI %d input overflow\r\n", dlci);
+            }
+        }
+        break;
+
+    default:
+        Trace(ZONE_WARNING, "DLCI %d: unexpected frame %x\r\n", dlci, control);
+        break;
+    }
+}
+
+/* the modem's commands (MSC, test, ...) are confirmed with the same message as response */
+void Cmux::answerControlMessage(const std::string_view message)
+{
+    if (message.empty() || !(message[0] & CR)) {
+        return;
+    }
+    std::array<char, CmuxDecoder::MAXINFOLENGTH> response;
+    std::memcpy(response.data(), message.data(), message.length());
+    response[0] &= ~CR;
+    sendFrame(0, UIH, std::string_view(response.data(), message.length()), std::chrono::milliseconds(100));
+}
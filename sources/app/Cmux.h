@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string_view>
+#include "AT_Parser.h"
+#include "EventGroup.h"
+#include "Mutex.h"
+#include "os_StreamBuffer.h"
+
+namespace app
+{
+/*
+ * Reassembles 3GPP 27.010 basic option frames from the byte stream, it
+ * resynchronizes at the next flag after garbage or a bad FCS.
+ */
+struct CmuxDecoder final {
+    static constexpr const size_t MAXINFOLENGTH = 127;
+
+    CmuxDecoder(void) = default;
+
+    CmuxDecoder(const CmuxDecoder&) = delete;
+    CmuxDecoder(CmuxDecoder&&) = delete;
+    CmuxDecoder& operator=(const CmuxDecoder&) = delete;
+    CmuxDecoder& operator=(CmuxDecoder&&) = delete;
+
+    /* true once c completed a valid frame, it stays readable until the next call */
+    bool feed(const uint8_t c);
+    void reset(void);
+
+    uint8_t getDlci(void) const;
+    /* the control field without the P/F bit */
+    uint8_t getControl(void) const;
+    std::string_view getInfo(void) const;
+
+private:
+    static constexpr const size_t HEADERLENGTH = 3;
+
+    enum class State {
+        FLAG, ADDRESS, CONTROL, LENGTH, INFO, FCS, CLOSINGFLAG
+    };
+
+    State mState = State::FLAG;
+    // address, control and length field, the FCS is calculated over them
+    std::array<uint8_t, HEADERLENGTH> mHeader;
+    size_t mLength = 0;
+    size_t mReceived = 0;
+    uint8_t mFcs = 0;
+    std::array<char, MAXINFOLENGTH> mInfo;
+};
+
+/*
+ * 3GPP 27.010 multiplexer, basic option. Once the modem is switched to
+ * multiplexer mode (AT+CMUX=0) the uart carries frames of several virtual
+ * channels (DLCIs), each one behaves like an AT interface of its own. DLCI 0
+ * controls the multiplexer, channel n is DLCI n + 1. Commands of the modem
+ * on DLCI 0 are answered with the same message, that's all the modem needs
+ * for the basic option.
+ *
+ * demux() is called in a loop by a task of its own, it decodes the frames of
+ * the uart and hands their payload to the input buffer of their channel. The
+ * send and receive functions of a channel are used like the ones of the uart,
+ * an ATParser per channel works on them independently. A long response on
+ * one channel only delays the others by one frame.
+ *
+ * Until open() channel 0 is the plain uart, demux() passes the input through
+ * to it. So its parser can switch the modem to multiplexer mode and keep
+ * working afterwards, it's the only reader of the uart input either way.
+ *
+ * There is no flow control, a channel whose input buffer stays full loses data.
+ */
+class Cmux final
+{
+public:
+    static constexpr const size_t MAXCHANNELS = 2;
+    static constexpr const size_t BUFFERSIZE = ATCmd::MAXREADLENGTH + 64;
+    // maximum information length N1, AT+CMUX has to set it
+    static constexpr const size_t FRAMESIZE = CmuxDecoder::MAXINFOLENGTH;
+    static constexpr const size_t MAXFRAMELENGTH = FRAMESIZE + 7;
+
+    static constexpr const uint8_t FLAG = 0xF9;
+    static constexpr const uint8_t SABM = 0x2F;
+    static constexpr const uint8_t UA = 0x63;
+    static constexpr const uint8_t DM = 0x0F;
+    static constexpr const uint8_t DISC = 0x43;
+    static constexpr const uint8_t UIH = 0xEF;
+    static constexpr const uint8_t UI = 0x03;
+    static constexpr const uint8_t PF = 0x10;
+
+    /* frames info for dlci into frame, returns the length of the frame */
+    static size_t encode(std::array<uint8_t, MAXFRAMELENGTH>& frame,
+                         const uint8_t                        dlci,
+                         const uint8_t                        control,
+                         const std::string_view               info = "");
+    static uint8_t calculateFcs(uint8_t const* data, const size_t length);
+
+    Cmux(const AT::SendFunction& send, const AT::ReceiveFunction& receive);
+
+    Cmux(const Cmux&) = delete;
+    Cmux(Cmux&&) = delete;
+    Cmux& operator=(const Cmux&) = delete;
+    Cmux& operator=(Cmux&&) = delete;
+
+    /* starts demultiplexing and establishes DLCI 0 and the channels, false if the modem refused one */
+    bool open(const std::chrono::milliseconds timeout);
+    /* stops demultiplexing and drops the buffered input, the modem left multiplexer mode */
+    void reset(void);
+    bool isOpen(void) const;
+
+    /* decodes the uart input until it times out */
+    void demux(const std::chrono::milliseconds timeout);
+
+    AT::SendFunction& getSend(const size_t channel);
+    AT::ReceiveFunction& getReceive(const size_t channel);
+
+private:
+    struct Channel {
+        os::StreamBuffer<char, BUFFERSIZE> mInput;
+        AT::SendFunction mSend;
+        AT::ReceiveFunction mReceive;
+    };
+
+    const AT::SendFunction& mUartSend;
+    const AT::ReceiveFunction& mUartReceive;
+
+    std::atomic<bool> mOpen {false};
+    std::array<Channel, MAXCHANNELS> mChannels;
+    // bit n is set when the modem acknowledged the SABM of DLCI n, bit n + REFUSED if it refused it
+    static constexpr const size_t REFUSED = 8;
+    os::EventGroup mEstablished;
+
+    // frames of different channels mustn't interleave on the uart
+    os::Mutex mSendMutex;
+    std::array<uint8_t, MAXFRAMELENGTH> mFrame;
+
+    CmuxDecoder mDecoder;
+    std::array<uint8_t, 64> mChunk;
+
+    size_t send(const uint8_t dlci, std::string_view data, const std::chrono::milliseconds timeout);
+    bool sendFrame(const uint8_t dlci, const uint8_t control, const std::string_view info,
+                   const std::chrono::milliseconds timeout);
+    void dispatch(void);
+    void answerControlMessage(const std::string_view message);
+};
+}
@@ -0,0 +1,437 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "unittest.h"
+#include "TaskInterruptable.h"
+#include "os_StreamBuffer.h"
+#include "AT_Parser.h"
+#include "Cmux.h"
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t STACKSIZE = 1024;
+// 115200 baud
+static constexpr const size_t UART_BYTES_PER_SECOND = 11520;
+static constexpr const size_t CONTROL_COMMANDS = 20;
+
+using app::Cmux;
+
+/*
+ * Plays a modem behind the uart, first in AT mode, after AT+CMUX as
+ * multiplexer. Every DLCI is an AT interface of its own, the commands are
+ * answered in order per interface. The uart to the host transmits at
+ * UART_BYTES_PER_SECOND, frame by frame round robin over the DLCIs, in AT
+ * mode in pieces of the same size. Its frames carry the C/R bit of the
+ * initiator like ours, the decoder ignores it.
+ */
+class CmuxPeer final
+{
+    os::StreamBuffer<char, 4096> mToModem;
+    os::StreamBuffer<char, 4096> mFromModem;
+    std::atomic<bool> mRunning {true};
+    std::atomic<bool> mMultiplexed {false};
+
+    std::mutex mMutex;
+    std::deque<char> mRaw;
+    std::deque<std::vector<uint8_t> > mFrames;
+    std::array<std::deque<char>, Cmux::MAXCHANNELS + 1> mOutput;
+    std::array<std::string, Cmux::MAXCHANNELS + 1> mLines;
+    size_t mNextDlci = 1;
+
+    app::CmuxDecoder mDecoder;
+    os::TaskInterruptable mTask;
+    os::TaskInterruptable mUart;
+
+    void output(const size_t dlci, const std::string& response)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto& queue = mMultiplexed ? mOutput[dlci] : mRaw;
+        queue.insert(queue.end(), response.begin(), response.end());
+    }
+
+    void frame(const uint8_t dlci, const uint8_t control, const std::string_view info = "")
+    {
+        std::array<uint8_t, Cmux::MAXFRAMELENGTH> frame;
+        const size_t length = Cmux::encode(frame, dlci, control, info);
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFrames.emplace_back(frame.data(), frame.data() + length);
+    }
+
+    void execute(const size_t dlci, const std::string& line)
+    {
+        size_t socket;
+        size_t length;
+        if (line.compare(0, 7, "AT+CMUX") == 0) {
+            output(dlci, "\r\nOK\r\n");
+            mMultiplexed = true;
+        } else if (line == "AT+CGATT?") {
+            output(dlci, "\r\n+CGATT: 1\r\n\r\nOK\r\n");
+        } else if (std::sscanf(line.c_str(), "AT+USORD=%zu,%zu", &socket, &length) == 2) {
+            output(dlci, "\r\n+USORD: " + std::to_string(socket) + "," + std::to_string(length) +
+                   ",\"" + std::string(length, 'x') + "\"\r\n\r\nOK\r\n");
+        } else {
+            output(dlci, "\r\nOK\r\n");
+        }
+    }
+
+    void receive(const size_t dlci, const std::string_view data)
+    {
+        for (const char c : data) {
+            if (c == '\r') {
+                execute(dlci, mLines[dlci]);
+                mLines[dlci].clear();
+            } else {
+                mLines[dlci] += c;
+            }
+        }
+    }
+
+    void onFrame(void)
+    {
+        const uint8_t dlci = mDecoder.getDlci();
+        switch (mDecoder.getControl()) {
+        case Cmux::SABM:
+            frame(dlci, Cmux::UA | Cmux::PF);
+            if (dlci == 1) {
+                // modem status command for DLCI 1: DV, RTR, RTC set
+                frame(0, Cmux::UIH, "\xE3\x05\x07\x0D");
+            }
+            break;
+
+        case Cmux::UIH:
+            if (dlci == 0) {
+                if (mDecoder.getInfo() == "\xE1\x05\x07\x0D") {
+                    mStatusAnswered = true;
+                }
+            } else if (dlci <= Cmux::MAXCHANNELS) {
+                receive(dlci, mDecoder.getInfo());
+            }
+            break;
+        }
+    }
+
+    void run(void)
+    {
+        std::array<char, 64> chunk;
+        while (mRunning) {
+            const size_t length = mToModem.receive(chunk.data(), chunk.size(), std::chrono::milliseconds(100));
+            for (size_t i = 0; i < length; i++) {
+                if (!mMultiplexed) {
+                    receive(1, std::string_view(chunk.data() + i, 1));
+                } else if (mDecoder.feed(chunk[i])) {
+                    onFrame();
+                }
+            }
+        }
+    }
+
+    /* the next piece on the line: raw AT output first, then control frames, then the DLCIs in turn */
+    bool next(std::vector<uint8_t>& piece)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mRaw.empty()) {
+            const size_t length = std::min(mRaw.size(), Cmux::FRAMESIZE);
+            piece.assign(mRaw.begin(), mRaw.begin() + length);
+            mRaw.erase(mRaw.begin(), mRaw.begin() + length);
+            return true;
+        }
+        if (!mFrames.empty()) {
+            piece = mFrames.front();
+            mFrames.pop_front();
+            return true;
+        }
+        for (size_t i = 0; i < Cmux::MAXCHANNELS; i++) {
+            const size_t dlci = mNextDlci;
+            mNextDlci = mNextDlci % Cmux::MAXCHANNELS + 1;
+            auto& queue = mOutput[dlci];
+            if (queue.empty()) {
+                continue;
+            }
+            const std::string info(queue.begin(), queue.begin() + std::min(queue.size(), Cmux::FRAMESIZE));
+            queue.erase(queue.begin(), queue.begin() + info.length());
+
+            std::array<uint8_t, Cmux::MAXFRAMELENGTH> frame;
+            const size_t length = Cmux::encode(frame, dlci, Cmux::UIH, info);
+            piece.assign(frame.data(), frame.data() + length);
+            return true;
+        }
+        return false;
+    }
+
+    void transmit(void)
+    {
+        std::vector<uint8_t> piece;
+        while (mRunning) {
+            if (!next(piece)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(piece.size() * 1000000 / UART_BYTES_PER_SECOND));
+            mFromModem.send(reinterpret_cast<const char*>(piece.data()), piece.size());
+        }
+    }
+
+public:
+    std::atomic<bool> mStatusAnswered {false};
+
+    app::AT::SendFunction mSend;
+    app::AT::ReceiveFunction mReceive;
+
+    CmuxPeer(void) :
+        mTask("Peer", STACKSIZE, os::Task::Priority::HIGH, [this](const bool&) {run(); }),
+        mUart("Uart", STACKSIZE, os::Task::Priority::HIGH, [this](const bool&) {transmit(); }),
+        mSend([this](std::string_view data, std::chrono::milliseconds timeout) -> size_t {
+        return mToModem.send(data.data(), data.length(), timeout);
+    }),
+        mReceive([this](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
+        return mFromModem.receive(reinterpret_cast<char*>(data), length, timeout);
+    }) {}
+
+    ~CmuxPeer(void)
+    {
+        mRunning = false;
+        mTask.join();
+        mUart.join();
+    }
+
+    bool isMultiplexed(void) const
+    {
+        return mMultiplexed;
+    }
+};
+
+/* runs a task calling f like the ModemDriver as long as it exists */
+class Loop final
+{
+    std::atomic<bool> mRunning {true};
+    os::TaskInterruptable mTask;
+
+public:
+    Loop(const char* name, const std::function<void(void)>& f) :
+        mTask(name, STACKSIZE, os::Task::Priority::VERY_HIGH, [this, f](const bool&) {
+        while (mRunning) {
+            f();
+        }
+    }) {}
+
+    ~Loop(void)
+    {
+        mRunning = false;
+        mTask.join();
+    }
+};
+
+/*
+ * A download task reads 1024 bytes with AT+USORD back to back, meanwhile
+ * AT+CGATT? checks are sent every 20 ms. Returns the mean latency of the
+ * checks in ms, 0 if one failed. Without the multiplexer both share the
+ * parser and the uart, with it each has a channel of its own.
+ */
+static double controlLatency(const bool multiplexed)
+{
+    CmuxPeer peer;
+    Cmux mux(peer.mSend, peer.mReceive);
+    Loop demux("Demux", [&] {mux.demux(std::chrono::milliseconds(100)); });
+
+    app::ATParser controlParser(mux.getReceive(0));
+    app::ATParser dataParser(mux.getReceive(1));
+    app::ATParser& downloadParser = multiplexed ? dataParser : controlParser;
+    app::AT::SendFunction& controlSend = mux.getSend(0);
+    app::AT::SendFunction& downloadSend = multiplexed ? mux.getSend(1) : controlSend;
+
+    app::ATCmdOK controlOk;
+    app::ATCmdERROR controlError;
+    app::ATCmdOK dataOk;
+    app::ATCmdERROR dataError;
+    app::ATCmdCGATT cgatt;
+    const std::function<void(size_t, size_t)> urc = [](const size_t, const size_t) {};
+    app::ATCmdUSORD usord(downloadSend, urc);
+    std::atomic<size_t> downloaded {0};
+    usord.setDataSink([&](const std::string_view data) {downloaded += data.length(); });
+
+    controlParser.registerAtCommand(&controlOk);
+    controlParser.registerAtCommand(&controlError);
+    controlParser.registerAtCommand(&cgatt);
+    dataParser.registerAtCommand(&dataOk);
+    dataParser.registerAtCommand(&dataError);
+    downloadParser.registerAtCommand(&usord);
+
+    Loop control("Control", [&] {controlParser.parse(std::chrono::milliseconds(200)); });
+    Loop data("Data", [&] {dataParser.parse(std::chrono::milliseconds(200)); });
+
+    if (multiplexed) {
+        app::ATCmd cmux("AT+CMUX", "AT+CMUX=0,0,,127\r", "");
+        controlParser.registerAtCommand(&cmux);
+        if ((cmux.send(controlSend, std::chrono::milliseconds(1000)) != app::AT::Return_t::FINISHED) ||
+            !mux.open(std::chrono::milliseconds(1000)))
+        {
+            return 0;
+        }
+    }
+
+    std::atomic<bool> downloading {true};
+    os::TaskInterruptable download("Download", STACKSIZE, os::Task::Priority::MEDIUM, [&](const bool&) {
+        while (downloading) {
+            usord.send(0, app::ATCmd::MAXREADLENGTH, std::chrono::milliseconds(1000));
+        }
+    });
+
+    // the download is under way
+    while (downloaded < app::ATCmd::MAXREADLENGTH) {
+        os::ThisTask::sleep(std::chrono::milliseconds(1));
+    }
+
+    double latencyMs = 0;
+    size_t failed = 0;
+    for (size_t i = 0; i < CONTROL_COMMANDS; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        if (cgatt.send(controlSend, std::chrono::milliseconds(2000)) != app::AT::Return_t::FINISHED) {
+            failed++;
+        }
+        latencyMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        os::ThisTask::sleep(std::chrono::milliseconds(20));
+    }
+    downloading = false;
+    download.join();
+
+    if (failed || !cgatt.getResult()) {
+        return 0;
+    }
+    return latencyMs / CONTROL_COMMANDS;
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_FrameCoding(void)
+{
+    TestCaseBegin();
+    std::array<uint8_t, Cmux::MAXFRAMELENGTH> frame;
+
+    // SABM on DLCI 0 as found in 27.010 traces
+    CHECK(Cmux::encode(frame, 0, Cmux::SABM | Cmux::PF) == 6);
+    const std::array<uint8_t, 6> sabm {0xF9, 0x03, 0x3F, 0x01, 0x1C, 0xF9};
+    CHECK(std::equal(sabm.begin(), sabm.end(), frame.begin()));
+
+    // UA on DLCI 0, after leading garbage and repeated flags
+    app::CmuxDecoder decoder;
+    const std::array<uint8_t, 9> ua {'O', 'K', 0xF9, 0xF9, 0x03, 0x73, 0x01, 0xD7, 0xF9};
+    size_t frames = 0;
+    for (const auto c : ua) {
+        frames += decoder.feed(c);
+    }
+    CHECK(frames == 1);
+    CHECK(decoder.getDlci() == 0);
+    CHECK(decoder.getControl() == Cmux::UA);
+    CHECK(decoder.getInfo().empty());
+
+    // UIH with payload, info longer than FRAMESIZE is cut
+    const std::string info(200, 'a');
+    const size_t length = Cmux::encode(frame, 2, Cmux::UIH, info);
+    CHECK(length == Cmux::MAXFRAMELENGTH - 1);
+    frames = 0;
+    for (size_t i = 0; i < length; i++) {
+        frames += decoder.feed(frame[i]);
+    }
+    CHECK(frames == 1);
+    CHECK(decoder.getDlci() == 2);
+    CHECK(decoder.getControl() == Cmux::UIH);
+    CHECK(decoder.getInfo() == std::string_view(info.data(), Cmux::FRAMESIZE));
+
+    // a corrupted FCS drops the frame, the next one is decoded again
+    frame[length - 2] ^= 0x01;
+    frames = 0;
+    for (size_t i = 0; i < length; i++) {
+        frames += decoder.feed(frame[i]);
+    }
+    CHECK(frames == 0);
+    for (const auto c : sabm) {
+        frames += decoder.feed(c);
+    }
+    CHECK(frames == 1);
+    CHECK(decoder.getControl() == Cmux::SABM);
+    TestCaseEnd();
+}
+
+int ut_OpenAndTransfer(void)
+{
+    TestCaseBegin();
+    CmuxPeer peer;
+    Cmux mux(peer.mSend, peer.mReceive);
+    Loop demux("Demux", [&] {mux.demux(std::chrono::milliseconds(100)); });
+
+    // channel 0 is the plain uart until the multiplexer is open
+    std::array<uint8_t, 64> response;
+    CHECK(mux.getSend(0)("AT+CMUX=0,0,,127\r", std::chrono::milliseconds(100)) == 17);
+    CHECK(mux.getReceive(0)(response.data(), 6, std::chrono::milliseconds(1000)) == 6);
+    CHECK(std::string_view(reinterpret_cast<char*>(response.data()), 6) == "\r\nOK\r\n");
+    CHECK(peer.isMultiplexed());
+
+    CHECK(mux.open(std::chrono::milliseconds(1000)));
+    CHECK(mux.isOpen());
+
+    // a request spanning two frames, the answer comes on its channel only
+    const std::string request = "AT+CGATT?\rAT" + std::string(Cmux::FRAMESIZE, 'Z') + "\r";
+    CHECK(mux.getSend(1)(request, std::chrono::milliseconds(100)) == request.length());
+    const std::string_view expected = "\r\n+CGATT: 1\r\n\r\nOK\r\n\r\nOK\r\n";
+    size_t received = 0;
+    while (received < expected.length()) {
+        const size_t length = mux.getReceive(1)(response.data() + received, expected.length() - received,
+                                                std::chrono::milliseconds(1000));
+        if (!length) {
+            break;
+        }
+        received += length;
+    }
+    CHECK(std::string_view(reinterpret_cast<char*>(response.data()), received) == expected);
+    CHECK(mux.getReceive(0)(response.data(), response.size(), std::chrono::milliseconds(50)) == 0);
+
+    // the modem status command was confirmed
+    CHECK(peer.mStatusAnswered);
+
+    mux.reset();
+    CHECK(!mux.isOpen());
+    TestCaseEnd();
+}
+
+int ut_ControlLatencyUnderDownload(void)
+{
+    TestCaseBegin();
+    const double shared = controlLatency(false);
+    const double multiplexed = controlLatency(true);
+
+    CHECK(shared > 0);
+    CHECK(multiplexed > 0);
+    // shared, a check waits for the rest of a 1 KB response, about 90 ms at 115200 baud.
+    // Multiplexed only for the frame on the line.
+    CHECK(multiplexed < 0.5 * shared);
+    printf("AT+CGATT? latency during download: shared uart %.1f ms, CMUX %.1f ms\n", shared, multiplexed);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    std::thread scheduler(os::Task::startScheduler);
+
+    RunTest(true, ut_FrameCoding);
+    RunTest(true, ut_OpenAndTransfer);
+    RunTest(true, ut_ControlLatencyUnderDownload);
+
+    os::Task::endScheduler();
+    scheduler.join();
+    UnitTestMainEnd();
+}
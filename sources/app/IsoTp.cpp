@@ -1,3 +1,9 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
 #include <cstring>
 #include "os_Task.h"
 #include "Can.h"
@@ -7,6 +13,7 @@
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
 using app::ISOTP;
+using app::IsoTpEngine;
 
 ISOTP::ISOTP(const hal::Can& interface, const uint32_t sid, const uint32_t did) : mInterface(interface), mSid(sid),
     mDid(did)
@@ -215,3 +222,540 @@ bool ISOTP::receive_FC(const std::chrono::milliseconds timeout)
     Trace(ZONE_INFO, "Receiving Flow Control failed probably due timeout.\r\n");
     return false;
 }
+
+//------------------------IsoTpEngine---------------------------------
+
+CanTxMsg IsoTpEngine::toCanTxMsg(const Frame& frame)
+{
+    CanTxMsg msg;
+    std::memset(&msg, 0, sizeof(msg));
+    if (frame.mExtended) {
+        msg.IDE = CAN_Id_Extended;
+        msg.ExtId = frame.mId;
+    } else {
+        msg.IDE = CAN_Id_Standard;
+        msg.StdId = frame.mId;
+    }
+    msg.RTR = CAN_RTR_Data;
+    msg.DLC = std::min<size_t>(frame.mLength, sizeof(msg.Data));
+    std::memcpy(msg.Data, frame.mData.data(), msg.DLC);
+    return msg;
+}
+
+IsoTpEngine::IsoTpEngine(const Transmit& transmit, const Clock& clock, const size_t frameSize) :
+    mTransmit(transmit), mClock(clock),
+    mFrameSize(std::clamp(toValidLength(frameSize), CLASSICFRAMESIZE, MAXFRAMESIZE))
+{}
+
+size_t IsoTpEngine::open(const uint32_t          txId,
+                         const uint32_t          rxId,
+                         char*                   rxBuffer,
+                         const size_t            rxBufferLength,
+                         const ReceiveCompletion& completion)
+{
+    return open(Address {txId, rxId}, rxBuffer, rxBufferLength, completion);
+}
+
+size_t IsoTpEngine::open(const Address&          address,
+                         char*                   rxBuffer,
+                         const size_t            rxBufferLength,
+                         const ReceiveCompletion& completion)
+{
+    size_t free = MAXSESSIONS;
+    for (size_t i = 0; i < MAXSESSIONS; i++) {
+        const Address& other = mSessions[i].mAddress;
+        if (!mSessions[i].mOpen) {
+            free = std::min(free, i);
+        } else if ((other.mRxId == address.mRxId)
+                   && ((other.mAddressing == Addressing::NORMAL) || (address.mAddressing == Addressing::NORMAL)
+                       || (other.mRxAddress == address.mRxAddress)))
+        {
+            Trace(ZONE_ERROR, "ID %x is taken\r\n", address.mRxId);
+            return MAXSESSIONS;
+        }
+    }
+    if (free == MAXSESSIONS) {
+        Trace(ZONE_ERROR, "No session left\r\n");
+        return MAXSESSIONS;
+    }
+
+    Session& session = mSessions[free];
+    session = Session();
+    session.mOpen = true;
+    session.mAddress = address;
+    session.mRxBuffer = rxBuffer;
+    session.mRxBufferLength = std::min(rxBufferLength, MAXPAYLOAD);
+    session.mRxCompletion = completion;
+    return free;
+}
+
+void IsoTpEngine::close(const size_t session)
+{
+    mSessions[session] = Session();
+}
+
+void IsoTpEngine::setFlowControl(const size_t session, const uint8_t blockSize, const uint8_t separationTime)
+{
+    mSessions[session].mPolicy = FlowControlPolicy::FIXED;
+    mSessions[session].mBacklog = nullptr;
+    mSessions[session].mRxBlockSize = blockSize;
+    mSessions[session].mRxSeparationTime = separationTime;
+}
+
+void IsoTpEngine::setBulkFlowControl(const size_t session)
+{
+    setFlowControl(session, 0, 0);
+}
+
+void IsoTpEngine::setAdaptiveFlowControl(const size_t session, const Backlog& backlog, const size_t capacity)
+{
+    mSessions[session].mPolicy = FlowControlPolicy::ADAPTIVE;
+    mSessions[session].mBacklog = backlog;
+    mSessions[session].mBacklogCapacity = capacity;
+}
+
+bool IsoTpEngine::send(const size_t session, const std::string_view message, const SendCompletion& completion)
+{
+    Session& s = mSessions[session];
+    if (!s.mOpen || (s.mTxState != TxState::IDLE) || message.empty() || (message.size() > MAXPAYLOAD)) {
+        return false;
+    }
+
+    // the next process() transmits it, so the completion never runs inside send()
+    s.mTxMessage = message;
+    s.mTxCompletion = completion;
+    s.mTxIndex = 0;
+    s.mTxState = TxState::FIRST_FRAME;
+    s.mTxDeadline = mClock();
+    return true;
+}
+
+bool IsoTpEngine::isSending(const size_t session) const
+{
+    return mSessions[session].mTxState != TxState::IDLE;
+}
+
+void IsoTpEngine::onReceive(const CanRxMsg& msg)
+{
+    Frame frame;
+    frame.mExtended = msg.IDE == CAN_Id_Extended;
+    frame.mId = frame.mExtended ? msg.ExtId : msg.StdId;
+    frame.mLength = std::min<size_t>(msg.DLC, sizeof(msg.Data));
+    std::memcpy(frame.mData.data(), msg.Data, frame.mLength);
+    onReceive(frame);
+}
+
+void IsoTpEngine::onReceive(const Frame& frame)
+{
+    for (auto& session : mSessions) {
+        const Address& address = session.mAddress;
+        if (!session.mOpen || (address.mRxId != frame.mId)) {
+            continue;
+        }
+
+        // the protocol control information follows the address
+        const size_t offset = address.mAddressing == Addressing::NORMAL ? 0 : 1;
+        const size_t length = std::min<size_t>(frame.mLength, frame.mData.size());
+        if ((length <= offset) || (offset && (frame.mData[0] != address.mRxAddress))) {
+            continue;
+        }
+        const uint8_t* data = frame.mData.data() + offset;
+
+        switch (data[0] >> 4) {
+        case FrameTypes::SINGLE_FRAME:
+            receiveSingleFrame(session, data, length - offset);
+            break;
+
+        case FrameTypes::FIRST_FRAME:
+            receiveFirstFrame(session, data, length - offset, mClock());
+            break;
+
+        case FrameTypes::CONSECUTIVE_FRAME:
+            receiveConsecutiveFrame(session, data, length - offset, mClock());
+            break;
+
+        case FrameTypes::FLOW_CONTROL:
+            receiveFlowControl(session, data, length - offset, mClock());
+            break;
+
+        default:
+            Trace(ZONE_WARNING, "Unknown frame type %x\r\n", data[0]);
+            break;
+        }
+        return;
+    }
+}
+
+uint32_t IsoTpEngine::process(void)
+{
+    const uint32_t now = mClock();
+
+    for (auto& session : mSessions) {
+        if (!session.mOpen) {
+            continue;
+        }
+        if (session.mFlowControlPending) {
+            sendFlowControl(session, session.mFlowControlStatus);
+        }
+
+        if (session.mTxState != TxState::IDLE) {
+            if (session.mTxState == TxState::WAIT_FLOW_CONTROL) {
+                if (isDue(session.mTxDeadline, now)) {
+                    Trace(ZONE_WARNING, "No flow control from %x\r\n", session.mAddress.mRxId);
+                    finishSending(session, false);
+                }
+            } else {
+                sendFrames(session, now);
+            }
+        }
+
+        if (session.mRxWaiting && isDue(session.mRxWaitDeadline, now)) {
+            answerFlowControl(session, now);
+        }
+        if ((session.mRxState == RxState::RECEIVING) && isDue(session.mRxDeadline, now)) {
+            Trace(ZONE_WARNING, "No consecutive frame from %x\r\n", session.mAddress.mRxId);
+            finishReceiving(session, false, std::string_view());
+        }
+    }
+
+    // completions may have started new transfers meanwhile
+    uint32_t next = IDLE;
+    for (const auto& session : mSessions) {
+        if (!session.mOpen) {
+            continue;
+        }
+        if (session.mFlowControlPending) {
+            next = std::min(next, RETRYINTERVAL_US);
+        }
+        if (session.mTxState != TxState::IDLE) {
+            next = std::min(next, isDue(session.mTxDeadline, now) ? 0 : session.mTxDeadline - now);
+        }
+        if (session.mRxWaiting) {
+            next = std::min(next, isDue(session.mRxWaitDeadline, now) ? 0 : session.mRxWaitDeadline - now);
+        }
+        if (session.mRxState == RxState::RECEIVING) {
+            next = std::min(next, isDue(session.mRxDeadline, now) ? 0 : session.mRxDeadline - now);
+        }
+    }
+    return next;
+}
+
+uint32_t IsoTpEngine::separationTimeToUs(const uint8_t separationTime)
+{
+    if (separationTime <= 0x7F) {
+        return separationTime * 1000;
+    }
+    if ((separationTime >= 0xF1) && (separationTime <= 0xF9)) {
+        return (separationTime - 0xF0) * 100;
+    }
+    // reserved values mean the longest separation time
+    return 0x7F * 1000;
+}
+
+bool IsoTpEngine::isDue(const uint32_t deadline, const uint32_t now)
+{
+    return static_cast<int32_t>(now - deadline) >= 0;
+}
+
+/* the CAN FD frame length which holds length bytes */
+size_t IsoTpEngine::toValidLength(const size_t length)
+{
+    if (length <= CLASSICFRAMESIZE) {
+        return length;
+    }
+    if (length <= 24) {
+        return (length + 3) & ~static_cast<size_t>(3);
+    }
+    if (length <= 32) {
+        return 32;
+    }
+    return length <= 48 ? 48 : MAXFRAMESIZE;
+}
+
+size_t IsoTpEngine::getFrameCapacity(const Session& session) const
+{
+    return mFrameSize - (session.mAddress.mAddressing == Addressing::NORMAL ? 0 : 1);
+}
+
+bool IsoTpEngine::transmit(const Session& session, const uint8_t* data, const size_t length)
+{
+    const Address& address = session.mAddress;
+    Frame frame;
+    frame.mId = address.mTxId;
+    frame.mExtended = address.mTxId > 0x7ff;
+
+    size_t offset = 0;
+    if (address.mAddressing != Addressing::NORMAL) {
+        frame.mData[offset++] = address.mTxAddress;
+    }
+    std::memcpy(frame.mData.data() + offset, data, length);
+    frame.mLength = toValidLength(offset + length);
+    // padding of CAN FD frames
+    std::fill(frame.mData.begin() + offset + length, frame.mData.begin() + frame.mLength, 0xCC);
+    return mTransmit(frame);
+}
+
+/* transmits the frames of the message which are due, with a separation time of 0 until the controller is full */
+void IsoTpEngine::sendFrames(Session& session, const uint32_t now)
+{
+    std::array<uint8_t, MAXFRAMESIZE> frame;
+    const size_t capacity = getFrameCapacity(session);
+    const std::string_view& message = session.mTxMessage;
+
+    while (isDue(session.mTxDeadline, now)) {
+        if (session.mTxState == TxState::FIRST_FRAME) {
+            // the single frame of classic CAN, with CAN FD only for what fits in 8 bytes
+            const size_t classic = capacity - (mFrameSize - CLASSICFRAMESIZE);
+            size_t header = 0;
+            if (message.size() <= classic - 1) {
+                frame[header++] = (FrameTypes::SINGLE_FRAME << 4) | message.size();
+            } else if (message.size() <= capacity - 2) {
+                frame[header++] = FrameTypes::SINGLE_FRAME << 4;
+                frame[header++] = message.size();
+            }
+            if (header) {
+                std::memcpy(frame.data() + header, message.data(), message.size());
+                if (!transmit(session, frame.data(), header + message.size())) {
+                    session.mTxDeadline = now + RETRYINTERVAL_US;
+                    return;
+                }
+                finishSending(session, true);
+                return;
+            }
+
+            if (message.size() <= MAXSHORTPAYLOAD) {
+                frame[header++] = (FrameTypes::FIRST_FRAME << 4) | (message.size() >> 8);
+                frame[header++] = message.size() & 0xff;
+            } else {
+                // escape sequence, the length follows in 32 bits
+                const uint32_t length = message.size();
+                frame[header++] = FrameTypes::FIRST_FRAME << 4;
+                frame[header++] = 0;
+                frame[header++] = length >> 24;
+                frame[header++] = (length >> 16) & 0xff;
+                frame[header++] = (length >> 8) & 0xff;
+                frame[header++] = length & 0xff;
+            }
+            std::memcpy(frame.data() + header, message.data(), capacity - header);
+            if (!transmit(session, frame.data(), capacity)) {
+                session.mTxDeadline = now + RETRYINTERVAL_US;
+                return;
+            }
+            session.mTxIndex = capacity - header;
+            session.mTxSequence = 1;
+            session.mTxState = TxState::WAIT_FLOW_CONTROL;
+            session.mTxDeadline = now + TIMEOUT_US;
+            return;
+        }
+
+        if (session.mTxState != TxState::CONSECUTIVE_FRAMES) {
+            return;
+        }
+        const size_t length = std::min(capacity - 1, message.size() - session.mTxIndex);
+        frame[0] = (FrameTypes::CONSECUTIVE_FRAME << 4) | session.mTxSequence;
+        std::memcpy(frame.data() + 1, message.data() + session.mTxIndex, length);
+        if (!transmit(session, frame.data(), length + 1)) {
+            session.mTxDeadline = now + RETRYINTERVAL_US;
+            return;
+        }
+        session.mTxIndex += length;
+        session.mTxSequence = (session.mTxSequence + 1) & 0x0f;
+
+        if (session.mTxIndex == message.size()) {
+            finishSending(session, true);
+            return;
+        }
+        if (session.mTxBlockLeft && (--session.mTxBlockLeft == 0)) {
+            session.mTxState = TxState::WAIT_FLOW_CONTROL;
+            session.mTxDeadline = now + TIMEOUT_US;
+            return;
+        }
+        session.mTxDeadline = now + session.mTxSeparationUs;
+    }
+}
+
+bool IsoTpEngine::sendFlowControl(Session& session, const FlowControlStatus status)
+{
+    const std::array<uint8_t, 3> frame {
+        static_cast<uint8_t>((FrameTypes::FLOW_CONTROL << 4) | status),
+        session.mRxBlockSize,
+        session.mRxSeparationTime
+    };
+
+    session.mFlowControlPending = !transmit(session, frame.data(), frame.size());
+    session.mFlowControlStatus = status;
+    return !session.mFlowControlPending;
+}
+
+/* asks for the next block of consecutive frames or to wait, as the policy of the session decides */
+void IsoTpEngine::answerFlowControl(Session& session, const uint32_t now)
+{
+    session.mRxWaiting = false;
+    if (session.mPolicy == FlowControlPolicy::ADAPTIVE) {
+        const size_t capacity = session.mBacklogCapacity;
+        const size_t free = capacity - std::min(session.mBacklog(), capacity);
+
+        if (free * 4 < capacity) {
+            if (++session.mRxWaits > MAXWAITFRAMES) {
+                Trace(ZONE_WARNING, "Consumer of %x didn't catch up\r\n", session.mAddress.mRxId);
+                finishReceiving(session, false, std::string_view());
+                return;
+            }
+            session.mRxWaiting = true;
+            session.mRxWaitDeadline = now + WAITINTERVAL_US;
+            session.mRxDeadline = now + TIMEOUT_US;
+            sendFlowControl(session, FS_Wait);
+            return;
+        }
+
+        session.mRxBlockSize = std::clamp<size_t>(free / 2, 1, UINT8_MAX);
+        if (free * 4 >= capacity * 3) {
+            session.mRxSeparationTime = 0;
+        } else if (free * 2 >= capacity) {
+            // 500 us
+            session.mRxSeparationTime = 0xF5;
+        } else {
+            session.mRxSeparationTime = 1;
+        }
+    }
+
+    session.mRxWaits = 0;
+    session.mRxBlockLeft = session.mRxBlockSize;
+    sendFlowControl(session, FS_Clear_To_Send);
+}
+
+void IsoTpEngine::finishSending(Session& session, const bool success)
+{
+    // the completion may send the next message
+    const SendCompletion completion = session.mTxCompletion;
+    session.mTxCompletion = nullptr;
+    session.mTxMessage = std::string_view();
+    session.mTxState = TxState::IDLE;
+    if (completion) {
+        completion(success);
+    }
+}
+
+void IsoTpEngine::finishReceiving(Session& session, const bool success, const std::string_view message)
+{
+    session.mRxState = RxState::IDLE;
+    session.mRxWaiting = false;
+    if (session.mRxCompletion) {
+        session.mRxCompletion(success, message);
+    }
+}
+
+void IsoTpEngine::receiveSingleFrame(Session& session, const uint8_t* data, const size_t length)
+{
+    size_t header = 1;
+    size_t messageLength = data[0] & 0x0f;
+    if (!messageLength && (length > 1)) {
+        // CAN FD, the length follows
+        messageLength = data[header++];
+    }
+    if (!messageLength || (messageLength > length - header)) {
+        Trace(ZONE_WARNING, "Invalid single frame\r\n");
+        return;
+    }
+    if (session.mRxState == RxState::RECEIVING) {
+        // the peer started over
+        finishReceiving(session, false, std::string_view());
+    }
+    // straight from the frame, it needs no buffer
+    finishReceiving(session, true, std::string_view(reinterpret_cast<const char*>(data + header), messageLength));
+}
+
+void IsoTpEngine::receiveFirstFrame(Session& session, const uint8_t* data, const size_t length, const uint32_t now)
+{
+    // even with an address a first frame has room for the escape sequence
+    if (length < CLASSICFRAMESIZE - 1) {
+        Trace(ZONE_WARNING, "Invalid first frame\r\n");
+        return;
+    }
+    size_t header = 2;
+    size_t messageLength = ((data[0] & 0x0f) << 8) | data[1];
+    if (!messageLength) {
+        messageLength = (static_cast<uint32_t>(data[2]) << 24) | (data[3] << 16) | (data[4] << 8) | data[5];
+        header = 6;
+        if (messageLength <= MAXSHORTPAYLOAD) {
+            Trace(ZONE_WARNING, "Escape sequence for %d bytes\r\n", static_cast<int>(messageLength));
+            return;
+        }
+    }
+    if (messageLength <= length - header) {
+        Trace(ZONE_WARNING, "Invalid first frame\r\n");
+        return;
+    }
+    if (session.mRxState == RxState::RECEIVING) {
+        finishReceiving(session, false, std::string_view());
+    }
+    if (messageLength > session.mRxBufferLength) {
+        Trace(ZONE_WARNING, "Message of %d bytes doesn't fit\r\n", static_cast<int>(messageLength));
+        sendFlowControl(session, FS_Overflow);
+        return;
+    }
+
+    std::memcpy(session.mRxBuffer, data + header, length - header);
+    session.mRxLength = messageLength;
+    session.mRxIndex = length - header;
+    session.mRxSequence = 1;
+    session.mRxState = RxState::RECEIVING;
+    session.mRxDeadline = now + TIMEOUT_US;
+    session.mRxWaits = 0;
+    answerFlowControl(session, now);
+}
+
+void IsoTpEngine::receiveConsecutiveFrame(Session&       session,
+                                          const uint8_t* data,
+                                          const size_t   length,
+                                          const uint32_t now)
+{
+    if (session.mRxState != RxState::RECEIVING) {
+        return;
+    }
+    if ((data[0] & 0x0f) != session.mRxSequence) {
+        Trace(ZONE_WARNING, "Sequence number %d instead of %d\r\n", data[0] & 0x0f, session.mRxSequence);
+        finishReceiving(session, false, std::string_view());
+        return;
+    }
+
+    const size_t bytes = std::min(length - 1, session.mRxLength - session.mRxIndex);
+    std::memcpy(session.mRxBuffer + session.mRxIndex, data + 1, bytes);
+    session.mRxIndex += bytes;
+    session.mRxSequence = (session.mRxSequence + 1) & 0x0f;
+
+    if (session.mRxIndex == session.mRxLength) {
+        finishReceiving(session, true, std::string_view(session.mRxBuffer, session.mRxLength));
+        return;
+    }
+    session.mRxDeadline = now + TIMEOUT_US;
+    if (session.mRxBlockLeft && (--session.mRxBlockLeft == 0)) {
+        answerFlowControl(session, now);
+    }
+}
+
+void IsoTpEngine::receiveFlowControl(Session& session, const uint8_t* data, const size_t length, const uint32_t now)
+{
+    if ((session.mTxState != TxState::WAIT_FLOW_CONTROL) || (length < 3)) {
+        return;
+    }
+
+    switch (data[0] & 0x0f) {
+    case FS_Clear_To_Send:
+        session.mTxBlockLeft = data[1];
+        session.mTxSeparationUs = separationTimeToUs(data[2]);
+        session.mTxState = TxState::CONSECUTIVE_FRAMES;
+        session.mTxDeadline = now;
+        sendFrames(session, now);
+        break;
+
+    case FS_Wait:
+        session.mTxDeadline = now + TIMEOUT_US;
+        break;
+
+    default:
+        Trace(ZONE_WARNING, "Flow control status %d from %x\r\n", data[0] & 0x0f, session.mAddress.mRxId);
+        finishSending(session, false);
+        break;
+    }
+}
@@ -1,6 +1,16 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <string_view>
 #include "Can.h"
+#include "InplaceFunction.h"
 
 namespace app
 {
@@ -45,4 +55,189 @@ public:
     size_t send_Message(const std::string_view message, const std::chrono::milliseconds timeout);
     size_t receive_Message(char* buffer, const size_t length, const std::chrono::milliseconds timeout);
 };
+
+/*
+ * Event driven ISO-TP (ISO 15765-2:2016). The engine isn't thread safe, one
+ * task drives it: it feeds the received frames to onReceive(), e.g. from a
+ * queue or Can::enableDeferredReceive(), and calls process(). The
+ * completions run in that task and may send the next message right away.
+ * Nothing blocks, separation times and timeouts are deadlines process()
+ * works off. It returns the time until it has to run again.
+ */
+class IsoTpEngine final
+{
+public:
+    static constexpr const size_t MAXSESSIONS = 4;
+    static constexpr const size_t CLASSICFRAMESIZE = 8;
+    static constexpr const size_t MAXFRAMESIZE = 64;
+    // the longest message a first frame without escape sequence announces
+    static constexpr const size_t MAXSHORTPAYLOAD = 4095;
+    static constexpr const size_t MAXPAYLOAD = UINT32_MAX;
+    // N_Bs and N_Cr, how long we wait for the flow control and the next consecutive frame
+    static constexpr const uint32_t TIMEOUT_US = 1000000;
+    // a frame the CAN controller didn't take is sent again after
+    static constexpr const uint32_t RETRYINTERVAL_US = 200;
+    static constexpr const uint32_t WAITINTERVAL_US = 5000;
+    // N_WFTmax, the wait frames we send in a row before we give up
+    static constexpr const size_t MAXWAITFRAMES = 16;
+    // returned by process() if no deadline is pending
+    static constexpr const uint32_t IDLE = UINT32_MAX;
+
+    // extended and mixed start every frame with an address byte, sessions may share an rxId then
+    enum class Addressing {
+        NORMAL, EXTENDED, MIXED
+    };
+
+    // IDs above 0x7FF are sent as extended IDs
+    struct Address {
+        uint32_t mTxId;
+        uint32_t mRxId;
+        Addressing mAddressing = Addressing::NORMAL;
+        // the address byte we send and the one we expect, both N_AE with mixed addressing
+        uint8_t mTxAddress = 0;
+        uint8_t mRxAddress = 0;
+    };
+
+    struct Frame {
+        uint32_t mId;
+        bool mExtended;
+        uint8_t mLength;
+        std::array<uint8_t, MAXFRAMESIZE> mData;
+    };
+
+    // the time in microseconds, it may wrap
+    using Clock = util::InplaceFunction<uint32_t(void)>;
+    using Transmit = util::InplaceFunction<bool(const Frame&)>;
+    using SendCompletion = util::InplaceFunction<void(const bool success)>;
+    using ReceiveCompletion = util::InplaceFunction<void(const bool success, const std::string_view message)>;
+    // the frames received but not yet passed to onReceive()
+    using Backlog = util::InplaceFunction<size_t(void)>;
+
+    static CanTxMsg toCanTxMsg(const Frame& frame);
+
+    /*
+     * frameSize is the TX_DL of the bus, up to 64 for CAN FD. Longer frames than 8 bytes are padded to the
+     * next CAN FD length, received frames are taken at any valid length.
+     */
+    IsoTpEngine(const Transmit& transmit, const Clock& clock, const size_t frameSize = CLASSICFRAMESIZE);
+
+    IsoTpEngine(const IsoTpEngine&) = delete;
+    IsoTpEngine(IsoTpEngine&&) = delete;
+    IsoTpEngine& operator=(const IsoTpEngine&) = delete;
+    IsoTpEngine& operator=(IsoTpEngine&&) = delete;
+
+    /* returns the session, MAXSESSIONS if all are in use or the receive address is taken */
+    size_t open(const Address& address, char* rxBuffer, const size_t rxBufferLength,
+                const ReceiveCompletion& completion);
+    /* normal addressing */
+    size_t open(const uint32_t txId, const uint32_t rxId, char* rxBuffer, const size_t rxBufferLength,
+                const ReceiveCompletion& completion);
+    /* fails the transfers of the session without calling its completions */
+    void close(const size_t session);
+    /* the flow control we answer first frames with, by default all frames at 1 ms for a peer of unknown speed */
+    void setFlowControl(const size_t session, const uint8_t blockSize, const uint8_t separationTime);
+    /* block size and separation time 0, only for peers known to keep up, e.g. our own firmware */
+    void setBulkFlowControl(const size_t session);
+    /*
+     * decided per block from the backlog of the receive path, which holds capacity frames: a block takes at
+     * most half of the free frames and the separation time grows as they shrink. Below a quarter free we send
+     * FS_Wait every WAITINTERVAL_US and fail the reception after MAXWAITFRAMES.
+     */
+    void setAdaptiveFlowControl(const size_t session, const Backlog& backlog, const size_t capacity);
+
+    /* false if the session is already sending or message is too long, message stays valid until completion */
+    bool send(const size_t session, const std::string_view message, const SendCompletion& completion);
+    bool isSending(const size_t session) const;
+
+    void onReceive(const Frame& frame);
+    void onReceive(const CanRxMsg& msg);
+    /* returns the microseconds until it has to be called again or IDLE */
+    uint32_t process(void);
+
+private:
+    enum FrameTypes {
+        SINGLE_FRAME = 0x00,
+        FIRST_FRAME = 0x01,
+        CONSECUTIVE_FRAME = 0x02,
+        FLOW_CONTROL = 0x03
+    };
+
+    enum FlowControlStatus {
+        FS_Clear_To_Send = 0x00,
+        FS_Wait = 0x01,
+        FS_Overflow = 0x02
+    };
+
+    enum class TxState {
+        IDLE, FIRST_FRAME, WAIT_FLOW_CONTROL, CONSECUTIVE_FRAMES
+    };
+
+    enum class RxState {
+        IDLE, RECEIVING
+    };
+
+    enum class FlowControlPolicy {
+        FIXED, ADAPTIVE
+    };
+
+    struct Session {
+        bool mOpen = false;
+        Address mAddress {0, 0};
+
+        TxState mTxState = TxState::IDLE;
+        std::string_view mTxMessage;
+        size_t mTxIndex = 0;
+        uint8_t mTxSequence = 0;
+        // consecutive frames left until the next flow control, 0 if it won't come
+        size_t mTxBlockLeft = 0;
+        uint32_t mTxSeparationUs = 0;
+        uint32_t mTxDeadline = 0;
+        SendCompletion mTxCompletion;
+
+        RxState mRxState = RxState::IDLE;
+        char* mRxBuffer = nullptr;
+        size_t mRxBufferLength = 0;
+        size_t mRxLength = 0;
+        size_t mRxIndex = 0;
+        uint8_t mRxSequence = 0;
+        size_t mRxBlockLeft = 0;
+        uint32_t mRxDeadline = 0;
+        // fixed or the last one the adaptive policy decided on
+        uint8_t mRxBlockSize = 0;
+        uint8_t mRxSeparationTime = 1;
+        FlowControlPolicy mPolicy = FlowControlPolicy::FIXED;
+        Backlog mBacklog;
+        size_t mBacklogCapacity = 0;
+        size_t mRxWaits = 0;
+        bool mRxWaiting = false;
+        uint32_t mRxWaitDeadline = 0;
+        // a flow control the CAN controller didn't take yet
+        bool mFlowControlPending = false;
+        FlowControlStatus mFlowControlStatus = FS_Clear_To_Send;
+        ReceiveCompletion mRxCompletion;
+    };
+
+    const Transmit mTransmit;
+    const Clock mClock;
+    const size_t mFrameSize;
+    std::array<Session, MAXSESSIONS> mSessions;
+
+    static uint32_t separationTimeToUs(const uint8_t separationTime);
+    static bool isDue(const uint32_t deadline, const uint32_t now);
+    static size_t toValidLength(const size_t length);
+
+    /* the bytes of a frame left after the address */
+    size_t getFrameCapacity(const Session& session) const;
+    bool transmit(const Session& session, const uint8_t* data, const size_t length);
+    void sendFrames(Session& session, const uint32_t now);
+    bool sendFlowControl(Session& session, const FlowControlStatus status);
+    void answerFlowControl(Session& session, const uint32_t now);
+    void finishSending(Session& session, const bool success);
+    void finishReceiving(Session& session, const bool success, const std::string_view message);
+
+    void receiveSingleFrame(Session& session, const uint8_t* data, const size_t length);
+    void receiveFirstFrame(Session& session, const uint8_t* data, const size_t length, const uint32_t now);
+    void receiveConsecutiveFrame(Session& session, const uint8_t* data, const size_t length, const uint32_t now);
+    void receiveFlowControl(Session& session, const uint8_t* data, const size_t length, const uint32_t now);
+};
 }
@@ -2,9 +2,13 @@
 /*
  * Copyright (c) 2014-2018 Nils Weiss
  */
+#include <algorithm>
 #include <array>
+#include <cstdio>
 #include <cstring>
+#include <deque>
 #include <string>
+#include <vector>
 #include "unittest.h"
 #include "os_Task.h"
 #include "IsoTp.h"
@@ -48,6 +52,309 @@ bool hal::Can::receive(CanRxMsg& msg) const
     std::memcpy(&msg, &rxBuffArray[rxBuffCounter++], sizeof(CanRxMsg));
     return true;
 }
+/*
+ * Two nodes on a CAN bus in simulated time. Each one has the 3 transmit
+ * mailboxes of a bxCAN, the frame of the lowest ID among them wins the
+ * arbitration and takes the worst case bit stuffed length at the bitrate.
+ * Frames longer than 8 bytes are CAN FD frames, their data phase runs at
+ * the data bitrate. The engines are driven like a task would: process() after every frame
+ * and whenever the deadline it returned expires.
+ *
+ * A node with a receive capacity queues the frames it receives like a
+ * receive interrupt would, a consumer passes them to the engine one per
+ * service time. Frames which find the queue full are dropped.
+ */
+struct SimulatedBus {
+    static constexpr const size_t MAILBOXES = 3;
+    using IsoTpEngine = app::IsoTpEngine;
+    using Frame = IsoTpEngine::Frame;
+
+    SimulatedBus(const uint32_t bitrate, const uint32_t dataBitrate = 0) :
+        mBitrate(bitrate), mDataBitrate(dataBitrate ? dataBitrate : bitrate)
+    {}
+
+    IsoTpEngine::Transmit transmitOf(const size_t node)
+    {
+        return [this, node](const Frame& frame) {
+                   if (mMailboxes[node].size() >= MAILBOXES) {
+                       return false;
+                   }
+                   mMailboxes[node].push_back(frame);
+                   return true;
+        };
+    }
+
+    IsoTpEngine::Clock clock(void)
+    {
+        return [this] {
+                   return mNow;
+        };
+    }
+
+    /* transfers frames until done() or nothing is left to do, false if that took longer than limitUs */
+    template<typename Done>
+    bool run(const Done& done, const uint32_t limitUs)
+    {
+        const uint32_t start = mNow;
+        while (!done()) {
+            const uint32_t next = std::min(mEngines[0]->process(), mEngines[1]->process());
+            if (!mBusy) {
+                startFrame();
+            }
+
+            uint64_t target = UINT64_MAX;
+            if (mBusy) {
+                target = mFrameEnd;
+            }
+            if (next != IsoTpEngine::IDLE) {
+                target = std::min<uint64_t>(target, mNow + next);
+            }
+            for (size_t node = 0; node < mRxQueues.size(); node++) {
+                if (!mRxQueues[node].empty()) {
+                    target = std::min<uint64_t>(target, std::max(mNow, mRxReady[node]));
+                }
+            }
+            if ((target == UINT64_MAX) || (target - start > limitUs)) {
+                return done();
+            }
+            mNow = target;
+
+            if (mBusy && (mNow == mFrameEnd)) {
+                mBusy = false;
+                deliver();
+            }
+            for (size_t node = 0; node < mRxQueues.size(); node++) {
+                if (!mRxQueues[node].empty() && (mNow >= mRxReady[node])) {
+                    const Frame frame = mRxQueues[node].front();
+                    mRxQueues[node].pop_front();
+                    mRxReady[node] = mNow + mRxServiceUs[node];
+                    mEngines[node]->onReceive(frame);
+                }
+            }
+        }
+        return true;
+    }
+
+    const uint32_t mBitrate;
+    const uint32_t mDataBitrate;
+    std::array<IsoTpEngine*, 2> mEngines;
+    std::array<std::vector<Frame>, 2> mMailboxes;
+    // every frame that went over the bus
+    std::vector<Frame> mLog;
+    uint32_t mNow = 0;
+
+    // 0 passes the frames to the engine right away
+    std::array<size_t, 2> mRxCapacity {};
+    std::array<uint32_t, 2> mRxServiceUs {};
+    std::array<std::deque<Frame>, 2> mRxQueues;
+    size_t mDropped = 0;
+
+private:
+    bool mBusy = false;
+    size_t mSender = 0;
+    std::array<uint32_t, 2> mRxReady {};
+    Frame mFrame;
+    uint32_t mFrameEnd = 0;
+
+    void startFrame(void)
+    {
+        const Frame* winner = nullptr;
+        size_t box = 0;
+        for (size_t node = 0; node < mMailboxes.size(); node++) {
+            for (size_t i = 0; i < mMailboxes[node].size(); i++) {
+                if (!winner || (mMailboxes[node][i].mId < winner->mId)) {
+                    winner = &mMailboxes[node][i];
+                    mSender = node;
+                    box = i;
+                }
+            }
+        }
+        if (!winner) {
+            return;
+        }
+
+        mFrame = *winner;
+        mMailboxes[mSender].erase(mMailboxes[mSender].begin() + box);
+        const uint64_t length = mFrame.mLength;
+        uint64_t ns;
+        if (length <= app::IsoTpEngine::CLASSICFRAMESIZE) {
+            const uint64_t header = mFrame.mExtended ? 67 : 47;
+            const uint64_t stuffed = header - 13 + 8 * length;
+            ns = (header + 8 * length + (stuffed - 1) / 4) * 1000000000 / mBitrate;
+        } else {
+            // arbitration, ACK and EOF at the bitrate, DLC, data and a 17 or 21 bit CRC at the data bitrate
+            const uint64_t nominal = (mFrame.mExtended ? 36 : 17) + 12;
+            const uint64_t data = 5 + 8 * length + (length > 16 ? 26 : 22);
+            ns = nominal * 1000000000 / mBitrate + (data + (data - 1) / 4) * 1000000000 / mDataBitrate;
+        }
+        mFrameEnd = mNow + (ns + 999) / 1000;
+        mBusy = true;
+    }
+
+    void deliver(void)
+    {
+        mLog.push_back(mFrame);
+
+        const size_t receiver = 1 - mSender;
+        if (!mRxCapacity[receiver]) {
+            mEngines[receiver]->onReceive(mFrame);
+        } else if (mRxQueues[receiver].size() < mRxCapacity[receiver]) {
+            mRxQueues[receiver].push_back(mFrame);
+        } else {
+            mDropped++;
+        }
+    }
+};
+
+static std::string pattern(const size_t length, const char first)
+{
+    std::string message(length, first);
+    for (size_t i = 0; i < length; i++) {
+        message[i] += i % 23;
+    }
+    return message;
+}
+
+/* sends message count times in a row, the next one from the completion of the last */
+struct MessageStream {
+    app::IsoTpEngine& mEngine;
+    const size_t mSession;
+    const std::string_view mMessage;
+    size_t mLeft;
+    size_t mFailed = 0;
+
+    void sendNext(void)
+    {
+        mEngine.send(mSession, mMessage, [this](const bool success) {
+            mFailed += !success;
+            if (--mLeft) {
+                sendNext();
+            }
+        });
+    }
+};
+
+/*
+ * Sends count messages of length bytes on each of sessions at once and
+ * returns how many messages per second arrived, all sessions together.
+ */
+static double messagesPerSecond(const size_t sessions, const size_t length, const size_t count)
+{
+    using app::IsoTpEngine;
+    SimulatedBus bus(500000);
+    IsoTpEngine sender(bus.transmitOf(0), bus.clock());
+    IsoTpEngine receiver(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&sender, &receiver};
+
+    const std::string message = pattern(length, 'a');
+    static std::array<std::array<char, IsoTpEngine::MAXSHORTPAYLOAD>, IsoTpEngine::MAXSESSIONS> buffers;
+    std::vector<MessageStream> streams;
+    streams.reserve(sessions);
+    size_t received = 0;
+
+    for (size_t i = 0; i < sessions; i++) {
+        const size_t session = sender.open(0x600 + i, 0x700 + i, nullptr, 0, nullptr);
+        receiver.open(0x700 + i, 0x600 + i, buffers[i].data(), buffers[i].size(),
+                      [&received, &message](const bool success, const std::string_view data) {
+            received += success && (data == message);
+        });
+        streams.push_back({sender, session, message, count});
+    }
+    for (auto& stream : streams) {
+        stream.sendNext();
+    }
+
+    bus.run([&] {
+        return received == sessions * count;
+    }, 60000000);
+    if (received != sessions * count) {
+        return 0;
+    }
+    return received * 1000000.0 / bus.mNow;
+}
+
+/*
+ * Sends message from one node to the other with bulk flow control, returns
+ * the microseconds until it arrived or 0 if it didn't arrive intact.
+ */
+static uint32_t transferUs(const uint32_t    bitrate,
+                           const uint32_t    dataBitrate,
+                           const size_t      frameSize,
+                           const std::string& message)
+{
+    using app::IsoTpEngine;
+    SimulatedBus bus(bitrate, dataBitrate);
+    IsoTpEngine sender(bus.transmitOf(0), bus.clock(), frameSize);
+    IsoTpEngine receiver(bus.transmitOf(1), bus.clock(), frameSize);
+    bus.mEngines = {&sender, &receiver};
+
+    std::vector<char> buffer(message.size());
+    bool intact = false;
+    bool sent = false;
+    const size_t session = sender.open(0x7ff, 0x6ff, nullptr, 0, nullptr);
+    const size_t rxSession = receiver.open(0x6ff, 0x7ff, buffer.data(), buffer.size(),
+                                           [&intact, &message](const bool success, const std::string_view data) {
+        intact = success && (data == message);
+    });
+    receiver.setBulkFlowControl(rxSession);
+
+    sender.send(session, message, [&sent](const bool success) {
+        sent = success;
+    });
+    bus.run([&] {
+        return intact && sent;
+    }, 100000000);
+    return intact && sent ? bus.mNow : 0;
+}
+
+enum class Policy {
+    FIXED, BULK, ADAPTIVE
+};
+
+/*
+ * Sends count messages of length bytes to a receiver which takes serviceUs
+ * per frame out of a receive queue of 16 frames. Returns the payload
+ * kbit/s of the messages which arrived intact, failed counts the others.
+ */
+static double payloadKbitPerSecond(const uint32_t bitrate, const Policy policy, const uint32_t serviceUs,
+                                   const size_t length, const size_t count, size_t& failed)
+{
+    using app::IsoTpEngine;
+    static constexpr const size_t CAPACITY = 16;
+    SimulatedBus bus(bitrate);
+    IsoTpEngine sender(bus.transmitOf(0), bus.clock());
+    IsoTpEngine receiver(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&sender, &receiver};
+    bus.mRxCapacity[1] = CAPACITY;
+    bus.mRxServiceUs[1] = serviceUs;
+
+    const std::string message = pattern(length, 'a');
+    static std::array<char, IsoTpEngine::MAXSHORTPAYLOAD> buffer;
+    size_t received = 0;
+    failed = 0;
+    const size_t session = sender.open(0x600, 0x700, nullptr, 0, nullptr);
+    const size_t rxSession = receiver.open(0x700, 0x600, buffer.data(), buffer.size(),
+                                           [&received, &message](const bool success, const std::string_view data) {
+        received += success && (data == message);
+    });
+    if (policy == Policy::BULK) {
+        receiver.setBulkFlowControl(rxSession);
+    } else if (policy == Policy::ADAPTIVE) {
+        receiver.setAdaptiveFlowControl(rxSession, [&bus] {
+            return bus.mRxQueues[1].size();
+        }, CAPACITY);
+    }
+
+    MessageStream stream {sender, session, message, count};
+    stream.sendNext();
+    bus.run([&] {
+        return received == count;
+    }, 600000000);
+    // a first frame that was dropped doesn't even fail, the bus runs until nothing is left to do
+    failed = count - received;
+    return received * length * 8 * 1000.0 / bus.mNow;
+}
+
 //-------------------------TESTCASES-------------------------
 
 int ut_SingleFrameTest(void)
@@ -542,6 +849,553 @@ int ut_Timeout(void)
     TestCaseEnd();
 }
 
+int ut_EngineSingleFrame(void)
+{
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    app::IsoTpEngine a(bus.transmitOf(0), bus.clock());
+    app::IsoTpEngine b(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&a, &b};
+
+    char buffer[16];
+    std::string received;
+    size_t completions = 0;
+    const size_t sessionA = a.open(0x7ff, 0x6ff, buffer, sizeof(buffer), nullptr);
+    b.open(0x6ff, 0x7ff, buffer, sizeof(buffer), [&](const bool success, const std::string_view message) {
+        CHECK(success);
+        received = message;
+    });
+    CHECK(a.open(0x123, 0x6ff, buffer, sizeof(buffer), nullptr) == app::IsoTpEngine::MAXSESSIONS);
+
+    CHECK(a.send(sessionA, "hello12", [&](const bool success) {
+        CHECK(success);
+        completions++;
+    }));
+    // one message at a time
+    CHECK(!a.send(sessionA, "again", nullptr));
+    CHECK(a.isSending(sessionA));
+    CHECK(completions == 0);
+
+    CHECK(bus.run([&] {
+        return !received.empty();
+    }, 10000));
+    CHECK(received == "hello12");
+    CHECK(completions == 1);
+    CHECK(!a.isSending(sessionA));
+
+    CHECK(bus.mLog.size() == 1);
+    CHECK(bus.mLog[0].mId == 0x7ff);
+    CHECK(!bus.mLog[0].mExtended);
+    CHECK(bus.mLog[0].mLength == 8);
+    CHECK(bus.mLog[0].mData[0] == 0x07);
+    CHECK_MEMCMP(bus.mLog[0].mData.data() + 1, "hello12", 7);
+
+    const CanTxMsg msg = app::IsoTpEngine::toCanTxMsg(bus.mLog[0]);
+    CHECK(msg.StdId == 0x7ff);
+    CHECK(msg.IDE == CAN_Id_Standard);
+    CHECK(msg.DLC == 8);
+    CHECK_MEMCMP(msg.Data, bus.mLog[0].mData.data(), 8);
+    TestCaseEnd();
+}
+
+int ut_EngineFullDuplex(void)
+{
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    app::IsoTpEngine a(bus.transmitOf(0), bus.clock());
+    app::IsoTpEngine b(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&a, &b};
+
+    const std::string toB = pattern(1000, 'A');
+    const std::string toA = pattern(300, 'a');
+    char bufferA[400];
+    char bufferB[app::IsoTpEngine::MAXSHORTPAYLOAD];
+    std::string receivedA;
+    std::string receivedB;
+    size_t sent = 0;
+    const size_t sessionA = a.open(0x7ff, 0x6ff, bufferA, sizeof(bufferA), [&](const bool success, const std::string_view message) {
+        CHECK(success);
+        receivedA = message;
+    });
+    const size_t sessionB = b.open(0x6ff, 0x7ff, bufferB, sizeof(bufferB), [&](const bool success, const std::string_view message) {
+        CHECK(success);
+        receivedB = message;
+    });
+    // b wants the consecutive frames as fast as possible, a controller with full mailboxes delays them
+    b.setFlowControl(sessionB, 0, 0);
+
+    CHECK(a.send(sessionA, toB, [&](const bool success) {
+        CHECK(success);
+        sent++;
+    }));
+    CHECK(b.send(sessionB, toA, [&](const bool success) {
+        CHECK(success);
+        sent++;
+    }));
+
+    CHECK(bus.run([&] {
+        return sent == 2 && !receivedA.empty() && !receivedB.empty();
+    }, 1000000));
+    CHECK(receivedB == toB);
+    CHECK(receivedA == toA);
+
+    // 1000 bytes are 1 first and 142 consecutive frames, every frame of a full length
+    const size_t framesToB = std::count_if(bus.mLog.begin(), bus.mLog.end(), [](const app::IsoTpEngine::Frame& frame) {
+        return frame.mId == 0x7ff && (frame.mData[0] >> 4) != 0x3;
+    });
+    CHECK(framesToB == 143);
+    TestCaseEnd();
+}
+
+int ut_EngineBlockSize(void)
+{
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    app::IsoTpEngine a(bus.transmitOf(0), bus.clock());
+    app::IsoTpEngine b(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&a, &b};
+
+    const std::string message = pattern(200, '0');
+    char buffer[256];
+    std::string received;
+    const size_t sessionA = a.open(0x18DA10F1, 0x18DAF110, nullptr, 0, nullptr);
+    const size_t sessionB = b.open(0x18DAF110, 0x18DA10F1, buffer, sizeof(buffer), [&](const bool success, const std::string_view data) {
+        CHECK(success);
+        received = data;
+    });
+    // 500 us separation time, a flow control after every 4 consecutive frames
+    b.setFlowControl(sessionB, 4, 0xF5);
+
+    CHECK(a.send(sessionA, message, nullptr));
+    CHECK(bus.run([&] {
+        return !received.empty();
+    }, 100000));
+    CHECK(received == message);
+
+    size_t flowControls = 0;
+    uint32_t lastConsecutiveFrame = 0;
+    for (const auto& msg : bus.mLog) {
+        CHECK(msg.mExtended);
+        if (msg.mId == 0x18DAF110) {
+            CHECK(msg.mLength == 3);
+            CHECK(msg.mData[0] == 0x30);
+            CHECK(msg.mData[1] == 4);
+            CHECK(msg.mData[2] == 0xF5);
+            flowControls++;
+        }
+        if ((msg.mData[0] >> 4) == 0x2) {
+            lastConsecutiveFrame = msg.mData[0] & 0x0f;
+        }
+    }
+    // 28 consecutive frames, the last block needs no flow control after it
+    CHECK(flowControls == 7);
+    CHECK(lastConsecutiveFrame == (28 & 0x0f));
+    // 7 blocks of at least 3 separation times
+    CHECK(bus.mNow >= 7 * 3 * 500);
+    TestCaseEnd();
+}
+
+int ut_EngineFailures(void)
+{
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    app::IsoTpEngine a(bus.transmitOf(0), bus.clock());
+    app::IsoTpEngine b(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&a, &b};
+
+    char bufferA[64];
+    char bufferB[32];
+    size_t failedReceptions = 0;
+    const size_t sessionA = a.open(0x7ff, 0x6ff, bufferA, sizeof(bufferA), nullptr);
+    const size_t sessionB = b.open(0x6ff, 0x7ff, bufferB, sizeof(bufferB), [&](const bool success, const std::string_view) {
+        failedReceptions += !success;
+    });
+
+    // too long for the buffer of b
+    int result = -1;
+    const std::string message = pattern(100, 'x');
+    CHECK(a.send(sessionA, message, [&](const bool success) {
+        result = success;
+    }));
+    CHECK(bus.run([&] {
+        return result != -1;
+    }, 10000));
+    CHECK(result == 0);
+    CHECK(bus.mLog.back().mData[0] == 0x32);
+
+    // nobody answers the first frame
+    b.close(sessionB);
+    result = -1;
+    CHECK(a.send(sessionA, message, [&](const bool success) {
+        result = success;
+    }));
+    CHECK(bus.run([&] {
+        return result != -1;
+    }, 2 * app::IsoTpEngine::TIMEOUT_US));
+    CHECK(result == 0);
+    CHECK(bus.mNow >= app::IsoTpEngine::TIMEOUT_US);
+
+    // the consecutive frames stop after the first frame
+    CanRxMsg msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.StdId = 0x6ff;
+    msg.DLC = 8;
+    msg.Data[0] = 0x10;
+    msg.Data[1] = 20;
+    a.onReceive(msg);
+    CHECK(bus.mMailboxes[0].size() == 1);
+    const uint32_t start = bus.mNow;
+    CHECK(a.process() == app::IsoTpEngine::TIMEOUT_US);
+    bus.mNow += app::IsoTpEngine::TIMEOUT_US;
+    CHECK(a.process() == app::IsoTpEngine::IDLE);
+    CHECK(bus.mNow - start == app::IsoTpEngine::TIMEOUT_US);
+
+    // a wrong sequence number
+    const size_t sessionB2 = b.open(0x6ff, 0x7ff, bufferB, sizeof(bufferB), [&](const bool success, const std::string_view) {
+        failedReceptions += !success;
+    });
+    msg.StdId = 0x7ff;
+    b.onReceive(msg);
+    msg.Data[0] = 0x22;
+    b.onReceive(msg);
+    CHECK(failedReceptions == 1);
+    CHECK(b.process() == app::IsoTpEngine::IDLE);
+    b.close(sessionB2);
+    TestCaseEnd();
+}
+
+int ut_EngineMessagesPerSecond(void)
+{
+    TestCaseBegin();
+    // 64 byte messages, 10 frames each, at the default separation time of 1 ms
+    const double single = messagesPerSecond(1, 64, 50);
+    const double concurrent = messagesPerSecond(app::IsoTpEngine::MAXSESSIONS, 64, 50);
+    CHECK(single > 0);
+    CHECK(concurrent > 2 * single);
+    printf("ISO-TP at 500 kbit/s, 64 byte messages: %.0f messages/s on one session, %.0f messages/s on %zu sessions\n",
+           single, concurrent, app::IsoTpEngine::MAXSESSIONS);
+    TestCaseEnd();
+}
+
+int ut_EngineWaitsForConsumer(void)
+{
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    app::IsoTpEngine a(bus.transmitOf(0), bus.clock());
+    app::IsoTpEngine b(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&a, &b};
+
+    const std::string message = pattern(100, 'm');
+    char buffer[128];
+    size_t backlog = 14;
+    // successful and failed receptions
+    std::array<size_t, 2> receptions {};
+    const size_t sessionA = a.open(0x7ff, 0x6ff, nullptr, 0, nullptr);
+    const size_t sessionB = b.open(0x6ff, 0x7ff, buffer, sizeof(buffer), [&receptions, &message](const bool success, const std::string_view data) {
+        receptions[!(success && (data == message))]++;
+    });
+    b.setAdaptiveFlowControl(sessionB, [&backlog] {
+        return backlog;
+    }, 16);
+
+    auto flowControls = [&](const uint8_t status) {
+                            return std::count_if(bus.mLog.begin(), bus.mLog.end(), [status](const app::IsoTpEngine::Frame& frame) {
+            return frame.mId == 0x6ff && frame.mData[0] == status;
+        });
+                        };
+
+    // only 2 of 16 frames free, the consumer is behind
+    CHECK(a.send(sessionA, message, nullptr));
+    CHECK(bus.run([&] {
+        return flowControls(0x31) == 3;
+    }, 3 * app::IsoTpEngine::WAITINTERVAL_US));
+    CHECK(flowControls(0x30) == 0);
+    CHECK(a.isSending(sessionA));
+
+    // caught up, a block of half the free frames without separation time
+    backlog = 0;
+    CHECK(bus.run([&] {
+        return receptions[0] == 1;
+    }, app::IsoTpEngine::WAITINTERVAL_US + 10000));
+    CHECK(flowControls(0x30) == 2);
+    const auto clearToSend = std::find_if(bus.mLog.begin(), bus.mLog.end(), [](const app::IsoTpEngine::Frame& frame) {
+        return frame.mId == 0x6ff && frame.mData[0] == 0x30;
+    });
+    CHECK(clearToSend->mData[1] == 8);
+    CHECK(clearToSend->mData[2] == 0);
+
+    // half full, slower
+    backlog = 8;
+    bus.mLog.clear();
+    CHECK(a.send(sessionA, message, nullptr));
+    CHECK(bus.run([&] {
+        return receptions[0] == 2;
+    }, 100000));
+    CHECK(bus.mLog[1].mData[0] == 0x30);
+    CHECK(bus.mLog[1].mData[1] == 4);
+    CHECK(bus.mLog[1].mData[2] == 0xF5);
+
+    // the consumer never catches up
+    backlog = 16;
+    bus.mLog.clear();
+    int sent = -1;
+    CHECK(a.send(sessionA, message, [&sent](const bool success) {
+        sent = success;
+    }));
+    CHECK(bus.run([&] {
+        return sent != -1;
+    }, 2 * app::IsoTpEngine::TIMEOUT_US));
+    CHECK(flowControls(0x31) == app::IsoTpEngine::MAXWAITFRAMES);
+    CHECK(receptions[1] == 1);
+    CHECK(sent == 0);
+    TestCaseEnd();
+}
+
+int ut_EngineFlowControlThroughput(void)
+{
+    TestCaseBegin();
+    // the receiver needs 200 us per frame, faster than 500 kbit/s but slower than 1 Mbit/s
+    static constexpr const uint32_t SERVICE_US = 200;
+    static constexpr const size_t MESSAGES = 8;
+    static constexpr const std::array<uint32_t, 3> bitrates {125000, 500000, 1000000};
+    static constexpr const std::array<const char*, 3> names {"fixed", "bulk", "adaptive"};
+
+    std::array<std::array<double, 3>, 3> kbits;
+    std::array<std::array<size_t, 3>, 3> failed;
+    printf("ISO-TP payload kbit/s, %zu messages of %zu bytes, receiver at %u us per frame:\n",
+           MESSAGES, app::IsoTpEngine::MAXSHORTPAYLOAD, SERVICE_US);
+    for (size_t rate = 0; rate < bitrates.size(); rate++) {
+        for (size_t policy = 0; policy < names.size(); policy++) {
+            kbits[rate][policy] = payloadKbitPerSecond(bitrates[rate], static_cast<Policy>(policy), SERVICE_US,
+                                                       app::IsoTpEngine::MAXSHORTPAYLOAD, MESSAGES, failed[rate][policy]);
+        }
+        printf("%7u bit/s:", bitrates[rate]);
+        for (size_t policy = 0; policy < names.size(); policy++) {
+            printf(" %s %6.1f (%zu lost)", names[policy], kbits[rate][policy], failed[rate][policy]);
+        }
+        printf("\n");
+    }
+
+    const auto fixed = static_cast<size_t>(Policy::FIXED);
+    const auto bulk = static_cast<size_t>(Policy::BULK);
+    const auto adaptive = static_cast<size_t>(Policy::ADAPTIVE);
+    for (size_t rate = 0; rate < bitrates.size(); rate++) {
+        CHECK(failed[rate][fixed] == 0);
+        CHECK(failed[rate][adaptive] == 0);
+    }
+    // at 125 kbit/s a frame takes longer than the separation time anyway, adaptive only pays for its flow controls
+    CHECK(kbits[0][adaptive] > 0.9 * kbits[0][fixed]);
+    CHECK(kbits[1][adaptive] > 2 * kbits[1][fixed]);
+    CHECK(kbits[2][adaptive] > 2 * kbits[2][fixed]);
+    // bulk is the fastest while the receiver keeps up
+    CHECK(failed[1][bulk] == 0);
+    CHECK(kbits[1][bulk] > 2 * kbits[1][fixed]);
+    CHECK(kbits[1][bulk] >= kbits[1][adaptive]);
+    // and overruns it otherwise
+    CHECK(failed[2][bulk] > 0);
+    CHECK(kbits[2][adaptive] > kbits[2][bulk]);
+    TestCaseEnd();
+}
+
+int ut_EngineEscapeSequence(void)
+{
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    app::IsoTpEngine a(bus.transmitOf(0), bus.clock());
+    app::IsoTpEngine b(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&a, &b};
+
+    // longer than 4095 bytes, the length follows in 32 bits
+    const std::string message = pattern(5000, 'e');
+    char buffer[4096];
+    size_t failedReceptions = 0;
+    const size_t sessionA = a.open(0x7ff, 0x6ff, nullptr, 0, nullptr);
+    b.open(0x6ff, 0x7ff, buffer, sizeof(buffer), [&failedReceptions](const bool success, const std::string_view) {
+        failedReceptions += !success;
+    });
+    CHECK(a.send(sessionA, message, nullptr));
+    a.process();
+    CHECK(bus.mMailboxes[0].size() == 1);
+    const app::IsoTpEngine::Frame firstFrame = bus.mMailboxes[0][0];
+    CHECK(firstFrame.mLength == 8);
+    CHECK(firstFrame.mData[0] == 0x10);
+    CHECK(firstFrame.mData[1] == 0x00);
+    CHECK(firstFrame.mData[2] == 0x00);
+    CHECK(firstFrame.mData[3] == 0x00);
+    CHECK(firstFrame.mData[4] == 0x13);
+    CHECK(firstFrame.mData[5] == 0x88);
+    CHECK_MEMCMP(firstFrame.mData.data() + 6, message.data(), 2);
+
+    // 5000 bytes don't fit the 4096 of b
+    CHECK(bus.run([&] {
+        return !a.isSending(sessionA);
+    }, 10000));
+    CHECK(bus.mLog.back().mData[0] == 0x32);
+
+    // the escape sequence isn't allowed for what a short first frame holds
+    app::IsoTpEngine::Frame frame {0x7ff, false, 8, {0x10, 0x00, 0x00, 0x00, 0x00, 0x10}};
+    bus.mLog.clear();
+    b.onReceive(frame);
+    CHECK(b.process() == app::IsoTpEngine::IDLE);
+    CHECK(bus.mMailboxes[1].empty());
+    CHECK(failedReceptions == 0);
+
+    // 100 KiB at 500 kbit/s
+    const uint32_t us = transferUs(500000, 0, app::IsoTpEngine::CLASSICFRAMESIZE, pattern(100 * 1024, 'A'));
+    CHECK(us > 0);
+    TestCaseEnd();
+}
+
+int ut_EngineAddressing(void)
+{
+    using app::IsoTpEngine;
+    TestCaseBegin();
+    SimulatedBus bus(500000);
+    IsoTpEngine tester(bus.transmitOf(0), bus.clock());
+    IsoTpEngine ecus(bus.transmitOf(1), bus.clock());
+    bus.mEngines = {&tester, &ecus};
+
+    // extended addressing, the tester F1 sends to both ECUs on the same ID
+    std::array<std::string, 4> received;
+    std::array<char[256], 4> buffers;
+    std::array<size_t, 4> sessions;
+    sessions[0] = tester.open({0x6F1, 0x610, IsoTpEngine::Addressing::EXTENDED, 0x10, 0xF1}, buffers[0], 256,
+                              [&received](const bool, const std::string_view data) {
+        received[0] = data;
+    });
+    sessions[1] = tester.open({0x6F1, 0x620, IsoTpEngine::Addressing::EXTENDED, 0x20, 0xF1}, buffers[1], 256,
+                              [&received](const bool, const std::string_view data) {
+        received[1] = data;
+    });
+    sessions[2] = ecus.open({0x610, 0x6F1, IsoTpEngine::Addressing::EXTENDED, 0xF1, 0x10}, buffers[2], 256,
+                            [&received](const bool, const std::string_view data) {
+        received[2] = data;
+    });
+    sessions[3] = ecus.open({0x620, 0x6F1, IsoTpEngine::Addressing::EXTENDED, 0xF1, 0x20}, buffers[3], 256,
+                            [&received](const bool, const std::string_view data) {
+        received[3] = data;
+    });
+    for (const auto session : sessions) {
+        CHECK(session < IsoTpEngine::MAXSESSIONS);
+    }
+    // the same address twice or next to normal addressing
+    CHECK(tester.open({0x6F1, 0x610, IsoTpEngine::Addressing::EXTENDED, 0x10, 0xF1}, nullptr, 0, nullptr)
+          == IsoTpEngine::MAXSESSIONS);
+    CHECK(tester.open(0x6F1, 0x610, nullptr, 0, nullptr) == IsoTpEngine::MAXSESSIONS);
+
+    // a single frame has a byte less
+    CHECK(tester.send(sessions[0], "123456", nullptr));
+    CHECK(bus.run([&] {
+        return !received[2].empty();
+    }, 10000));
+    CHECK(received[2] == "123456");
+    CHECK(received[3].empty());
+    CHECK(bus.mLog[0].mLength == 8);
+    CHECK(bus.mLog[0].mData[0] == 0x10);
+    CHECK(bus.mLog[0].mData[1] == 0x06);
+
+    const std::array<std::string, 4> messages {pattern(100, 'a'), pattern(150, 'b'), pattern(120, 'c'), pattern(7, 'd')};
+    for (size_t i = 0; i < 2; i++) {
+        CHECK(tester.send(sessions[i], messages[i], nullptr));
+        CHECK(ecus.send(sessions[2 + i], messages[2 + i], nullptr));
+    }
+    CHECK(bus.run([&] {
+        return received[0] == messages[2] && received[1] == messages[3] && received[2] == messages[0] && received[3] == messages[1];
+    }, 1000000));
+    for (const auto& frame : bus.mLog) {
+        if (frame.mId == 0x6F1) {
+            CHECK(frame.mData[0] == 0x10 || frame.mData[0] == 0x20);
+        } else {
+            CHECK(frame.mData[0] == 0xF1);
+        }
+    }
+
+    // mixed addressing, the address extension goes both ways
+    tester.close(sessions[0]);
+    ecus.close(sessions[2]);
+    sessions[0] = tester.open({0x18CE10F1, 0x18CEF110, IsoTpEngine::Addressing::MIXED, 0x42, 0x42}, nullptr, 0, nullptr);
+    sessions[2] = ecus.open({0x18CEF110, 0x18CE10F1, IsoTpEngine::Addressing::MIXED, 0x42, 0x42}, buffers[2], 256,
+                            [&received](const bool, const std::string_view data) {
+        received[2] = data;
+    });
+    bus.mLog.clear();
+    received[2].clear();
+    CHECK(tester.send(sessions[0], messages[0], nullptr));
+    CHECK(bus.run([&] {
+        return received[2] == messages[0];
+    }, 1000000));
+    // 5 bytes in the first frame, 6 in each of 16 consecutive frames and a flow control
+    CHECK(bus.mLog.size() == 1 + 16 + 1);
+    for (const auto& frame : bus.mLog) {
+        CHECK(frame.mExtended);
+        CHECK(frame.mData[0] == 0x42);
+    }
+    TestCaseEnd();
+}
+
+int ut_EngineCanFd(void)
+{
+    using app::IsoTpEngine;
+    TestCaseBegin();
+    SimulatedBus bus(500000, 2000000);
+    IsoTpEngine a(bus.transmitOf(0), bus.clock(), IsoTpEngine::MAXFRAMESIZE);
+    IsoTpEngine b(bus.transmitOf(1), bus.clock(), IsoTpEngine::MAXFRAMESIZE);
+    bus.mEngines = {&a, &b};
+
+    char buffer[256];
+    std::string received;
+    const size_t sessionA = a.open(0x7ff, 0x6ff, nullptr, 0, nullptr);
+    b.open(0x6ff, 0x7ff, buffer, sizeof(buffer), [&received](const bool, const std::string_view data) {
+        received = data;
+    });
+
+    // what fits in 8 bytes keeps the classic single frame
+    CHECK(a.send(sessionA, "abc", nullptr));
+    CHECK(bus.run([&] {
+        return received == "abc";
+    }, 10000));
+    CHECK(bus.mLog.back().mLength == 4);
+    CHECK(bus.mLog.back().mData[0] == 0x03);
+
+    // longer ones escape the length, padded to a valid length of CAN FD
+    const std::string twenty = pattern(20, 'f');
+    CHECK(a.send(sessionA, twenty, nullptr));
+    CHECK(bus.run([&] {
+        return received == twenty;
+    }, 10000));
+    CHECK(bus.mLog.back().mLength == 24);
+    CHECK(bus.mLog.back().mData[0] == 0x00);
+    CHECK(bus.mLog.back().mData[1] == 20);
+    CHECK(bus.mLog.back().mData[22] == 0xCC);
+    CHECK(bus.mLog.back().mData[23] == 0xCC);
+
+    // a first frame of 64 bytes, the last consecutive frame padded
+    const std::string hundred = pattern(100, 'F');
+    bus.mLog.clear();
+    CHECK(a.send(sessionA, hundred, nullptr));
+    CHECK(bus.run([&] {
+        return received == hundred;
+    }, 10000));
+    CHECK(bus.mLog.size() == 3);
+    CHECK(bus.mLog[0].mLength == 64);
+    CHECK(bus.mLog[0].mData[0] == 0x10);
+    CHECK(bus.mLog[0].mData[1] == 100);
+    CHECK(bus.mLog[2].mLength == 48);
+    CHECK(bus.mLog[2].mData[0] == 0x21);
+    CHECK(bus.mLog[2].mData[39] == 0xCC);
+
+    // 100 KiB, classic CAN against CAN FD at a data bitrate of 2 Mbit/s
+    const std::string message = pattern(100 * 1024, 'A');
+    const uint32_t classic = transferUs(500000, 0, IsoTpEngine::CLASSICFRAMESIZE, message);
+    const uint32_t fd = transferUs(500000, 2000000, IsoTpEngine::MAXFRAMESIZE, message);
+    CHECK(classic > 0);
+    CHECK(fd > 0);
+    CHECK(4 * fd < classic);
+    printf("ISO-TP 100 KiB at 500 kbit/s: classic CAN %u ms (%.1f kbit/s), CAN FD 64 bytes at 2 Mbit/s %u ms (%.1f kbit/s)\n",
+           classic / 1000, message.size() * 8000.0 / classic, fd / 1000, message.size() * 8000.0 / fd);
+    TestCaseEnd();
+}
+
 int main(int argc, const char* argv[])
 {
     UnitTestMainBegin();
@@ -556,5 +1410,15 @@ int main(int argc, const char* argv[])
     RunTest(true, ut_length_Bigger_than_Buffer);
     RunTest(true, ut_message_Bigger_than_Buffer);
     RunTest(true, ut_Timeout);
+    RunTest(true, ut_EngineSingleFrame);
+    RunTest(true, ut_EngineFullDuplex);
+    RunTest(true, ut_EngineBlockSize);
+    RunTest(true, ut_EngineFailures);
+    RunTest(true, ut_EngineMessagesPerSecond);
+    RunTest(true, ut_EngineWaitsForConsumer);
+    RunTest(true, ut_EngineFlowControlThroughput);
+    RunTest(true, ut_EngineEscapeSequence);
+    RunTest(true, ut_EngineAddressing);
+    RunTest(true, ut_EngineCanFd);
     UnitTestMainEnd();
 }
@@ -31,16 +31,24 @@ ModemDriver::ModemDriver(const hal::UsartWithDma& interface,
                          const hal::Gpio&         powerPin,
                          const hal::Gpio&         supplyPin) :
     mModemTxTask("ModemTxTask",
-                 ModemDriver::STACKSIZE,
                  os::Task::Priority::HIGH,
                  [this](const bool& join){
     modemTxTaskFunction(join);
+}),
+    mDemuxTask("DemuxTask",
+               os::Task::Priority::VERY_HIGH,
+               [this](const bool& join){
+    demuxTaskFunction(join);
 }),
     mParserTask("ParserTask",
-                ModemDriver::STACKSIZE,
                 os::Task::Priority::VERY_HIGH,
                 [this](const bool& join){
     parserTaskFunction(join);
+}),
+    mDataParserTask("DataParserTask",
+                    os::Task::Priority::VERY_HIGH,
+                    [this](const bool& join){
+    dataParserTaskFunction(join);
 }),
     mInterface(interface),
     mModemReset(resetPin),
@@ -49,10 +57,12 @@ ModemDriver::ModemDriver(const hal::UsartWithDma& interface,
     mSend([&](std::string_view in, std::chrono::milliseconds timeout) -> size_t {
     return mInterface.send(in, timeout.count());
 }),
-    mRecv([&](uint8_t* output, const size_t length, std::chrono::milliseconds timeout) -> bool {
+    mRecv([&](uint8_t* output, const size_t length, std::chrono::milliseconds timeout) -> size_t {
     return InputBuffer.receive(reinterpret_cast<char*>(output), length, timeout);
 }),
-    mParser(mRecv),
+    mMux(mSend, mRecv),
+    mParser(mMux.getReceive(CONTROLCHANNEL)),
+    mDataParser(mMux.getReceive(DATACHANNEL)),
     mUrcCallbackReceive([&](const size_t socket, const size_t bytes){
     for (size_t i = 0; i < mNumOfSockets; i++) {
         auto sock = mSockets[i];
@@ -60,6 +70,7 @@ ModemDriver::ModemDriver(const hal::UsartWithDma& interface,
             if (bytes) {
                 Trace(ZONE_INFO, "S%d: %d bytes available\r\n", socket, bytes);
                 sock->mNumberOfBytesForReceive.overwrite(bytes);
+                sock->markReady();
             } else {
                 sock->mNumberOfBytesForReceive.reset();
             }
@@ -73,11 +84,14 @@ ModemDriver::ModemDriver(const hal::UsartWithDma& interface,
         if (sock->mSocket == socket) {
             sock->isOpen = false;
             sock->isCreated = false;
+            sock->markReady();
         }
     }
 }),
     mATOK(),
     mATERROR(),
+    mDataATOK(),
+    mDataATERROR(),
     mATUUSORF("UUSORF", "+UUSORF: ", mUrcCallbackReceive),
     mATUUSORD("UUSORD", "+UUSORD: ", mUrcCallbackReceive),
     mATUUPSDD("UUPSDD", "+UUPSDD: ", mUrcCallbackClose),
@@ -88,11 +102,14 @@ ModemDriver::ModemDriver(const hal::UsartWithDma& interface,
 
     mParser.registerAtCommand(&mATOK);
     mParser.registerAtCommand(&mATERROR);
-    mParser.registerAtCommand(&mATUUSORF);
-    mParser.registerAtCommand(&mATUUSORD);
     mParser.registerAtCommand(&mATUUPSDD);
-    mParser.registerAtCommand(&mATUUSOCL);
     mParser.registerAtCommand(&mATCGATT);
+
+    mDataParser.registerAtCommand(&mDataATOK);
+    mDataParser.registerAtCommand(&mDataATERROR);
+    mDataParser.registerAtCommand(&mATUUSORF);
+    mDataParser.registerAtCommand(&mATUUSORD);
+    mDataParser.registerAtCommand(&mATUUSOCL);
 }
 
 ModemDriver::~ModemDriver(void)
@@ -113,27 +130,14 @@ void ModemDriver::modemTxTaskFunction(const bool& join)
             continue;
         }
 
-        while (mErrorCount < ERROR_THRESHOLD) {
-            for (size_t i = 0; i < mNumOfSockets; i++) {
-                auto sock = mSockets[i];
-                if (!sock->isCreated) {
-                    sock->create();
-                }
-
-                if (sock->isCreated && !sock->isOpen) {
-                    sock->open();
-                }
-
-                if (!sock->isOpen) {
-                    handleError("0");
-                    continue;
-                }
-                sock->checkAndSendData();
-                sock->checkAndReceiveData();
-            }
+        // the sockets have to be created again
+        for (size_t i = 0; i < mNumOfSockets; i++) {
+            mSockets[i]->markReady();
+        }
 
-            if (os::Task::getTickCount() - 2000 > lastGPRSCheck) {
-                auto result = mATCGATT.send(mSend, std::chrono::milliseconds(2000));
+        while (mErrorCount < ERROR_THRESHOLD) {
+            if (os::Task::getTickCount() - GPRS_CHECK_PERIOD > lastGPRSCheck) {
+                auto result = mATCGATT.send(mMux.getSend(CONTROLCHANNEL), std::chrono::milliseconds(2000));
                 if (result == AT::Return_t::FINISHED) {
                     out = !mATCGATT.getResult();
                 } else {
@@ -141,10 +145,33 @@ void ModemDriver::modemTxTaskFunction(const bool& join)
                 }
                 lastGPRSCheck = os::Task::getTickCount();
             }
+
+            // sleep until a socket is ready, at the latest until the next GPRS check
+            const uint32_t elapsed = os::Task::getTickCount() - lastGPRSCheck;
+            const uint32_t timeout = elapsed < GPRS_CHECK_PERIOD ? GPRS_CHECK_PERIOD - elapsed : 0;
+            auto ready = mScheduler.wait(std::chrono::milliseconds(timeout));
+            while (ready && (mErrorCount < ERROR_THRESHOLD)) {
+                const size_t slot = mScheduler.take(ready);
+                auto sock = mSockets[slot];
+                if (service(*sock)) {
+                    mScheduler.setKeepAlive(slot, sock->getKeepAliveDeadline());
+                } else {
+                    sock->markReady();
+                }
+                // a socket of higher priority may have become ready meanwhile
+                ready |= mScheduler.wait(std::chrono::milliseconds(0));
+            }
         }
     } while (!join);
 }
 
+void ModemDriver::demuxTaskFunction(const bool& join)
+{
+    do {
+        mMux.demux(std::chrono::milliseconds(100));
+    } while (!join);
+}
+
 void ModemDriver::parserTaskFunction(const bool& join)
 {
     do {
@@ -153,28 +180,59 @@ void ModemDriver::parserTaskFunction(const bool& join)
     } while (!join);
 }
 
+void ModemDriver::dataParserTaskFunction(const bool& join)
+{
+    do {
+        auto x = mDataParser.parse(std::chrono::milliseconds(45000));
+        Trace(ZONE_INFO, "Data parser terminated with %d\r\n", x);
+    } while (!join);
+}
+
 bool ModemDriver::modemStartup(void)
 {
-    static std::array<app::ATCmd, 6> startupCommands = {
+    // sent on the plain uart, N1 of AT+CMUX is Cmux::FRAMESIZE
+    static std::array<app::ATCmd, 3> uartCommands = {
         app::ATCmd("ATZ", "ATZ\r", ""),
+        app::ATCmd("ATE0V1", "ATE0V1\r", ""),
+        app::ATCmd("AT+CMUX", "AT+CMUX=0,0,,127\r", ""),
+    };
+    // every channel has settings of its own
+    static std::array<app::ATCmd, 5> controlCommands = {
         app::ATCmd("ATE0V1", "ATE0V1\r", ""),
         app::ATCmd("AT+CMEE", "AT+CMEE=2\r", ""),
         app::ATCmd("AT+CGCLASS", "AT+CGCLASS=\"B\"\r", ""),
         app::ATCmd("AT+CGGATT", "AT+CGATT=1\r", ""),
         app::ATCmd("AT+UPSDA", "AT+UPSDA=0,3\r", ""),
     };
+    static std::array<app::ATCmd, 2> dataCommands = {
+        app::ATCmd("ATE0V1", "ATE0V1\r", ""),
+        app::ATCmd("AT+CMEE", "AT+CMEE=2\r", ""),
+    };
 
-    for (auto& cmd : startupCommands) {
-        os::ThisTask::sleep(std::chrono::milliseconds(100));
+    auto sendAll = [](auto& commands, ATParser& parser, AT::SendFunction& send) {
+        for (auto& cmd : commands) {
+            os::ThisTask::sleep(std::chrono::milliseconds(100));
 
-        cmd.mParser = &mParser;
-        if (cmd.send(mSend, std::chrono::milliseconds(40000)) != AT::Return_t::FINISHED) {
-            Trace(ZONE_VERBOSE, "Cmd %s ERROR\r\n", cmd.mName.data());
-            return false;
+            cmd.mParser = &parser;
+            if (cmd.send(send, std::chrono::milliseconds(40000)) != AT::Return_t::FINISHED) {
+                Trace(ZONE_VERBOSE, "Cmd %s ERROR\r\n", cmd.mName.data());
+                return false;
+            }
+            Trace(ZONE_VERBOSE, "Cmd %s SUCCESS\r\n", cmd.mName.data());
         }
-        Trace(ZONE_VERBOSE, "Cmd %s SUCCESS\r\n", cmd.mName.data());
+        return true;
+    };
+
+    // the control channel is the plain uart until the multiplexer is open
+    if (!sendAll(uartCommands, mParser, mMux.getSend(CONTROLCHANNEL))) {
+        return false;
     }
-    return true;
+    if (!mMux.open(std::chrono::seconds(2))) {
+        Trace(ZONE_VERBOSE, "CMUX ERROR\r\n");
+        return false;
+    }
+    return sendAll(controlCommands, mParser, mMux.getSend(CONTROLCHANNEL)) &&
+           sendAll(dataCommands, mDataParser, mMux.getSend(DATACHANNEL));
 }
 
 void ModemDriver::modemOn(void) const
@@ -194,7 +252,10 @@ void ModemDriver::modemReset(void)
 {
     Trace(ZONE_INFO, "Modem Reset\r\n");
     modemOff();
+    mMux.reset();
     InputBuffer.reset();
+    mParser.reset();
+    mDataParser.reset();
     for (size_t i = 0; i < mNumOfSockets; i++) {
         auto sock = mSockets[i];
         sock->reset();
@@ -211,36 +272,59 @@ void ModemDriver::handleError(const char* str)
     mErrorCount++;
 }
 
+/* false if the socket isn't open, it has to be serviced again */
+bool ModemDriver::service(Socket& sock)
+{
+    if (!sock.isCreated) {
+        sock.create();
+    }
+
+    if (sock.isCreated && !sock.isOpen) {
+        sock.open();
+    }
+
+    if (!sock.isOpen) {
+        handleError("0");
+        return false;
+    }
+    sock.checkAndSendData();
+    sock.checkAndReceiveData();
+    return true;
+}
+
 app::Socket* ModemDriver::getSocket(app::Socket::Protocol protocol,
                                     std::string_view ip, std::string_view port)
 {
-    if (mNumOfSockets > MAXNUMOFSOCKETS) {
+    if (mNumOfSockets >= MAXNUMOFSOCKETS) {
         Trace(ZONE_ERROR, "Maximum number of sockets reached\r\n");
         return nullptr;
     }
 
     app::Socket* sock = nullptr;
     if (protocol == Socket::Protocol::TCP) {
-        sock = new TcpSocket(mParser, mSend, ip, port,
+        sock = new TcpSocket(mDataParser, mMux.getSend(DATACHANNEL), ip, port,
                              mUrcCallbackReceive, [&] {
             handleError("1");
         });
     }
 
     if (protocol == Socket::Protocol::UDP) {
-        sock = new UdpSocket(mParser, mSend, ip, port,
+        sock = new UdpSocket(mDataParser, mMux.getSend(DATACHANNEL), ip, port,
                              mUrcCallbackReceive, [&] {
             handleError("2");
         });
     }
 
     if (protocol == Socket::Protocol::DNS) {
-        sock = new DnsSocket(mParser, mSend, mUrcCallbackReceive, [&] {
+        sock = new DnsSocket(mDataParser, mMux.getSend(DATACHANNEL), mUrcCallbackReceive, [&] {
             handleError("3");
         });
     }
     if (sock) {
+        sock->mScheduler = &mScheduler;
+        sock->mSlot = mScheduler.add();
         mSockets[mNumOfSockets++] = sock;
+        sock->markReady();
     }
     return sock;
 }
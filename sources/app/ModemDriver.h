@@ -8,28 +8,51 @@
 #include <string>
 #include <string_view>
 #include <array>
+#include <atomic>
 #include "TaskInterruptable.h"
+#include "StaticTask.h"
 #include "os_StreamBuffer.h"
 #include "os_Queue.h"
 #include "UsartWithDma.h"
 #include "Gpio.h"
 #include "AT_Parser.h"
+#include "Cmux.h"
 #include "Socket.h"
+#include "SocketScheduler.h"
 
 namespace app
 {
+/*
+ * The modem runs in CMUX mode with two channels: the control channel carries
+ * the startup, the GPRS checks and the network URCs, the data channel the
+ * sockets and their URCs, which the modem reports on the channel the socket
+ * was created on. Every channel has a parser task of its own, so a large
+ * socket transfer doesn't hold up the control commands.
+ *
+ * The tx task only services the sockets the SocketScheduler reports ready,
+ * the socket created first has the highest priority. A socket that couldn't
+ * be opened stays ready, so it is retried until the error threshold resets
+ * the modem.
+ */
 class ModemDriver final
 {
     static constexpr size_t STACKSIZE = 2048;
     static constexpr size_t BUFFERSIZE = 1024;
     static constexpr size_t ERROR_THRESHOLD = 20;
     static constexpr const size_t MAXNUMOFSOCKETS = 5;
+    static_assert(MAXNUMOFSOCKETS <= SocketScheduler::MAXSOCKETS, "Every socket needs a slot");
+    static constexpr const uint32_t GPRS_CHECK_PERIOD = 2000;
+    static constexpr const size_t CONTROLCHANNEL = 0;
+    static constexpr const size_t DATACHANNEL = 1;
     static os::StreamBuffer<char, BUFFERSIZE> InputBuffer;
 
     std::array<Socket*, MAXNUMOFSOCKETS> mSockets;
+    SocketScheduler mScheduler;
 
-    os::TaskInterruptable mModemTxTask;
-    os::TaskInterruptable mParserTask;
+    os::StaticTask<STACKSIZE, os::TaskInterruptable> mModemTxTask;
+    os::StaticTask<STACKSIZE, os::TaskInterruptable> mDemuxTask;
+    os::StaticTask<STACKSIZE, os::TaskInterruptable> mParserTask;
+    os::StaticTask<STACKSIZE, os::TaskInterruptable> mDataParserTask;
 
     const hal::UsartWithDma& mInterface;
     const hal::Gpio& mModemReset;
@@ -38,23 +61,30 @@ class ModemDriver final
 
     AT::SendFunction mSend;
     AT::ReceiveFunction mRecv;
+    Cmux mMux;
     ATParser mParser;
+    ATParser mDataParser;
     std::function<void(size_t, size_t)> mUrcCallbackReceive;
     std::function<void(size_t, size_t)> mUrcCallbackClose;
 
     app::ATCmdOK mATOK;
     app::ATCmdERROR mATERROR;
+    app::ATCmdOK mDataATOK;
+    app::ATCmdERROR mDataATERROR;
     app::ATCmdURC mATUUSORF;
     app::ATCmdURC mATUUSORD;
     app::ATCmdURC mATUUPSDD;
     app::ATCmdURC mATUUSOCL;
     app::ATCmdCGATT mATCGATT;
 
-    size_t mErrorCount = 0;
+    // socket errors are also reported from the parser task
+    std::atomic<size_t> mErrorCount {0};
     size_t mNumOfSockets = 0;
 
     void modemTxTaskFunction(const bool&);
+    void demuxTaskFunction(const bool&);
     void parserTaskFunction(const bool&);
+    void dataParserTaskFunction(const bool&);
 
     void modemOn(void) const;
     void modemOff(void) const;
@@ -62,6 +92,7 @@ class ModemDriver final
     bool modemStartup(void);
 
     void handleError(const char* str = "");
+    bool service(Socket& sock);
 
 public:
     ModemDriver(const hal::UsartWithDma& interface,
@@ -87,7 +87,7 @@ size_t hal::UsartWithDma::receive(uint8_t* const data, const size_t length, cons
     return g_usartError ? 0 : length;
 }
 
-void hal::Usart::enableNonBlockingReceive(std::function<void(uint8_t)> callback) const
+void hal::Usart::enableNonBlockingReceive(util::InplaceFunction<void(uint8_t)> callback) const
 {
     g_usartNonBlockingEnabled = true;
     g_usartCallback = callback;
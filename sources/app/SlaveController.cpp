@@ -11,8 +11,7 @@ using app::SlaveController;
 
 static const int __attribute__((used)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
-constexpr std::chrono::milliseconds SlaveController:: UPDATE_INTERNAL_INTERVAL;
-constexpr std::chrono::milliseconds SlaveController::UPDATE_EXTERNAL_INTERVAL;
+constexpr std::chrono::milliseconds SlaveController::UPDATE_INTERVAL;
 
 SlaveController::SlaveController(
                                  BalanceController&                     rBal,
@@ -33,19 +32,12 @@ SlaveController::SlaveController(
                                  const dev::Light&                      rLight2,
                                  const virt::Light&                     vLight1,
                                  const virt::Light&                     vLight2) :
-    mUpdateExternalObjectsTask("6UpdateExternalTask",
-                               SlaveController::STACKSIZE,
-                               os::Task::Priority::HIGH,
-                               [this](const bool& join)
+    mUpdateTask("6UpdateTask",
+                SlaveController::STACKSIZE,
+                os::Task::Priority::HIGH,
+                [this](const bool& join)
 {
-    UpdateExternalObjectsTaskFunction(join);
-}),
-    mUpdateInternalObjectsTask("7UpdateInternalTask",
-                               SlaveController::STACKSIZE,
-                               os::Task::Priority::HIGH,
-                               [this](const bool& join)
-{
-    UpdateInternalObjectsTaskFunction(join);
+    UpdateTaskFunction(join);
 }),
     mRealBalancer(rBal),
     mVirtBalancer(vBal),
@@ -67,32 +59,34 @@ SlaveController::SlaveController(
     mVirtLight2(vLight2)
 {}
 
-void SlaveController::UpdateInternalObjectsTaskFunction(const bool& join)
+void SlaveController::UpdateTaskFunction(const bool& join)
 {
     do {
-        mRealBalancer.setTargetAngleInDegree(mVirtBalancer.getTargetAngleInDegree());
+        UpdateInternalObjects();
+        UpdateExternalObjects();
 
-        mRealLight1.setColor(mVirtLight1.getColor());
-        mRealLight2.setColor(mVirtLight2.getColor());
-
-        os::ThisTask::sleep(UPDATE_INTERNAL_INTERVAL);
+        os::ThisTask::sleep(UPDATE_INTERVAL);
     } while (!join);
 }
 
-void SlaveController::UpdateExternalObjectsTaskFunction(const bool& join)
+void SlaveController::UpdateInternalObjects(void)
 {
-    do {
-        mVirtMotorController.setCurrentRPS(mRealMotorController.getCurrentRPS());
+    mRealBalancer.setTargetAngleInDegree(mVirtBalancer.getTargetAngleInDegree());
 
-        mVirtBattery.setCurrent(mRealBattery.getCurrent());
-        mVirtBattery.setVoltage(mRealBattery.getVoltage());
-        mVirtBattery.setTemperature(mRealBattery.getTemperature());
+    mRealLight1.setColor(mVirtLight1.getColor());
+    mRealLight2.setColor(mVirtLight2.getColor());
+}
+
+void SlaveController::UpdateExternalObjects(void)
+{
+    mVirtMotorController.setCurrentRPS(mRealMotorController.getCurrentRPS());
 
-        mVirtTempSensor1.setTemperature(mRealTempSensor1.getTemperature());
-        mVirtTempSensor2.setTemperature(mRealTempSensor2.getTemperature());
-        mVirtTempSensor3.setTemperature(mRealTempSensor3.getTemperature());
-        mVirtTempSensor4.setTemperature(mRealTempSensor4.getTemperature());
+    mVirtBattery.setCurrent(mRealBattery.getCurrent());
+    mVirtBattery.setVoltage(mRealBattery.getVoltage());
+    mVirtBattery.setTemperature(mRealBattery.getTemperature());
 
-        os::ThisTask::sleep(UPDATE_EXTERNAL_INTERVAL);
-    } while (!join);
+    mVirtTempSensor1.setTemperature(mRealTempSensor1.getTemperature());
+    mVirtTempSensor2.setTemperature(mRealTempSensor2.getTemperature());
+    mVirtTempSensor3.setTemperature(mRealTempSensor3.getTemperature());
+    mVirtTempSensor4.setTemperature(mRealTempSensor4.getTemperature());
 }
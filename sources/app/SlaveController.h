@@ -23,11 +23,10 @@ namespace app
 class SlaveController final
 {
     static constexpr uint32_t STACKSIZE = 1024;
-    static constexpr auto UPDATE_INTERNAL_INTERVAL = std::chrono::milliseconds(20);
-    static constexpr auto UPDATE_EXTERNAL_INTERVAL = std::chrono::milliseconds(20);
+    static constexpr auto UPDATE_INTERVAL = std::chrono::milliseconds(20);
 
-    os::TaskInterruptable mUpdateExternalObjectsTask;
-    os::TaskInterruptable mUpdateInternalObjectsTask;
+    // the updates block on the ADC and the SPI DMA, so they can't run as timer callbacks
+    os::TaskInterruptable mUpdateTask;
 
     BalanceController& mRealBalancer;
     const virt::BalanceController& mVirtBalancer;
@@ -54,8 +53,9 @@ class SlaveController final
     const virt::Light& mVirtLight1;
     const virt::Light& mVirtLight2;
 
-    void UpdateExternalObjectsTaskFunction(const bool&);
-    void UpdateInternalObjectsTaskFunction(const bool&);
+    void UpdateTaskFunction(const bool& join);
+    void UpdateExternalObjects(void);
+    void UpdateInternalObjects(void);
 
 public:
     SlaveController(BalanceController&,
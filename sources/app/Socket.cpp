@@ -69,19 +69,19 @@ void Socket::checkAndReceiveData(void)
 {
     size_t bytes = 0;
 
-    if (isOpen && mNumberOfBytesForReceive.receive(bytes, std::chrono::milliseconds(10))) {
+    if (isOpen && !isBusy && mNumberOfBytesForReceive.receive(bytes, std::chrono::milliseconds(0))) {
         Trace(ZONE_VERBOSE, "receive\r\n");
 
         this->receiveData(bytes);
     }
-    if (isOpen && (os::Task::getTickCount() - mTimeOfLastReceive >= KEEP_ALIVE_PAUSE.count())) {
+    if (isOpen && !isBusy && (os::Task::getTickCount() - mTimeOfLastReceive >= KEEP_ALIVE_PAUSE.count())) {
         this->checkIfDataAvailable();
     }
 }
 
 void Socket::checkAndSendData(void)
 {
-    if (isOpen && mSendBuffer.bytesAvailable()) {
+    if (isOpen && !isBusy && mSendBuffer.bytesAvailable()) {
         Trace(ZONE_VERBOSE, "send\r\n");
         this->sendData();
     }
@@ -106,26 +106,80 @@ void Socket::storeReceivedData(const std::string_view data)
     mTimeOfLastReceive = os::Task::getTickCount();
 }
 
-size_t Socket::loadTemporaryBuffer(void)
+size_t Socket::getSendLength(void) const
 {
-    const size_t bytes = std::min(mTemporaryBuffer.size(), mSendBuffer.bytesAvailable());
+    const size_t bytes = std::min(ATCmd::MAXDATALENGTH, mSendBuffer.bytesAvailable());
 
     Trace(ZONE_VERBOSE, "Send %d \r\n", bytes);
+    return bytes;
+}
 
-    const size_t receivedLength = mSendBuffer.receive(mTemporaryBuffer.data(),
-                                                      bytes,
-                                                      std::chrono::milliseconds(10));
+/* called by the parser task once the modem prompts for the chunk */
+size_t Socket::loadSendData(char* data, const size_t length)
+{
+    const size_t receivedLength = mSendBuffer.receive(data, length, std::chrono::milliseconds(10));
 
-    if (receivedLength != bytes) {
+    if (receivedLength != length) {
         Trace(ZONE_ERROR, "Internal buffer didn't contain exact amount of bytes\r\n");
-        return 0;
     }
     return receivedLength;
 }
 
+void Socket::receiveDone(const bool success)
+{
+    if (!success) {
+        Trace(ZONE_ERROR, "receive failed\r\n");
+        mHandleError();
+    }
+    transferDone();
+}
+
+/* the parser had no room for the read, the announced bytes are read on the next try */
+void Socket::receiveDeferred(const size_t bytes)
+{
+    size_t announced;
+    // unless a URC announced a newer count meanwhile
+    if (!mNumberOfBytesForReceive.peek(announced, std::chrono::milliseconds(0))) {
+        mNumberOfBytesForReceive.overwrite(bytes);
+    }
+    transferDone();
+}
+
+void Socket::queryDone(const bool success)
+{
+    if (!success) {
+        Trace(ZONE_ERROR, "query available data failed\r\n");
+        mHandleError();
+    }
+    transferDone();
+}
+
+/* data may have been queued for the socket meanwhile, the ModemDriver has to look again */
+void Socket::transferDone(void)
+{
+    isBusy = false;
+    markReady();
+}
+
+void Socket::markReady(void)
+{
+    if (mScheduler) {
+        mScheduler->markReady(mSlot);
+    }
+}
+
+uint32_t Socket::getKeepAliveDeadline(void) const
+{
+    return mTimeOfLastReceive + KEEP_ALIVE_PAUSE.count();
+}
+
 size_t Socket::send(std::string_view message, const std::chrono::milliseconds timeout)
 {
-    return mSendBuffer.send(message.data(), message.length(), timeout);
+    const size_t length = mSendBuffer.send(message.data(), message.length(), timeout);
+    if (length) {
+        markReady();
+    }
+    return length;
 }
 
 size_t Socket::receive(uint8_t* message, size_t length, const std::chrono::milliseconds timeout)
@@ -162,6 +216,7 @@ TcpSocket::TcpSocket(ATParser& parser,
     mATCmdUSOWR(send),
     mATCmdUSORD(send, callback)
 {
+    mATCmdUSORD.setDataSink([this](const std::string_view data) {storeReceivedData(data); });
     parser.registerAtCommand(&mATCmdUSOWR);
     parser.registerAtCommand(&mATCmdUSORD);
 }
@@ -170,21 +225,39 @@ TcpSocket::~TcpSocket(){}
 
 void TcpSocket::sendData(void)
 {
-    const size_t receivedLength = loadTemporaryBuffer();
-    if (!receivedLength) {
+    const size_t length = getSendLength();
+    if (!length) {
         return;
     }
 
-    if (mATCmdUSOWR.send(mSocket,
-                         std::string_view(mTemporaryBuffer.data(),
-                                          receivedLength),
-                         std::chrono::milliseconds(5000)) == AT::Return_t::ERROR)
-    {
+    isBusy = true;
+    const auto ret = mATCmdUSOWR.sendAsync(mSocket, length,
+                                           [this](char* data, const size_t bytes) {return loadSendData(data, bytes); },
+                                           std::chrono::milliseconds(5000),
+                                           [this](const bool success) {dataSent(success); });
+    if (ret == AT::Return_t::TRY_AGAIN) {
+        // the chunk is still in the send buffer
+        transferDone();
+    } else if (ret != AT::Return_t::WAITING) {
         Trace(ZONE_ERROR, "send_data_failed\r\n");
         mHandleError();
-    } else {
-        mTimeOfLastSend = os::Task::getTickCount();
-        mATCmdUSORD.send(mSocket, 0, std::chrono::milliseconds(1000));
+        transferDone();
+    }
+}
+
+void TcpSocket::dataSent(const bool success)
+{
+    if (!success) {
+        Trace(ZONE_ERROR, "send_data_failed\r\n");
+        mHandleError();
+        transferDone();
+        return;
+    }
+    mTimeOfLastSend = os::Task::getTickCount();
+    if (mATCmdUSORD.sendAsync(mSocket, 0, std::chrono::milliseconds(1000),
+                              [this](const bool) {transferDone(); }) != AT::Return_t::WAITING)
+    {
+        transferDone();
     }
 }
 
@@ -194,11 +267,13 @@ void TcpSocket::receiveData(size_t bytes)
         return;
     }
     Trace(ZONE_INFO, "Start receive %d\r\n", bytes);
-    if (mATCmdUSORD.send(mSocket, bytes, std::chrono::milliseconds(1000)) == AT::Return_t::FINISHED) {
-        storeReceivedData(mATCmdUSORD.getData());
-    } else {
-        Trace(ZONE_ERROR, "receive failed\r\n");
-        mHandleError();
+    isBusy = true;
+    const auto ret = mATCmdUSORD.sendAsync(mSocket, bytes, std::chrono::milliseconds(1000),
+                                           [this](const bool success) {receiveDone(success); });
+    if (ret == AT::Return_t::TRY_AGAIN) {
+        receiveDeferred(bytes);
+    } else if (ret != AT::Return_t::WAITING) {
+        receiveDone(false);
     }
 }
 
@@ -229,11 +304,15 @@ bool TcpSocket::open(void)
 
 void TcpSocket::checkIfDataAvailable(void)
 {
-    if (mATCmdUSORD.send(mSocket, 0, std::chrono::milliseconds(1000)) != AT::Return_t::FINISHED) {
-        Trace(ZONE_ERROR, "query available data failed\r\n");
-        mHandleError();
-    }
     mTimeOfLastReceive = os::Task::getTickCount();
+    isBusy = true;
+    const auto ret = mATCmdUSORD.sendAsync(mSocket, 0, std::chrono::milliseconds(1000),
+                                           [this](const bool success) {queryDone(success); });
+    if (ret == AT::Return_t::TRY_AGAIN) {
+        transferDone();
+    } else if (ret != AT::Return_t::WAITING) {
+        queryDone(false);
+    }
 }
 
 UdpSocket::UdpSocket(ATParser& parser,
@@ -246,6 +325,7 @@ UdpSocket::UdpSocket(ATParser& parser,
     mATCmdUSOST(send),
     mATCmdUSORF(send, callback)
 {
+    mATCmdUSORF.setDataSink([this](const std::string_view data) {storeReceivedData(data); });
     parser.registerAtCommand(&mATCmdUSOST);
     parser.registerAtCommand(&mATCmdUSORF);
 }
@@ -254,20 +334,36 @@ UdpSocket::~UdpSocket(void){}
 
 void UdpSocket::sendData(void)
 {
-    const size_t receivedLength = loadTemporaryBuffer();
-    if (!receivedLength) {
+    const size_t length = getSendLength();
+    if (!length) {
         return;
     }
 
-    if (mATCmdUSOST.send(mSocket, mIP, mPort,
-                         std::string_view(mTemporaryBuffer.data(),
-                                          receivedLength), std::chrono::milliseconds(5000)) == AT::Return_t::ERROR)
-    {
+    isBusy = true;
+    const auto ret = mATCmdUSOST.sendAsync(mSocket, mIP, mPort, length,
+                                           [this](char* data, const size_t bytes) {return loadSendData(data, bytes); },
+                                           std::chrono::milliseconds(5000),
+                                           [this](const bool success) {dataSent(success); });
+    if (ret == AT::Return_t::TRY_AGAIN) {
+        // the chunk is still in the send buffer
+        transferDone();
+    } else if (ret != AT::Return_t::WAITING) {
+        dataSent(false);
+    }
+}
+
+void UdpSocket::dataSent(const bool success)
+{
+    if (!success) {
         Trace(ZONE_ERROR, "send_data_failed\r\n");
         mHandleError();
     }
     mTimeOfLastSend = os::Task::getTickCount();
-    mATCmdUSORF.send(mSocket, 0, std::chrono::milliseconds(1000));
+    if (mATCmdUSORF.sendAsync(mSocket, 0, std::chrono::milliseconds(1000),
+                              [this](const bool) {transferDone(); }) != AT::Return_t::WAITING)
+    {
+        transferDone();
+    }
 }
 
 void UdpSocket::receiveData(size_t bytes)
@@ -277,11 +373,13 @@ void UdpSocket::receiveData(size_t bytes)
     }
     Trace(ZONE_INFO, "S%d: receive %d\r\n", mSocket, bytes);
 
-    if (mATCmdUSORF.send(mSocket, bytes, std::chrono::milliseconds(1000)) == AT::Return_t::FINISHED) {
-        storeReceivedData(mATCmdUSORF.getData());
-    } else {
-        Trace(ZONE_ERROR, "receive_data_failed\r\n");
-        mHandleError();
+    isBusy = true;
+    const auto ret = mATCmdUSORF.sendAsync(mSocket, bytes, std::chrono::milliseconds(1000),
+                                           [this](const bool success) {receiveDone(success); });
+    if (ret == AT::Return_t::TRY_AGAIN) {
+        receiveDeferred(bytes);
+    } else if (ret != AT::Return_t::WAITING) {
+        receiveDone(false);
     }
 }
 
@@ -301,8 +399,13 @@ bool UdpSocket::open(void)
 
 void UdpSocket::checkIfDataAvailable(void)
 {
-    if (mATCmdUSORF.send(mSocket, 0, std::chrono::milliseconds(1000)) != AT::Return_t::FINISHED) {
-        mHandleError();
+    isBusy = true;
+    const auto ret = mATCmdUSORF.sendAsync(mSocket, 0, std::chrono::milliseconds(1000),
+                                           [this](const bool success) {queryDone(success); });
+    if (ret == AT::Return_t::TRY_AGAIN) {
+        transferDone();
+    } else if (ret != AT::Return_t::WAITING) {
+        queryDone(false);
     }
 }
 
@@ -313,6 +416,8 @@ DnsSocket::DnsSocket(ATParser& parser,
     UdpSocket(parser, send, "", "", callback, errorCallback),
     mATCmdUPSND(send)
 {
+    // the answers are decoded from getData()
+    mATCmdUSORF.setDataSink(nullptr);
     parser.registerAtCommand(&mATCmdUPSND);
 }
 
@@ -7,31 +7,54 @@
 
 #include <string_view>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include "AT_Parser.h"
 #include "os_Queue.h"
 #include "os_StreamBuffer.h"
+#include "SocketScheduler.h"
 
 namespace app
 {
 class ModemDriver;
 
+/*
+ * The data path of a socket runs asynchronously: sendData(), receiveData()
+ * and checkIfDataAvailable() queue their AT commands at the parser and return,
+ * the completions in the parser task issue the follow-up commands. isBusy is
+ * set until the last of them completed, the socket events wake the
+ * ModemDriver again then. create() and open() still block.
+ *
+ * Data is written in chunks of up to ATCmd::MAXDATALENGTH bytes and read in
+ * chunks of up to ATCmd::MAXREADLENGTH bytes. A chunk stays in the send
+ * buffer until the modem prompts for it, received data is stored straight
+ * from the parser.
+ *
+ * Whatever gives the socket work marks it ready at the SocketScheduler of the
+ * ModemDriver: queued data, announced data and the end of a transfer. The
+ * keep-alive is due at getKeepAliveDeadline(). A command the parser has no
+ * room for is no error, the socket marks itself ready and tries again.
+ */
 class Socket
 {
 protected:
-    static constexpr const size_t BUFFERSIZE = 512;
+    static constexpr const size_t SENDBUFFERSIZE = ATCmd::MAXDATALENGTH;
+    static constexpr const size_t RECEIVEBUFFERSIZE = ATCmd::MAXREADLENGTH;
     static constexpr const std::chrono::milliseconds KEEP_ALIVE_PAUSE = std::chrono::seconds(10);
     static constexpr const char* KEEP_ALIVE_MSG = "\r";
 
-    os::StreamBuffer<char, BUFFERSIZE> mSendBuffer;
-    os::StreamBuffer<char, BUFFERSIZE> mReceiveBuffer;
-    std::array<char, BUFFERSIZE> mTemporaryBuffer;
+    os::StreamBuffer<char, SENDBUFFERSIZE> mSendBuffer;
+    os::StreamBuffer<char, RECEIVEBUFFERSIZE> mReceiveBuffer;
 
     std::function<void(std::string_view)> mReceiveCallback;
     const std::function<void(void)> mHandleError;
 
     os::Queue<size_t, 1> mNumberOfBytesForReceive;
 
+    // set by the ModemDriver, wakes its socket loop
+    SocketScheduler* mScheduler = nullptr;
+    size_t mSlot = 0;
+
     virtual void sendData(void) = 0;
     virtual void receiveData(size_t) = 0;
     virtual bool create() = 0;
@@ -43,7 +66,14 @@ protected:
     void checkAndReceiveData(void);
     void checkAndSendData(void);
     void storeReceivedData(const std::string_view);
-    size_t loadTemporaryBuffer(void);
+    size_t getSendLength(void) const;
+    size_t loadSendData(char* data, const size_t length);
+    void receiveDone(const bool success);
+    void receiveDeferred(const size_t bytes);
+    void queryDone(const bool success);
+    void transferDone(void);
+    void markReady(void);
+    uint32_t getKeepAliveDeadline(void) const;
 
     ATCmdUSOCR mATCmdUSOCR;
     ATCmdUSOCO mATCmdUSOCO;
@@ -55,6 +85,7 @@ protected:
 
     bool isOpen = false;
     bool isCreated = false;
+    std::atomic<bool> isBusy {false};
 
 public:
     enum class Protocol { UDP, TCP, DNS };
@@ -98,6 +129,7 @@ class TcpSocket :
     virtual bool create(void) override;
     virtual bool open(void) override;
     virtual void checkIfDataAvailable(void) override;
+    void dataSent(const bool success);
 
     ATCmdUSOWR mATCmdUSOWR;
     ATCmdUSORD mATCmdUSORD;
@@ -129,6 +161,7 @@ protected:
     virtual bool create(void) override;
     virtual bool open(void) override;
     virtual void checkIfDataAvailable(void) override;
+    void dataSent(const bool success);
 
     ATCmdUSOST mATCmdUSOST;
     ATCmdUSORF mATCmdUSORF;
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "SocketScheduler.h"
+#include "os_Task.h"
+#include "trace.h"
+#include <algorithm>
+
+using app::SocketScheduler;
+
+static constexpr const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING;
+
+static_assert(SocketScheduler::MAXSOCKETS <= os::EventGroup::NUMBER_OF_BITS, "A socket needs an event bit");
+
+SocketScheduler::SocketScheduler(void)
+{
+    for (auto& since : mReadySince) {
+        since = NOTREADY;
+    }
+    mKeepAliveArmed.fill(false);
+    resetLatency();
+}
+
+size_t SocketScheduler::add(void)
+{
+    if (mNumberOfSockets >= MAXSOCKETS) {
+        Trace(ZONE_ERROR, "No slot left\r\n");
+        return MAXSOCKETS;
+    }
+    return mNumberOfSockets++;
+}
+
+void SocketScheduler::markReady(const size_t slot)
+{
+    stamp(slot);
+    mReady.set(1 << slot);
+}
+
+void SocketScheduler::setKeepAlive(const size_t slot, const uint32_t deadline)
+{
+    mKeepAlive[slot] = deadline;
+    mKeepAliveArmed[slot] = true;
+}
+
+SocketScheduler::ReadySet SocketScheduler::wait(const std::chrono::milliseconds timeout)
+{
+    const uint32_t now = os::Task::getTickCount();
+    uint32_t ticks = timeout.count();
+    for (size_t i = 0; i < mNumberOfSockets; i++) {
+        if (mKeepAliveArmed[i]) {
+            const int32_t remaining = static_cast<int32_t>(mKeepAlive[i] - now);
+            ticks = std::min<uint32_t>(ticks, std::max<int32_t>(remaining, 0));
+        }
+    }
+
+    const ReadySet mask = (1 << mNumberOfSockets) - 1;
+    ReadySet ready = 0;
+    if (mask) {
+        ready = mReady.waitAny(mask, std::chrono::milliseconds(ticks)) & mask;
+    } else {
+        os::ThisTask::sleep(std::chrono::milliseconds(ticks));
+    }
+
+    // a keep-alive that expired meanwhile joins the sockets that woke us
+    const uint32_t then = os::Task::getTickCount();
+    for (size_t i = 0; i < mNumberOfSockets; i++) {
+        if (mKeepAliveArmed[i] && (static_cast<int32_t>(mKeepAlive[i] - then) <= 0)) {
+            mKeepAliveArmed[i] = false;
+            stamp(i);
+            ready |= 1 << i;
+        }
+    }
+    return ready;
+}
+
+size_t SocketScheduler::take(ReadySet& ready)
+{
+    const size_t slot = __builtin_ctz(ready);
+    ready &= ready - 1;
+
+    const uint32_t since = mReadySince[slot].exchange(NOTREADY);
+    if (since != NOTREADY) {
+        record(slot, os::Task::getTickCount() - since);
+    }
+    return slot;
+}
+
+SocketScheduler::Histogram SocketScheduler::getLatency(const size_t slot) const
+{
+    return mLatency[slot];
+}
+
+void SocketScheduler::resetLatency(void)
+{
+    for (auto& latency : mLatency) {
+        latency.mBins.fill(0);
+        latency.mCount = 0;
+        latency.mMaxMs = 0;
+    }
+}
+
+/* the latency counts from the first mark, NOTREADY itself is never stored */
+void SocketScheduler::stamp(const size_t slot)
+{
+    uint32_t expected = NOTREADY;
+    mReadySince[slot].compare_exchange_strong(expected, std::min(os::Task::getTickCount(), NOTREADY - 1));
+}
+
+void SocketScheduler::record(const size_t slot, const uint32_t latencyMs)
+{
+    size_t bin = 0;
+    while ((bin < HISTOGRAMBINS - 1) && (latencyMs >= (1u << bin))) {
+        bin++;
+    }
+
+    Histogram& latency = mLatency[slot];
+    latency.mBins[bin]++;
+    latency.mCount++;
+    latency.mMaxMs = std::max(latency.mMaxMs, latencyMs);
+}
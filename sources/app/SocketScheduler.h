@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "EventGroup.h"
+
+namespace app
+{
+/*
+ * Ready set of the sockets serviced by one task. A socket is marked ready
+ * by whatever gives it work: data queued by the application, a URC
+ * announcing received data, the completion of its last transfer. The
+ * servicing task sleeps in wait() and takes the ready sockets one by one,
+ * the socket added first has the highest priority.
+ *
+ * Keep-alives are deadlines instead of polling: wait() wakes up once the
+ * earliest one expires and marks its socket ready. A deadline fires once,
+ * the servicing task sets the next one after it serviced the socket. A
+ * deadline set too early only costs a wakeup.
+ *
+ * The time from marking a socket ready until it is taken is recorded in a
+ * histogram per socket. Bin 0 counts latencies below 1 ms, bin n those
+ * below 2^n ms, the last one everything longer.
+ *
+ * markReady() may be called from any task. add(), setKeepAlive(), wait()
+ * and take() belong to the servicing task.
+ */
+class SocketScheduler final
+{
+public:
+    static constexpr const size_t MAXSOCKETS = 8;
+    static constexpr const size_t HISTOGRAMBINS = 8;
+
+    using ReadySet = uint32_t;
+
+    struct Histogram {
+        std::array<uint32_t, HISTOGRAMBINS> mBins;
+        uint32_t mCount;
+        uint32_t mMaxMs;
+    };
+
+    SocketScheduler(void);
+
+    SocketScheduler(const SocketScheduler&) = delete;
+    SocketScheduler(SocketScheduler&&) = delete;
+    SocketScheduler& operator=(const SocketScheduler&) = delete;
+    SocketScheduler& operator=(SocketScheduler&&) = delete;
+
+    /* returns the slot of the new socket, MAXSOCKETS if there is none left */
+    size_t add(void);
+    void markReady(const size_t slot);
+    /* arms the keep-alive of slot to fire at the tick count deadline */
+    void setKeepAlive(const size_t slot, const uint32_t deadline);
+
+    /* blocks until a socket is ready, at most until timeout or the next keep-alive */
+    ReadySet wait(const std::chrono::milliseconds timeout);
+    /* removes the socket of the highest priority from ready and returns its slot */
+    size_t take(ReadySet& ready);
+
+    Histogram getLatency(const size_t slot) const;
+    void resetLatency(void);
+
+private:
+    static constexpr const uint32_t NOTREADY = UINT32_MAX;
+
+    os::EventGroup mReady;
+    size_t mNumberOfSockets = 0;
+
+    // tick count of the first markReady() since the socket was taken
+    std::array<std::atomic<uint32_t>, MAXSOCKETS> mReadySince;
+    std::array<uint32_t, MAXSOCKETS> mKeepAlive;
+    std::array<bool, MAXSOCKETS> mKeepAliveArmed;
+    std::array<Histogram, MAXSOCKETS> mLatency;
+
+    void stamp(const size_t slot);
+    void record(const size_t slot, const uint32_t latencyMs);
+};
+}
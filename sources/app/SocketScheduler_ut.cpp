@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "unittest.h"
+#include "TaskInterruptable.h"
+#include "os_Queue.h"
+#include "SocketScheduler.h"
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t STACKSIZE = 1024;
+static constexpr const size_t NUMBER_OF_SOCKETS = 5; // ModemDriver::MAXNUMOFSOCKETS
+static constexpr const size_t ITEMS_PER_SOCKET = 40;
+
+using app::SocketScheduler;
+
+struct Latency {
+    double meanMs;
+    uint32_t maxMs;
+};
+
+/*
+ * Every socket gets ITEMS_PER_SOCKET pieces of work at random intervals of
+ * 5 to 45 ms, stamped with the tick count they were queued at. One service
+ * task takes them, either polling the sockets round robin with a blocking
+ * check of 10 ms each like the ModemDriver loop before, or from the ready
+ * set. Returns the latency from queueing until the service task took the
+ * work.
+ */
+static Latency serviceLatency(const bool polling, SocketScheduler& scheduler)
+{
+    std::array<os::Queue<uint32_t, ITEMS_PER_SOCKET>, NUMBER_OF_SOCKETS> work;
+    // socket i is in slot i
+    for (size_t i = 0; i < NUMBER_OF_SOCKETS; i++) {
+        scheduler.add();
+    }
+
+    std::array<os::TaskInterruptable*, NUMBER_OF_SOCKETS> applications;
+    for (size_t i = 0; i < NUMBER_OF_SOCKETS; i++) {
+        applications[i] = new os::TaskInterruptable("App", STACKSIZE, os::Task::Priority::MEDIUM,
+                                                    [&, i](const bool&) {
+            std::srand(i);
+            for (size_t k = 0; k < ITEMS_PER_SOCKET; k++) {
+                os::ThisTask::sleep(std::chrono::milliseconds(5 + std::rand() % 40));
+                uint32_t now = os::Task::getTickCount();
+                work[i].sendBack(now);
+                scheduler.markReady(i);
+            }
+        });
+    }
+
+    size_t taken = 0;
+    uint64_t sumMs = 0;
+    uint32_t maxMs = 0;
+    auto takeWork = [&](const size_t i, std::chrono::milliseconds timeout) {
+        uint32_t queued;
+        while (work[i].receive(queued, timeout)) {
+            const uint32_t latency = os::Task::getTickCount() - queued;
+            sumMs += latency;
+            maxMs = std::max(maxMs, latency);
+            taken++;
+            timeout = std::chrono::milliseconds(0);
+        }
+    };
+
+    os::TaskInterruptable service("Service", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        while (taken < NUMBER_OF_SOCKETS * ITEMS_PER_SOCKET) {
+            if (polling) {
+                for (size_t i = 0; i < NUMBER_OF_SOCKETS; i++) {
+                    takeWork(i, std::chrono::milliseconds(10));
+                }
+                continue;
+            }
+            for (auto ready = scheduler.wait(std::chrono::milliseconds(1000)); ready; ) {
+                takeWork(scheduler.take(ready), std::chrono::milliseconds(0));
+            }
+        }
+    });
+    service.join();
+
+    for (auto application : applications) {
+        application->join();
+        delete application;
+    }
+    return {static_cast<double>(sumMs) / taken, maxMs};
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_ServesInPriorityOrder(void)
+{
+    TestCaseBegin();
+    SocketScheduler scheduler;
+    for (size_t i = 0; i < SocketScheduler::MAXSOCKETS; i++) {
+        CHECK(scheduler.add() == i);
+    }
+    CHECK(scheduler.add() == SocketScheduler::MAXSOCKETS);
+
+    CHECK(scheduler.wait(std::chrono::milliseconds(0)) == 0);
+
+    scheduler.markReady(4);
+    scheduler.markReady(1);
+    scheduler.markReady(6);
+    scheduler.markReady(1);
+    auto ready = scheduler.wait(std::chrono::milliseconds(0));
+    CHECK(ready == ((1 << 1) | (1 << 4) | (1 << 6)));
+    CHECK(scheduler.take(ready) == 1);
+    CHECK(scheduler.take(ready) == 4);
+    CHECK(scheduler.take(ready) == 6);
+    CHECK(ready == 0);
+
+    // consumed by the last wait
+    CHECK(scheduler.wait(std::chrono::milliseconds(0)) == 0);
+
+    // the ready set wakes a waiting task
+    os::TaskInterruptable marker("Marker", STACKSIZE, os::Task::Priority::MEDIUM, [&](const bool&) {
+        os::ThisTask::sleep(std::chrono::milliseconds(20));
+        scheduler.markReady(3);
+    });
+    CHECK(scheduler.wait(std::chrono::milliseconds(1000)) == (1 << 3));
+    marker.join();
+    TestCaseEnd();
+}
+
+int ut_KeepAliveFiresOnce(void)
+{
+    TestCaseBegin();
+    SocketScheduler scheduler;
+    scheduler.add();
+    scheduler.add();
+
+    const uint32_t start = os::Task::getTickCount();
+    scheduler.setKeepAlive(1, start + 50);
+    CHECK(scheduler.wait(std::chrono::milliseconds(1000)) == (1 << 1));
+    const uint32_t elapsed = os::Task::getTickCount() - start;
+    CHECK(elapsed >= 50);
+    CHECK(elapsed < 100);
+
+    // not armed again
+    CHECK(scheduler.wait(std::chrono::milliseconds(20)) == 0);
+
+    // an expired deadline fires at once, together with marked sockets
+    scheduler.setKeepAlive(1, start);
+    scheduler.markReady(0);
+    CHECK(scheduler.wait(std::chrono::milliseconds(1000)) == 3);
+    TestCaseEnd();
+}
+
+int ut_RecordsLatency(void)
+{
+    TestCaseBegin();
+    SocketScheduler scheduler;
+    scheduler.add();
+
+    scheduler.markReady(0);
+    os::ThisTask::sleep(std::chrono::milliseconds(5));
+    // marking again doesn't restart the latency
+    scheduler.markReady(0);
+    auto ready = scheduler.wait(std::chrono::milliseconds(0));
+    CHECK(scheduler.take(ready) == 0);
+
+    ready = 1;
+    // taken without being marked, nothing to record
+    scheduler.take(ready);
+
+    SocketScheduler::Histogram latency = scheduler.getLatency(0);
+    CHECK(latency.mCount == 1);
+    CHECK(latency.mMaxMs >= 5);
+    // a loaded host may oversleep into the next bin
+    CHECK(latency.mMaxMs < 16);
+    CHECK(latency.mBins[(latency.mMaxMs < 8) ? 3 : 4] == 1);
+
+    scheduler.resetLatency();
+    CHECK(scheduler.getLatency(0).mCount == 0);
+    TestCaseEnd();
+}
+
+int ut_ServiceLatency(void)
+{
+    TestCaseBegin();
+    SocketScheduler polled;
+    SocketScheduler scheduled;
+    const Latency polling = serviceLatency(true, polled);
+    const Latency ready = serviceLatency(false, scheduled);
+
+    // the ready set is served within a tick
+    CHECK(ready.meanMs * 10 < polling.meanMs);
+    CHECK(ready.maxMs < polling.maxMs);
+    printf("Service latency with %zu sockets: polling mean %.1f ms max %u ms, ready set mean %.1f ms max %u ms\n",
+           NUMBER_OF_SOCKETS, polling.meanMs, polling.maxMs, ready.meanMs, ready.maxMs);
+
+    for (size_t i = 0; i < NUMBER_OF_SOCKETS; i++) {
+        const SocketScheduler::Histogram latency = scheduled.getLatency(i);
+        printf("S%zu:", i);
+        for (const auto bin : latency.mBins) {
+            printf(" %3u", bin);
+        }
+        printf(" (max %u ms)\n", latency.mMaxMs);
+    }
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    std::thread scheduler(os::Task::startScheduler);
+
+    RunTest(true, ut_ServesInPriorityOrder);
+    RunTest(true, ut_KeepAliveFiresOnce);
+    RunTest(true, ut_RecordsLatency);
+    RunTest(true, ut_ServiceLatency);
+
+    os::Task::endScheduler();
+    scheduler.join();
+    UnitTestMainEnd();
+}
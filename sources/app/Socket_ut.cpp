@@ -0,0 +1,547 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "unittest.h"
+#include "TaskInterruptable.h"
+#include "os_StreamBuffer.h"
+#include "os_Queue.h"
+#include "SocketScheduler.h"
+#include "AT_Parser.h"
+#include "Socket.h"
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t STACKSIZE = 1024;
+static constexpr const size_t NUMBER_OF_SOCKETS = 5; // ModemDriver::MAXNUMOFSOCKETS
+static constexpr const size_t BYTES_PER_SOCKET = 4096;
+static constexpr const std::chrono::milliseconds MODEM_LATENCY(10);
+static constexpr const size_t TRANSFER_BYTES = 8192;
+// chunk sizes of the data path before it was binary and zero-copy
+static constexpr const size_t LEGACY_TX_CHUNK = 512;
+static constexpr const size_t LEGACY_RX_CHUNK = 254;
+
+namespace app
+{
+/* stands in for the ModemDriver, which the sockets let service them */
+class ModemDriver final
+{
+public:
+    static void open(Socket& sock, const size_t socket, SocketScheduler& scheduler)
+    {
+        sock.mSocket = socket;
+        sock.isCreated = true;
+        sock.isOpen = true;
+        sock.mScheduler = &scheduler;
+        sock.mSlot = scheduler.add();
+    }
+
+    static void service(TcpSocket& sock, const bool blocking)
+    {
+        if (!blocking) {
+            sock.checkAndSendData();
+            return;
+        }
+
+        // TcpSocket::sendData() before the data path went asynchronous, the chunk was copied out first
+        std::array<char, LEGACY_TX_CHUNK> chunk;
+        const size_t length = sock.mSendBuffer.receive(chunk.data(),
+                                                       std::min(chunk.size(), sock.mSendBuffer.bytesAvailable()),
+                                                       std::chrono::milliseconds(10));
+        if (length && (sock.mATCmdUSOWR.send(sock.mSocket, std::string_view(chunk.data(), length),
+                                             std::chrono::milliseconds(5000)) == AT::Return_t::FINISHED))
+        {
+            sock.mATCmdUSORD.send(sock.mSocket, 0, std::chrono::milliseconds(1000));
+        }
+    }
+
+    static void waitUntilDone(const TcpSocket& sock)
+    {
+        while (sock.isBusy) {
+            sock.mScheduler->wait(std::chrono::milliseconds(100));
+        }
+    }
+
+    /* a URC announced bytes for the socket */
+    static void announce(TcpSocket& sock, const size_t bytes)
+    {
+        sock.mNumberOfBytesForReceive.overwrite(bytes);
+        sock.checkAndReceiveData();
+    }
+
+    static size_t getAnnouncedBytes(const TcpSocket& sock)
+    {
+        size_t bytes = 0;
+        sock.mNumberOfBytesForReceive.peek(bytes, std::chrono::milliseconds(0));
+        return bytes;
+    }
+
+    static bool isBusy(const TcpSocket& sock)
+    {
+        return sock.isBusy;
+    }
+
+    static size_t getUnsentBytes(const TcpSocket& sock)
+    {
+        return sock.mSendBuffer.bytesAvailable();
+    }
+
+    static void upload(TcpSocket& sock, const bool legacy)
+    {
+        service(sock, legacy);
+        waitUntilDone(sock);
+    }
+
+    /* reads the announced bytes into the receive buffer of the socket */
+    static void download(TcpSocket& sock, const size_t bytes, const bool legacy)
+    {
+        if (legacy) {
+            sock.mATCmdUSORD.send(sock.mSocket, std::min(bytes, LEGACY_RX_CHUNK), std::chrono::milliseconds(1000));
+            return;
+        }
+        sock.receiveData(bytes);
+        waitUntilDone(sock);
+    }
+};
+}
+
+/*
+ * Plays the modem behind the AT channel: prompts for the payload of AT+USOWR
+ * and checks it, answers AT+USORD with a raw payload. Commands are worked on in order, every answer leaves
+ * MODEM_LATENCY after its command or payload came in, delayed by the uart
+ * and the network stack of the modem. Commands written meanwhile queue up.
+ */
+class ScriptedModem final
+{
+    struct Answer {
+        std::chrono::steady_clock::time_point mDue;
+        std::array<char, app::ATCmd::MAXDATALENGTH + 64> mText;
+        size_t mLength;
+    };
+
+    os::StreamBuffer<char, 1024> mToModem;
+    os::StreamBuffer<char, 2048> mFromModem;
+    os::Queue<Answer, 16> mAnswers;
+    std::atomic<bool> mRunning {true};
+    os::TaskInterruptable mTask;
+    os::TaskInterruptable mUart;
+
+    bool readLine(std::array<char, 64>& line)
+    {
+        size_t length = 0;
+        while (mRunning && (length < line.size() - 1)) {
+            if (mToModem.receive(line.data() + length, 1, std::chrono::milliseconds(100)) != 1) {
+                continue;
+            }
+            if (line[length] == '\r') {
+                line[length] = 0;
+                return true;
+            }
+            length++;
+        }
+        return false;
+    }
+
+    void answer(const std::string_view response)
+    {
+        Answer answer;
+        answer.mDue = std::chrono::steady_clock::now() + MODEM_LATENCY;
+        answer.mLength = std::min(response.length(), answer.mText.size());
+        std::memcpy(answer.mText.data(), response.data(), answer.mLength);
+        mAnswers.sendBack(answer);
+    }
+
+    void transmit(void)
+    {
+        while (mRunning) {
+            Answer answer;
+            if (!mAnswers.receive(answer, std::chrono::milliseconds(100))) {
+                continue;
+            }
+            std::this_thread::sleep_until(answer.mDue);
+            mFromModem.send(answer.mText.data(), answer.mLength);
+        }
+    }
+
+    void write(const size_t socket, const size_t length)
+    {
+        answer("\r\n@");
+
+        std::array<char, app::ATCmd::MAXDATALENGTH> data;
+        size_t received = 0;
+        while (mRunning && (received < length)) {
+            received += mToModem.receive(data.data() + received, length - received, std::chrono::milliseconds(100));
+        }
+        for (size_t i = 0; i < received; i++) {
+            if (data[i] != static_cast<char>(socket * 31 + mReceived[socket] + i)) {
+                mErrors++;
+            }
+        }
+        mReceived[socket] += received;
+
+        std::array<char, 48> response;
+        std::snprintf(response.data(), response.size(), "\r\n+USOWR: %zu,%zu\r\n\r\nOK\r\n", socket, length);
+        answer(response.data());
+    }
+
+    void read(const size_t socket, const size_t length)
+    {
+        std::array<char, app::ATCmd::MAXDATALENGTH + 64> response;
+        size_t pos = std::snprintf(response.data(), response.size(), "\r\n+USORD: %zu,%zu", socket, length);
+        if (length) {
+            pos += std::snprintf(response.data() + pos, response.size() - pos, ",\"");
+            for (size_t i = 0; i < length; i++) {
+                response[pos++] = static_cast<char>(socket * 17 + mSent[socket] + i);
+            }
+            response[pos++] = '"';
+            mSent[socket] += length;
+        }
+        pos += std::snprintf(response.data() + pos, response.size() - pos, "\r\n\r\nOK\r\n");
+        answer(std::string_view(response.data(), pos));
+    }
+
+    void run(void)
+    {
+        std::array<char, 64> line;
+        while (readLine(line)) {
+            size_t socket;
+            size_t length;
+            mCommands++;
+            if (std::sscanf(line.data(), "AT+USOWR=%zu,%zu", &socket, &length) == 2) {
+                write(socket, length);
+            } else if (std::sscanf(line.data(), "AT+USORD=%zu,%zu", &socket, &length) == 2) {
+                read(socket, length);
+            } else {
+                answer("\r\nERROR\r\n");
+            }
+        }
+    }
+
+public:
+    std::array<std::atomic<size_t>, NUMBER_OF_SOCKETS> mReceived {};
+    std::array<std::atomic<size_t>, NUMBER_OF_SOCKETS> mSent {};
+    std::atomic<size_t> mCommands {0};
+    std::atomic<size_t> mErrors {0};
+
+    app::AT::SendFunction mSend;
+    app::AT::ReceiveFunction mReceive;
+
+    ScriptedModem(void) :
+        mTask("Modem", STACKSIZE, os::Task::Priority::HIGH, [this](const bool&) {run(); }),
+        mUart("Uart", STACKSIZE, os::Task::Priority::HIGH, [this](const bool&) {transmit(); }),
+        mSend([this](std::string_view data, std::chrono::milliseconds timeout) -> size_t {
+        return mToModem.send(data.data(), data.length(), timeout);
+    }),
+        mReceive([this](uint8_t* data, const size_t length, std::chrono::milliseconds timeout) -> size_t {
+        return mFromModem.receive(reinterpret_cast<char*>(data), length, timeout);
+    }) {}
+
+    ~ScriptedModem(void)
+    {
+        mRunning = false;
+        mTask.join();
+        mUart.join();
+    }
+
+    bool isDone(void) const
+    {
+        for (const auto& received : mReceived) {
+            if (received < BYTES_PER_SOCKET) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/*
+ * Five applications stream BYTES_PER_SOCKET each through their TcpSocket, one
+ * service task forwards them like the ModemDriver loop. Returns the mean
+ * throughput of a socket in bytes per second, 0 if the data got lost.
+ */
+static double socketThroughput(const bool blocking, const size_t pipelineDepth, size_t& maxPendingCmds)
+{
+    ScriptedModem modem;
+    app::ATParser parser(modem.mReceive);
+    parser.setPipelineDepth(pipelineDepth);
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    const std::function<void(size_t, size_t)> urc = [](const size_t, const size_t) {};
+    std::atomic<size_t> errors {0};
+    app::SocketScheduler scheduler;
+    std::array<app::TcpSocket*, NUMBER_OF_SOCKETS> sockets;
+    for (size_t i = 0; i < NUMBER_OF_SOCKETS; i++) {
+        sockets[i] = new app::TcpSocket(parser, modem.mSend, "127.0.0.1", "1234", urc, [&] {errors++; });
+        app::ModemDriver::open(*sockets[i], i, scheduler);
+    }
+
+    std::atomic<bool> running {true};
+    os::TaskInterruptable parserTask("Parser", STACKSIZE, os::Task::Priority::VERY_HIGH, [&](const bool&) {
+        while (running) {
+            parser.parse(std::chrono::milliseconds(200));
+        }
+    });
+
+    std::array<os::TaskInterruptable*, NUMBER_OF_SOCKETS> applications;
+    for (size_t i = 0; i < NUMBER_OF_SOCKETS; i++) {
+        applications[i] = new os::TaskInterruptable("App", STACKSIZE, os::Task::Priority::MEDIUM,
+                                                    [&, i](const bool&) {
+            std::array<char, 64> chunk;
+            for (size_t sent = 0; sent < BYTES_PER_SOCKET; ) {
+                const size_t length = std::min(chunk.size(), BYTES_PER_SOCKET - sent);
+                for (size_t k = 0; k < length; k++) {
+                    chunk[k] = static_cast<char>(i * 31 + sent + k);
+                }
+                sent += sockets[i]->send(std::string_view(chunk.data(), length), std::chrono::milliseconds(5000));
+            }
+        });
+    }
+
+    maxPendingCmds = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    os::TaskInterruptable service("Service", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        while (!modem.isDone() && (std::chrono::high_resolution_clock::now() - start < std::chrono::seconds(20))) {
+            for (auto sock : sockets) {
+                app::ModemDriver::service(*sock, blocking);
+            }
+            maxPendingCmds = std::max(maxPendingCmds, parser.getNumberOfPendingCmds());
+            scheduler.wait(std::chrono::milliseconds(10));
+        }
+    });
+    service.join();
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    for (auto application : applications) {
+        application->join();
+        delete application;
+    }
+
+    // the last follow-up commands are still in flight
+    while (parser.getNumberOfPendingCmds()) {
+        os::ThisTask::sleep(std::chrono::milliseconds(1));
+    }
+    running = false;
+    parserTask.join();
+    for (auto sock : sockets) {
+        delete sock;
+    }
+
+    if (!modem.isDone() || modem.mErrors || errors) {
+        return 0;
+    }
+    return static_cast<double>(BYTES_PER_SOCKET) * 1000000 / us;
+}
+
+static double getThreadCpuUs(void)
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+struct TransferCost {
+    double bytesPerCommand;
+    double cpuUsPerKB;
+};
+
+/*
+ * One socket uploads and downloads TRANSFER_BYTES, either in the chunks of
+ * the legacy data path or in binary chunks of up to ATCmd::MAXDATALENGTH
+ * per write and ATCmd::MAXREADLENGTH per read.
+ * The cpu time is the one of the parser task and the application, the
+ * scripted modem isn't counted.
+ */
+static TransferCost transferCost(const bool legacy)
+{
+    ScriptedModem modem;
+    app::ATParser parser(modem.mReceive);
+    app::ATCmdOK ok;
+    app::ATCmdERROR error;
+    parser.registerAtCommand(&ok);
+    parser.registerAtCommand(&error);
+
+    const std::function<void(size_t, size_t)> urc = [](const size_t, const size_t) {};
+    std::atomic<size_t> errors {0};
+    app::SocketScheduler scheduler;
+    app::TcpSocket sock(parser, modem.mSend, "127.0.0.1", "1234", urc, [&] {errors++; });
+    app::ModemDriver::open(sock, 0, scheduler);
+
+    std::atomic<bool> running {true};
+    std::atomic<double> parserCpuUs {0};
+    os::TaskInterruptable parserTask("Parser", STACKSIZE, os::Task::Priority::VERY_HIGH, [&](const bool&) {
+        const double start = getThreadCpuUs();
+        while (running) {
+            parser.parse(std::chrono::milliseconds(200));
+        }
+        parserCpuUs = getThreadCpuUs() - start;
+    });
+
+    const double start = getThreadCpuUs();
+    std::array<char, app::ATCmd::MAXDATALENGTH> chunk;
+    for (size_t sent = 0; (sent < TRANSFER_BYTES) || app::ModemDriver::getUnsentBytes(sock); ) {
+        // the application keeps the send buffer filled
+        const size_t length = std::min(chunk.size(), TRANSFER_BYTES - sent);
+        for (size_t k = 0; k < length; k++) {
+            chunk[k] = static_cast<char>(sent + k);
+        }
+        sent += sock.send(std::string_view(chunk.data(), length), std::chrono::milliseconds(0));
+        app::ModemDriver::upload(sock, legacy);
+    }
+
+    for (size_t received = 0; received < TRANSFER_BYTES; ) {
+        app::ModemDriver::download(sock, TRANSFER_BYTES - received, legacy);
+        const size_t length = sock.receive(reinterpret_cast<uint8_t*>(chunk.data()), chunk.size(),
+                                           std::chrono::milliseconds(0));
+        if (!length) {
+            errors++;
+            break;
+        }
+        for (size_t k = 0; k < length; k++) {
+            if (chunk[k] != static_cast<char>(received + k)) {
+                errors++;
+            }
+        }
+        received += length;
+    }
+    double cpuUs = getThreadCpuUs() - start;
+
+    running = false;
+    parserTask.join();
+    cpuUs += parserCpuUs;
+
+    if ((modem.mReceived[0] != TRANSFER_BYTES) || modem.mErrors || errors) {
+        return {0, 0};
+    }
+    return {2.0 * TRANSFER_BYTES / modem.mCommands, cpuUs * 1024 / (2 * TRANSFER_BYTES)};
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_RetryWhenParserIsFull(void)
+{
+    TestCaseBegin();
+    // the modem stays silent, the commands remain pending
+    os::StreamBuffer<char, 1024> toModem;
+    app::AT::SendFunction send = [&](std::string_view data, std::chrono::milliseconds timeout) -> size_t {
+        return toModem.send(data.data(), data.length(), timeout);
+    };
+    app::ATParser parser([](uint8_t*, const size_t, std::chrono::milliseconds) -> size_t {return 0; });
+
+    const std::function<void(size_t, size_t)> urc = [](const size_t, const size_t) {};
+    size_t socketErrors = 0;
+    app::SocketScheduler others;
+    std::array<app::TcpSocket*, app::ATParser::MAXPENDINGCMDS> busy;
+    for (size_t i = 0; i < busy.size(); i++) {
+        busy[i] = new app::TcpSocket(parser, send, "127.0.0.1", "1234", urc, [&] {socketErrors++; });
+        app::ModemDriver::open(*busy[i], i, others);
+        app::ModemDriver::announce(*busy[i], 10);
+    }
+    CHECK(parser.getNumberOfPendingCmds() == app::ATParser::MAXPENDINGCMDS);
+
+    app::SocketScheduler scheduler;
+    app::TcpSocket sock(parser, send, "127.0.0.1", "1234", urc, [&] {socketErrors++; });
+    app::ModemDriver::open(sock, busy.size(), scheduler);
+
+    // the read is deferred, the announced bytes are kept for the next try
+    app::ModemDriver::announce(sock, 100);
+    CHECK(scheduler.wait(std::chrono::milliseconds(0)) != 0);
+    CHECK(!app::ModemDriver::isBusy(sock));
+    CHECK(app::ModemDriver::getAnnouncedBytes(sock) == 100);
+
+    // the chunk stays in the send buffer
+    CHECK(sock.send("abc", std::chrono::milliseconds(0)) == 3);
+    CHECK(scheduler.wait(std::chrono::milliseconds(0)) != 0);
+    app::ModemDriver::service(sock, false);
+    CHECK(scheduler.wait(std::chrono::milliseconds(0)) != 0);
+    CHECK(!app::ModemDriver::isBusy(sock));
+    CHECK(app::ModemDriver::getUnsentBytes(sock) == 3);
+
+    CHECK(socketErrors == 0);
+    for (auto s : busy) {
+        delete s;
+    }
+    TestCaseEnd();
+}
+
+int ut_AsyncSocketThroughput(void)
+{
+    TestCaseBegin();
+    size_t blockingPendingCmds;
+    size_t asyncPendingCmds;
+    const double blocking = socketThroughput(true, 1, blockingPendingCmds);
+    const double async = socketThroughput(false, 1, asyncPendingCmds);
+
+    CHECK(blocking > 0);
+    CHECK(async > 0);
+    CHECK(asyncPendingCmds == NUMBER_OF_SOCKETS);
+    // the AT channel is serial and every payload waits 50 ms for the prompt, both
+    // are bound by the modem. Async writes smaller chunks at times, it mustn't lose much.
+    CHECK(async >= 0.8 * blocking);
+    printf("Socket throughput with %zu sockets: blocking %.0f B/s, async %.0f B/s\n",
+           NUMBER_OF_SOCKETS, blocking, async);
+    TestCaseEnd();
+}
+
+int ut_PipelinedUploadThroughput(void)
+{
+    TestCaseBegin();
+    size_t sequentialPendingCmds;
+    size_t pipelinedPendingCmds;
+    const double sequential = socketThroughput(false, 1, sequentialPendingCmds);
+    const double pipelined = socketThroughput(false, 4, pipelinedPendingCmds);
+
+    CHECK(sequential > 0);
+    CHECK(pipelined > 0);
+    // the next command follows the payload at once instead of waiting a round trip for
+    // its final result, the AT+USORD after each upload doesn't take a round trip of its own
+    CHECK(pipelined > 1.1 * sequential);
+    printf("Upload throughput with %zu sockets: sequential %.0f B/s, pipelined %.0f B/s\n",
+           NUMBER_OF_SOCKETS, sequential, pipelined);
+    TestCaseEnd();
+}
+
+int ut_BinaryChunksThroughput(void)
+{
+    TestCaseBegin();
+    const TransferCost legacy = transferCost(true);
+    const TransferCost binary = transferCost(false);
+
+    CHECK(legacy.bytesPerCommand > 0);
+    CHECK(binary.bytesPerCommand > 0);
+    // an upload takes AT+USOWR and AT+USORD, a download AT+USORD
+    CHECK(binary.bytesPerCommand > 2 * legacy.bytesPerCommand);
+    printf("Bytes per AT command: legacy %.0f, binary %.0f. CPU per KB: legacy %.0f us, binary %.0f us\n",
+           legacy.bytesPerCommand, binary.bytesPerCommand, legacy.cpuUsPerKB, binary.cpuUsPerKB);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    std::thread scheduler(os::Task::startScheduler);
+
+    RunTest(true, ut_RetryWhenParserIsFull);
+    RunTest(true, ut_AsyncSocketThroughput);
+    RunTest(true, ut_PipelinedUploadThroughput);
+    RunTest(true, ut_BinaryChunksThroughput);
+
+    os::Task::endScheduler();
+    scheduler.join();
+    UnitTestMainEnd();
+}
@@ -4,6 +4,9 @@
  */
 
 #include "Can.h"
+#include "CanRxRing.h"
+#include "CanTxQueue.h"
+#include "WorkQueue.h"
 #include "trace.h"
 
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
@@ -11,6 +14,9 @@ static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNIN
 using hal::Can;
 using hal::Factory;
 
+static_assert(std::is_same<Can::TransmitCompletion, CanTxQueue::Completion>::value, "Completion mismatch");
+static_assert(os::WorkQueue::HIGH == 0, "HIGH isn't the default priority of enableDeferredReceive");
+
 #if USB_LP_CAN1_RX0_INTERRUPT_ENABLED
 void    USB_LP_CAN1_RX0_IRQHandler(void)
 {
@@ -27,9 +33,62 @@ void    CAN1_RX1_IRQHandler(void)
 }
 #endif
 
+#if USB_HP_CAN1_TX_INTERRUPT_ENABLED
+void    USB_HP_CAN1_TX_IRQHandler(void)
+{
+    constexpr const Can& can = Factory<Can>::get<Can::Description::MAINCAN>();
+    Can::Can_TX_IRQHandler(can);
+}
+#endif
+
+void Can::Can_TX_IRQHandler(const Can& peripherie)
+{
+    CAN_TypeDef* const can = reinterpret_cast<CAN_TypeDef*>(peripherie.mPeripherie);
+    CanTxQueue* const queue = Can::TransmitQueues[peripherie.mDescription];
+
+    if (queue) {
+        queue->onTransmitInterrupt(*can);
+    } else {
+        can->TSR = CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2;
+    }
+}
+
 void Can::Can_IRQHandler(const Can& peripherie)
 {
     static CanRxMsg msg;
+    auto& buffered = Can::BufferedReceives[peripherie.mDescription];
+    auto& deferred = Can::DeferredReceives[peripherie.mDescription];
+
+    if (buffered.mRing) {
+        // one interrupt empties both fifos, the other one finds nothing left to do
+        CAN_TypeDef* const can = reinterpret_cast<CAN_TypeDef*>(peripherie.mPeripherie);
+        size_t stored = buffered.mRing->drain(*can, CAN_FIFO0);
+        stored += buffered.mRing->drain(*can, CAN_FIFO1);
+        if (stored && buffered.mNotify) {
+            buffered.mNotify();
+        }
+        return;
+    }
+
+    if (deferred.mWorkQueue) {
+        CAN_TypeDef* const can = reinterpret_cast<CAN_TypeDef*>(peripherie.mPeripherie);
+        const std::array<uint32_t, 2> interrupts {CAN_IT_FMP0, CAN_IT_FMP1};
+
+        for (uint8_t fifo = CAN_FIFO0; fifo <= CAN_FIFO1; fifo++) {
+            if (CAN_GetITStatus(can, interrupts[fifo])) {
+                // the messages wait in the hardware fifo until the worker read them
+                CAN_ITConfig(can, interrupts[fifo], DISABLE);
+                const auto priority = static_cast<os::WorkQueue::Priority>(deferred.mPriority);
+                if (!deferred.mWorkQueue->postFromISR(priority, [&peripherie](uint32_t payload) {
+                    peripherie.drainFifo(payload);
+                }, fifo)) {
+                    // queue full, serve the fifo in the interrupt as without work queue
+                    peripherie.drainFifo(fifo);
+                }
+            }
+        }
+        return;
+    }
 
     if (CAN_GetITStatus(reinterpret_cast<CAN_TypeDef*>(peripherie.mPeripherie), CAN_IT_FMP0)) {
         if (Can::ReceiveInterruptCallbacks[peripherie.mDescription]) {
@@ -59,7 +118,7 @@ void Can::initialize() const
     NVIC_EnableIRQ(CAN1_RX1_IRQn);
 }
 
-void Can::enableNonBlockingReceive(std::function<void(CanRxMsg)> callback) const
+void Can::enableNonBlockingReceive(util::InplaceFunction<void(CanRxMsg)> callback) const
 {
     ReceiveInterruptCallbacks[mDescription] = callback;
 
@@ -69,13 +128,77 @@ void Can::enableNonBlockingReceive(std::function<void(CanRxMsg)> callback) const
     CAN_ITConfig(reinterpret_cast<CAN_TypeDef*>(mPeripherie), CAN_IT_FMP0 | CAN_IT_FMP1, ENABLE);
 }
 
+void Can::enableDeferredReceive(util::InplaceFunction<void(CanRxMsg)> callback, os::WorkQueue& workQueue,
+                                const uint8_t priority) const
+{
+    DeferredReceives[mDescription] = DeferredReceive {&workQueue, priority};
+    enableNonBlockingReceive(callback);
+}
+
+void Can::enableBufferedReceive(CanRxRing& ring, util::InplaceFunction<void(void)> notify) const
+{
+    BufferedReceives[mDescription] = BufferedReceive {&ring, notify};
+    enableNonBlockingReceive(nullptr);
+}
+
+void Can::drainFifo(const uint8_t fifo) const
+{
+    CAN_TypeDef* const can = reinterpret_cast<CAN_TypeDef*>(mPeripherie);
+    CanRxMsg msg;
+
+    while (CAN_MessagePending(can, fifo)) {
+        CAN_Receive(can, fifo, &msg);
+        if (ReceiveInterruptCallbacks[mDescription]) {
+            ReceiveInterruptCallbacks[mDescription](msg);
+        }
+    }
+    CAN_ITConfig(can, fifo == CAN_FIFO0 ? CAN_IT_FMP0 : CAN_IT_FMP1, ENABLE);
+}
+
 void Can::disableNonBlockingReceive(void) const
 {
     CAN_ITConfig(reinterpret_cast<CAN_TypeDef*>(mPeripherie), CAN_IT_FMP0 | CAN_IT_FMP1, DISABLE);
+    DeferredReceives[mDescription] = DeferredReceive {nullptr, os::WorkQueue::HIGH};
+    BufferedReceives[mDescription] = BufferedReceive {nullptr, nullptr};
+}
+
+void Can::enableQueuedTransmit(CanTxQueue& queue) const
+{
+    TransmitQueues[mDescription] = &queue;
+
+    NVIC_SetPriority(getTxIRQn(), 0xf);
+    NVIC_EnableIRQ(getTxIRQn());
+    CAN_ITConfig(reinterpret_cast<CAN_TypeDef*>(mPeripherie), CAN_IT_TME, ENABLE);
+}
+
+bool Can::enqueue(const CanFrame& frame, TransmitCompletion completion) const
+{
+    CanTxQueue* const queue = TransmitQueues[mDescription];
+    if (!queue) {
+        return false;
+    }
+
+    // the queue belongs to the transmit interrupt
+    NVIC_DisableIRQ(getTxIRQn());
+    const bool queued = queue->enqueue(*reinterpret_cast<CAN_TypeDef*>(mPeripherie), frame, completion);
+    NVIC_EnableIRQ(getTxIRQn());
+    return queued;
 }
 
 bool Can::send(CanTxMsg& msg) const
 {
+    if (TransmitQueues[mDescription]) {
+        // CAN_Transmit would race the transmit interrupt for the empty mailboxes
+        CanFrame frame {};
+        frame.mId = (msg.IDE == CAN_Id_Extended) ? (msg.ExtId | CanFrame::EXTENDED) : msg.StdId;
+        if (msg.RTR == CAN_RTR_Remote) {
+            frame.mId |= CanFrame::REMOTE;
+        }
+        frame.mLength = std::min<uint8_t>(msg.DLC, frame.mData.size());
+        std::copy_n(msg.Data, frame.mData.size(), frame.mData.begin());
+        return enqueue(frame);
+    }
+
     auto ret = CAN_Transmit(reinterpret_cast<CAN_TypeDef*>(mPeripherie), &msg);
 
     return ret != CAN_TxStatus_NoMailBox;
@@ -100,6 +223,33 @@ bool Can::receive(CanRxMsg& msg) const
     return false;
 }
 
+size_t Can::receive(CanFrame* const frames, const size_t length) const
+{
+    CanRxRing* const ring = BufferedReceives[mDescription].mRing;
+    if (ring) {
+        return ring->receive(frames, length);
+    }
+
+    CAN_TypeDef* const can = reinterpret_cast<CAN_TypeDef*>(mPeripherie);
+    size_t count = 0;
+    for (uint8_t fifo = CAN_FIFO0; fifo <= CAN_FIFO1; fifo++) {
+        while ((count < length) && CanRxRing::readMailbox(*can, fifo, frames[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+IRQn Can::getTxIRQn(void) const
+{
+    switch (mPeripherie) {
+    case CAN1_BASE:
+        return IRQn::USB_HP_CAN1_TX_IRQn;
+    }
+
+    return IRQn::UsageFault_IRQn;
+}
+
 bool Can::hasOverRunError(void) const
 {
     return CAN_GetFlagStatus(reinterpret_cast<CAN_TypeDef*>(mPeripherie),
@@ -112,6 +262,9 @@ void Can::clearOverRunError(void) const
 }
 
 Can::ReceiveCallbackArray Can::ReceiveInterruptCallbacks;
+std::array<Can::DeferredReceive, Can::__ENUM__SIZE> Can::DeferredReceives;
+std::array<Can::BufferedReceive, Can::__ENUM__SIZE> Can::BufferedReceives;
+std::array<CanTxQueue*, Can::__ENUM__SIZE> Can::TransmitQueues;
 
 constexpr const std::array<const Can, Can::__ENUM__SIZE + 1> Factory<Can>::Container;
 constexpr const std::array<const CAN_FilterInitTypeDef, 1> Factory<Can>::CanFilterContainer;
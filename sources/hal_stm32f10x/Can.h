@@ -8,14 +8,24 @@
 #include <cstdint>
 #include <limits>
 #include <array>
-#include <functional>
+#include "InplaceFunction.h"
 #include "stm32f10x_can.h"
 #include "stm32f10x_rcc.h"
 #include "hal_Factory.h"
 
+struct CanFrame;
+class CanRxRing;
+class CanTxQueue;
+
+namespace os
+{
+class WorkQueue;
+}
+
 extern "C" {
 void    USB_LP_CAN1_RX0_IRQHandler(void);
 void    CAN1_RX1_IRQHandler(void);
+void    USB_HP_CAN1_TX_IRQHandler(void);
 }
 
 namespace hal
@@ -23,6 +33,9 @@ namespace hal
 struct Can {
 #include "Can_config.h"
 
+    /* CanTxQueue::Completion */
+    using TransmitCompletion = util::InplaceFunction<void (const bool sent, const uint16_t timestamp)>;
+
     const enum Description mDescription;
 
     Can() = delete;
@@ -34,14 +47,30 @@ struct Can {
     bool hasOverRunError(void) const;
     void clearOverRunError(void) const;
 
+    /* goes through the transmit queue once queued transmit is enabled */
     bool send(CanTxMsg&) const;
+    /* the transmit interrupt keeps the mailboxes loaded from queue, ordered by arbitration priority */
+    void enableQueuedTransmit(CanTxQueue& queue) const;
+    /* doesn't block, false if the queue is full or queued transmit isn't enabled */
+    bool enqueue(const CanFrame& frame, TransmitCompletion completion = nullptr) const;
     size_t messagePending(void) const;
     bool receive(CanRxMsg& msg) const;
-
-    void enableNonBlockingReceive(std::function<void(CanRxMsg)> callback) const;
+    /* takes up to length frames from the ring if buffered receive is enabled, else from the hardware fifos */
+    size_t receive(CanFrame* const frames, const size_t length) const;
+
+    void enableNonBlockingReceive(util::InplaceFunction<void(CanRxMsg)> callback) const;
+    /*
+     * the interrupt only masks the fifo, a worker of the queue reads it and calls the callback,
+     * priority is an os::WorkQueue::Priority, HIGH by default
+     */
+    void enableDeferredReceive(util::InplaceFunction<void(CanRxMsg)> callback, os::WorkQueue& workQueue,
+                               const uint8_t priority = 0) const;
+    /* the interrupt drains both fifos into ring and calls notify if it stored frames */
+    void enableBufferedReceive(CanRxRing& ring, util::InplaceFunction<void(void)> notify = nullptr) const;
     void disableNonBlockingReceive(void) const;
 
     static void Can_IRQHandler(const Can& peripherie);
+    static void Can_TX_IRQHandler(const Can& peripherie);
 
 private:
     constexpr Can(const enum Description& desc,
@@ -55,8 +84,23 @@ private:
     const CAN_InitTypeDef mConfiguration;
 
     void initialize(void) const;
-
-    using ReceiveCallbackArray = std::array<std::function<void (CanRxMsg)>, Can::__ENUM__SIZE>;
+    void drainFifo(const uint8_t fifo) const;
+    IRQn getTxIRQn(void) const;
+
+    struct DeferredReceive {
+        os::WorkQueue* mWorkQueue;
+        uint8_t mPriority;
+    };
+    static std::array<DeferredReceive, Can::__ENUM__SIZE> DeferredReceives;
+
+    struct BufferedReceive {
+        CanRxRing* mRing;
+        util::InplaceFunction<void(void)> mNotify;
+    };
+    static std::array<BufferedReceive, Can::__ENUM__SIZE> BufferedReceives;
+    static std::array<CanTxQueue*, Can::__ENUM__SIZE> TransmitQueues;
+
+    using ReceiveCallbackArray = std::array<util::InplaceFunction<void (CanRxMsg)>, Can::__ENUM__SIZE>;
     static ReceiveCallbackArray ReceiveInterruptCallbacks;
 
     friend class Factory<Can>;
@@ -20,6 +20,13 @@ void Dma::DMA_IRQHandlerSemaphore(const Dma& dma, const Dma::SemaphoreArray& arr
     }
 }
 
+void Dma::DMA_IRQHandlerNotifier(const Dma& dma, const Dma::NotifierArray& array)
+{
+    if (array[dma.mDescription] != nullptr) {
+        array[dma.mDescription]->notifyFromISR();
+    }
+}
+
 void Dma::DMA_IRQHandlerCallback(const Dma& dma, const Dma::CallbackArray& array)
 {
     if (array[dma.mDescription] != nullptr) {
@@ -44,16 +51,19 @@ void Dma::DMA_IRQHandler(const Dma& peripherie, const uint32_t TCFlag, const uin
 void Dma::DMA_TCIRQHandler(const Dma& peripherie)
 {
     DMA_IRQHandlerSemaphore(peripherie, Dma::TCInterruptSemaphores);
+    DMA_IRQHandlerNotifier(peripherie, Dma::TCInterruptNotifiers);
     DMA_IRQHandlerCallback(peripherie, Dma::TCInterruptCallbacks);
 }
 void Dma::DMA_HTIRQHandler(const Dma& peripherie)
 {
     DMA_IRQHandlerSemaphore(peripherie, Dma::HTInterruptSemaphores);
+    DMA_IRQHandlerNotifier(peripherie, Dma::HTInterruptNotifiers);
     DMA_IRQHandlerCallback(peripherie, Dma::HTInterruptCallbacks);
 }
 void Dma::DMA_TEIRQHandler(const Dma& peripherie)
 {
     DMA_IRQHandlerSemaphore(peripherie, Dma::TEInterruptSemaphores);
+    DMA_IRQHandlerNotifier(peripherie, Dma::TEInterruptNotifiers);
     DMA_IRQHandlerCallback(peripherie, Dma::TEInterruptCallbacks);
 }
 
@@ -342,7 +352,58 @@ void Dma::unregisterInterruptSemaphore(const InterruptSource source) const
     }
 }
 
-bool Dma::registerInterruptCallback(std::function<void(void)> function, const Dma::InterruptSource source) const
+bool Dma::registerInterruptNotifier(os::TaskNotifier* const notifier, const Dma::InterruptSource source) const
+{
+    switch (source) {
+    case Dma::TC:
+        if (mDmaInterrupt & DMA_IT_TC) {
+            Dma::TCInterruptNotifiers[mDescription] = notifier;
+            return true;
+        } else {
+            Trace(ZONE_ERROR, "Invalid DMA configuration\r\n");
+            return false;
+        }
+
+    case Dma::HT:
+        if (mDmaInterrupt & DMA_IT_HT) {
+            Dma::HTInterruptNotifiers[mDescription] = notifier;
+            return true;
+        } else {
+            Trace(ZONE_ERROR, "Invalid DMA configuration\r\n");
+            return false;
+        }
+
+    case Dma::TE:
+        if (mDmaInterrupt & DMA_IT_TE) {
+            Dma::TEInterruptNotifiers[mDescription] = notifier;
+            return true;
+        } else {
+            Trace(ZONE_ERROR, "Invalid DMA configuration\r\n");
+            return false;
+        }
+    }
+
+    return false;
+}
+
+void Dma::unregisterInterruptNotifier(const InterruptSource source) const
+{
+    switch (source) {
+    case Dma::TC:
+        Dma::TCInterruptNotifiers[mDescription] = nullptr;
+        return;
+
+    case Dma::HT:
+        Dma::HTInterruptNotifiers[mDescription] = nullptr;
+        return;
+
+    case Dma::TE:
+        Dma::TEInterruptNotifiers[mDescription] = nullptr;
+        return;
+    }
+}
+
+bool Dma::registerInterruptCallback(util::InplaceFunction<void(void)> function, const Dma::InterruptSource source) const
 {
     switch (source) {
     case Dma::TC:
@@ -406,6 +467,9 @@ void Dma::setCurrentDataCounter(uint16_t value) const
 Dma::SemaphoreArray Dma::TCInterruptSemaphores;
 Dma::SemaphoreArray Dma::HTInterruptSemaphores;
 Dma::SemaphoreArray Dma::TEInterruptSemaphores;
+Dma::NotifierArray Dma::TCInterruptNotifiers;
+Dma::NotifierArray Dma::HTInterruptNotifiers;
+Dma::NotifierArray Dma::TEInterruptNotifiers;
 Dma::CallbackArray Dma::TCInterruptCallbacks;
 Dma::CallbackArray Dma::HTInterruptCallbacks;
 Dma::CallbackArray Dma::TEInterruptCallbacks;
@@ -9,11 +9,12 @@
 #include <cstdint>
 #include <limits>
 #include <array>
-#include <functional>
+#include "InplaceFunction.h"
 #include "stm32f10x.h"
 #include "stm32f10x_dma.h"
 #include "stm32f10x_rcc.h"
 #include "Semaphore.h"
+#include "TaskNotifier.h"
 #include "hal_Factory.h"
 
 extern "C" {
@@ -57,8 +58,10 @@ struct Dma {
     void enable(void) const;
     void disable(void) const;
     bool registerInterruptSemaphore(os::Semaphore* const semaphore, const InterruptSource) const;
-    bool registerInterruptCallback(std::function<void(void)> callback, const InterruptSource) const;
+    bool registerInterruptCallback(util::InplaceFunction<void(void)> callback, const InterruptSource) const;
     void unregisterInterruptSemaphore(const InterruptSource) const;
+    bool registerInterruptNotifier(os::TaskNotifier* const notifier, const InterruptSource) const;
+    void unregisterInterruptNotifier(const InterruptSource) const;
     void unregisterInterruptCallback(const InterruptSource) const;
 
     uint16_t getCurrentDataCounter(void) const;
@@ -96,12 +99,17 @@ private:
 
     using SemaphoreArray = std::array<os::Semaphore*, Dma::__ENUM__SIZE>;
     inline static void DMA_IRQHandlerSemaphore(const Dma& peripherie, const SemaphoreArray&);
-    using CallbackArray = std::array<std::function<void (void)>, Dma::__ENUM__SIZE>;
+    using NotifierArray = std::array<os::TaskNotifier*, Dma::__ENUM__SIZE>;
+    inline static void DMA_IRQHandlerNotifier(const Dma& peripherie, const NotifierArray&);
+    using CallbackArray = std::array<util::InplaceFunction<void (void)>, Dma::__ENUM__SIZE>;
     inline static void DMA_IRQHandlerCallback(const Dma& peripherie, const CallbackArray&);
 
     static SemaphoreArray TCInterruptSemaphores; // Transfer Complete
     static SemaphoreArray HTInterruptSemaphores; // Half Transfer
     static SemaphoreArray TEInterruptSemaphores; // Transfer Error
+    static NotifierArray TCInterruptNotifiers;
+    static NotifierArray HTInterruptNotifiers;
+    static NotifierArray TEInterruptNotifiers;
     static CallbackArray TCInterruptCallbacks;
     static CallbackArray HTInterruptCallbacks;
     static CallbackArray TEInterruptCallbacks;
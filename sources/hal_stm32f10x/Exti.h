@@ -9,7 +9,7 @@
 #include <cstdint>
 #include <limits>
 #include <array>
-#include <functional>
+#include "InplaceFunction.h"
 #include "stm32f10x_exti.h"
 #include "stm32f10x_rcc.h"
 #include "stm32f10x.h"
@@ -39,7 +39,7 @@ struct Exti {
 
     void enable(void) const;
     void disable(void) const;
-    void registerInterruptCallback(std::function<void(void)> ) const;
+    void registerInterruptCallback(util::InplaceFunction<void(void)> ) const;
     void unregisterInterruptCallback(void) const;
     void handleInterrupt(void) const;
 
@@ -66,7 +66,7 @@ private:
     void initialize(void) const;
     bool getStatus(void) const;
 
-    using CallbackArray = std::array<std::function<void (void)>, Exti::__ENUM__SIZE>;
+    using CallbackArray = std::array<util::InplaceFunction<void (void)>, Exti::__ENUM__SIZE>;
     static CallbackArray ExtiCallbacks;
 
     friend class Factory<Exti>;
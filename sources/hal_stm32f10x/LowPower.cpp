@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "LowPower.h"
+#include "stm32f10x_exti.h"
+#include "misc.h"
+#include "stm32f10x_pwr.h"
+#include "stm32f10x_rcc.h"
+#include "stm32f10x_rtc.h"
+#include "DeepSleepInterface.h"
+#include "trace.h"
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+using hal::LowPower;
+using os::TicklessIdle;
+
+void RTCAlarm_IRQHandler(void)
+{
+    RTC_ClearITPendingBit(RTC_IT_ALR);
+    EXTI_ClearITPendingBit(EXTI_Line17);
+}
+
+void vApplicationSuppressTicksAndSleep(uint32_t xExpectedIdleTime)
+{
+    LowPower::suppressTicksAndSleep(xExpectedIdleTime);
+}
+
+void LowPower::initialize(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR | RCC_APB1Periph_BKP, ENABLE);
+    PWR_BackupAccessCmd(ENABLE);
+
+    RCC_LSEConfig(RCC_LSE_ON);
+    while (RCC_GetFlagStatus(RCC_FLAG_LSERDY) == RESET) {}
+    RCC_RTCCLKConfig(RCC_RTCCLKSource_LSE);
+    RCC_RTCCLKCmd(ENABLE);
+
+    RTC_WaitForSynchro();
+    RTC_WaitForLastTask();
+    RTC_SetPrescaler(RTC_PRESCALER - 1);
+    RTC_WaitForLastTask();
+    RTC_ITConfig(RTC_IT_ALR, ENABLE);
+    RTC_WaitForLastTask();
+
+    EXTI_InitTypeDef exti {EXTI_Line17, EXTI_Mode_Interrupt, EXTI_Trigger_Rising, ENABLE};
+    EXTI_Init(&exti);
+
+    NVIC_InitTypeDef nvic {RTCAlarm_IRQn, 0xf, 0, ENABLE};
+    NVIC_Init(&nvic);
+}
+
+void LowPower::suppressTicksAndSleep(const uint32_t expectedIdleTime)
+{
+    const bool deepSleep = os::DeepSleepController::isInGlobalDeepSleep();
+    const TicklessIdle::TickConverter converter = deepSleep ?
+                                                  TicklessIdle::TickConverter(LSE_HZ, RTC_MAX_COUNTS) :
+                                                  TicklessIdle::TickConverter(configCPU_CLOCK_HZ, SYSTICK_MAX_COUNTS);
+
+    const uint32_t plannedTicks = TicklessIdle::getSleepTicks(expectedIdleTime, converter.getMaxTicks());
+    if (plannedTicks == 0) {
+        return;
+    }
+
+    /* interrupts still end WFI while they are masked, they run after the tick is restored */
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+    /* a tick that is due already has to be processed first */
+    if ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) ||
+        (eTaskConfirmSleepModeStatus() == eAbortSleep))
+    {
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        __enable_irq();
+        return;
+    }
+
+    const uint32_t countsPerTick = configCPU_CLOCK_HZ / configTICK_RATE_HZ;
+    uint32_t phase = converter.phaseOf(countsPerTick - 1 - SysTick->VAL, countsPerTick);
+
+    uint32_t latencyUs = 0;
+    const uint32_t counts = converter.countsUntil(plannedTicks, phase);
+    const uint32_t elapsed = deepSleep ? stop(counts, latencyUs) : sleep(counts, latencyUs);
+    const uint32_t restartAt = DWT->CYCCNT;
+
+    uint32_t sleptTicks = converter.completedTicks(elapsed, phase);
+
+    SysTick->LOAD = converter.remainingOf(phase, countsPerTick) - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = countsPerTick - 1;
+
+    if (sleptTicks >= plannedTicks) {
+        /* the tick interrupt steps the last tick, so the task waiting for it is unblocked on time */
+        sleptTicks = plannedTicks;
+        vTaskStepTick(plannedTicks - 1);
+        SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+    } else {
+        vTaskStepTick(sleptTicks);
+    }
+
+    latencyUs += cyclesToUs(DWT->CYCCNT - restartAt, SystemCoreClock);
+    __enable_irq();
+
+    TicklessIdle::recordSleep(plannedTicks, sleptTicks, latencyUs);
+}
+
+/* Sleep mode, the SysTick is the wakeup timer */
+uint32_t LowPower::sleep(const uint32_t counts, uint32_t& latencyUs)
+{
+    SysTick->LOAD = counts - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+    __ISB();
+    const uint32_t wokeAt = DWT->CYCCNT;
+
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+    uint32_t elapsed;
+    if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) {
+        /* the tick is accounted for here, not by its interrupt */
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+        elapsed = counts;
+    } else {
+        elapsed = counts - 1 - SysTick->VAL;
+    }
+
+    latencyUs = cyclesToUs(DWT->CYCCNT - wokeAt, SystemCoreClock);
+    return elapsed;
+}
+
+/* STOP mode, the RTC alarm wakes up, counts are LSE cycles */
+uint32_t LowPower::stop(const uint32_t counts, uint32_t& latencyUs)
+{
+    const uint64_t start = getLseCounts();
+
+    /* the alarm matches whole RTC counts, it is late by less than one */
+    RTC_WaitForLastTask();
+    RTC_SetAlarm((start + counts + RTC_PRESCALER - 1) / RTC_PRESCALER);
+    RTC_WaitForLastTask();
+    RTC_ClearFlag(RTC_FLAG_ALR);
+    EXTI_ClearITPendingBit(EXTI_Line17);
+
+    PWR_EnterSTOPMode(PWR_Regulator_LowPower, PWR_STOPEntry_WFI);
+    const uint32_t wokeAt = DWT->CYCCNT;
+
+    /* the core runs from HSI until the PLL is selected again */
+    restoreSystemClock();
+    const uint32_t restoredAt = DWT->CYCCNT;
+
+    /* the counter registers are valid again after resynchronisation */
+    RTC_WaitForSynchro();
+    const uint32_t elapsed = getLseCounts() - start;
+
+    latencyUs = cyclesToUs(restoredAt - wokeAt, HSI_VALUE) + cyclesToUs(DWT->CYCCNT - restoredAt, SystemCoreClock);
+    return elapsed;
+}
+
+/* LSE cycles counted by the RTC */
+uint64_t LowPower::getLseCounts(void)
+{
+    uint32_t counter;
+    uint32_t divider;
+
+    do {
+        counter = RTC_GetCounter();
+        divider = RTC_GetDivider();
+    } while (counter != RTC_GetCounter());
+
+    return static_cast<uint64_t>(counter) * RTC_PRESCALER + RTC_PRESCALER - 1 - divider;
+}
+
+void LowPower::restoreSystemClock(void)
+{
+    RCC_HSEConfig(RCC_HSE_ON);
+    while (RCC_GetFlagStatus(RCC_FLAG_HSERDY) == RESET) {}
+
+    RCC_PLLCmd(ENABLE);
+    while (RCC_GetFlagStatus(RCC_FLAG_PLLRDY) == RESET) {}
+
+    RCC_SYSCLKConfig(RCC_SYSCLKSource_PLLCLK);
+    while (RCC_GetSYSCLKSource() != 0x08) {}
+}
+
+uint32_t LowPower::cyclesToUs(const uint32_t cycles, const uint32_t clock)
+{
+    return static_cast<uint64_t>(cycles) * 1000000 / clock;
+}
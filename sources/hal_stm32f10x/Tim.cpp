@@ -131,7 +131,7 @@ void Tim::initialize(void) const
     }
 }
 
-void Tim::registerInterruptCallback(std::function<void(void)> f) const
+void Tim::registerInterruptCallback(util::InplaceFunction<void(void)> f) const
 {
     TimCallbacks[mDescription] = f;
 }
@@ -116,7 +116,7 @@ void Usart::setBaudRate(const size_t baudRate) const
     USART_Cmd(reinterpret_cast<USART_TypeDef*>(mPeripherie), ENABLE);
 }
 
-void Usart::enableNonBlockingReceive(std::function<void(uint8_t)> callback) const
+void Usart::enableNonBlockingReceive(util::InplaceFunction<void(uint8_t)> callback) const
 {
     ReceiveInterruptCallbacks[mDescription] = callback;
 
@@ -9,7 +9,7 @@
 #include <cstdint>
 #include <limits>
 #include <array>
-#include <functional>
+#include "InplaceFunction.h"
 #include "stm32f10x_usart.h"
 #include "stm32f10x_rcc.h"
 #include "hal_Factory.h"
@@ -64,7 +64,7 @@ struct Usart {
 
     void setBaudRate(const size_t) const;
 
-    void enableNonBlockingReceive(std::function<void(uint8_t)> callback) const;
+    void enableNonBlockingReceive(util::InplaceFunction<void(uint8_t)> callback) const;
     void disableNonBlockingReceive(void) const;
 
     static void USART_IRQHandler(const Usart& peripherie);
@@ -84,7 +84,7 @@ private:
     void initialize(void) const;
     IRQn getIRQn(void) const;
 
-    using ReceiveCallbackArray = std::array<std::function<void (uint8_t)>, Usart::__ENUM__SIZE>;
+    using ReceiveCallbackArray = std::array<util::InplaceFunction<void (uint8_t)>, Usart::__ENUM__SIZE>;
 
     static ReceiveCallbackArray ReceiveInterruptCallbacks;
 
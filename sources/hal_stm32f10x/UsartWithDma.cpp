@@ -5,6 +5,7 @@
 
 #include "UsartWithDma.h"
 #include "trace.h"
+#include "os_Task.h"
 
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
@@ -13,8 +14,9 @@ using hal::Factory;
 using hal::Usart;
 using hal::UsartWithDma;
 
-std::array<os::Semaphore, Usart::__ENUM__SIZE> UsartWithDma::DmaTransferCompleteSemaphores;
-std::array<os::Semaphore, Usart::__ENUM__SIZE> UsartWithDma::DmaReceiveCompleteSemaphores;
+std::array<os::TaskNotifier, Usart::__ENUM__SIZE> UsartWithDma::DmaTransferCompleteNotifiers;
+std::array<os::TaskNotifier, Usart::__ENUM__SIZE> UsartWithDma::DmaReceiveCompleteNotifiers;
+std::array<UsartWithDma::TxQueue, Usart::__ENUM__SIZE> UsartWithDma::TxQueues;
 
 void UsartWithDma::initialize() const
 {
@@ -27,13 +29,7 @@ void UsartWithDma::initialize() const
     }
     USART_DMACmd(reinterpret_cast<USART_TypeDef*>(mUsart.mPeripherie), mDmaCmd, ENABLE);
 
-    if (!DmaTransferCompleteSemaphores[static_cast<size_t>(mUsart.mDescription)] ||
-        !DmaReceiveCompleteSemaphores[static_cast<size_t>(mUsart.mDescription)])
-    {
-        Trace(ZONE_ERROR, "Semaphore allocation failed\r\n");
-    } else {
-        registerInterruptSemaphores();
-    }
+    registerInterruptNotifiers();
     mInitialized = true;
     Trace(ZONE_INFO, "Init done!\r\n");
 }
@@ -48,27 +44,27 @@ bool UsartWithDma::isInitalized(void) const
     return mInitialized;
 }
 
-void UsartWithDma::registerInterruptSemaphores(void) const
+void UsartWithDma::registerInterruptNotifiers(void) const
 {
     if ((mTxDma != nullptr)) {
-        mTxDma->registerInterruptSemaphore(&DmaTransferCompleteSemaphores.at(mUsart.mDescription),
-                                           Dma::InterruptSource::TC);
+        mTxDma->registerInterruptNotifier(&DmaTransferCompleteNotifiers.at(mUsart.mDescription),
+                                          Dma::InterruptSource::TC);
     }
 
     if ((mRxDma != nullptr)) {
-        mRxDma->registerInterruptSemaphore(&DmaReceiveCompleteSemaphores.at(mUsart.mDescription),
-                                           Dma::InterruptSource::TC);
+        mRxDma->registerInterruptNotifier(&DmaReceiveCompleteNotifiers.at(mUsart.mDescription),
+                                          Dma::InterruptSource::TC);
     }
 }
 
-void UsartWithDma::registerTransferCompleteCallback(std::function<void(void)> f) const
+void UsartWithDma::registerTransferCompleteCallback(util::InplaceFunction<void(void)> f) const
 {
     if (mTxDma != nullptr) {
         mTxDma->registerInterruptCallback(f, Dma::InterruptSource::TC);
     }
 }
 
-void UsartWithDma::registerReceiveCompleteCallback(std::function<void(void)> f) const
+void UsartWithDma::registerReceiveCompleteCallback(util::InplaceFunction<void(void)> f) const
 {
     if (mRxDma != nullptr) {
         mRxDma->registerInterruptCallback(f, Dma::InterruptSource::TC);
@@ -89,13 +85,12 @@ size_t UsartWithDma::send(uint8_t const* const data, const size_t length, const
     const bool dmaSupport = (mTxDma != nullptr) && (mDmaCmd & USART_DMAReq_Tx);
 
     if (dmaSupport && (length > MIN_LENGTH_FOR_DMA_TRANSFER)) {
-        // clear Semaphore
-        DmaTransferCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(0));
+        DmaTransferCompleteNotifiers.at(mUsart.mDescription).prepare();
         // we have DMA support
         mTxDma->setupTransfer(data, length);
         mTxDma->enable();
 
-        if (DmaTransferCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(ticksToWait))) {
+        if (DmaTransferCompleteNotifiers.at(mUsart.mDescription).wait(std::chrono::milliseconds(ticksToWait))) {
             mTxDma->disable();
             return length;
         } else {
@@ -123,12 +118,11 @@ size_t UsartWithDma::receive(uint8_t* const data, const size_t length, const uin
     const bool dmaSupport = (mRxDma != nullptr) && (mDmaCmd & USART_DMAReq_Rx);
 
     if (dmaSupport && (length > MIN_LENGTH_FOR_DMA_TRANSFER)) {
-        // clear Semaphore
-        DmaReceiveCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(0));
+        DmaReceiveCompleteNotifiers.at(mUsart.mDescription).prepare();
         mRxDma->setupTransfer(data, length);
         mRxDma->enable();
 
-        DmaReceiveCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(ticksToWait));
+        DmaReceiveCompleteNotifiers.at(mUsart.mDescription).wait(std::chrono::milliseconds(ticksToWait));
 
         mRxDma->disable();
         return length - mRxDma->getCurrentDataCounter();
@@ -175,6 +169,35 @@ void UsartWithDma::receiveNonBlocking(uint8_t const* const data, const size_t le
     }
 }
 
+bool UsartWithDma::sendQueued(uint8_t const* const              data,
+                              const size_t                      length,
+                              util::InplaceFunction<void(void)> completion) const
+{
+    const bool dmaSupport = (mTxDma != nullptr) && (mDmaCmd & USART_DMAReq_Tx);
+
+    if (!dmaSupport || (data == nullptr)) {
+        return false;
+    }
+
+    TxQueue& queue = TxQueues.at(mUsart.mDescription);
+
+    os::ThisTask::enterCriticalSection();
+    if (!queue.isActive()) {
+        mTxDma->registerInterruptCallback([this] {
+            TxQueues.at(mUsart.mDescription).onTransferComplete(*mTxDma);
+        }, Dma::InterruptSource::TC);
+    }
+    const bool retVal = queue.enqueue(*mTxDma, data, length, completion);
+    os::ThisTask::exitCriticalSection();
+
+    return retVal;
+}
+
+size_t UsartWithDma::getTxQueueSpacesAvailable(void) const
+{
+    return TxQueues.at(mUsart.mDescription).spacesAvailable();
+}
+
 void UsartWithDma::stopNonBlockingSend(void) const
 {
     if (mTxDma != nullptr) {
@@ -10,7 +10,8 @@
 #include <array>
 #include "Dma.h"
 #include "Usart.h"
-#include "Semaphore.h"
+#include "TaskNotifier.h"
+#include "DmaTxQueue.h"
 #include "hal_Factory.h"
 #include <string_view>
 
@@ -45,11 +46,17 @@ struct UsartWithDma {
     void sendNonBlocking(uint8_t const* const, const size_t, const bool repeat) const;
     void receiveNonBlocking(uint8_t const* const, const size_t, const bool repeat) const;
 
+    /* Queues data for transmission without blocking. The transfer complete
+     * interrupt chains the queued transfers and calls completion from ISR
+     * context. Returns false if the queue is full. Don't mix with send(). */
+    bool sendQueued(uint8_t const* const, const size_t, util::InplaceFunction<void(void)> completion = nullptr) const;
+    size_t getTxQueueSpacesAvailable(void) const;
+
     void stopNonBlockingSend(void) const;
     void stopNonBlockingReceive(void) const;
 
-    void registerTransferCompleteCallback(std::function<void(void)> ) const;
-    void registerReceiveCompleteCallback(std::function<void(void)> ) const;
+    void registerTransferCompleteCallback(util::InplaceFunction<void(void)> ) const;
+    void registerReceiveCompleteCallback(util::InplaceFunction<void(void)> ) const;
 
     const Usart& mUsart;
 
@@ -68,11 +75,15 @@ private:
     mutable bool mInitialized = false;
 
     void initialize(void) const;
-    void registerInterruptSemaphores(void) const;
+    void registerInterruptNotifiers(void) const;
 
     static constexpr const size_t MIN_LENGTH_FOR_DMA_TRANSFER = 5;
-    static std::array<os::Semaphore, Usart::__ENUM__SIZE> DmaTransferCompleteSemaphores;
-    static std::array<os::Semaphore, Usart::__ENUM__SIZE> DmaReceiveCompleteSemaphores;
+    static std::array<os::TaskNotifier, Usart::__ENUM__SIZE> DmaTransferCompleteNotifiers;
+    static std::array<os::TaskNotifier, Usart::__ENUM__SIZE> DmaReceiveCompleteNotifiers;
+
+    static constexpr const size_t TX_QUEUE_LENGTH = 8;
+    using TxQueue = DmaTxQueue<Dma, TX_QUEUE_LENGTH>;
+    static std::array<TxQueue, Usart::__ENUM__SIZE> TxQueues;
 
     friend class Factory<UsartWithDma>;
     friend struct Dma;
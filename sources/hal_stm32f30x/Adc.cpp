@@ -21,14 +21,14 @@ extern "C" void ADC1_2_IRQHandler(void)
     constexpr auto& adc1 = Factory<Adc>::get<Adc::Description::PMD_ADC1>();
 
     if (ADC_GetITStatus(adc1.getBasePointer(), ADC_FLAG_EOC) == SET) {
-        Adc::ConversionCompleteSemaphores[static_cast<size_t>(adc1.mDescription)].giveFromISR();
+        Adc::ConversionCompleteNotifiers[static_cast<size_t>(adc1.mDescription)].notifyFromISR();
         ADC_ClearITPendingBit(adc1.getBasePointer(), ADC_FLAG_EOC);
     }
 
     constexpr auto& adc2 = Factory<Adc>::get<Adc::Description::PMD_ADC2>();
 
     if (ADC_GetITStatus(adc2.getBasePointer(), ADC_FLAG_EOC) == SET) {
-        Adc::ConversionCompleteSemaphores[static_cast<size_t>(adc2.mDescription)].giveFromISR();
+        Adc::ConversionCompleteNotifiers[static_cast<size_t>(adc2.mDescription)].notifyFromISR();
         ADC_ClearITPendingBit(adc2.getBasePointer(), ADC_FLAG_EOC);
     }
 }
@@ -38,7 +38,7 @@ extern "C" void ADC3_IRQHandler(void)
     constexpr auto& adc = Factory<Adc>::get<Adc::Description::PMD_ADC3>();
 
     if (ADC_GetITStatus(adc.getBasePointer(), ADC_FLAG_EOC) == SET) {
-        Adc::ConversionCompleteSemaphores[static_cast<size_t>(adc.mDescription)].giveFromISR();
+        Adc::ConversionCompleteNotifiers[static_cast<size_t>(adc.mDescription)].notifyFromISR();
         ADC_ClearITPendingBit(adc.getBasePointer(), ADC_FLAG_EOC);
     }
 }
@@ -48,7 +48,7 @@ extern "C" void ADC4_IRQHandler(void)
     constexpr auto& adc = Factory<Adc>::get<Adc::Description::PMD_ADC4>();
 
     if (ADC_GetITStatus(adc.getBasePointer(), ADC_FLAG_EOC) == SET) {
-        Adc::ConversionCompleteSemaphores[static_cast<size_t>(adc.mDescription)].giveFromISR();
+        Adc::ConversionCompleteNotifiers[static_cast<size_t>(adc.mDescription)].notifyFromISR();
         ADC_ClearITPendingBit(adc.getBasePointer(), ADC_FLAG_EOC);
     }
 }
@@ -109,8 +109,9 @@ uint32_t Adc::getValue(const Adc::Channel& channel) const
 
     ADC_RegularChannelConfig(ADCx, channel.mChannel, channel.mRank, channel.mSampleTime);
 
+    ConversionCompleteNotifiers[static_cast<size_t>(mDescription)].prepare();
     ADC_StartConversion(ADCx);
-    ConversionCompleteSemaphores[static_cast<size_t>(mDescription)].take();
+    ConversionCompleteNotifiers[static_cast<size_t>(mDescription)].wait();
 
     uint32_t returnValue = ADC_GetConversionValue(ADCx);
 
@@ -144,6 +145,6 @@ void Adc::stopConversion(void) const
 }
 
 std::array<uint32_t, Adc::Description::__ENUM__SIZE> Adc::CalibrationValues;
-std::array<os::Semaphore, Adc::Description::__ENUM__SIZE> Adc::ConversionCompleteSemaphores;
+std::array<os::TaskNotifier, Adc::Description::__ENUM__SIZE> Adc::ConversionCompleteNotifiers;
 std::array<os::Mutex, Adc::Description::__ENUM__SIZE> Adc::ConverterAvailableMutex;
 constexpr std::array<const Adc, Adc::Description::__ENUM__SIZE> Factory<Adc>::Container;
@@ -13,7 +13,7 @@
 #include "stm32f30x_adc.h"
 #include "stm32f30x_rcc.h"
 #include "Mutex.h"
-#include "Semaphore.h"
+#include "TaskNotifier.h"
 #include "hal_Factory.h"
 
 extern "C" void ADC1_2_IRQHandler(void);
@@ -63,7 +63,7 @@ private:
     void stopConversion(void) const;
 
     static std::array<uint32_t, Description::__ENUM__SIZE> CalibrationValues;
-    static std::array<os::Semaphore, Description::__ENUM__SIZE> ConversionCompleteSemaphores;
+    static std::array<os::TaskNotifier, Description::__ENUM__SIZE> ConversionCompleteNotifiers;
     static std::array<os::Mutex, Description::__ENUM__SIZE> ConverterAvailableMutex;
     static constexpr uint8_t TWO_CONVERSION_SAMPLE_DELAY = 0;
     static constexpr uint32_t INTERRUPT_PRIORITY = 0xa;
@@ -38,7 +38,19 @@ void AdcWithDma::startConversion(uint16_t const* const data, const size_t length
 }
 
 void AdcWithDma::startConversion(uint16_t const* const data, const size_t length,
-                                 std::function<void(void)> callBack) const
+                                 os::TaskNotifier* dataAvailableNotifier) const
+{
+    mDma.setupTransfer(reinterpret_cast<uint8_t const* const>(data), length, true);
+    if (dataAvailableNotifier != nullptr) {
+        mDma.registerInterruptNotifier(dataAvailableNotifier, Dma::TC);
+    }
+
+    mDma.enable();
+    mAdcChannel.startConversion();
+}
+
+void AdcWithDma::startConversion(uint16_t const* const data, const size_t length,
+                                 util::InplaceFunction<void(void)> callBack) const
 {
     mDma.setupTransfer(reinterpret_cast<uint8_t const* const>(data), length, true);
     mDma.registerInterruptCallback(callBack, Dma::TC);
@@ -11,6 +11,7 @@
 #include "Dma.h"
 #include "AdcChannel.h"
 #include "Semaphore.h"
+#include "TaskNotifier.h"
 #include "hal_Factory.h"
 #include "stm32f30x_syscfg.h"
 
@@ -26,11 +27,15 @@ struct AdcWithDma {
     template<size_t n>
     void startConversion(const std::array<uint16_t, n>& data, os::Semaphore* dataAvailable = nullptr) const;
     template<size_t n>
-    void startConversion(const std::array<uint16_t, n>& data, std::function<void(void)> callBack) const;
+    void startConversion(const std::array<uint16_t, n>& data, os::TaskNotifier* dataAvailable) const;
+    template<size_t n>
+    void startConversion(const std::array<uint16_t, n>& data, util::InplaceFunction<void(void)> callBack) const;
     void stopConversion(void) const;
 
     void startConversion(uint16_t const* const data, const size_t length, os::Semaphore* dataAvailableSemaphore) const;
-    void startConversion(uint16_t const* const data, const size_t length, std::function<void(void)> callBack) const;
+    /* the waiting task calls prepare() on the notifier before every wait() */
+    void startConversion(uint16_t const* const data, const size_t length, os::TaskNotifier* dataAvailableNotifier) const;
+    void startConversion(uint16_t const* const data, const size_t length, util::InplaceFunction<void(void)> callBack) const;
 
     float getVoltage(const uint16_t) const;
     float getVoltage(const float) const;
@@ -59,7 +64,13 @@ void AdcWithDma::startConversion(const std::array<uint16_t, n>& data, os::Semaph
 }
 
 template<size_t n>
-void AdcWithDma::startConversion(const std::array<uint16_t, n>& data, std::function<void(void)> callBack) const
+void AdcWithDma::startConversion(const std::array<uint16_t, n>& data, os::TaskNotifier* dataAvailable) const
+{
+    startConversion(data.data(), data.size(), dataAvailable);
+}
+
+template<size_t n>
+void AdcWithDma::startConversion(const std::array<uint16_t, n>& data, util::InplaceFunction<void(void)> callBack) const
 {
     startConversion(data.data(), data.size(), callBack);
 }
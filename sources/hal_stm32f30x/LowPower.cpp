@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include "LowPower.h"
+#include "stm32f30x_exti.h"
+#include "stm32f30x_misc.h"
+#include "stm32f30x_pwr.h"
+#include "stm32f30x_rcc.h"
+#include "stm32f30x_rtc.h"
+#include "DeepSleepInterface.h"
+#include "trace.h"
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+using hal::LowPower;
+using os::TicklessIdle;
+
+void RTC_WKUP_IRQHandler(void)
+{
+    RTC_ClearITPendingBit(RTC_IT_WUT);
+    EXTI_ClearITPendingBit(EXTI_Line20);
+}
+
+void vApplicationSuppressTicksAndSleep(uint32_t xExpectedIdleTime)
+{
+    LowPower::suppressTicksAndSleep(xExpectedIdleTime);
+}
+
+void LowPower::initialize(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    RTC_WakeUpCmd(DISABLE);
+    RTC_WakeUpClockConfig(RTC_WakeUpClock_RTCCLK_Div16);
+    RTC_ITConfig(RTC_IT_WUT, ENABLE);
+
+    EXTI_InitTypeDef exti {EXTI_Line20, EXTI_Mode_Interrupt, EXTI_Trigger_Rising, ENABLE};
+    EXTI_Init(&exti);
+
+    NVIC_InitTypeDef nvic {RTC_WKUP_IRQn, 0xf, 0, ENABLE};
+    NVIC_Init(&nvic);
+}
+
+void LowPower::suppressTicksAndSleep(const uint32_t expectedIdleTime)
+{
+    const bool deepSleep = os::DeepSleepController::isInGlobalDeepSleep();
+    const TicklessIdle::TickConverter converter = deepSleep ?
+                                                  TicklessIdle::TickConverter(WAKEUP_TIMER_HZ, WAKEUP_TIMER_MAX_COUNTS) :
+                                                  TicklessIdle::TickConverter(configCPU_CLOCK_HZ, SYSTICK_MAX_COUNTS);
+
+    const uint32_t plannedTicks = TicklessIdle::getSleepTicks(expectedIdleTime, converter.getMaxTicks());
+    if (plannedTicks == 0) {
+        return;
+    }
+
+    /* interrupts still end WFI while they are masked, they run after the tick is restored */
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+    /* a tick that is due already has to be processed first */
+    if ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) ||
+        (eTaskConfirmSleepModeStatus() == eAbortSleep))
+    {
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        __enable_irq();
+        return;
+    }
+
+    const uint32_t countsPerTick = configCPU_CLOCK_HZ / configTICK_RATE_HZ;
+    uint32_t phase = converter.phaseOf(countsPerTick - 1 - SysTick->VAL, countsPerTick);
+
+    uint32_t latencyUs = 0;
+    const uint32_t counts = converter.countsUntil(plannedTicks, phase);
+    const uint32_t elapsed = deepSleep ? stop(counts, latencyUs) : sleep(counts, latencyUs);
+    const uint32_t restartAt = DWT->CYCCNT;
+
+    uint32_t sleptTicks = converter.completedTicks(elapsed, phase);
+
+    SysTick->LOAD = converter.remainingOf(phase, countsPerTick) - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = countsPerTick - 1;
+
+    if (sleptTicks >= plannedTicks) {
+        /* the tick interrupt steps the last tick, so the task waiting for it is unblocked on time */
+        sleptTicks = plannedTicks;
+        vTaskStepTick(plannedTicks - 1);
+        SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+    } else {
+        vTaskStepTick(sleptTicks);
+    }
+
+    latencyUs += cyclesToUs(DWT->CYCCNT - restartAt, SystemCoreClock);
+    __enable_irq();
+
+    TicklessIdle::recordSleep(plannedTicks, sleptTicks, latencyUs);
+}
+
+/* Sleep mode, the SysTick is the wakeup timer */
+uint32_t LowPower::sleep(const uint32_t counts, uint32_t& latencyUs)
+{
+    SysTick->LOAD = counts - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+    __ISB();
+    const uint32_t wokeAt = DWT->CYCCNT;
+
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+    uint32_t elapsed;
+    if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) {
+        /* the tick is accounted for here, not by its interrupt */
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+        elapsed = counts;
+    } else {
+        elapsed = counts - 1 - SysTick->VAL;
+    }
+
+    latencyUs = cyclesToUs(DWT->CYCCNT - wokeAt, SystemCoreClock);
+    return elapsed;
+}
+
+/* STOP mode, the RTC wakeup timer wakes up */
+uint32_t LowPower::stop(const uint32_t counts, uint32_t& latencyUs)
+{
+    const uint32_t calendarStart = getCalendarCounts();
+
+    RTC_WakeUpCmd(DISABLE);
+    RTC_SetWakeUpCounter(counts - 1);
+    RTC_ClearFlag(RTC_FLAG_WUTF);
+    EXTI_ClearITPendingBit(EXTI_Line20);
+    RTC_WakeUpCmd(ENABLE);
+
+    PWR_EnterSTOPMode(PWR_Regulator_LowPower, PWR_STOPEntry_WFI);
+    const uint32_t wokeAt = DWT->CYCCNT;
+
+    /* the core runs from HSI until the PLL is selected again */
+    restoreSystemClock();
+    const uint32_t restoredAt = DWT->CYCCNT;
+
+    const bool completed = RTC_GetFlagStatus(RTC_FLAG_WUTF) == SET;
+    RTC_WakeUpCmd(DISABLE);
+
+    uint32_t elapsed = counts;
+    if (!completed) {
+        /* another interrupt ended STOP, the wakeup timer can't be read so
+         * the calendar tells how long it was, much coarser */
+        RTC_WaitForSynchro();
+        const uint32_t countsPerHour = 3600 * ((RTC->PRER & RTC_PRER_PREDIV_S) + 1);
+        const uint64_t calendarElapsed = (getCalendarCounts() + countsPerHour - calendarStart) % countsPerHour;
+        const uint32_t prescaler = ((RTC->PRER & RTC_PRER_PREDIV_A) >> 16) + 1;
+        elapsed = std::min<uint64_t>(calendarElapsed * prescaler * WAKEUP_TIMER_HZ / LSE_VALUE, counts - 1);
+    }
+
+    latencyUs = cyclesToUs(restoredAt - wokeAt, HSI_VALUE) + cyclesToUs(DWT->CYCCNT - restoredAt, SystemCoreClock);
+    return elapsed;
+}
+
+/* RTCCLK / (PREDIV_A + 1) counts since the start of the hour */
+uint32_t LowPower::getCalendarCounts(void)
+{
+    /* reading SSR locks TR until DR is read */
+    const uint32_t ssr = RTC->SSR;
+    const uint32_t tr = RTC->TR;
+    (void)RTC->DR;
+
+    const uint32_t minutes = ((tr & RTC_TR_MNT) >> 12) * 10 + ((tr & RTC_TR_MNU) >> 8);
+    const uint32_t seconds = ((tr & RTC_TR_ST) >> 4) * 10 + (tr & RTC_TR_SU);
+    const uint32_t synchronousPrescaler = RTC->PRER & RTC_PRER_PREDIV_S;
+
+    return (minutes * 60 + seconds) * (synchronousPrescaler + 1) + synchronousPrescaler - ssr;
+}
+
+void LowPower::restoreSystemClock(void)
+{
+    RCC_HSEConfig(RCC_HSE_ON);
+    while (RCC_GetFlagStatus(RCC_FLAG_HSERDY) == RESET) {}
+
+    RCC_PLLCmd(ENABLE);
+    while (RCC_GetFlagStatus(RCC_FLAG_PLLRDY) == RESET) {}
+
+    RCC_SYSCLKConfig(RCC_SYSCLKSource_PLLCLK);
+    while (RCC_GetSYSCLKSource() != 0x08) {}
+}
+
+uint32_t LowPower::cyclesToUs(const uint32_t cycles, const uint32_t clock)
+{
+    return static_cast<uint64_t>(cycles) * 1000000 / clock;
+}
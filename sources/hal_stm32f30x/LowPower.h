@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#ifndef SOURCES_PMD_LOWPOWER_H_
+#define SOURCES_PMD_LOWPOWER_H_
+
+#include <cstdint>
+#include "stm32f30x.h"
+#include "TicklessIdle.h"
+
+extern "C" {
+void RTC_WKUP_IRQHandler(void);
+void vApplicationSuppressTicksAndSleep(uint32_t xExpectedIdleTime);
+}
+
+namespace hal
+{
+/*
+ * Tickless idle of the STM32F30x, FreeRTOS calls suppressTicksAndSleep()
+ * from the idle task if configUSE_TICKLESS_IDLE is set.
+ *
+ * Usually the cpu sleeps in Sleep mode and the SysTick, reloaded with the
+ * whole sleep, wakes it up. All peripherals keep running, every interrupt
+ * ends the sleep early. While the DeepSleepModules are in global deep sleep
+ * the cpu enters STOP mode instead and the RTC wakeup timer wakes it up.
+ * The system clock is restored from HSE and PLL afterwards.
+ *
+ * The wakeup latency is the time from leaving WFI until the kernel tick runs
+ * again and interrupts are enabled. It is measured with the DWT cycle counter.
+ */
+struct LowPower {
+    LowPower() = delete;
+    LowPower(const LowPower&) = delete;
+    LowPower(LowPower&&) = delete;
+    LowPower& operator=(const LowPower&) = delete;
+    LowPower& operator=(LowPower&&) = delete;
+
+    /* the system rtc has to be initialized before */
+    static void initialize(void);
+    static void suppressTicksAndSleep(const uint32_t expectedIdleTime);
+
+private:
+    /* the wakeup timer counts RTCCLK / 16 */
+    static constexpr uint32_t WAKEUP_TIMER_HZ = LSE_VALUE / 16;
+    static constexpr uint32_t WAKEUP_TIMER_MAX_COUNTS = 0x10000;
+    static constexpr uint32_t SYSTICK_MAX_COUNTS = 0x1000000;
+
+    static uint32_t sleep(const uint32_t counts, uint32_t& latencyUs);
+    static uint32_t stop(const uint32_t counts, uint32_t& latencyUs);
+    static uint32_t getCalendarCounts(void);
+    static void restoreSystemClock(void);
+    static uint32_t cyclesToUs(const uint32_t cycles, const uint32_t clock);
+};
+}
+
+#endif /* SOURCES_PMD_LOWPOWER_H_ */
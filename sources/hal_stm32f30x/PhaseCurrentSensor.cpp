@@ -55,7 +55,7 @@ void PhaseCurrentSensor::setNumberOfMeasurementsForPhaseCurrentValue(uint32_t va
     mAdcWithDma.startConversion(
                                 MeasurementValueBuffer[mDescription].data(), mNumberOfMeasurementsForPhaseCurrentValue,
                                 [&] {
-        this->updateCurrentValue();
+        this->conversionComplete();
     });
 }
 
@@ -64,6 +64,30 @@ size_t PhaseCurrentSensor::getNumberOfMeasurementsForPhaseCurrentValue(void) con
     return mNumberOfMeasurementsForPhaseCurrentValue;
 }
 
+/*
+ * DMA transfer complete interrupt. With a work queue the filter runs in its
+ * worker while the circular DMA already refills the buffer, so a few samples
+ * may stem from the next period. The low pass does not care. If the queue is
+ * full the round is dropped and counted as overflow of the queue.
+ */
+void PhaseCurrentSensor::conversionComplete(void) const
+{
+    if (mWorkQueue) {
+        mWorkQueue->postFromISR(os::WorkQueue::HIGH, [this](uint32_t) {
+            this->updateCurrentValue();
+            if (mValueAvailableSemaphore) {
+                mValueAvailableSemaphore->give();
+            }
+        });
+        return;
+    }
+
+    updateCurrentValue();
+    if (mValueAvailableSemaphore) {
+        mValueAvailableSemaphore->giveFromISR();
+    }
+}
+
 void PhaseCurrentSensor::updateCurrentValue(void) const
 {
     auto& array = MeasurementValueBuffer[mDescription];
@@ -72,10 +96,6 @@ void PhaseCurrentSensor::updateCurrentValue(void) const
         mPhaseCurrentValue -= mPhaseCurrentValue / FILTERWIDTH;
         mPhaseCurrentValue += static_cast<float>(array[i]) / FILTERWIDTH;
     }
-
-    if (mValueAvailableSemaphore) {
-        mValueAvailableSemaphore->giveFromISR();
-    }
 }
 
 void PhaseCurrentSensor::registerValueAvailableSemaphore(os::Semaphore* valueAvailable) const
@@ -88,10 +108,20 @@ void PhaseCurrentSensor::unregisterValueAvailableSemaphore(void) const
     mValueAvailableSemaphore = nullptr;
 }
 
+void PhaseCurrentSensor::registerWorkQueue(os::WorkQueue* workQueue) const
+{
+    mWorkQueue = workQueue;
+}
+
+void PhaseCurrentSensor::unregisterWorkQueue(void) const
+{
+    mWorkQueue = nullptr;
+}
+
 void PhaseCurrentSensor::enable(void) const
 {
     mAdcWithDma.startConversion(MeasurementValueBuffer[mDescription], [&] {
-        this->updateCurrentValue();
+        this->conversionComplete();
     });
 }
 
@@ -12,6 +12,7 @@
 #include "stm32f30x_syscfg.h"
 #include "TimHalfBridge.h"
 #include "AdcWithDma.h"
+#include "WorkQueue.h"
 
 namespace hal
 {
@@ -28,6 +29,9 @@ struct PhaseCurrentSensor {
     float getCurrentVoltage(void) const;
     void registerValueAvailableSemaphore(os::Semaphore* valueAvailable) const;
     void unregisterValueAvailableSemaphore(void) const;
+    /* filters the samples in a worker of the queue instead of the DMA interrupt */
+    void registerWorkQueue(os::WorkQueue* workQueue) const;
+    void unregisterWorkQueue(void) const;
     void calibrate(void) const;
     void reset(void) const;
     void setPulsWidthForTriggerPerMill(uint32_t) const;
@@ -43,6 +47,7 @@ private:
                                  const TIM_OCInitTypeDef& adcTrgoConf) :
         mDescription(desc), mHBridge(hBridge), mAdcWithDma(adc), mAdcTrgoConfiguration(adcTrgoConf){}
 
+    void conversionComplete(void) const;
     void updateCurrentValue(void) const;
     void initialize(void) const;
 
@@ -56,6 +61,7 @@ private:
     mutable size_t mNumberOfMeasurementsForPhaseCurrentValue = MAX_NUMBER_OF_MEASUREMENTS;
 
     mutable os::Semaphore* mValueAvailableSemaphore = nullptr;
+    mutable os::WorkQueue* mWorkQueue = nullptr;
 
     friend class Factory<PhaseCurrentSensor>;
 
@@ -13,7 +13,7 @@ using hal::Factory;
 using hal::Spi;
 using hal::SpiWithDma;
 
-std::array<os::Semaphore, Spi::__ENUM__SIZE> SpiWithDma::DmaTransferCompleteSemaphores;
+std::array<os::TaskNotifier, Spi::__ENUM__SIZE> SpiWithDma::DmaTransferCompleteNotifiers;
 
 void SpiWithDma::initialize() const
 {
@@ -22,23 +22,19 @@ void SpiWithDma::initialize() const
     }
     SPI_I2S_DMACmd(reinterpret_cast<SPI_TypeDef*>(mSpi->mPeripherie), mDmaCmd, ENABLE);
 
-    if (!DmaTransferCompleteSemaphores[(size_t)mSpi->mDescription]) {
-        Trace(ZONE_ERROR, "Semaphore allocation failed/r/n");
-    } else {
-        registerInterruptCallbacks();
-    }
+    registerInterruptCallbacks();
 }
 
 void SpiWithDma::registerInterruptCallbacks(void) const
 {
     if (mTxDma) {
-        mTxDma->registerInterruptSemaphore(&DmaTransferCompleteSemaphores.at(mSpi->mDescription),
-                                           Dma::InterruptSource::TC);
+        mTxDma->registerInterruptNotifier(&DmaTransferCompleteNotifiers.at(mSpi->mDescription),
+                                          Dma::InterruptSource::TC);
     }
 
     if (mRxDma) {
-        mRxDma->registerInterruptSemaphore(&DmaTransferCompleteSemaphores.at(mSpi->mDescription),
-                                           Dma::InterruptSource::TC);
+        mRxDma->registerInterruptNotifier(&DmaTransferCompleteNotifiers.at(mSpi->mDescription),
+                                          Dma::InterruptSource::TC);
     }
 }
 
@@ -51,13 +47,12 @@ size_t SpiWithDma::send(uint8_t const* const data, const size_t length) const
     if (mTxDma && (mDmaCmd & SPI_I2S_DMAReq_Tx)
         && (length > MIN_LENGTH_FOR_DMA_TRANSFER))
     {
-        // clear Semaphore
-        DmaTransferCompleteSemaphores.at(mSpi->mDescription).take(std::chrono::microseconds(1));
+        DmaTransferCompleteNotifiers.at(mSpi->mDescription).prepare();
         // we have DMA support
         mTxDma->setupTransfer((uint8_t* const)data, length);
         mTxDma->enable();
 
-        DmaTransferCompleteSemaphores.at(mSpi->mDescription).take();
+        DmaTransferCompleteNotifiers.at(mSpi->mDescription).wait();
 
         mTxDma->disable();
         return length;
@@ -82,7 +77,8 @@ size_t SpiWithDma::receive(uint8_t* const data, const size_t length) const
     {
         // we have DMA support
         // disable TX interrupt to avoid two callback calls
-        mTxDma->unregisterInterruptSemaphore(Dma::InterruptSource::TC);
+        mTxDma->unregisterInterruptNotifier(Dma::InterruptSource::TC);
+        DmaTransferCompleteNotifiers.at(mSpi->mDescription).prepare();
 
         mRxDma->setupTransfer((uint8_t* const)data, length);
         const uint8_t dummy = 0xff;
@@ -91,7 +87,7 @@ size_t SpiWithDma::receive(uint8_t* const data, const size_t length) const
         mRxDma->enable();
         mTxDma->enable();
 
-        DmaTransferCompleteSemaphores.at(mSpi->mDescription).take();
+        DmaTransferCompleteNotifiers.at(mSpi->mDescription).wait();
 
         mTxDma->disable();
         mRxDma->disable();
@@ -10,7 +10,7 @@
 #include <array>
 #include "Dma.h"
 #include "Spi.h"
-#include "Semaphore.h"
+#include "TaskNotifier.h"
 #include "hal_Factory.h"
 
 namespace hal
@@ -50,7 +50,7 @@ private:
     bool isReadyToReceive(void) const;
 
     static constexpr const size_t MIN_LENGTH_FOR_DMA_TRANSFER = 2;
-    static std::array<os::Semaphore, Spi::__ENUM__SIZE> DmaTransferCompleteSemaphores;
+    static std::array<os::TaskNotifier, Spi::__ENUM__SIZE> DmaTransferCompleteNotifiers;
 
     friend class Factory<SpiWithDma>;
     friend class Dma;
@@ -128,7 +128,7 @@ uint32_t HallDecoder::getCurrentHallState(void) const
     }
 }
 
-void HallDecoder::registerCommutationCallback(std::function<void(void)> callback) const
+void HallDecoder::registerCommutationCallback(util::InplaceFunction<void(void)> callback) const
 {
     CommutationCallbacks[mDescription] = callback;
 }
@@ -138,7 +138,7 @@ void HallDecoder::unregisterCommutationCallback(void) const
     registerCommutationCallback([] {});
 }
 
-void HallDecoder::registerHallEventCheckCallback(std::function<void(void)> callback) const
+void HallDecoder::registerHallEventCheckCallback(util::InplaceFunction<void(void)> callback) const
 {
     HallEventCallbacks[mDescription] = callback;
 }
@@ -197,5 +197,5 @@ void HallDecoder::initialize(void) const
 
 constexpr const std::array<const HallDecoder,
                            HallDecoder::Description::__ENUM__SIZE> Factory<HallDecoder>::Container;
-std::array<std::function<void(void)>, HallDecoder::Description::__ENUM__SIZE> HallDecoder::CommutationCallbacks;
-std::array<std::function<void(void)>, HallDecoder::Description::__ENUM__SIZE> HallDecoder::HallEventCallbacks;
+std::array<util::InplaceFunction<void(void)>, HallDecoder::Description::__ENUM__SIZE> HallDecoder::CommutationCallbacks;
+std::array<util::InplaceFunction<void(void)>, HallDecoder::Description::__ENUM__SIZE> HallDecoder::HallEventCallbacks;
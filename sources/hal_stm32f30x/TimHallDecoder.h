@@ -11,7 +11,7 @@
 #include "hal_Factory.h"
 #include "dev_Factory.h"
 #include "Tim.h"
-#include <functional>
+#include "InplaceFunction.h"
 
 extern "C" {
 void TIM3_IRQHandler(void);
@@ -59,10 +59,10 @@ private:
     void interruptHandler(void) const;
     void saveTimestamp(const uint32_t) const;
 
-    void registerCommutationCallback(std::function<void(void)> ) const;
+    void registerCommutationCallback(util::InplaceFunction<void(void)> ) const;
     void unregisterCommutationCallback(void) const;
 
-    void registerHallEventCheckCallback(std::function<void(void)> ) const;
+    void registerHallEventCheckCallback(util::InplaceFunction<void(void)> ) const;
     void unregisterHallEventCheckCallback(void) const;
 
     static const size_t NUMBER_OF_TIMESTAMPS = 10;
@@ -70,8 +70,8 @@ private:
     mutable std::array<uint32_t, NUMBER_OF_TIMESTAMPS> mTimestamps = {};
     mutable size_t mTimestampPosition = 0;
 
-    static std::array<std::function<void(void)>, Description::__ENUM__SIZE> CommutationCallbacks;
-    static std::array<std::function<void(void)>, Description::__ENUM__SIZE> HallEventCallbacks;
+    static std::array<util::InplaceFunction<void(void)>, Description::__ENUM__SIZE> CommutationCallbacks;
+    static std::array<util::InplaceFunction<void(void)>, Description::__ENUM__SIZE> HallEventCallbacks;
 
     friend class Factory<HallDecoder>;
     friend struct dev::SensorBLDC;
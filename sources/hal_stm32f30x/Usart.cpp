@@ -125,7 +125,7 @@ void Usart::setBaudRate(const size_t baudRate) const
     USART_Cmd(reinterpret_cast<USART_TypeDef*>(mPeripherie), ENABLE);
 }
 
-void Usart::enableReceiveTimeout(std::function<void(void)> callback, const size_t bitsUntilTimeout) const
+void Usart::enableReceiveTimeout(util::InplaceFunction<void(void)> callback, const size_t bitsUntilTimeout) const
 {
     ReceiveTimeoutInterruptCallbacks[mDescription] = callback;
 
@@ -134,7 +134,7 @@ void Usart::enableReceiveTimeout(std::function<void(void)> callback, const size_
     enableReceiveTimeoutIT_Flag();
 }
 
-void Usart::enableNonBlockingReceive(std::function<void(uint8_t)> callback) const
+void Usart::enableNonBlockingReceive(util::InplaceFunction<void(uint8_t)> callback) const
 {
     ReceiveInterruptCallbacks[mDescription] = callback;
 
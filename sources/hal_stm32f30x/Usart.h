@@ -9,7 +9,7 @@
 #include <cstdint>
 #include <limits>
 #include <array>
-#include <functional>
+#include "InplaceFunction.h"
 #include "stm32f30x_usart.h"
 #include "stm32f30x_rcc.h"
 #include "hal_Factory.h"
@@ -64,8 +64,8 @@ struct Usart {
 
     void setBaudRate(const size_t) const;
 
-    void enableReceiveTimeout(std::function<void(void)> callback, const size_t) const;
-    void enableNonBlockingReceive(std::function<void(uint8_t)> callback) const;
+    void enableReceiveTimeout(util::InplaceFunction<void(void)> callback, const size_t) const;
+    void enableNonBlockingReceive(util::InplaceFunction<void(uint8_t)> callback) const;
 
     void disableReceiveTimeout(void) const;
     void disableNonBlockingReceive(void) const;
@@ -91,8 +91,8 @@ private:
     void initialize(void) const;
     IRQn getIRQn(void) const;
 
-    using ReceiveCallbackArray = std::array<std::function<void (uint8_t)>, Usart::__ENUM__SIZE>;
-    using ReceiveTimeoutCallbackArray = std::array<std::function<void (void)>, Usart::__ENUM__SIZE>;
+    using ReceiveCallbackArray = std::array<util::InplaceFunction<void (uint8_t)>, Usart::__ENUM__SIZE>;
+    using ReceiveTimeoutCallbackArray = std::array<util::InplaceFunction<void (void)>, Usart::__ENUM__SIZE>;
 
     static ReceiveTimeoutCallbackArray ReceiveTimeoutInterruptCallbacks;
     static ReceiveCallbackArray ReceiveInterruptCallbacks;
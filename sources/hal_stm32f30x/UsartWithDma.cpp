@@ -5,6 +5,7 @@
 
 #include "UsartWithDma.h"
 #include "trace.h"
+#include "os_Task.h"
 
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
@@ -13,8 +14,11 @@ using hal::Factory;
 using hal::Usart;
 using hal::UsartWithDma;
 
-std::array<os::Semaphore, Usart::__ENUM__SIZE> UsartWithDma::DmaTransferCompleteSemaphores;
-std::array<os::Semaphore, Usart::__ENUM__SIZE> UsartWithDma::DmaReceiveCompleteSemaphores;
+std::array<os::TaskNotifier, Usart::__ENUM__SIZE> UsartWithDma::DmaTransferCompleteNotifiers;
+std::array<os::TaskNotifier, Usart::__ENUM__SIZE> UsartWithDma::DmaReceiveCompleteNotifiers;
+std::array<UsartWithDma::TxQueue, Usart::__ENUM__SIZE> UsartWithDma::TxQueues;
+std::array<util::InplaceFunction<void(const size_t)>, Usart::__ENUM__SIZE> UsartWithDma::ContinuousReceiveCallbacks;
+std::array<size_t, Usart::__ENUM__SIZE> UsartWithDma::ContinuousReceiveLengths;
 
 void UsartWithDma::initialize() const
 {
@@ -27,36 +31,30 @@ void UsartWithDma::initialize() const
     }
     USART_DMACmd(reinterpret_cast<USART_TypeDef*>(mUsart.mPeripherie), mDmaCmd, ENABLE);
 
-    if (!DmaTransferCompleteSemaphores[static_cast<size_t>(mUsart.mDescription)] ||
-        !DmaReceiveCompleteSemaphores[static_cast<size_t>(mUsart.mDescription)])
-    {
-        Trace(ZONE_ERROR, "Semaphore allocation failed/r/n");
-    } else {
-        registerInterruptSemaphores();
-    }
+    registerInterruptNotifiers();
 }
 
-void UsartWithDma::registerInterruptSemaphores(void) const
+void UsartWithDma::registerInterruptNotifiers(void) const
 {
     if ((mTxDma != nullptr)) {
-        mTxDma->registerInterruptSemaphore(&DmaTransferCompleteSemaphores.at(mUsart.mDescription),
-                                           Dma::InterruptSource::TC);
+        mTxDma->registerInterruptNotifier(&DmaTransferCompleteNotifiers.at(mUsart.mDescription),
+                                          Dma::InterruptSource::TC);
     }
 
     if ((mRxDma != nullptr)) {
-        mRxDma->registerInterruptSemaphore(&DmaReceiveCompleteSemaphores.at(mUsart.mDescription),
-                                           Dma::InterruptSource::TC);
+        mRxDma->registerInterruptNotifier(&DmaReceiveCompleteNotifiers.at(mUsart.mDescription),
+                                          Dma::InterruptSource::TC);
     }
 }
 
-void UsartWithDma::registerTransferCompleteCallback(std::function<void(void)> f) const
+void UsartWithDma::registerTransferCompleteCallback(util::InplaceFunction<void(void)> f) const
 {
     if (mTxDma != nullptr) {
         mTxDma->registerInterruptCallback(f, Dma::InterruptSource::TC);
     }
 }
 
-void UsartWithDma::registerReceiveCompleteCallback(std::function<void(void)> f) const
+void UsartWithDma::registerReceiveCompleteCallback(util::InplaceFunction<void(void)> f) const
 {
     if (mRxDma != nullptr) {
         mRxDma->registerInterruptCallback(f, Dma::InterruptSource::TC);
@@ -70,13 +68,12 @@ size_t UsartWithDma::send(uint8_t const* const data, const size_t length, const
     }
 
     if ((mTxDma != nullptr) && (mDmaCmd & USART_DMAReq_Tx) && (length > MIN_LENGTH_FOR_DMA_TRANSFER)) {
-        // clear Semaphore
-        DmaTransferCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(0));
+        DmaTransferCompleteNotifiers.at(mUsart.mDescription).prepare();
         // we have DMA support
         mTxDma->setupTransfer(data, length);
         mTxDma->enable();
 
-        if (DmaTransferCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(ticksToWait))) {
+        if (DmaTransferCompleteNotifiers.at(mUsart.mDescription).wait(std::chrono::milliseconds(ticksToWait))) {
             mTxDma->disable();
             return length;
         } else {
@@ -90,7 +87,7 @@ size_t UsartWithDma::send(uint8_t const* const data, const size_t length, const
 
 void UsartWithDma::receiveTimeoutCallback(void) const
 {
-    DmaReceiveCompleteSemaphores.at(mUsart.mDescription).giveFromISR();
+    DmaReceiveCompleteNotifiers.at(mUsart.mDescription).notifyFromISR();
 }
 
 void UsartWithDma::enableReceiveTimeout(const size_t bitsUntilTimeout) const
@@ -107,6 +104,66 @@ void UsartWithDma::disableReceiveTimeout(void) const
     mUsart.disableReceiveTimeout();
 }
 
+void UsartWithDma::continuousReceiveCallback(void) const
+{
+    const size_t length = ContinuousReceiveLengths.at(mUsart.mDescription);
+
+    if (mUsart.hasOverRunError()) {
+        mUsart.clearOverRunError();
+    }
+
+    if ((length != 0) && ContinuousReceiveCallbacks.at(mUsart.mDescription)) {
+        const size_t writeIndex = (length - mRxDma->getCurrentDataCounter()) % length;
+        ContinuousReceiveCallbacks.at(mUsart.mDescription)(writeIndex);
+    }
+}
+
+void UsartWithDma::enableContinuousReceive(uint8_t* const                            ring,
+                                           const size_t                              length,
+                                           util::InplaceFunction<void(const size_t)> writeIndexCallback,
+                                           const size_t                              bitsUntilTimeout) const
+{
+    if ((ring == nullptr) || (length == 0) || (mRxDma == nullptr) || !(mDmaCmd & USART_DMAReq_Rx)) {
+        return;
+    }
+
+    ContinuousReceiveLengths.at(mUsart.mDescription) = length;
+    ContinuousReceiveCallbacks.at(mUsart.mDescription) = writeIndexCallback;
+
+    const auto publish = [this] {
+                             continuousReceiveCallback();
+                         };
+
+    mRxDma->unregisterInterruptNotifier(Dma::InterruptSource::TC);
+    if (!mRxDma->registerInterruptCallback(publish, Dma::InterruptSource::HT) ||
+        !mRxDma->registerInterruptCallback(publish, Dma::InterruptSource::TC))
+    {
+        Trace(ZONE_ERROR, "Rx Dma needs HT and TC interrupts for continuous receive\r\n");
+    }
+
+    mRxDma->setupTransfer(ring, length, true);
+    mRxDma->enable();
+
+    mUsart.enableReceiveTimeout(publish, bitsUntilTimeout);
+}
+
+void UsartWithDma::disableContinuousReceive(void) const
+{
+    if (mRxDma == nullptr) {
+        return;
+    }
+
+    mUsart.disableReceiveTimeout();
+    mRxDma->disable();
+    mRxDma->unregisterInterruptCallback(Dma::InterruptSource::HT);
+    mRxDma->unregisterInterruptCallback(Dma::InterruptSource::TC);
+
+    ContinuousReceiveCallbacks.at(mUsart.mDescription) = nullptr;
+    ContinuousReceiveLengths.at(mUsart.mDescription) = 0;
+
+    registerInterruptNotifiers();
+}
+
 size_t UsartWithDma::receiveWithTimeout(uint8_t* const data, const size_t length, const uint32_t ticksToWait) const
 {
     /* Timeout is used to detect the end of a block of data */
@@ -128,13 +185,12 @@ size_t UsartWithDma::receive(uint8_t* const data, const size_t length, const uin
     }
 
     if ((mRxDma != nullptr) && (mDmaCmd & USART_DMAReq_Rx) && (length > MIN_LENGTH_FOR_DMA_TRANSFER)) {
-        // clear Semaphore
-        DmaReceiveCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(0));
+        DmaReceiveCompleteNotifiers.at(mUsart.mDescription).prepare();
         // we have DMA support
         mRxDma->setupTransfer(data, length);
         mRxDma->enable();
 
-        DmaReceiveCompleteSemaphores.at(mUsart.mDescription).take(std::chrono::milliseconds(ticksToWait));
+        DmaReceiveCompleteNotifiers.at(mUsart.mDescription).wait(std::chrono::milliseconds(ticksToWait));
 
         mRxDma->disable();
         return length - mRxDma->getCurrentDataCounter();
@@ -173,6 +229,35 @@ void UsartWithDma::receiveNonBlocking(uint8_t const* const data, const size_t le
     }
 }
 
+bool UsartWithDma::sendQueued(uint8_t const* const              data,
+                              const size_t                      length,
+                              util::InplaceFunction<void(void)> completion) const
+{
+    const bool dmaSupport = (mTxDma != nullptr) && (mDmaCmd & USART_DMAReq_Tx);
+
+    if (!dmaSupport || (data == nullptr)) {
+        return false;
+    }
+
+    TxQueue& queue = TxQueues.at(mUsart.mDescription);
+
+    os::ThisTask::enterCriticalSection();
+    if (!queue.isActive()) {
+        mTxDma->registerInterruptCallback([this] {
+            TxQueues.at(mUsart.mDescription).onTransferComplete(*mTxDma);
+        }, Dma::InterruptSource::TC);
+    }
+    const bool retVal = queue.enqueue(*mTxDma, data, length, completion);
+    os::ThisTask::exitCriticalSection();
+
+    return retVal;
+}
+
+size_t UsartWithDma::getTxQueueSpacesAvailable(void) const
+{
+    return TxQueues.at(mUsart.mDescription).spacesAvailable();
+}
+
 void UsartWithDma::stopNonBlockingSend(void) const
 {
     if (mTxDma != nullptr) {
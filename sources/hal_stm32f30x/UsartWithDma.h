@@ -10,7 +10,8 @@
 #include <array>
 #include "Dma.h"
 #include "Usart.h"
-#include "Semaphore.h"
+#include "TaskNotifier.h"
+#include "DmaTxQueue.h"
 #include "hal_Factory.h"
 
 namespace hal
@@ -41,15 +42,30 @@ struct UsartWithDma {
     void sendNonBlocking(uint8_t const* const, const size_t, const bool repeat) const;
     void receiveNonBlocking(uint8_t const* const, const size_t, const bool repeat) const;
 
+    /* Queues data for transmission without blocking. The transfer complete
+     * interrupt chains the queued transfers and calls completion from ISR
+     * context. Returns false if the queue is full. Don't mix with send(). */
+    bool sendQueued(uint8_t const* const, const size_t, util::InplaceFunction<void(void)> completion = nullptr) const;
+    size_t getTxQueueSpacesAvailable(void) const;
+
     void stopNonBlockingSend(void) const;
     void stopNonBlockingReceive(void) const;
 
-    void registerTransferCompleteCallback(std::function<void(void)> ) const;
-    void registerReceiveCompleteCallback(std::function<void(void)> ) const;
+    void registerTransferCompleteCallback(util::InplaceFunction<void(void)> ) const;
+    void registerReceiveCompleteCallback(util::InplaceFunction<void(void)> ) const;
 
     void enableReceiveTimeout(const size_t bitsUntilTimeout) const;
     void disableReceiveTimeout(void) const;
 
+    /* Runs the Rx Dma in circular mode over ring. HT, TC and the receive timeout
+     * interrupt report the current write index to writeIndexCallback. The Rx Dma
+     * has to be configured with DMA_IT_HT | DMA_IT_TC. */
+    void enableContinuousReceive(uint8_t* const                            ring,
+                                 const size_t                              length,
+                                 util::InplaceFunction<void(const size_t)> writeIndexCallback,
+                                 const size_t                              bitsUntilTimeout) const;
+    void disableContinuousReceive(void) const;
+
     const Usart& mUsart;
 
 private:
@@ -65,12 +81,19 @@ private:
     Dma const* const mRxDma;
 
     void initialize(void) const;
-    void registerInterruptSemaphores(void) const;
+    void registerInterruptNotifiers(void) const;
     void receiveTimeoutCallback(void) const;
+    void continuousReceiveCallback(void) const;
 
     static constexpr const size_t MIN_LENGTH_FOR_DMA_TRANSFER = 0;
-    static std::array<os::Semaphore, Usart::__ENUM__SIZE> DmaTransferCompleteSemaphores;
-    static std::array<os::Semaphore, Usart::__ENUM__SIZE> DmaReceiveCompleteSemaphores;
+    static std::array<os::TaskNotifier, Usart::__ENUM__SIZE> DmaTransferCompleteNotifiers;
+    static std::array<os::TaskNotifier, Usart::__ENUM__SIZE> DmaReceiveCompleteNotifiers;
+
+    static constexpr const size_t TX_QUEUE_LENGTH = 8;
+    using TxQueue = DmaTxQueue<Dma, TX_QUEUE_LENGTH>;
+    static std::array<TxQueue, Usart::__ENUM__SIZE> TxQueues;
+    static std::array<util::InplaceFunction<void(const size_t)>, Usart::__ENUM__SIZE> ContinuousReceiveCallbacks;
+    static std::array<size_t, Usart::__ENUM__SIZE> ContinuousReceiveLengths;
 
     friend class Factory<UsartWithDma>;
     friend struct Dma;
@@ -3,14 +3,17 @@
  * Copyright (c) 2014-2018 Nils Weiss
  */
 
+#include <algorithm>
 #include "DeepSleepInterface.h"
 #include "trace.h"
 
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
+using os::DeepSleepController;
 using os::DeepSleepModule;
 
 std::vector<DeepSleepModule*> os::DeepSleepModule::Modules;
+bool DeepSleepController::InGlobalDeepSleep = false;
 
 DeepSleepModule::DeepSleepModule(void)
 {
@@ -26,3 +29,13 @@ DeepSleepModule::~DeepSleepModule(void)
         }
     }
 }
+
+uint32_t DeepSleepController::getTicksUntilNextDeadline(void)
+{
+    uint32_t ticks = std::numeric_limits<uint32_t>::max();
+
+    for (const DeepSleepModule* module : DeepSleepModule::Modules) {
+        ticks = std::min(ticks, module->getTicksUntilNextDeadline());
+    }
+    return ticks;
+}
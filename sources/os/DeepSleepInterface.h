@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 
 namespace os
@@ -27,11 +29,17 @@ protected:
     virtual void enterDeepSleep(void) {while (true) {}}
     virtual void exitDeepSleep(void) {while (true) {}}
 
+    /* Ticks until the module needs the cpu for something the kernel doesn't
+     * know about, e.g. polling hardware. Tickless idle never sleeps longer. */
+    virtual uint32_t getTicksUntilNextDeadline(void) const {return std::numeric_limits<uint32_t>::max(); }
+
     friend class DeepSleepController;
 };
 
 class DeepSleepController
 {
+    static bool InGlobalDeepSleep;
+
 public:
     static void enterGlobalDeepSleep(void)
     {
@@ -40,14 +48,21 @@ public:
         {
             module->enterDeepSleep();
         }
+        InGlobalDeepSleep = true;
     }
     static void exitGlobalDeepSleep(void)
     {
+        InGlobalDeepSleep = false;
         for (DeepSleepModule* module :
              DeepSleepModule::Modules)
         {
             module->exitDeepSleep();
         }
     }
+
+    /* all modules stopped their peripherals, tickless idle may stop the clocks */
+    static bool isInGlobalDeepSleep(void) {return InGlobalDeepSleep; }
+
+    static uint32_t getTicksUntilNextDeadline(void);
 };
 }
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "EventGroup.h"
+#include "os_Task.h"
+
+using os::EventGroup;
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+EventGroup::EventGroup(void) :
+    mEventGroupHandle(xEventGroupCreateStatic(&mEventGroupBuffer))
+{}
+#else
+EventGroup::EventGroup(void) :
+    mEventGroupHandle(xEventGroupCreate())
+{}
+
+EventGroup::EventGroup(EventGroup&& rhs) :
+    mEventGroupHandle(rhs.mEventGroupHandle)
+{
+    rhs.mEventGroupHandle = nullptr;
+}
+
+EventGroup& EventGroup::operator=(EventGroup&& rhs)
+{
+    if (this == &rhs) {
+        return *this;
+    }
+    if (*this) {
+        vEventGroupDelete(mEventGroupHandle);
+    }
+    mEventGroupHandle = rhs.mEventGroupHandle;
+    rhs.mEventGroupHandle = nullptr;
+    return *this;
+}
+#endif
+
+EventGroup::~EventGroup(void)
+{
+    if (*this) {
+        vEventGroupDelete(mEventGroupHandle);
+    }
+}
+
+EventBits_t EventGroup::set(const EventBits_t bits) const
+{
+    return *this ? xEventGroupSetBits(mEventGroupHandle, bits) : 0;
+}
+
+EventBits_t EventGroup::clear(const EventBits_t bits) const
+{
+    return *this ? xEventGroupClearBits(mEventGroupHandle, bits) : 0;
+}
+
+EventBits_t EventGroup::get(void) const
+{
+    return *this ? xEventGroupGetBits(mEventGroupHandle) : 0;
+}
+
+EventBits_t EventGroup::getFromISR(void) const
+{
+    return *this ? xEventGroupGetBitsFromISR(mEventGroupHandle) : 0;
+}
+
+#if (configUSE_TIMERS == 1) && (INCLUDE_xTimerPendFunctionCall == 1)
+bool EventGroup::setFromISR(const EventBits_t bits) const
+{
+    BaseType_t highPriorityTaskWoken = 0;
+    bool retVal = *this ? xEventGroupSetBitsFromISR(mEventGroupHandle, bits, &highPriorityTaskWoken) : false;
+    if (highPriorityTaskWoken) {
+        ThisTask::yield();
+    }
+    return retVal;
+}
+#endif
+
+EventBits_t EventGroup::wait(const EventBits_t bits, const bool waitForAll, const uint32_t ticksToWait) const
+{
+    return *this ? xEventGroupWaitBits(mEventGroupHandle, bits, pdTRUE, waitForAll, ticksToWait) : 0;
+}
+
+EventGroup::operator bool() const
+{
+    return mEventGroupHandle != nullptr;
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include "FreeRTOS.h"
+#include "event_groups.h"
+#include <chrono>
+
+namespace os
+{
+/*
+ * Lets one task block on several sources at once. Every producer (stream
+ * buffer or queue writer, URC handler, interrupt) sets its own bit after it
+ * queued its data, the consumer blocks in waitAny() until one of its bits is
+ * set or the timeout expires. Bits stay set until they are consumed, so an
+ * event raised while the consumer is busy is not lost.
+ */
+class EventGroup
+{
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    StaticEventGroup_t mEventGroupBuffer;
+#endif
+    EventGroupHandle_t mEventGroupHandle = nullptr;
+
+    EventBits_t wait(const EventBits_t bits, const bool waitForAll, const uint32_t ticksToWait) const;
+
+public:
+    /* with 32 bit ticks the kernel reserves the upper 8 bits */
+    static constexpr const size_t NUMBER_OF_BITS = configUSE_16_BIT_TICKS ? 8 : 24;
+
+    EventGroup(void);
+    EventGroup(const EventGroup&) = delete;
+    EventGroup& operator=(const EventGroup&) = delete;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    EventGroup(EventGroup&&) = delete;
+    EventGroup& operator=(EventGroup&&) = delete;
+#else
+    EventGroup(EventGroup&&);
+    EventGroup& operator=(EventGroup&&);
+#endif
+    ~EventGroup(void);
+
+    EventBits_t set(const EventBits_t bits) const;
+    EventBits_t clear(const EventBits_t bits) const;
+    EventBits_t get(void) const;
+    EventBits_t getFromISR(void) const;
+#if (configUSE_TIMERS == 1) && (INCLUDE_xTimerPendFunctionCall == 1)
+    /* deferred to the timer task by the kernel */
+    bool setFromISR(const EventBits_t bits) const;
+#endif
+
+    /* returns the bits of the group when it woke up, consumed bits are cleared */
+    template<class rep, class period>
+    inline EventBits_t waitAny(const EventBits_t bits, const std::chrono::duration<rep, period>& d) const
+    {
+        return wait(bits, false, std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS);
+    }
+    inline EventBits_t waitAny(const EventBits_t bits) const {return wait(bits, false, portMAX_DELAY); }
+
+    template<class rep, class period>
+    inline EventBits_t waitAll(const EventBits_t bits, const std::chrono::duration<rep, period>& d) const
+    {
+        return wait(bits, true, std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS);
+    }
+    inline EventBits_t waitAll(const EventBits_t bits) const {return wait(bits, true, portMAX_DELAY); }
+
+    operator bool() const;
+};
+}
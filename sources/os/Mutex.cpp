@@ -7,6 +7,11 @@
 
 using os::Mutex;
 
+#if configSUPPORT_STATIC_ALLOCATION == 1
+Mutex::Mutex(void) :
+    mMutexHandle(xSemaphoreCreateMutexStatic(&mMutexBuffer))
+{}
+#else
 Mutex::Mutex(void) :
     mMutexHandle(xSemaphoreCreateMutex())
 {}
@@ -23,6 +28,7 @@ Mutex& Mutex::operator=(Mutex&& rhs)
     rhs.mMutexHandle = nullptr;
     return *this;
 }
+#endif
 
 Mutex::~Mutex(void)
 {
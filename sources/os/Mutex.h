@@ -12,14 +12,22 @@ namespace os
 {
 class Mutex
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    StaticSemaphore_t mMutexBuffer;
+#endif
     SemaphoreHandle_t mMutexHandle = nullptr;
 
 public:
     Mutex(void);
     Mutex(const Mutex&) = delete;
-    Mutex(Mutex&&);
     Mutex& operator=(const Mutex&) = delete;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    Mutex(Mutex&&) = delete;
+    Mutex& operator=(Mutex&&) = delete;
+#else
+    Mutex(Mutex&&);
     Mutex& operator=(Mutex&&);
+#endif
     ~Mutex(void);
 
     bool take(uint32_t ticksToWait = portMAX_DELAY) const;
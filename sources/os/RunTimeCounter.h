@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace os
+{
+/*
+ * Run time stats counter made of a free running 32 bit hardware counter
+ * divided by 2^shift. The division alone would wrap at 2^(32 - shift), but
+ * FreeRTOS and os::Telemetry take the run time deltas modulo 2^32. So the
+ * wraps of the hardware counter are counted into the upper bits.
+ *
+ * sample() has to see the hardware counter at least once per wrap, the tick
+ * hook calls it. get() may be called from tasks and interrupts of a lower
+ * priority than the caller of sample(), it retries if a sample came in
+ * between.
+ */
+template<uint8_t shift>
+class RunTimeCounter
+{
+    static_assert((shift > 0) && (shift < 32), "RunTimeCounter needs a shift of 1 to 31");
+
+    volatile uint32_t mLast = 0;
+    volatile uint32_t mWraps = 0;
+
+public:
+    void sample(const uint32_t hardwareCounter)
+    {
+        if (hardwareCounter < mLast) {
+            mWraps = mWraps + 1;
+        }
+        mLast = hardwareCounter;
+    }
+
+    /* read returns the hardware counter */
+    template<typename Read>
+    uint32_t get(const Read& read) const
+    {
+        uint32_t wraps;
+        uint32_t last;
+        uint32_t hardwareCounter;
+        do {
+            wraps = mWraps;
+            last = mLast;
+            hardwareCounter = read();
+        } while ((wraps != mWraps) || (last != mLast));
+
+        // wrapped since the last sample
+        if (hardwareCounter < last) {
+            wraps++;
+        }
+        return (wraps << (32 - shift)) | (hardwareCounter >> shift);
+    }
+};
+}
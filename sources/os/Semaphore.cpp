@@ -8,6 +8,11 @@
 
 using os::Semaphore;
 
+#if configSUPPORT_STATIC_ALLOCATION == 1
+Semaphore::Semaphore(void) :
+    mSemaphoreHandle(xSemaphoreCreateBinaryStatic(&mSemaphoreBuffer))
+{}
+#else
 Semaphore::Semaphore(void) :
     mSemaphoreHandle(xSemaphoreCreateBinary())
 {}
@@ -24,6 +29,7 @@ Semaphore& Semaphore::operator=(Semaphore&& rhs)
     rhs.mSemaphoreHandle = nullptr;
     return *this;
 }
+#endif
 
 Semaphore::~Semaphore(void)
 {
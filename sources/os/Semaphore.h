@@ -13,15 +13,23 @@ namespace os
 {
 class Semaphore
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    StaticSemaphore_t mSemaphoreBuffer;
+#endif
     SemaphoreHandle_t mSemaphoreHandle = nullptr;
     bool take(const uint32_t ticksToWait) const;
 
 public:
     Semaphore(void);
     Semaphore(const Semaphore&) = delete;
-    Semaphore(Semaphore&&);
     Semaphore& operator=(const Semaphore&) = delete;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    Semaphore(Semaphore&&) = delete;
+    Semaphore& operator=(Semaphore&&) = delete;
+#else
+    Semaphore(Semaphore&&);
     Semaphore& operator=(Semaphore&&);
+#endif
     ~Semaphore(void);
 
     inline bool take(void) const {return this->take(portMAX_DELAY); }
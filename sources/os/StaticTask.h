@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <array>
+#include "os_Task.h"
+#include "TaskEndless.h"
+
+namespace os
+{
+/*
+ * Stack and control block of a task, placed in .bss together with the object
+ * owning the task. Without configSUPPORT_STATIC_ALLOCATION the storage is
+ * empty and the task is created from the FreeRTOS heap as before.
+ */
+template<size_t stackSize>
+struct TaskStorage {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    std::array<StackType_t, Task::STACKSIZE_IN_BYTE(stackSize)> mStack;
+    StaticTask_t mTaskBuffer;
+
+    StackType_t* stack(void) {return mStack.data(); }
+    StaticTask_t* taskBuffer(void) {return &mTaskBuffer; }
+#else
+    StackType_t* stack(void) {return nullptr; }
+    StaticTask_t* taskBuffer(void) {return nullptr; }
+#endif
+};
+
+template<size_t stackSize, typename TaskType = TaskEndless>
+class StaticTask :
+    private TaskStorage<stackSize>, public TaskType
+{
+public:
+    StaticTask(char const* const name, const os::Task::Priority priority,
+               const std::function<void(const bool&)> function) :
+        TaskType(name, stackSize, priority, function,
+                 TaskStorage<stackSize>::stack(), TaskStorage<stackSize>::taskBuffer()) {}
+
+    StaticTask(const StaticTask&) = delete;
+    StaticTask(StaticTask&&) = delete;
+    StaticTask& operator=(const StaticTask&) = delete;
+    StaticTask& operator=(StaticTask&&) = delete;
+};
+}
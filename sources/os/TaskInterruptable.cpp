@@ -13,18 +13,31 @@ using os::TaskInterruptable;
 TaskInterruptable::TaskInterruptable(char const* const                      name,
                                      const uint16_t                         stackSize,
                                      const os::Task::Priority               priority,
-                                     const std::function<void(const bool&)> function) :
+                                     const std::function<void(const bool&)> function,
+                                     StackType_t* const                     stack,
+                                     StaticTask_t* const                    taskBuffer) :
     Task(name, stackSize, priority,
-         function),
+         function, stack, taskBuffer),
     mJoinFlag(false)
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    this->mJoinSemaphore = xSemaphoreCreateBinaryStatic(&this->mJoinSemaphoreBuffer);
+#else
     vSemaphoreCreateBinary(this->mJoinSemaphore);
+#endif
     xSemaphoreTake(this->mJoinSemaphore, 0);
+#if defined(portHOST_POSIX)
+    Task::resumeAll();
+#endif
 }
 
 TaskInterruptable::~TaskInterruptable(void)
 {
-    this->Task::~Task();
+    // the task has to be gone before its join semaphore, ~Task runs too late for that
+    if (this->mHandle) {
+        vTaskDelete(this->mHandle);
+        this->mHandle = nullptr;
+    }
     vSemaphoreDelete(this->mJoinSemaphore);
 }
 
@@ -33,7 +46,8 @@ void TaskInterruptable::taskFunction(void)
     while (true) {
         mTaskFunction(mJoinFlag);
         xSemaphoreGive(this->mJoinSemaphore);
-        this->suspend();
+        // the joining task may destroy this object as soon as the semaphore is given
+        vTaskSuspend(nullptr);
     }
 }
 
@@ -10,15 +10,34 @@
 
 namespace os
 {
+/*
+ * On the host port every task is a thread that starts running at once. There
+ * the scheduler is suspended before the Task base creates the task and the
+ * TaskInterruptable constructor resumes it once the object is complete, so the
+ * new task never calls taskFunction() on a half constructed object.
+ */
+struct TaskConstructionGuard {
+    TaskConstructionGuard(void)
+    {
+#if defined(portHOST_POSIX)
+        Task::suspendAll();
+#endif
+    }
+};
+
 class TaskInterruptable :
-    public Task
+    private TaskConstructionGuard, public Task
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    StaticSemaphore_t mJoinSemaphoreBuffer;
+#endif
     xSemaphoreHandle mJoinSemaphore;
     bool mJoinFlag;
 
 public:
     TaskInterruptable(char const* const name, const uint16_t stackSize, const os::Task::Priority priority,
-                      const std::function<void(const bool&)> function);
+                      const std::function<void(const bool&)> function,
+                      StackType_t* const stack = nullptr, StaticTask_t* const taskBuffer = nullptr);
     virtual ~TaskInterruptable(void) override;
     using Task::Task;
 
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "TaskNotifier.h"
+#include "os_Task.h"
+
+using os::TaskNotifier;
+
+void TaskNotifier::prepare(void)
+{
+    ulTaskNotifyTake(pdTRUE, 0);
+    mWaitingTask = xTaskGetCurrentTaskHandle();
+}
+
+bool TaskNotifier::wait(const uint32_t ticksToWait)
+{
+    if (ulTaskNotifyTake(pdTRUE, ticksToWait) != 0) {
+        return true;
+    }
+
+    // timed out, a late notify() must not reach this task once it waits for something else
+    ThisTask::enterCriticalSection();
+    const bool notified = mWaitingTask == nullptr;
+    mWaitingTask = nullptr;
+    ThisTask::exitCriticalSection();
+
+    // the notification raced the timeout, take it
+    return notified && (ulTaskNotifyTake(pdTRUE, 0) != 0);
+}
+
+bool TaskNotifier::notify(void)
+{
+    // notify inside the critical section, a timed out wait() has to see either
+    // the registered task or the notification already given
+    ThisTask::enterCriticalSection();
+    const TaskHandle_t task = mWaitingTask;
+    mWaitingTask = nullptr;
+    const bool retVal = task ? xTaskNotify(task, 0, eIncrement) == pdPASS : false;
+    ThisTask::exitCriticalSection();
+
+    return retVal;
+}
+
+bool TaskNotifier::notifyFromISR(void)
+{
+    BaseType_t highPriorityTaskWoken = 0;
+
+    const UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    const TaskHandle_t task = mWaitingTask;
+    mWaitingTask = nullptr;
+    const bool retVal = task ? xTaskNotifyFromISR(task, 0, eIncrement, &highPriorityTaskWoken) == pdPASS : false;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    if (highPriorityTaskWoken) {
+        ThisTask::yield();
+    }
+    return retVal;
+}
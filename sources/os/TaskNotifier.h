@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include <chrono>
+
+namespace os
+{
+/*
+ * Signals completion of an operation directly to the one task waiting for it,
+ * through the notification value of that task. Unlike a binary semaphore it
+ * needs no kernel object, only the handle of the waiting task, and waking the
+ * task skips the queue code of the kernel.
+ *
+ * The waiting task calls prepare() before it starts the operation and wait()
+ * afterwards. Only the first notify() after prepare() reaches the task, and
+ * none after wait() timed out. The notification value is shared with
+ * everything else waiting on notifications of that task, e.g. the consumer of
+ * an SpscRing, so a task must not wait for both at the same time.
+ */
+class TaskNotifier
+{
+    volatile TaskHandle_t mWaitingTask = nullptr;
+
+    bool wait(const uint32_t ticksToWait);
+
+public:
+    TaskNotifier(void) = default;
+    TaskNotifier(const TaskNotifier&) = delete;
+    TaskNotifier(TaskNotifier&&) = delete;
+    TaskNotifier& operator=(const TaskNotifier&) = delete;
+    TaskNotifier& operator=(TaskNotifier&&) = delete;
+
+    /* registers the calling task and drops a stale notification */
+    void prepare(void);
+
+    inline bool wait(void) {return this->wait(portMAX_DELAY); }
+
+    template<class rep, class period>
+    inline bool wait(const std::chrono::duration<rep, period>& d)
+    {
+        return wait(std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS);
+    }
+
+    bool notify(void);
+    bool notifyFromISR(void);
+};
+}
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "Telemetry.h"
+#include "trace.h"
+
+using os::Telemetry;
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+Telemetry::Telemetry(Publisher                       publisher,
+                     const std::chrono::milliseconds interval,
+                     const Mode                      mode) :
+    mPublisher(publisher),
+    mMode(mode),
+    mInterval(interval),
+    mTask(TASK_NAME,
+          os::Task::Priority::LOWEST,
+          [&](const bool& join)
+{
+    taskFunction(join);
+}) {}
+
+bool Telemetry::watch(char const* const name, FillLevel fillLevel, const size_t capacity)
+{
+    if (mNumberOfWatches == MAX_WATCHES) {
+        Trace(ZONE_ERROR, "Too many telemetry watches\r\n");
+        return false;
+    }
+
+    os::ThisTask::enterCriticalSection();
+    mWatches[mNumberOfWatches] = Watch {name, fillLevel, capacity};
+    mNumberOfWatches++;
+    os::ThisTask::exitCriticalSection();
+    return true;
+}
+
+uint32_t Telemetry::lastRunTimeOf(const UBaseType_t number) const
+{
+    for (const auto& runTime : mLastRunTime) {
+        if (runTime.number == number) {
+            return runTime.counter;
+        }
+    }
+    return 0;
+}
+
+size_t Telemetry::sample(uint8_t* const buffer, const size_t length)
+{
+    if (length < sizeof(RecordHeader)) {
+        return 0;
+    }
+
+    uint32_t totalRunTime = 0;
+    const UBaseType_t numberOfTasks = std::min<UBaseType_t>(
+        uxTaskGetSystemState(mTaskStatus.data(), mTaskStatus.size(), &totalRunTime),
+        (length - sizeof(RecordHeader)) / sizeof(TaskRecord));
+    const uint32_t elapsed = totalRunTime - mLastTotalRunTime;
+    mLastTotalRunTime = totalRunTime;
+
+    const uint32_t heapFree = xPortGetFreeHeapSize();
+    mHeapMinimumFree = std::min(mHeapMinimumFree, heapFree);
+
+    uint8_t* p = buffer + sizeof(RecordHeader);
+    std::array<RunTime, MAX_TASKS> runTimes {};
+
+    for (size_t i = 0; i < numberOfTasks; i++) {
+        const TaskStatus_t& status = mTaskStatus[i];
+        const uint32_t busy = status.ulRunTimeCounter - lastRunTimeOf(status.xTaskNumber);
+        TaskRecord task {};
+
+        task.number = static_cast<uint8_t>(status.xTaskNumber);
+        task.state = static_cast<uint8_t>(status.eCurrentState);
+        task.priority = static_cast<uint8_t>(status.uxCurrentPriority);
+        task.cpuPermille = elapsed ? static_cast<uint16_t>((uint64_t(busy) * 1000) / elapsed) : 0;
+        task.stackHighWaterBytes = static_cast<uint16_t>(status.usStackHighWaterMark * sizeof(StackType_t));
+        std::strncpy(task.name, status.pcTaskName, sizeof(task.name));
+
+        std::memcpy(p, &task, sizeof(task));
+        p += sizeof(task);
+        runTimes[i] = RunTime {status.xTaskNumber, status.ulRunTimeCounter};
+
+        if (std::strcmp(status.pcTaskName, TASK_NAME) == 0) {
+            mTelemetryPermille = task.cpuPermille;
+        }
+    }
+    mLastRunTime = runTimes;
+
+    if ((mMode == Mode::LOW_OVERHEAD) && (mTelemetryPermille > LOW_OVERHEAD_PERMILLE)) {
+        mInterval *= 2;
+        Trace(ZONE_INFO, "Telemetry interval raised to %d ms\r\n", static_cast<int>(mInterval.count()));
+    }
+
+    const size_t numberOfWatches = std::min(mNumberOfWatches,
+                                            (length - (p - buffer)) / sizeof(WatchRecord));
+    for (size_t i = 0; i < numberOfWatches; i++) {
+        const Watch& watched = mWatches[i];
+        WatchRecord watch {};
+
+        watch.fillLevel = static_cast<uint16_t>(watched.fillLevel ? watched.fillLevel() : 0);
+        watch.capacity = static_cast<uint16_t>(watched.capacity);
+        std::strncpy(watch.name, watched.name, sizeof(watch.name));
+
+        std::memcpy(p, &watch, sizeof(watch));
+        p += sizeof(watch);
+    }
+
+    const RecordHeader header {
+        MAGIC,
+        VERSION,
+        static_cast<uint16_t>(p - buffer),
+        os::Task::getTickCount(),
+        heapFree,
+        mHeapMinimumFree,
+        static_cast<uint8_t>(numberOfTasks),
+        static_cast<uint8_t>(numberOfWatches),
+        mTelemetryPermille
+    };
+    std::memcpy(buffer, &header, sizeof(header));
+    return header.length;
+}
+
+void Telemetry::taskFunction(const bool& join)
+{
+    do {
+        os::ThisTask::sleep(mInterval);
+
+        const size_t length = sample(mRecord.data(), mRecord.size());
+        if (mPublisher) {
+            mPublisher(mRecord.data(), length);
+        }
+    } while (!join);
+}
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <chrono>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "TaskInterruptable.h"
+#include "StaticTask.h"
+#include "InplaceFunction.h"
+
+namespace os
+{
+/*
+ * Periodically samples per task CPU load and stack high-water mark, the free
+ * heap and registered fill levels (queues, stream buffers), and publishes them
+ * as one binary record. utilities/telemetryDecoder.py decodes the records.
+ *
+ * Needs configUSE_TRACE_FACILITY and configGENERATE_RUN_TIME_STATS, the
+ * projects enable both with TELEMETRY=1.
+ *
+ * The load of the telemetry task itself is reported in the header. In
+ * LOW_OVERHEAD mode the interval doubles whenever it exceeds 1%.
+ */
+class Telemetry final
+{
+public:
+    static constexpr const size_t MAX_TASKS = 16;
+    static constexpr const size_t MAX_WATCHES = 8;
+    static constexpr const size_t NAME_LENGTH = 8;
+    static constexpr const uint8_t MAGIC = 0x54;
+    static constexpr const uint8_t VERSION = 1;
+    static constexpr const uint16_t LOW_OVERHEAD_PERMILLE = 10;
+
+    enum class Mode {
+        CONTINUOUS,
+        LOW_OVERHEAD
+    };
+
+    /* all fields little endian */
+    struct __attribute__((packed)) RecordHeader {
+        uint8_t magic;
+        uint8_t version;
+        uint16_t length;
+        uint32_t tick;
+        uint32_t heapFree;
+        uint32_t heapMinimumFree;
+        uint8_t numberOfTasks;
+        uint8_t numberOfWatches;
+        uint16_t telemetryPermille;
+    };
+
+    struct __attribute__((packed)) TaskRecord {
+        uint8_t number;
+        uint8_t state;
+        uint8_t priority;
+        uint8_t reserved;
+        uint16_t cpuPermille;
+        uint16_t stackHighWaterBytes;
+        char name[NAME_LENGTH];
+    };
+
+    struct __attribute__((packed)) WatchRecord {
+        uint16_t fillLevel;
+        uint16_t capacity;
+        char name[NAME_LENGTH];
+    };
+
+    static constexpr const size_t MAX_RECORD_LENGTH = sizeof(RecordHeader) +
+                                                      MAX_TASKS * sizeof(TaskRecord) +
+                                                      MAX_WATCHES * sizeof(WatchRecord);
+
+    using Publisher = util::InplaceFunction<void(uint8_t const*, size_t)>;
+    using FillLevel = util::InplaceFunction<size_t(void)>;
+
+    Telemetry(Publisher                       publisher,
+              const std::chrono::milliseconds interval,
+              const Mode                      mode = Mode::LOW_OVERHEAD);
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry(Telemetry&&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+    Telemetry& operator=(Telemetry&&) = delete;
+
+    bool watch(char const* const name, FillLevel fillLevel, const size_t capacity);
+    size_t sample(uint8_t* const buffer, const size_t length);
+
+    std::chrono::milliseconds getInterval(void) const {return mInterval; }
+
+private:
+    static constexpr const size_t STACKSIZE = 512;
+    static constexpr char const* const TASK_NAME = "Telemetry";
+
+    struct Watch {
+        char const* name;
+        FillLevel fillLevel;
+        size_t capacity;
+    };
+
+    struct RunTime {
+        UBaseType_t number;
+        uint32_t counter;
+    };
+
+    const Publisher mPublisher;
+    const Mode mMode;
+    std::chrono::milliseconds mInterval;
+
+    std::array<TaskStatus_t, MAX_TASKS> mTaskStatus;
+    std::array<RunTime, MAX_TASKS> mLastRunTime {};
+    std::array<Watch, MAX_WATCHES> mWatches {};
+    std::array<uint8_t, MAX_RECORD_LENGTH> mRecord;
+    size_t mNumberOfWatches = 0;
+    uint32_t mLastTotalRunTime = 0;
+    uint32_t mHeapMinimumFree = UINT32_MAX;
+    uint16_t mTelemetryPermille = 0;
+
+    // last member, the task must not start before everything else is constructed
+    os::StaticTask<STACKSIZE, os::TaskInterruptable> mTask;
+
+    void taskFunction(const bool&);
+    uint32_t lastRunTimeOf(const UBaseType_t number) const;
+};
+}
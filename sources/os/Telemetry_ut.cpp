@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "unittest.h"
+#include "Telemetry.h"
+#include "RunTimeCounter.h"
+
+//--------------------------BUFFERS--------------------------
+static std::array<TaskStatus_t, 3> g_tasks {};
+static uint32_t g_totalRunTime = 0;
+static size_t g_freeHeap = 0;
+static uint32_t g_tick = 0;
+
+static void setTask(const size_t i, char const* const name, const UBaseType_t number, const uint32_t runTime)
+{
+    g_tasks[i].pcTaskName = name;
+    g_tasks[i].xTaskNumber = number;
+    g_tasks[i].eCurrentState = eBlocked;
+    g_tasks[i].uxCurrentPriority = number;
+    g_tasks[i].ulRunTimeCounter = runTime;
+    g_tasks[i].usStackHighWaterMark = 10 * number;
+}
+
+template<typename T>
+static T recordAt(const uint8_t* const buffer, const size_t offset)
+{
+    T record;
+    std::memcpy(&record, buffer + offset, sizeof(record));
+    return record;
+}
+
+//--------------------------MOCKING--------------------------
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* const pxTaskStatusArray,
+                                 const UBaseType_t   uxArraySize,
+                                 uint32_t* const     pulTotalRunTime)
+{
+    const UBaseType_t n = std::min<UBaseType_t>(uxArraySize, g_tasks.size());
+    std::copy_n(g_tasks.begin(), n, pxTaskStatusArray);
+    *pulTotalRunTime = g_totalRunTime;
+    return n;
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+    return g_freeHeap;
+}
+
+os::TaskInterruptable::TaskInterruptable(char const* const                      name,
+                                         const uint16_t                         stackSize,
+                                         const os::Task::Priority               priority,
+                                         const std::function<void(const bool&)> function,
+                                         StackType_t* const                     stack,
+                                         StaticTask_t* const                    taskBuffer) :
+    Task(name, stackSize, priority, function, stack, taskBuffer) {}
+os::TaskInterruptable::~TaskInterruptable(void) {}
+void os::TaskInterruptable::taskFunction(void) {}
+os::Task::Task(char const* const                      name,
+               const uint16_t                         stackSize,
+               const os::Task::Priority               priority,
+               const std::function<void(const bool&)> function,
+               StackType_t* const                     stack,
+               StaticTask_t* const                    taskBuffer) {}
+os::Task::~Task(void) {}
+void os::Task::taskFunction(void) {}
+void os::Task::suspendAll(void) {}
+uint32_t os::Task::getTickCount(void) {return g_tick; }
+void os::ThisTask::sleep(const std::chrono::milliseconds ms) {}
+void os::ThisTask::enterCriticalSection(void) {}
+void os::ThisTask::exitCriticalSection(void) {}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_EncodesRecord(void)
+{
+    TestCaseBegin();
+    static os::Telemetry telemetry(nullptr, std::chrono::milliseconds(100), os::Telemetry::Mode::CONTINUOUS);
+    std::array<uint8_t, os::Telemetry::MAX_RECORD_LENGTH> buffer;
+    size_t queueLevel = 3;
+
+    CHECK(telemetry.watch("rxQueue", [&] {return queueLevel; }, 16));
+
+    setTask(0, "IDLE", 1, 0);
+    setTask(1, "Telemetry", 2, 0);
+    setTask(2, "ModemDriverTask", 3, 0);
+    g_freeHeap = 4000;
+    telemetry.sample(buffer.data(), buffer.size());
+
+    // 1000 ticks of run time: idle 700, telemetry 5, modem 295
+    setTask(0, "IDLE", 1, 700);
+    setTask(1, "Telemetry", 2, 5);
+    setTask(2, "ModemDriverTask", 3, 295);
+    g_totalRunTime = 1000;
+    g_freeHeap = 5000;
+    g_tick = 1234;
+    queueLevel = 9;
+    const size_t length = telemetry.sample(buffer.data(), buffer.size());
+
+    using os::Telemetry;
+    CHECK(length == sizeof(Telemetry::RecordHeader) + 3 * sizeof(Telemetry::TaskRecord) +
+          sizeof(Telemetry::WatchRecord));
+
+    const auto header = recordAt<Telemetry::RecordHeader>(buffer.data(), 0);
+    CHECK(header.magic == Telemetry::MAGIC);
+    CHECK(header.version == Telemetry::VERSION);
+    CHECK(header.length == length);
+    CHECK(header.tick == 1234);
+    CHECK(header.heapFree == 5000);
+    CHECK(header.heapMinimumFree == 4000);
+    CHECK(header.numberOfTasks == 3);
+    CHECK(header.numberOfWatches == 1);
+    CHECK(header.telemetryPermille == 5);
+
+    size_t offset = sizeof(Telemetry::RecordHeader);
+    const auto idle = recordAt<Telemetry::TaskRecord>(buffer.data(), offset);
+    CHECK(idle.number == 1);
+    CHECK(idle.cpuPermille == 700);
+    CHECK(idle.stackHighWaterBytes == 10 * sizeof(StackType_t));
+    CHECK(std::strncmp(idle.name, "IDLE", Telemetry::NAME_LENGTH) == 0);
+
+    offset += 2 * sizeof(Telemetry::TaskRecord);
+    const auto modem = recordAt<Telemetry::TaskRecord>(buffer.data(), offset);
+    CHECK(modem.number == 3);
+    CHECK(modem.state == eBlocked);
+    CHECK(modem.cpuPermille == 295);
+    CHECK(std::strncmp(modem.name, "ModemDri", Telemetry::NAME_LENGTH) == 0);
+
+    offset += sizeof(Telemetry::TaskRecord);
+    const auto watch = recordAt<Telemetry::WatchRecord>(buffer.data(), offset);
+    CHECK(watch.fillLevel == 9);
+    CHECK(watch.capacity == 16);
+    CHECK(std::strncmp(watch.name, "rxQueue", Telemetry::NAME_LENGTH) == 0);
+    TestCaseEnd();
+}
+
+int ut_TruncatesToBuffer(void)
+{
+    TestCaseBegin();
+    static os::Telemetry telemetry(nullptr, std::chrono::milliseconds(100));
+    std::array<uint8_t, sizeof(os::Telemetry::RecordHeader) + sizeof(os::Telemetry::TaskRecord)> buffer;
+
+    CHECK(telemetry.watch("rxQueue", [] {return size_t(1); }, 16));
+    CHECK(telemetry.sample(buffer.data(), sizeof(os::Telemetry::RecordHeader) - 1) == 0);
+    CHECK(telemetry.sample(buffer.data(), buffer.size()) == buffer.size());
+
+    const auto header = recordAt<os::Telemetry::RecordHeader>(buffer.data(), 0);
+    CHECK(header.numberOfTasks == 1);
+    CHECK(header.numberOfWatches == 0);
+
+    for (size_t i = 1; i < os::Telemetry::MAX_WATCHES; i++) {
+        CHECK(telemetry.watch("more", nullptr, 1));
+    }
+    CHECK(!telemetry.watch("tooMany", nullptr, 1));
+    TestCaseEnd();
+}
+
+int ut_LowOverheadBacksOff(void)
+{
+    TestCaseBegin();
+    static os::Telemetry telemetry(nullptr, std::chrono::milliseconds(100));
+    std::array<uint8_t, os::Telemetry::MAX_RECORD_LENGTH> buffer;
+
+    setTask(0, "IDLE", 1, 0);
+    setTask(1, "Telemetry", 2, 0);
+    setTask(2, "ModemDriverTask", 3, 0);
+    g_totalRunTime = 0;
+    telemetry.sample(buffer.data(), buffer.size());
+
+    // telemetry at 1% keeps the interval
+    setTask(1, "Telemetry", 2, 10);
+    g_totalRunTime = 1000;
+    telemetry.sample(buffer.data(), buffer.size());
+    CHECK(telemetry.getInterval() == std::chrono::milliseconds(100));
+
+    // telemetry at 2% doubles it
+    setTask(1, "Telemetry", 2, 30);
+    g_totalRunTime = 2000;
+    telemetry.sample(buffer.data(), buffer.size());
+    CHECK(telemetry.getInterval() == std::chrono::milliseconds(200));
+    TestCaseEnd();
+}
+
+int ut_RunTimeCounterWrapsAt32Bit(void)
+{
+    TestCaseBegin();
+    os::RunTimeCounter<6> counter;
+    uint32_t hardware = 0;
+    const auto read = [&hardware] {
+        return hardware;
+    };
+
+    hardware = 0x00001000;
+    counter.sample(hardware);
+    CHECK(counter.get(read) == 0x40);
+
+    // the hardware counter wrapped, the run time counter goes on
+    hardware = 0xFFFFFFC0;
+    counter.sample(hardware);
+    const uint32_t before = counter.get(read);
+    CHECK(before == 0x03FFFFFF);
+    hardware = 0x00000100;
+    CHECK(counter.get(read) == 0x04000004);
+    counter.sample(hardware);
+    CHECK(counter.get(read) - before == 5);
+
+    // all wraps counted, the run time counter wraps at 2^32 like the deltas of FreeRTOS assume
+    for (size_t i = 1; i < 64; i++) {
+        hardware = 0xFFFFFFC0;
+        counter.sample(hardware);
+        hardware = 0x00000100;
+        counter.sample(hardware);
+    }
+    CHECK(counter.get(read) == 0x00000004);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_EncodesRecord);
+    RunTest(true, ut_TruncatesToBuffer);
+    RunTest(true, ut_LowOverheadBacksOff);
+    RunTest(true, ut_RunTimeCounterWrapsAt32Bit);
+    UnitTestMainEnd();
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include "TicklessIdle.h"
+#include "DeepSleepInterface.h"
+#include "os_Task.h"
+
+using os::TicklessIdle;
+
+TicklessIdle::Statistics TicklessIdle::Counters {};
+uint32_t TicklessIdle::StatisticsStart = 0;
+
+uint32_t TicklessIdle::TickConverter::getMaxTicks(void) const
+{
+    return static_cast<uint64_t>(mMaxCounts) * configTICK_RATE_HZ / mCountsPerSecond;
+}
+
+/* both conversions of the tick timer round to nearest, truncating would lose
+ * a bit of time with every sleep */
+uint32_t TicklessIdle::TickConverter::phaseOf(const uint32_t elapsed, const uint32_t countsPerTick) const
+{
+    const uint64_t units = static_cast<uint64_t>(std::min(elapsed, countsPerTick - 1)) * mCountsPerSecond;
+    return std::min<uint64_t>((units + countsPerTick / 2) / countsPerTick, mCountsPerSecond - 1);
+}
+
+uint32_t TicklessIdle::TickConverter::countsUntil(const uint32_t ticks, const uint32_t phase) const
+{
+    const uint64_t units = static_cast<uint64_t>(ticks) * mCountsPerSecond - phase;
+    const uint64_t counts = (units + configTICK_RATE_HZ - 1) / configTICK_RATE_HZ;
+    return std::min<uint64_t>(counts, mMaxCounts);
+}
+
+uint32_t TicklessIdle::TickConverter::completedTicks(const uint32_t counts, uint32_t& phase) const
+{
+    const uint64_t units = static_cast<uint64_t>(counts) * configTICK_RATE_HZ + phase;
+    phase = units % mCountsPerSecond;
+    return units / mCountsPerSecond;
+}
+
+uint32_t TicklessIdle::TickConverter::remainingOf(const uint32_t phase, const uint32_t countsPerTick) const
+{
+    const uint64_t passed = (static_cast<uint64_t>(phase) * countsPerTick + mCountsPerSecond / 2) / mCountsPerSecond;
+    return std::max<uint64_t>(countsPerTick - passed, 1);
+}
+
+uint32_t TicklessIdle::getSleepTicks(const uint32_t expectedIdleTime, const uint32_t maxTicks)
+{
+    const uint32_t ticks = std::min({expectedIdleTime, maxTicks, DeepSleepController::getTicksUntilNextDeadline()});
+    return ticks < configEXPECTED_IDLE_TIME_BEFORE_SLEEP ? 0 : ticks;
+}
+
+void TicklessIdle::recordSleep(const uint32_t plannedTicks, const uint32_t sleptTicks, const uint32_t wakeupLatencyUs)
+{
+    ThisTask::enterCriticalSection();
+    Counters.asleepTicks += sleptTicks;
+    Counters.sleeps++;
+    if (sleptTicks < plannedTicks) {
+        Counters.earlyWakeups++;
+    }
+    Counters.maxWakeupLatencyUs = std::max(Counters.maxWakeupLatencyUs, wakeupLatencyUs);
+    ThisTask::exitCriticalSection();
+}
+
+TicklessIdle::Statistics TicklessIdle::getStatistics(void)
+{
+    ThisTask::enterCriticalSection();
+    Statistics statistics = Counters;
+    statistics.awakeTicks = xTaskGetTickCount() - StatisticsStart - Counters.asleepTicks;
+    ThisTask::exitCriticalSection();
+    return statistics;
+}
+
+void TicklessIdle::resetStatistics(void)
+{
+    ThisTask::enterCriticalSection();
+    Counters = Statistics {};
+    StatisticsStart = xTaskGetTickCount();
+    ThisTask::exitCriticalSection();
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "FreeRTOS.h"
+#include "task.h"
+
+namespace os
+{
+/*
+ * Bookkeeping of tickless idle. With TICKLESS_IDLE the projects route
+ * portSUPPRESS_TICKS_AND_SLEEP to hal::LowPower. It asks getSleepTicks() how
+ * long the cpu may sleep, sleeps with the tick stopped and reports the result
+ * with recordSleep().
+ *
+ * The sleep ends at the earliest of the next task unblock time of the kernel
+ * and the deadlines of the registered DeepSleepModules.
+ */
+class TicklessIdle final
+{
+public:
+    struct Statistics {
+        uint32_t asleepTicks;
+        uint32_t awakeTicks;
+        uint32_t sleeps;
+        uint32_t earlyWakeups;
+        uint32_t maxWakeupLatencyUs;
+    };
+
+    /*
+     * Converts between kernel ticks and the counts of a wakeup timer that keeps
+     * running while the tick is stopped. The position inside the current tick
+     * is kept as phase, in units of 1 / (countsPerSecond * configTICK_RATE_HZ)
+     * seconds: a count is configTICK_RATE_HZ units, a tick countsPerSecond
+     * units. Carrying the phase from the stopped tick into the sleep and back
+     * into the restarted tick keeps rounding from drifting the kernel time.
+     * The wakeup timer has to count at least configTICK_RATE_HZ.
+     */
+    class TickConverter
+    {
+        const uint32_t mCountsPerSecond;
+        const uint32_t mMaxCounts;
+
+    public:
+        constexpr TickConverter(const uint32_t countsPerSecond, const uint32_t maxCounts) :
+            mCountsPerSecond(countsPerSecond), mMaxCounts(maxCounts) {}
+
+        /* the longest sleep the wakeup timer can measure */
+        uint32_t getMaxTicks(void) const;
+
+        /* phase of a tick timer that counted elapsed of countsPerTick */
+        uint32_t phaseOf(const uint32_t elapsed, const uint32_t countsPerTick) const;
+
+        /* counts from phase until ticks ticks are complete, the current one included */
+        uint32_t countsUntil(const uint32_t ticks, const uint32_t phase) const;
+
+        /* complete ticks after counts starting at phase, phase is advanced */
+        uint32_t completedTicks(const uint32_t counts, uint32_t& phase) const;
+
+        /* counts of a tick timer with countsPerTick still left in the tick at phase */
+        uint32_t remainingOf(const uint32_t phase, const uint32_t countsPerTick) const;
+    };
+
+    TicklessIdle(void) = delete;
+    TicklessIdle(const TicklessIdle&) = delete;
+    TicklessIdle(TicklessIdle&&) = delete;
+    TicklessIdle& operator=(const TicklessIdle&) = delete;
+    TicklessIdle& operator=(TicklessIdle&&) = delete;
+
+    /* 0 if a sleep isn't worth it */
+    static uint32_t getSleepTicks(const uint32_t expectedIdleTime, const uint32_t maxTicks);
+    static void recordSleep(const uint32_t plannedTicks, const uint32_t sleptTicks, const uint32_t wakeupLatencyUs);
+
+    static Statistics getStatistics(void);
+    static void resetStatistics(void);
+
+private:
+    static Statistics Counters;
+    static uint32_t StatisticsStart;
+};
+}
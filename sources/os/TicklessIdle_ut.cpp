@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "unittest.h"
+#include "TicklessIdle.h"
+#include "DeepSleepInterface.h"
+#include "os_Task.h"
+
+//--------------------------BUFFERS--------------------------
+static uint32_t g_tick = 0;
+
+struct DeadlineModule : public os::DeepSleepModule {
+    uint32_t mDeadline = std::numeric_limits<uint32_t>::max();
+
+    uint32_t getTicksUntilNextDeadline(void) const override {return mDeadline; }
+};
+
+//--------------------------MOCKING--------------------------
+TickType_t xTaskGetTickCount(void)
+{
+    return g_tick;
+}
+
+void os::ThisTask::enterCriticalSection(void) {}
+void os::ThisTask::exitCriticalSection(void) {}
+
+/*
+ * Runs the kernel through awake phases and sleeps like hal::LowPower does:
+ * the tick timer is stopped at some point of a tick, the wakeup timer sleeps
+ * until planned ticks are complete or is interrupted early, the ticks are
+ * stepped and the tick timer restarts with the rest of the current tick. The
+ * kernel time mustn't drift away from the real time, however many sleeps.
+ */
+static bool simulate(const uint32_t wakeupTimerHz, const uint32_t maxCounts)
+{
+    static constexpr uint32_t TICK_TIMER_HZ = 72000000;
+    static constexpr uint32_t COUNTS_PER_TICK = TICK_TIMER_HZ / configTICK_RATE_HZ;
+    const os::TicklessIdle::TickConverter converter(wakeupTimerHz, maxCounts);
+    const double tolerance = 1.0 / wakeupTimerHz + 2.0 / TICK_TIMER_HZ;
+
+    uint64_t kernelTicks = 0;
+    uint32_t tickTimer = 0;
+    double realTime = 0;
+
+    std::srand(wakeupTimerHz);
+    for (size_t i = 0; i < 20000; i++) {
+        const uint32_t awake = std::rand() % (3 * COUNTS_PER_TICK);
+        tickTimer += awake;
+        kernelTicks += tickTimer / COUNTS_PER_TICK;
+        tickTimer %= COUNTS_PER_TICK;
+        realTime += static_cast<double>(awake) / TICK_TIMER_HZ;
+
+        const uint32_t plannedTicks = 2 + std::rand() % std::min<uint32_t>(converter.getMaxTicks() - 1, 500);
+        uint32_t phase = converter.phaseOf(tickTimer, COUNTS_PER_TICK);
+        const uint32_t counts = converter.countsUntil(plannedTicks, phase);
+        const bool early = std::rand() % 3 == 0;
+        const uint32_t elapsed = early ? std::rand() % counts : counts;
+        realTime += static_cast<double>(elapsed) / wakeupTimerHz;
+
+        const uint32_t ticks = converter.completedTicks(elapsed, phase);
+        if ((ticks > plannedTicks) || (!early && (ticks != plannedTicks))) {
+            return false;
+        }
+        kernelTicks += ticks;
+
+        const uint32_t remaining = converter.remainingOf(phase, COUNTS_PER_TICK);
+        if ((remaining == 0) || (remaining > COUNTS_PER_TICK)) {
+            return false;
+        }
+        tickTimer = COUNTS_PER_TICK - remaining;
+
+        const double kernelTime = static_cast<double>(kernelTicks) / configTICK_RATE_HZ +
+                                  static_cast<double>(tickTimer) / TICK_TIMER_HZ;
+        if (std::fabs(kernelTime - realTime) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_SleepTicksHonourDeadlines(void)
+{
+    TestCaseBegin();
+    using os::TicklessIdle;
+
+    CHECK(TicklessIdle::getSleepTicks(100, 1000) == 100);
+    CHECK(TicklessIdle::getSleepTicks(100, 30) == 30);
+    CHECK(TicklessIdle::getSleepTicks(1, 1000) == 0);
+
+    DeadlineModule balance;
+    DeadlineModule battery;
+    balance.mDeadline = 40;
+    battery.mDeadline = 4;
+    CHECK(TicklessIdle::getSleepTicks(100, 1000) == 4);
+    battery.mDeadline = 1;
+    CHECK(TicklessIdle::getSleepTicks(100, 1000) == 0);
+    TestCaseEnd();
+}
+
+int ut_ConvertsTicks(void)
+{
+    TestCaseBegin();
+    // rtc wakeup timer at 2048 Hz, kernel at 1000 Hz, SysTick 72000 counts per tick
+    const os::TicklessIdle::TickConverter converter(2048, 0x10000);
+    CHECK(converter.getMaxTicks() == 32000);
+
+    // half a tick is gone, 2.5 ticks are 5.12 counts
+    uint32_t phase = converter.phaseOf(36000, 72000);
+    CHECK(phase == 1024);
+    CHECK(converter.countsUntil(3, phase) == 6);
+    CHECK(converter.countsUntil(100000, phase) == 0x10000);
+
+    // 6 counts end 0.43 ticks into the 4th tick
+    CHECK(converter.completedTicks(6, phase) == 3);
+    CHECK(phase == 880);
+    CHECK(converter.remainingOf(phase, 72000) == 41062);
+
+    // an early wakeup after 2 counts, still inside the 2nd tick
+    phase = 1024;
+    CHECK(converter.completedTicks(2, phase) == 1);
+    CHECK(phase == 1024 + 2000 - 2048);
+    TestCaseEnd();
+}
+
+int ut_SimulationDoesNotDrift(void)
+{
+    TestCaseBegin();
+    CHECK(simulate(2048, 0x10000));
+    CHECK(simulate(32768, 0x10000000));
+    CHECK(simulate(72000000, 0x1000000));
+    TestCaseEnd();
+}
+
+int ut_RecordsStatistics(void)
+{
+    TestCaseBegin();
+    using os::TicklessIdle;
+
+    g_tick = 1000;
+    TicklessIdle::resetStatistics();
+    TicklessIdle::recordSleep(10, 10, 12);
+    TicklessIdle::recordSleep(20, 5, 30);
+    g_tick = 1100;
+
+    const TicklessIdle::Statistics statistics = TicklessIdle::getStatistics();
+    CHECK(statistics.asleepTicks == 15);
+    CHECK(statistics.awakeTicks == 85);
+    CHECK(statistics.sleeps == 2);
+    CHECK(statistics.earlyWakeups == 1);
+    CHECK(statistics.maxWakeupLatencyUs == 30);
+
+    TicklessIdle::resetStatistics();
+    CHECK(TicklessIdle::getStatistics().sleeps == 0);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_SleepTicksHonourDeadlines);
+    RunTest(true, ut_ConvertsTicks);
+    RunTest(true, ut_SimulationDoesNotDrift);
+    RunTest(true, ut_RecordsStatistics);
+    UnitTestMainEnd();
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "Timer.h"
+#include "TaskNotifier.h"
+#include "os_Task.h"
+
+using os::Timer;
+
+static_assert(INCLUDE_xTimerPendFunctionCall == 1, "Timer::~Timer pends a function call to the timer task");
+
+static void notifyDeleted(void* notifier, uint32_t)
+{
+    static_cast<os::TaskNotifier*>(notifier)->notify();
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+Timer::Timer(char const* const name, const uint32_t periodInTicks, const Mode mode, Callback callback) :
+    mCallback(callback),
+    mTimerHandle(xTimerCreateStatic(name, periodInTicks, mode == Mode::PERIODIC ? pdTRUE : pdFALSE, this,
+                                    &Timer::callback, &mTimerBuffer))
+{}
+#else
+Timer::Timer(char const* const name, const uint32_t periodInTicks, const Mode mode, Callback callback) :
+    mCallback(callback),
+    mTimerHandle(xTimerCreate(name, periodInTicks, mode == Mode::PERIODIC ? pdTRUE : pdFALSE, this,
+                              &Timer::callback))
+{}
+#endif
+
+Timer::~Timer(void)
+{
+    if (!*this) {
+        return;
+    }
+    xTimerDelete(mTimerHandle, portMAX_DELAY);
+
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        return;
+    }
+    // the timer task works on its queue in order, once it ran notifyDeleted() the
+    // callback of this timer is done and the kernel doesn't touch mTimerBuffer anymore
+    TaskNotifier deleted;
+    deleted.prepare();
+    if (xTimerPendFunctionCall(&notifyDeleted, &deleted, 0, portMAX_DELAY) == pdPASS) {
+        deleted.wait();
+    }
+}
+
+void Timer::callback(TimerHandle_t handle)
+{
+    auto timer = static_cast<Timer*>(pvTimerGetTimerID(handle));
+    if (timer->mCallback) {
+        timer->mCallback();
+    }
+}
+
+bool Timer::start(void) const
+{
+    return *this ? xTimerStart(mTimerHandle, 0) == pdPASS : false;
+}
+
+bool Timer::stop(void) const
+{
+    return *this ? xTimerStop(mTimerHandle, 0) == pdPASS : false;
+}
+
+bool Timer::reset(void) const
+{
+    return *this ? xTimerReset(mTimerHandle, 0) == pdPASS : false;
+}
+
+bool Timer::startFromISR(void) const
+{
+    BaseType_t highPriorityTaskWoken = 0;
+    bool retVal = *this ? xTimerStartFromISR(mTimerHandle, &highPriorityTaskWoken) == pdPASS : false;
+    if (highPriorityTaskWoken) {
+        ThisTask::yield();
+    }
+    return retVal;
+}
+
+bool Timer::stopFromISR(void) const
+{
+    BaseType_t highPriorityTaskWoken = 0;
+    bool retVal = *this ? xTimerStopFromISR(mTimerHandle, &highPriorityTaskWoken) == pdPASS : false;
+    if (highPriorityTaskWoken) {
+        ThisTask::yield();
+    }
+    return retVal;
+}
+
+bool Timer::resetFromISR(void) const
+{
+    BaseType_t highPriorityTaskWoken = 0;
+    bool retVal = *this ? xTimerResetFromISR(mTimerHandle, &highPriorityTaskWoken) == pdPASS : false;
+    if (highPriorityTaskWoken) {
+        ThisTask::yield();
+    }
+    return retVal;
+}
+
+bool Timer::changePeriod(const uint32_t periodInTicks) const
+{
+    return *this ? xTimerChangePeriod(mTimerHandle, periodInTicks, 0) == pdPASS : false;
+}
+
+bool Timer::isActive(void) const
+{
+    return *this ? xTimerIsTimerActive(mTimerHandle) != pdFALSE : false;
+}
+
+Timer::operator bool() const
+{
+    return mTimerHandle != nullptr;
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include "FreeRTOS.h"
+#include "timers.h"
+#include "InplaceFunction.h"
+#include <chrono>
+
+namespace os
+{
+/*
+ * FreeRTOS software timer. All timers share the timer service task, so a
+ * periodic job costs a timer control block instead of a task with its own
+ * stack. The callback runs in the timer service task at
+ * configTIMER_TASK_PRIORITY and must never block.
+ *
+ * Commands are queued to the timer service task without blocking, they fail
+ * if its queue is full. Before the scheduler runs they are kept in the queue
+ * and executed once it starts. Once the scheduler runs, the destructor waits
+ * until the timer service task deleted the timer, so a running callback can't
+ * outlive its Timer. A timer must therefore not be destroyed by a timer
+ * callback. Timers destroyed before the scheduler starts have to be allocated
+ * dynamically, the delete command still touches a static timer buffer.
+ */
+class Timer
+{
+public:
+    using Callback = util::InplaceFunction<void (void)>;
+
+    enum class Mode {
+        ONE_SHOT,
+        PERIODIC
+    };
+
+private:
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    StaticTimer_t mTimerBuffer;
+#endif
+    const Callback mCallback;
+    TimerHandle_t mTimerHandle = nullptr;
+
+    static void callback(TimerHandle_t);
+
+public:
+    template<class rep, class period>
+    Timer(char const* const name, const std::chrono::duration<rep, period>& d, const Mode mode, Callback callback) :
+        Timer(name, std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS, mode,
+              callback) {}
+    Timer(char const* const name, const uint32_t periodInTicks, const Mode mode, Callback callback);
+
+    Timer(const Timer&) = delete;
+    Timer(Timer&&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    Timer& operator=(Timer&&) = delete;
+    ~Timer(void);
+
+    bool start(void) const;
+    bool stop(void) const;
+    bool reset(void) const;
+    bool startFromISR(void) const;
+    bool stopFromISR(void) const;
+    bool resetFromISR(void) const;
+
+    /* also starts a dormant timer */
+    template<class rep, class period>
+    inline bool changePeriod(const std::chrono::duration<rep, period>& d) const
+    {
+        return changePeriod(std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS);
+    }
+    bool changePeriod(const uint32_t periodInTicks) const;
+
+    bool isActive(void) const;
+
+    operator bool() const;
+};
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include "WorkQueue.h"
+#include "trace.h"
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+using os::WorkQueue;
+
+WorkQueue::WorkQueue(Item* const items, const size_t length) :
+    mLength(length),
+    mPending(length * Priority::__ENUM__SIZE, 0)
+{
+    for (size_t i = 0; i < mRings.size(); i++) {
+        mRings[i] = Ring {items + i * length, 0, 0};
+    }
+}
+
+/* both wrap at 2^32, the latency is taken modulo 2^32 */
+uint32_t WorkQueue::timestamp(void)
+{
+#if defined(portGET_CYCLE_COUNTER_VALUE)
+    // not the run time counter, its wraps are counted by the tick hook, which an interrupt may preempt
+    return portGET_CYCLE_COUNTER_VALUE();
+#else
+    return xTaskGetTickCountFromISR();
+#endif
+}
+
+/* has to be called inside a critical section */
+bool WorkQueue::push(const Priority priority, const Function& function, const uint32_t payload)
+{
+    Ring& ring = mRings[priority];
+
+    if (ring.count == mLength) {
+        mStatistics.overflows++;
+        return false;
+    }
+
+    Item& item = ring.items[(ring.head + ring.count) % mLength];
+    item.function = function;
+    item.payload = payload;
+    item.postedAt = timestamp();
+    ring.count++;
+
+    mStatistics.depth++;
+    if (mStatistics.depth > mStatistics.maxDepth) {
+        mStatistics.maxDepth = mStatistics.depth;
+    }
+    return true;
+}
+
+bool WorkQueue::post(const Priority priority, const Function& function, const uint32_t payload)
+{
+    ThisTask::enterCriticalSection();
+    const bool posted = push(priority, function, payload);
+    ThisTask::exitCriticalSection();
+
+    if (!posted) {
+        Trace(ZONE_WARNING, "Work queue full\r\n");
+        return false;
+    }
+    return mPending.give();
+}
+
+bool WorkQueue::postFromISR(const Priority priority, const Function& function, const uint32_t payload)
+{
+    const UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    const bool posted = push(priority, function, payload);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    return posted ? mPending.giveFromISR() : false;
+}
+
+bool WorkQueue::dispatch(const uint32_t ticksToWait)
+{
+    if (!mPending.take(ticksToWait)) {
+        return false;
+    }
+
+    Item item;
+    ThisTask::enterCriticalSection();
+    for (auto& ring : mRings) {
+        if (ring.count) {
+            item = ring.items[ring.head];
+            ring.head = (ring.head + 1) % mLength;
+            ring.count--;
+            break;
+        }
+    }
+    mStatistics.depth--;
+    mStatistics.dispatched++;
+    const uint32_t latency = timestamp() - item.postedAt;
+    if (latency > mStatistics.maxLatency) {
+        mStatistics.maxLatency = latency;
+    }
+    ThisTask::exitCriticalSection();
+
+    if (item.function) {
+        item.function(item.payload);
+    }
+    return true;
+}
+
+WorkQueue::Statistics WorkQueue::getStatistics(void) const
+{
+    ThisTask::enterCriticalSection();
+    const Statistics statistics = mStatistics;
+    ThisTask::exitCriticalSection();
+    return statistics;
+}
+
+void WorkQueue::resetStatistics(void)
+{
+    ThisTask::enterCriticalSection();
+    mStatistics.maxDepth = mStatistics.depth;
+    mStatistics.maxLatency = 0;
+    mStatistics.dispatched = 0;
+    mStatistics.overflows = 0;
+    ThisTask::exitCriticalSection();
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "CountingSemaphore.h"
+#include "InplaceFunction.h"
+
+namespace os
+{
+/*
+ * Deferred interrupt work (bottom halves). An interrupt posts a work item, a
+ * function and a 32 bit payload, and returns. One or more worker tasks call
+ * dispatch() and run the items at task level. Posting copies the item into a
+ * fixed ring, nothing is allocated. Every priority has its own ring, workers
+ * always run the oldest item of the most urgent priority first.
+ *
+ * The dispatch latency is the time from post to start of an item. It is
+ * counted in CPU cycles if the port provides a cycle counter
+ * (portGET_CYCLE_COUNTER_VALUE), in ticks otherwise.
+ */
+class WorkQueue
+{
+public:
+    using Function = util::InplaceFunction<void (uint32_t)>;
+
+    enum Priority {
+        HIGH = 0,
+        LOW,
+        __ENUM__SIZE
+    };
+
+    struct Item {
+        Function function;
+        uint32_t payload;
+        uint32_t postedAt;
+    };
+
+    struct Statistics {
+        size_t depth;
+        size_t maxDepth;
+        uint32_t maxLatency;
+        uint32_t dispatched;
+        uint32_t overflows;
+    };
+
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue(WorkQueue&&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+    WorkQueue& operator=(WorkQueue&&) = delete;
+
+    /* both fail without blocking if the ring of the priority is full */
+    bool post(const Priority priority, const Function& function, const uint32_t payload = 0);
+    bool postFromISR(const Priority priority, const Function& function, const uint32_t payload = 0);
+
+    /* runs at most one item, returns false if nothing was posted until the timeout */
+    template<class rep, class period>
+    inline bool dispatch(const std::chrono::duration<rep, period>& d)
+    {
+        return dispatch(std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS);
+    }
+    bool dispatch(const uint32_t ticksToWait = portMAX_DELAY);
+
+    Statistics getStatistics(void) const;
+    void resetStatistics(void);
+
+protected:
+    WorkQueue(Item* const items, const size_t length);
+    ~WorkQueue(void) = default;
+
+private:
+    struct Ring {
+        Item* items;
+        size_t head;
+        size_t count;
+    };
+
+    const size_t mLength;
+    std::array<Ring, Priority::__ENUM__SIZE> mRings;
+    const CountingSemaphore mPending;
+    Statistics mStatistics {};
+
+    bool push(const Priority priority, const Function& function, const uint32_t payload);
+    static uint32_t timestamp(void);
+};
+
+/*
+ * Work queue with rings of length items per priority, placed together with
+ * the object owning it.
+ */
+template<size_t length>
+struct WorkQueueStorage {
+    std::array<WorkQueue::Item, length * WorkQueue::Priority::__ENUM__SIZE> mItems;
+};
+
+template<size_t length>
+class StaticWorkQueue :
+    private WorkQueueStorage<length>, public WorkQueue
+{
+public:
+    StaticWorkQueue(void) :
+        WorkQueue(WorkQueueStorage<length>::mItems.data(), length) {}
+
+    StaticWorkQueue(const StaticWorkQueue&) = delete;
+    StaticWorkQueue(StaticWorkQueue&&) = delete;
+    StaticWorkQueue& operator=(const StaticWorkQueue&) = delete;
+    StaticWorkQueue& operator=(StaticWorkQueue&&) = delete;
+};
+}
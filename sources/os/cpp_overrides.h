@@ -12,25 +12,61 @@
 #include "SEGGER_RTT.h"
 #endif
 
+#if defined(USE_POOL_ALLOCATOR)
+#include "os_PoolAllocator.h"
+
+// block size and number of blocks per class, can be overridden per project
+#ifndef POOL_ALLOCATOR_SIZE_CLASSES
+#define POOL_ALLOCATOR_SIZE_CLASSES os::SizeClass<16, 32>, \
+    os::SizeClass<32, 16>, \
+    os::SizeClass<64, 8>, \
+    os::SizeClass<128, 4>, \
+    os::SizeClass<256, 2>
+#endif
+
+using CppAllocator = os::PoolAllocator<POOL_ALLOCATOR_SIZE_CLASSES>;
+CppAllocator g_CppAllocator;
+
+static inline void* cppAllocate(size_t size)
+{
+    return g_CppAllocator.allocate(size);
+}
+
+static inline void cppFree(void* p)
+{
+    g_CppAllocator.deallocate(p);
+}
+#else
+static inline void* cppAllocate(size_t size)
+{
+    return pvPortMalloc(size);
+}
+
+static inline void cppFree(void* p)
+{
+    vPortFree(p);
+}
+#endif
+
 //Override C++ new/delete operators to reduce memory footprint
 void* operator new(size_t size)
 {
-    return pvPortMalloc(size);
+    return cppAllocate(size);
 }
 
 void* operator new[](size_t size)
 {
-    return pvPortMalloc(size);
+    return cppAllocate(size);
 }
 
 void operator delete(void* p)
 {
-    vPortFree(p);
+    cppFree(p);
 }
 
 void operator delete[](void* p)
 {
-    vPortFree(p);
+    cppFree(p);
 }
 
 extern "C" void abort(void)
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <algorithm>
+
+namespace os
+{
+/*
+ * Zero-copy companion of StreamBuffer. The producer acquires a contiguous
+ * region, fills it in place (e.g. by DMA) and commits it. The consumer peeks
+ * a contiguous region, parses it in place and releases it. Safe for one
+ * producer and one consumer, either of them may run in an ISR.
+ */
+template<typename T, size_t n>
+class BipBuffer
+{
+public:
+    struct Span {
+        T* data;
+        size_t length;
+    };
+
+    BipBuffer(void) = default;
+    BipBuffer(const BipBuffer&) = delete;
+    BipBuffer(BipBuffer&&) = delete;
+    BipBuffer& operator=(const BipBuffer&) = delete;
+    BipBuffer& operator=(BipBuffer&&) = delete;
+
+    Span acquireWrite(const size_t maxLength);
+    void commitWrite(const size_t length);
+
+    Span peekRead(void);
+    void releaseRead(const size_t length);
+
+    bool isEmpty(void) const;
+    void reset(void);
+
+private:
+    std::array<T, n> mBuffer;
+
+    std::atomic<size_t> mWrite {0};
+    std::atomic<size_t> mLast {n};
+    std::atomic<size_t> mRead {0};
+
+    // producer only
+    size_t mReserveStart = 0;
+    size_t mReserveLength = 0;
+
+    // consumer only
+    size_t mPeekLength = 0;
+};
+
+template<typename T, size_t n>
+typename BipBuffer<T, n>::Span BipBuffer<T, n>::acquireWrite(const size_t maxLength)
+{
+    const size_t write = mWrite.load(std::memory_order_relaxed);
+    const size_t read = mRead.load(std::memory_order_acquire);
+
+    if (write < read) {
+        // wrapped, the free region ends one element in front of read
+        mReserveStart = write;
+        mReserveLength = std::min(maxLength, read - write - 1);
+    } else {
+        const size_t tail = n - write;
+        const size_t head = read > 0 ? read - 1 : 0;
+
+        if ((tail >= maxLength) || (tail >= head)) {
+            mReserveStart = write;
+            mReserveLength = std::min(maxLength, tail);
+        } else {
+            mReserveStart = 0;
+            mReserveLength = std::min(maxLength, head);
+        }
+    }
+    return Span {mBuffer.data() + mReserveStart, mReserveLength};
+}
+
+template<typename T, size_t n>
+void BipBuffer<T, n>::commitWrite(const size_t length)
+{
+    const size_t used = std::min(length, mReserveLength);
+    const size_t write = mWrite.load(std::memory_order_relaxed);
+
+    mReserveLength = 0;
+    if (used == 0) {
+        return;
+    }
+
+    if (mReserveStart != write) {
+        // the reserved region wrapped, data of the current lap ends at write
+        mLast.store(write, std::memory_order_relaxed);
+    }
+    mWrite.store(mReserveStart + used, std::memory_order_release);
+}
+
+template<typename T, size_t n>
+typename BipBuffer<T, n>::Span BipBuffer<T, n>::peekRead(void)
+{
+    const size_t write = mWrite.load(std::memory_order_acquire);
+    size_t read = mRead.load(std::memory_order_relaxed);
+
+    if (write < read) {
+        const size_t last = mLast.load(std::memory_order_relaxed);
+        if (read == last) {
+            read = 0;
+            mRead.store(read, std::memory_order_release);
+            mPeekLength = write;
+        } else {
+            mPeekLength = last - read;
+        }
+    } else {
+        mPeekLength = write - read;
+    }
+    return Span {mBuffer.data() + read, mPeekLength};
+}
+
+template<typename T, size_t n>
+void BipBuffer<T, n>::releaseRead(const size_t length)
+{
+    const size_t read = mRead.load(std::memory_order_relaxed);
+    const size_t used = std::min(length, mPeekLength);
+
+    mPeekLength -= used;
+    mRead.store(read + used, std::memory_order_release);
+}
+
+template<typename T, size_t n>
+bool BipBuffer<T, n>::isEmpty(void) const
+{
+    return mWrite.load(std::memory_order_acquire) == mRead.load(std::memory_order_acquire);
+}
+
+template<typename T, size_t n>
+void BipBuffer<T, n>::reset(void)
+{
+    mWrite.store(0);
+    mLast.store(n);
+    mRead.store(0);
+    mReserveStart = 0;
+    mReserveLength = 0;
+    mPeekLength = 0;
+}
+}
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "unittest.h"
+#include "os_BipBuffer.h"
+#include "os_StreamBuffer.h"
+
+#define NUM_TEST_LOOPS 255
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t BUFFERSIZE = 1024;
+static constexpr const size_t CHUNKSIZE = 64;
+static constexpr const size_t BENCHMARK_BYTES = 64 * 1024 * 1024;
+
+struct StreamBufferMock {
+    std::array<uint8_t, BUFFERSIZE> memory;
+    size_t head = 0;
+    size_t tail = 0;
+};
+
+//--------------------------MOCKING--------------------------
+
+/* copy-in/copy-out ring, like the FreeRTOS stream buffer without blocking */
+StreamBufferHandle_t xStreamBufferGenericCreate(size_t     xBufferSizeBytes,
+                                                size_t     xTriggerLevelBytes,
+                                                BaseType_t xIsMessageBuffer)
+{
+    return reinterpret_cast<StreamBufferHandle_t>(new StreamBufferMock);
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t xStreamBuffer)
+{
+    delete reinterpret_cast<StreamBufferMock*>(xStreamBuffer);
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer,
+                         const void*          pvTxData,
+                         size_t               xDataLengthBytes,
+                         TickType_t           xTicksToWait)
+{
+    auto sb = reinterpret_cast<StreamBufferMock*>(xStreamBuffer);
+    auto p = reinterpret_cast<const uint8_t*>(pvTxData);
+    const size_t length = std::min(xDataLengthBytes, BUFFERSIZE - (sb->head - sb->tail));
+
+    for (size_t i = 0; i < length; i++) {
+        sb->memory[sb->head++ % BUFFERSIZE] = *p++;
+    }
+    return length;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer,
+                            void*                pvRxData,
+                            size_t               xBufferLengthBytes,
+                            TickType_t           xTicksToWait)
+{
+    auto sb = reinterpret_cast<StreamBufferMock*>(xStreamBuffer);
+    auto p = reinterpret_cast<uint8_t*>(pvRxData);
+    const size_t length = std::min(xBufferLengthBytes, sb->head - sb->tail);
+
+    for (size_t i = 0; i < length; i++) {
+        *p++ = sb->memory[sb->tail++ % BUFFERSIZE];
+    }
+    return length;
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_AcquireCommitPeekRelease(void)
+{
+    TestCaseBegin();
+    os::BipBuffer<uint8_t, 16> testee;
+
+    CHECK(testee.isEmpty());
+    auto w = testee.acquireWrite(10);
+    CHECK(w.length == 10);
+    std::memcpy(w.data, "0123456789", 10);
+    testee.commitWrite(10);
+
+    auto r = testee.peekRead();
+    CHECK(r.length == 10);
+    CHECK_MEMCMP(r.data, "0123456789", 10);
+    testee.releaseRead(4);
+
+    r = testee.peekRead();
+    CHECK(r.length == 6);
+    CHECK_MEMCMP(r.data, "456789", 6);
+    testee.releaseRead(6);
+    CHECK(testee.isEmpty());
+    TestCaseEnd();
+}
+
+int ut_Wraparound(void)
+{
+    TestCaseBegin();
+    os::BipBuffer<uint8_t, 16> testee;
+
+    testee.acquireWrite(12);
+    testee.commitWrite(12);
+    testee.peekRead();
+    testee.releaseRead(8);
+
+    // tail holds 4 elements, head 7: the grant moves to the front
+    auto w = testee.acquireWrite(6);
+    CHECK(w.length == 6);
+    std::memcpy(w.data, "abcdef", 6);
+    testee.commitWrite(6);
+
+    auto r = testee.peekRead();
+    CHECK(r.length == 4);
+    testee.releaseRead(4);
+
+    r = testee.peekRead();
+    CHECK(r.length == 6);
+    CHECK_MEMCMP(r.data, "abcdef", 6);
+
+    // the next grant continues behind the unread data
+    w = testee.acquireWrite(16);
+    CHECK(w.length == 10);
+    CHECK(w.data == r.data + 6);
+    testee.releaseRead(6);
+    CHECK(testee.isEmpty());
+    TestCaseEnd();
+}
+
+int ut_PartialCommit(void)
+{
+    TestCaseBegin();
+    os::BipBuffer<uint8_t, 16> testee;
+
+    auto w = testee.acquireWrite(32);
+    CHECK(w.length == 16);
+    testee.commitWrite(3);
+    CHECK(testee.peekRead().length == 3);
+
+    w = testee.acquireWrite(4);
+    CHECK(w.length == 4);
+    testee.commitWrite(0);
+    CHECK(testee.peekRead().length == 3);
+    TestCaseEnd();
+}
+
+int ut_TwoThreadStress(void)
+{
+    TestCaseBegin();
+    static os::BipBuffer<uint8_t, 128> testee;
+    constexpr const size_t numberOfBytes = NUM_TEST_LOOPS * 4096;
+
+    std::thread producer([] {
+        uint8_t value = 0;
+        size_t written = 0;
+        while (written < numberOfBytes) {
+            auto w = testee.acquireWrite(std::min(1 + written % 23, numberOfBytes - written));
+            for (size_t i = 0; i < w.length; i++) {
+                w.data[i] = value++;
+            }
+            testee.commitWrite(w.length);
+            written += w.length;
+        }
+    });
+
+    uint8_t expected = 0;
+    size_t received = 0;
+    while (received < numberOfBytes) {
+        auto r = testee.peekRead();
+        for (size_t i = 0; i < r.length; i++) {
+            if (r.data[i] != expected++) {
+                errors++;
+            }
+        }
+        testee.releaseRead(r.length);
+        received += r.length;
+    }
+    producer.join();
+
+    CHECK(received == numberOfBytes);
+    CHECK(testee.isEmpty());
+    TestCaseEnd();
+}
+
+int ut_BenchmarkAgainstStreamBuffer(void)
+{
+    TestCaseBegin();
+    os::StreamBuffer<uint8_t, BUFFERSIZE> streamBuffer;
+    os::BipBuffer<uint8_t, BUFFERSIZE> bipBuffer;
+    std::array<uint8_t, CHUNKSIZE> dmaBuffer;
+    std::array<uint8_t, CHUNKSIZE> temporaryBuffer;
+    size_t checksumStream = 0;
+    size_t checksumBip = 0;
+
+    // ISR -> stream buffer -> temporary buffer -> parser
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < BENCHMARK_BYTES / CHUNKSIZE; i++) {
+        std::fill(dmaBuffer.begin(), dmaBuffer.end(), static_cast<uint8_t>(i));
+        streamBuffer.send(dmaBuffer.data(), dmaBuffer.size());
+        const size_t length = streamBuffer.receive(temporaryBuffer.data(), temporaryBuffer.size());
+        for (size_t j = 0; j < length; j++) {
+            checksumStream += temporaryBuffer[j];
+        }
+    }
+    const auto streamDuration = std::chrono::high_resolution_clock::now() - start;
+
+    // DMA writes into the bip buffer, the parser reads in place
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < BENCHMARK_BYTES / CHUNKSIZE; i++) {
+        auto w = bipBuffer.acquireWrite(CHUNKSIZE);
+        std::fill(w.data, w.data + w.length, static_cast<uint8_t>(i));
+        bipBuffer.commitWrite(w.length);
+        auto r = bipBuffer.peekRead();
+        for (size_t j = 0; j < r.length; j++) {
+            checksumBip += r.data[j];
+        }
+        bipBuffer.releaseRead(r.length);
+    }
+    const auto bipDuration = std::chrono::high_resolution_clock::now() - start;
+
+    CHECK(checksumStream == checksumBip);
+
+    using std::chrono::microseconds;
+    printf("%u MiB: StreamBuffer %lld us, BipBuffer %lld us\n",
+           static_cast<unsigned>(BENCHMARK_BYTES >> 20),
+           static_cast<long long>(std::chrono::duration_cast<microseconds>(streamDuration).count()),
+           static_cast<long long>(std::chrono::duration_cast<microseconds>(bipDuration).count()));
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_AcquireCommitPeekRelease);
+    RunTest(true, ut_Wraparound);
+    RunTest(true, ut_PartialCommit);
+    RunTest(true, ut_TwoThreadStress);
+    RunTest(true, ut_BenchmarkAgainstStreamBuffer);
+    UnitTestMainEnd();
+}
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <tuple>
+#include "FreeRTOS.h"
+#include "os_Task.h"
+#include "for_each_tuple.h"
+
+namespace os
+{
+struct PoolStatistics {
+    size_t blockSize;
+    size_t capacity;
+    size_t live;
+    size_t peak;
+    size_t failed;
+};
+
+/*
+ * Pool of NumberOfBlocks fixed size blocks. Free blocks are kept in an
+ * intrusive free list, blocks which were never handed out are taken from the
+ * end of the storage. Allocation and release are O(1).
+ */
+template<size_t BlockSize, size_t NumberOfBlocks>
+class SizeClass
+{
+    static_assert(BlockSize % alignof(std::max_align_t) == 0,
+                  "BlockSize has to be a multiple of the fundamental alignment");
+    static_assert(NumberOfBlocks > 0, "SizeClass needs at least one block");
+
+    alignas(std::max_align_t) std::array<uint8_t, BlockSize* NumberOfBlocks> mStorage {};
+    void* mFreeList = nullptr;
+    size_t mUnused = NumberOfBlocks;
+    size_t mLive = 0;
+    size_t mPeak = 0;
+    size_t mFailed = 0;
+
+public:
+    static constexpr const size_t blockSize = BlockSize;
+
+    constexpr SizeClass(void) = default;
+    SizeClass(const SizeClass&) = delete;
+    SizeClass(SizeClass&&) = delete;
+    SizeClass& operator=(const SizeClass&) = delete;
+    SizeClass& operator=(SizeClass&&) = delete;
+
+    void* allocate(void);
+    void deallocate(void* const block);
+    bool owns(void const* const pointer) const;
+    PoolStatistics getStatistics(void) const {return PoolStatistics {BlockSize, NumberOfBlocks, mLive, mPeak, mFailed}; }
+};
+
+/*
+ * Size class allocator for operator new. A request is served by the first
+ * SizeClass with a large enough block. If that class is exhausted, or the
+ * request is larger than every class, it falls back to the FreeRTOS heap.
+ * Statistics are kept per class, the heap fallback is reported as class
+ * numberOfClasses with blockSize 0.
+ *
+ * Classes have to be ordered by ascending BlockSize. All members are constant
+ * initialized, so an allocator with static storage duration is usable before
+ * any constructor ran.
+ */
+template<typename ... Classes>
+class PoolAllocator
+{
+    std::tuple<Classes ...> mClasses;
+    size_t mHeapLive = 0;
+    size_t mHeapPeak = 0;
+    size_t mHeapFailed = 0;
+
+public:
+    static constexpr const size_t numberOfClasses = sizeof ... (Classes);
+
+    constexpr PoolAllocator(void) = default;
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator(PoolAllocator&&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(PoolAllocator&&) = delete;
+
+    void* allocate(const size_t size);
+    void deallocate(void* const pointer);
+    PoolStatistics getStatistics(const size_t index) const;
+};
+
+template<size_t BlockSize, size_t NumberOfBlocks>
+void* SizeClass<BlockSize, NumberOfBlocks>::allocate(void)
+{
+    void* block = nullptr;
+
+    if (mFreeList != nullptr) {
+        block = mFreeList;
+        std::memcpy(&mFreeList, block, sizeof(mFreeList));
+    } else if (mUnused != 0) {
+        mUnused--;
+        block = &mStorage[mUnused * BlockSize];
+    } else {
+        mFailed++;
+        return nullptr;
+    }
+
+    mLive++;
+    if (mLive > mPeak) {
+        mPeak = mLive;
+    }
+    return block;
+}
+
+template<size_t BlockSize, size_t NumberOfBlocks>
+void SizeClass<BlockSize, NumberOfBlocks>::deallocate(void* const block)
+{
+    std::memcpy(block, &mFreeList, sizeof(mFreeList));
+    mFreeList = block;
+    mLive--;
+}
+
+template<size_t BlockSize, size_t NumberOfBlocks>
+bool SizeClass<BlockSize, NumberOfBlocks>::owns(void const* const pointer) const
+{
+    const auto address = reinterpret_cast<uintptr_t>(pointer);
+    const auto begin = reinterpret_cast<uintptr_t>(mStorage.data());
+    return (address >= begin) && (address < begin + mStorage.size());
+}
+
+template<typename ... Classes>
+void* PoolAllocator<Classes ...>::allocate(const size_t size)
+{
+    void* pointer = nullptr;
+    bool served = false;
+
+    os::ThisTask::enterCriticalSection();
+    for_each(mClasses, [&](auto& sizeClass) {
+        if (!served && (size <= sizeClass.blockSize)) {
+            served = true;
+            pointer = sizeClass.allocate();
+        }
+    });
+    os::ThisTask::exitCriticalSection();
+
+    if (pointer != nullptr) {
+        return pointer;
+    }
+
+    pointer = pvPortMalloc(size);
+
+    os::ThisTask::enterCriticalSection();
+    if (pointer == nullptr) {
+        mHeapFailed++;
+    } else {
+        mHeapLive++;
+        if (mHeapLive > mHeapPeak) {
+            mHeapPeak = mHeapLive;
+        }
+    }
+    os::ThisTask::exitCriticalSection();
+    return pointer;
+}
+
+template<typename ... Classes>
+void PoolAllocator<Classes ...>::deallocate(void* const pointer)
+{
+    if (pointer == nullptr) {
+        return;
+    }
+
+    bool released = false;
+
+    os::ThisTask::enterCriticalSection();
+    for_each(mClasses, [&](auto& sizeClass) {
+        if (!released && sizeClass.owns(pointer)) {
+            released = true;
+            sizeClass.deallocate(pointer);
+        }
+    });
+    if (!released) {
+        mHeapLive--;
+    }
+    os::ThisTask::exitCriticalSection();
+
+    if (!released) {
+        vPortFree(pointer);
+    }
+}
+
+template<typename ... Classes>
+PoolStatistics PoolAllocator<Classes ...>::getStatistics(const size_t index) const
+{
+    os::ThisTask::enterCriticalSection();
+    PoolStatistics statistics {0, 0, mHeapLive, mHeapPeak, mHeapFailed};
+    size_t i = 0;
+    for_each(mClasses, [&](const auto& sizeClass) {
+        if (i++ == index) {
+            statistics = sizeClass.getStatistics();
+        }
+    });
+    os::ThisTask::exitCriticalSection();
+    return statistics;
+}
+}
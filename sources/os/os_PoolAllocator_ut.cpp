@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "unittest.h"
+#include "os_PoolAllocator.h"
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t TRACE_LENGTH = 200000;
+static constexpr const size_t TRACE_SLOTS = 96;
+static size_t g_heapAllocations = 0;
+static bool g_heapExhausted = false;
+
+using Allocator = os::PoolAllocator<os::SizeClass<16, 32>,
+                                    os::SizeClass<32, 32>,
+                                    os::SizeClass<64, 16>,
+                                    os::SizeClass<128, 8>,
+                                    os::SizeClass<256, 4> >;
+
+/* size 0 releases the slot, everything else allocates into it */
+struct TraceEntry {
+    uint16_t slot;
+    uint16_t size;
+};
+
+//--------------------------MOCKING--------------------------
+
+void* pvPortMalloc(size_t xSize)
+{
+    if (g_heapExhausted) {
+        return nullptr;
+    }
+    g_heapAllocations++;
+    return std::malloc(xSize);
+}
+
+void vPortFree(void* pv)
+{
+    std::free(pv);
+}
+
+void os::ThisTask::enterCriticalSection(void) {}
+void os::ThisTask::exitCriticalSection(void) {}
+
+/* object sizes as they show up on the target: small captures, list nodes,
+ * vector growth and the occasional large buffer */
+static std::vector<TraceEntry> recordTrace(void)
+{
+    static constexpr const std::array<uint16_t, 12> sizes {{8, 12, 16, 16, 24, 32, 40, 48, 64, 100, 200, 600}};
+    std::vector<TraceEntry> trace;
+    std::array<bool, TRACE_SLOTS> used {};
+    uint32_t seed = 0x1234567;
+
+    trace.reserve(TRACE_LENGTH + TRACE_SLOTS);
+    for (size_t i = 0; i < TRACE_LENGTH; i++) {
+        seed = seed * 1103515245 + 12345;
+        const uint16_t slot = (seed >> 8) % TRACE_SLOTS;
+        trace.push_back(TraceEntry {slot, used[slot] ? uint16_t(0) : sizes[(seed >> 20) % sizes.size()]});
+        used[slot] = !used[slot];
+    }
+    for (uint16_t slot = 0; slot < TRACE_SLOTS; slot++) {
+        if (used[slot]) {
+            trace.push_back(TraceEntry {slot, 0});
+        }
+    }
+    return trace;
+}
+
+template<typename Allocate, typename Release>
+static size_t replay(const std::vector<TraceEntry>& trace, Allocate allocate, Release release)
+{
+    std::array<uint8_t*, TRACE_SLOTS> slots {};
+    std::array<uint16_t, TRACE_SLOTS> sizes {};
+    size_t corrupted = 0;
+
+    for (const auto& entry : trace) {
+        uint8_t*& p = slots[entry.slot];
+        if (entry.size == 0) {
+            for (size_t i = 0; i < sizes[entry.slot]; i++) {
+                if (p[i] != static_cast<uint8_t>(entry.slot)) {
+                    corrupted++;
+                    break;
+                }
+            }
+            release(p);
+            p = nullptr;
+        } else {
+            p = static_cast<uint8_t*>(allocate(entry.size));
+            sizes[entry.slot] = entry.size;
+            std::memset(p, entry.slot, entry.size);
+        }
+    }
+    return corrupted;
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_SizeClassSelection(void)
+{
+    TestCaseBegin();
+    static Allocator allocator;
+
+    void* a = allocator.allocate(1);
+    void* b = allocator.allocate(16);
+    void* c = allocator.allocate(17);
+    void* d = allocator.allocate(256);
+    g_heapAllocations = 0;
+    void* e = allocator.allocate(257);
+    CHECK(g_heapAllocations == 1);
+
+    CHECK(allocator.getStatistics(0).live == 2);
+    CHECK(allocator.getStatistics(1).live == 1);
+    CHECK(allocator.getStatistics(4).live == 1);
+    CHECK(allocator.getStatistics(Allocator::numberOfClasses).live == 1);
+    CHECK(allocator.getStatistics(Allocator::numberOfClasses).blockSize == 0);
+
+    for (auto p : {a, b, c, d, e}) {
+        CHECK((reinterpret_cast<uintptr_t>(p) & (alignof(std::max_align_t) - 1)) == 0);
+        allocator.deallocate(p);
+    }
+    allocator.deallocate(nullptr);
+
+    for (size_t i = 0; i <= Allocator::numberOfClasses; i++) {
+        CHECK(allocator.getStatistics(i).live == 0);
+    }
+    CHECK(allocator.getStatistics(0).peak == 2);
+    TestCaseEnd();
+}
+
+int ut_ExhaustionFallsBackToHeap(void)
+{
+    TestCaseBegin();
+    static Allocator allocator;
+    std::array<void*, 40> blocks;
+
+    g_heapAllocations = 0;
+    for (auto& p : blocks) {
+        p = allocator.allocate(16);
+    }
+    CHECK(allocator.getStatistics(0).live == 32);
+    CHECK(allocator.getStatistics(0).failed == 8);
+    CHECK(g_heapAllocations == 8);
+
+    g_heapExhausted = true;
+    CHECK(allocator.allocate(1000) == nullptr);
+    CHECK(allocator.getStatistics(Allocator::numberOfClasses).failed == 1);
+    g_heapExhausted = false;
+
+    // freed blocks are reused last in, first out
+    allocator.deallocate(blocks[3]);
+    CHECK(allocator.allocate(10) == blocks[3]);
+
+    for (auto p : blocks) {
+        allocator.deallocate(p);
+    }
+    CHECK(allocator.getStatistics(0).live == 0);
+    CHECK(allocator.getStatistics(Allocator::numberOfClasses).live == 0);
+    CHECK(allocator.getStatistics(Allocator::numberOfClasses).peak == 8);
+    TestCaseEnd();
+}
+
+int ut_ReplayTrace(void)
+{
+    TestCaseBegin();
+    static Allocator allocator;
+    const auto trace = recordTrace();
+
+    g_heapAllocations = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    CHECK(replay(trace,
+                 [](size_t size) {return allocator.allocate(size); },
+                 [](void* p) {allocator.deallocate(p); }) == 0);
+    const auto poolDuration = std::chrono::high_resolution_clock::now() - start;
+    const size_t poolHeapAllocations = g_heapAllocations;
+
+    start = std::chrono::high_resolution_clock::now();
+    CHECK(replay(trace,
+                 [](size_t size) {return pvPortMalloc(size); },
+                 [](void* p) {vPortFree(p); }) == 0);
+    const auto heapDuration = std::chrono::high_resolution_clock::now() - start;
+
+    size_t served = 0;
+    for (size_t i = 0; i <= Allocator::numberOfClasses; i++) {
+        const auto statistics = allocator.getStatistics(i);
+        CHECK(statistics.live == 0);
+        CHECK(statistics.peak <= statistics.capacity || statistics.blockSize == 0);
+        printf("class %3u: peak %3u/%3u failed %u\n", static_cast<unsigned>(statistics.blockSize),
+               static_cast<unsigned>(statistics.peak), static_cast<unsigned>(statistics.capacity),
+               static_cast<unsigned>(statistics.failed));
+        served += statistics.blockSize ? statistics.peak : 0;
+    }
+    CHECK(served != 0);
+
+    using std::chrono::microseconds;
+    printf("%u operations: pool %lld us (%u heap fallbacks), heap only %lld us\n",
+           static_cast<unsigned>(trace.size()),
+           static_cast<long long>(std::chrono::duration_cast<microseconds>(poolDuration).count()),
+           static_cast<unsigned>(poolHeapAllocations),
+           static_cast<long long>(std::chrono::duration_cast<microseconds>(heapDuration).count()));
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_SizeClassSelection);
+    RunTest(true, ut_ExhaustionFallsBackToHeap);
+    RunTest(true, ut_ReplayTrace);
+    UnitTestMainEnd();
+}
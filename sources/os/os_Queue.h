@@ -8,6 +8,7 @@
 #include "FreeRTOS.h"
 #include "queue.h"
 #include "os_Task.h"
+#include <array>
 #include <chrono>
 
 namespace os
@@ -15,14 +16,23 @@ namespace os
 template<typename T, size_t n>
 class Queue
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    std::array<uint8_t, n * sizeof(T)> mStorage;
+    StaticQueue_t mQueueBuffer;
+#endif
     QueueHandle_t mQueueHandle = nullptr;
 
 public:
     Queue(void);
     Queue(const Queue&) = delete;
-    Queue(Queue&&);
     Queue& operator=(const Queue&) = delete;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    Queue(Queue&&) = delete;
+    Queue& operator=(Queue&&) = delete;
+#else
+    Queue(Queue&&);
     Queue& operator=(Queue&&);
+#endif
     ~Queue(void);
 
     bool sendFront(T & message, std::chrono::milliseconds) const;
@@ -45,14 +55,23 @@ public:
 template<typename T>
 class Queue<T, 1>
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    std::array<uint8_t, sizeof(T)> mStorage;
+    StaticQueue_t mQueueBuffer;
+#endif
     QueueHandle_t mQueueHandle = nullptr;
 
 public:
     Queue(void);
     Queue(const Queue&) = delete;
-    Queue(Queue&&);
     Queue& operator=(const Queue&) = delete;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    Queue(Queue&&) = delete;
+    Queue& operator=(Queue&&) = delete;
+#else
+    Queue(Queue&&);
     Queue& operator=(Queue&&);
+#endif
     ~Queue(void);
 
     bool peek(T & message, std::chrono::milliseconds = std::chrono::milliseconds(portMAX_DELAY)) const;
@@ -65,6 +84,11 @@ public:
     void reset(void) const;
 };
 
+#if configSUPPORT_STATIC_ALLOCATION == 1
+template<typename T, size_t n>
+Queue<T, n>::Queue(void) :
+    mQueueHandle(xQueueCreateStatic(n, sizeof(T), mStorage.data(), &mQueueBuffer)) {}
+#else
 template<typename T, size_t n>
 Queue<T, n>::Queue(void) :
     mQueueHandle(xQueueCreate(n, sizeof(T))) {}
@@ -83,6 +107,7 @@ Queue<T, n>& Queue<T, n>::operator=(Queue<T, n>&& rhs)
     rhs.mQueueHandle = nullptr;
     return *this;
 }
+#endif
 
 template<typename T, size_t n>
 Queue<T, n>::~Queue(void)
@@ -199,6 +224,12 @@ void Queue<T, n>::reset(void) const
 }
 ///////////////////////////////////////////////////////////
 
+#if configSUPPORT_STATIC_ALLOCATION == 1
+template<typename T>
+Queue<T, 1>::Queue(void) :
+    mQueueHandle(xQueueCreateStatic(1, sizeof(T), mStorage.data(), &mQueueBuffer))
+{}
+#else
 template<typename T>
 Queue<T, 1>::Queue(void) :
     mQueueHandle(xQueueCreate(1, sizeof(T)))
@@ -218,6 +249,7 @@ Queue<T, 1>& Queue<T, 1>::operator=(Queue<T, 1>&& rhs)
     rhs.mQueueHandle = nullptr;
     return *this;
 }
+#endif
 
 template<typename T>
 Queue<T, 1>::~Queue(void)
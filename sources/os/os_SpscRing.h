@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "os_Task.h"
+#include "log2.h"
+
+namespace os
+{
+/*
+ * Lock-free single producer / single consumer ring for ISR to task transport.
+ * No critical section is taken. If a consumer task is registered, every push
+ * wakes it through a direct-to-task notification.
+ */
+template<typename T, size_t N>
+class SpscRing
+{
+    static_assert((size_t(1) << constexpr_log2<N>()) == N, "SpscRing size has to be a power of two");
+    static constexpr const size_t MASK = N - 1;
+
+    std::array<T, N> mBuffer;
+    std::atomic<size_t> mHead {0};
+    std::atomic<size_t> mTail {0};
+    TaskHandle_t mConsumerTask = nullptr;
+
+    size_t write(T const* const data, const size_t length);
+    bool receive(const uint32_t ticksToWait) const;
+
+public:
+    SpscRing(void) = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing(SpscRing&&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    SpscRing& operator=(SpscRing&&) = delete;
+
+    void registerConsumerTask(void);
+
+    bool push(const T& element);
+    size_t push(T const* const data, const size_t length);
+    bool pushFromISR(const T& element);
+    size_t pushFromISR(T const* const data, const size_t length);
+
+    bool pop(T& element);
+    size_t pop(T* const data, const size_t length);
+
+    template<class rep, class period>
+    inline size_t pop(T* const data, const size_t length, const std::chrono::duration<rep, period>& d)
+    {
+        size_t count = pop(data, length);
+        if ((count == 0) &&
+            receive(std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / portTICK_RATE_MS))
+        {
+            count = pop(data, length);
+        }
+        return count;
+    }
+
+    size_t size(void) const;
+    size_t spacesAvailable(void) const;
+    bool isEmpty(void) const {return size() == 0; }
+    bool isFull(void) const {return size() == N; }
+    static constexpr size_t capacity(void) {return N; }
+};
+
+template<typename T, size_t N>
+void SpscRing<T, N>::registerConsumerTask(void)
+{
+    mConsumerTask = xTaskGetCurrentTaskHandle();
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::write(T const* const data, const size_t length)
+{
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    const size_t tail = mTail.load(std::memory_order_acquire);
+    const size_t count = std::min(length, N - (head - tail));
+
+    for (size_t i = 0; i < count; i++) {
+        mBuffer[(head + i) & MASK] = data[i];
+    }
+    mHead.store(head + count, std::memory_order_release);
+    return count;
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::receive(const uint32_t ticksToWait) const
+{
+    return (mConsumerTask != nullptr) && (ulTaskNotifyTake(pdTRUE, ticksToWait) != 0);
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::push(const T& element)
+{
+    return push(&element, 1) == 1;
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::push(T const* const data, const size_t length)
+{
+    const size_t count = write(data, length);
+    if ((count != 0) && (mConsumerTask != nullptr)) {
+        xTaskNotifyGive(mConsumerTask);
+    }
+    return count;
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::pushFromISR(const T& element)
+{
+    return pushFromISR(&element, 1) == 1;
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::pushFromISR(T const* const data, const size_t length)
+{
+    const size_t count = write(data, length);
+    if ((count != 0) && (mConsumerTask != nullptr)) {
+        BaseType_t highPriorityTaskWoken = 0;
+        vTaskNotifyGiveFromISR(mConsumerTask, &highPriorityTaskWoken);
+        if (highPriorityTaskWoken) {
+            ThisTask::yield();
+        }
+    }
+    return count;
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::pop(T& element)
+{
+    return pop(&element, 1) == 1;
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::pop(T* const data, const size_t length)
+{
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    const size_t head = mHead.load(std::memory_order_acquire);
+    const size_t count = std::min(length, head - tail);
+
+    for (size_t i = 0; i < count; i++) {
+        data[i] = mBuffer[(tail + i) & MASK];
+    }
+    mTail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::size(void) const
+{
+    return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::spacesAvailable(void) const
+{
+    return N - size();
+}
+}
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "unittest.h"
+#include "os_SpscRing.h"
+
+#define NUM_TEST_LOOPS 255
+
+//--------------------------BUFFERS--------------------------
+std::mutex g_notificationMutex;
+std::condition_variable g_notificationCondition;
+uint32_t g_notificationValue = 0;
+size_t g_numberOfNotifications = 0;
+
+//--------------------------MOCKING--------------------------
+
+void os::ThisTask::yield(void) {}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return reinterpret_cast<TaskHandle_t>(0x1);
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t  xTaskToNotify,
+                              uint32_t      ulValue,
+                              eNotifyAction eAction,
+                              uint32_t*     pulPreviousNotificationValue)
+{
+    std::lock_guard<std::mutex> lock(g_notificationMutex);
+    g_notificationValue++;
+    g_numberOfNotifications++;
+    g_notificationCondition.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken)
+{
+    xTaskGenericNotify(xTaskToNotify, 0, eIncrement, nullptr);
+    *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    std::unique_lock<std::mutex> lock(g_notificationMutex);
+    g_notificationCondition.wait_for(lock, std::chrono::milliseconds(xTicksToWait), [] {
+        return g_notificationValue != 0;
+    });
+    const uint32_t value = g_notificationValue;
+    g_notificationValue = 0;
+    return value;
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_PushPop(void)
+{
+    TestCaseBegin();
+    os::SpscRing<uint8_t, 8> testee;
+    uint8_t value = 0;
+
+    CHECK(testee.isEmpty());
+    CHECK(testee.pop(value) == false);
+    for (uint8_t i = 0; i < 8; i++) {
+        CHECK(testee.push(i));
+    }
+    CHECK(testee.isFull());
+    CHECK(testee.push(8) == false);
+
+    for (uint8_t i = 0; i < 8; i++) {
+        CHECK(testee.pop(value));
+        CHECK(value == i);
+    }
+    CHECK(testee.isEmpty());
+    TestCaseEnd();
+}
+
+int ut_BatchWraparound(void)
+{
+    TestCaseBegin();
+    os::SpscRing<uint16_t, 16> testee;
+    std::array<uint16_t, 12> tx;
+    std::array<uint16_t, 12> rx;
+    uint16_t counter = 0;
+
+    for (size_t loop = 0; loop < NUM_TEST_LOOPS; loop++) {
+        for (auto& element : tx) {
+            element = counter++;
+        }
+        CHECK(testee.push(tx.data(), tx.size()) == tx.size());
+        CHECK(testee.push(tx.data(), tx.size()) == 4);
+        CHECK(testee.spacesAvailable() == 0);
+
+        CHECK(testee.pop(rx.data(), rx.size()) == rx.size());
+        CHECK(rx == tx);
+        CHECK(testee.pop(rx.data(), rx.size()) == 4);
+        CHECK(std::equal(rx.begin(), rx.begin() + 4, tx.begin()));
+    }
+    TestCaseEnd();
+}
+
+int ut_NotifyConsumer(void)
+{
+    TestCaseBegin();
+    os::SpscRing<uint8_t, 8> testee;
+    std::array<uint8_t, 8> rx;
+
+    g_numberOfNotifications = 0;
+    CHECK(testee.pushFromISR(1));
+    CHECK(g_numberOfNotifications == 0);
+
+    testee.registerConsumerTask();
+    CHECK(testee.pushFromISR(2));
+    CHECK(g_numberOfNotifications == 1);
+
+    CHECK(testee.pop(rx.data(), rx.size(), std::chrono::milliseconds(10)) == 2);
+    CHECK(testee.pop(rx.data(), rx.size(), std::chrono::milliseconds(10)) == 0);
+    TestCaseEnd();
+}
+
+int ut_TwoThreadStress(void)
+{
+    TestCaseBegin();
+    static os::SpscRing<uint32_t, 64> testee;
+    constexpr const uint32_t numberOfElements = NUM_TEST_LOOPS * 4096;
+
+    testee.registerConsumerTask();
+
+    std::thread producer([] {
+        std::array<uint32_t, 7> batch;
+        uint32_t next = 0;
+        while (next < numberOfElements) {
+            const size_t length = std::min<size_t>(1 + next % batch.size(), numberOfElements - next);
+            for (size_t i = 0; i < length; i++) {
+                batch[i] = next + i;
+            }
+            next += testee.pushFromISR(batch.data(), length);
+        }
+    });
+
+    std::array<uint32_t, 16> rx;
+    uint32_t expected = 0;
+    while (expected < numberOfElements) {
+        const size_t length = testee.pop(rx.data(), rx.size(), std::chrono::milliseconds(100));
+        for (size_t i = 0; i < length; i++) {
+            if (rx[i] != expected++) {
+                errors++;
+            }
+        }
+    }
+    producer.join();
+
+    CHECK(expected == numberOfElements);
+    CHECK(testee.isEmpty());
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_PushPop);
+    RunTest(true, ut_BatchWraparound);
+    RunTest(true, ut_NotifyConsumer);
+    RunTest(true, ut_TwoThreadStress);
+    UnitTestMainEnd();
+}
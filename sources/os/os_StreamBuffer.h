@@ -8,12 +8,18 @@
 #include "FreeRTOS.h"
 #include "stream_buffer.h"
 #include "os_Task.h"
+#include <array>
 
 namespace os
 {
 template<typename T, size_t n>
 class StreamBuffer
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    // FreeRTOS keeps one byte of the storage area free to tell full from empty
+    std::array<uint8_t, n * sizeof(T) + 1> mStorage;
+    StaticStreamBuffer_t mStreamBufferBuffer;
+#endif
     StreamBufferHandle_t mStreamBufferHandle = nullptr;
 
     bool send(T message, uint32_t ticksToWait) const;
@@ -24,9 +30,14 @@ class StreamBuffer
 public:
     StreamBuffer(const size_t triggerLevel = 1);
     StreamBuffer(const StreamBuffer&) = delete;
-    StreamBuffer(StreamBuffer&&);
     StreamBuffer& operator=(const StreamBuffer&) = delete;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    StreamBuffer(StreamBuffer&&) = delete;
+    StreamBuffer& operator=(StreamBuffer&&) = delete;
+#else
+    StreamBuffer(StreamBuffer&&);
     StreamBuffer& operator=(StreamBuffer&&);
+#endif
     ~StreamBuffer(void);
 
     template<class rep, class period>
@@ -76,6 +87,12 @@ public:
     bool receiveCompletedFromISR(void) const;
 };
 
+#if configSUPPORT_STATIC_ALLOCATION == 1
+template<typename T, size_t n>
+StreamBuffer<T, n>::StreamBuffer(const size_t triggerLevel) :
+    mStreamBufferHandle(xStreamBufferCreateStatic(mStorage.size(), triggerLevel, mStorage.data(),
+                                                  &mStreamBufferBuffer)) {}
+#else
 template<typename T, size_t n>
 StreamBuffer<T, n>::StreamBuffer(const size_t triggerLevel) :
     mStreamBufferHandle(xStreamBufferCreate(n * sizeof(T), triggerLevel)) {}
@@ -94,6 +111,7 @@ StreamBuffer<T, n>& StreamBuffer<T, n>::operator=(StreamBuffer<T, n>&& rhs)
     rhs.mStreamBufferHandle = nullptr;
     return *this;
 }
+#endif
 
 template<typename T, size_t n>
 StreamBuffer<T, n>::~StreamBuffer(void)
@@ -139,9 +157,9 @@ bool StreamBuffer<T, n>::receive(T& message, const uint32_t ticksToWait) const
 template<typename T, size_t n>
 bool StreamBuffer<T, n>::receiveFromISR(T& message) const
 {
-    uint32_t highPriorityTaskWoken = 0;
+    BaseType_t highPriorityTaskWoken = 0;
 
-    bool retValue = xStreamBufferReceiveFromISR(mStreamBufferHandle, &message, sizeof(message), &highPriorityTaskWoken);
+    auto retValue = xStreamBufferReceiveFromISR(mStreamBufferHandle, &message, sizeof(message), &highPriorityTaskWoken);
     if (highPriorityTaskWoken) {
         ThisTask::yield();
     }
@@ -4,7 +4,11 @@
  */
 
 #include "os_Task.h"
+#include "RunTimeCounter.h"
 #include "trace.h"
+#if defined(portHOST_POSIX)
+#include <thread>
+#endif
 
 static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
 
@@ -27,9 +31,23 @@ bool Task::schedulerRunning = false;
 Task::Task(char const* const                      name,
            const uint16_t                         stackSize,
            const os::Task::Priority               priority,
-           const std::function<void(const bool&)> function) :
+           const std::function<void(const bool&)> function,
+           StackType_t* const                     stack,
+           StaticTask_t* const                    taskBuffer) :
     mTaskFunction(function)
 {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    if ((stack != nullptr) && (taskBuffer != nullptr)) {
+        this->mHandle = xTaskCreateStatic(Task::task,
+                                          name,
+                                          Task::STACKSIZE_IN_BYTE(stackSize),
+                                          this,
+                                          static_cast<uint16_t>(priority),
+                                          stack,
+                                          taskBuffer);
+        return;
+    }
+#endif
     xTaskCreate(Task::task,
                 name,
                 Task::STACKSIZE_IN_BYTE(stackSize),
@@ -42,6 +60,7 @@ Task::~Task(void)
 {
     if (this->mHandle) {
         vTaskDelete(this->mHandle);
+        this->mHandle = nullptr;
     }
 }
 
@@ -53,8 +72,8 @@ void Task::task(void* pvParameters)
 void Task::taskFunction(void)
 {
     mTaskFunction(false);
+    this->mHandle = nullptr;
     vTaskDelete(nullptr);
-    this->mHandle = 0;
 }
 
 void Task::suspend(void) const
@@ -142,6 +161,10 @@ void os::ThisTask::sleep(const std::chrono::milliseconds ms)
     if (os::Task::isSchedulerRunning()) {
         vTaskDelay(ms.count() / portTICK_RATE_MS);
     } else {
+#if defined(portHOST_POSIX)
+        std::this_thread::sleep_for(ms);
+        return;
+#endif
         const size_t countervalue = ms.count() * (SystemCoreClock / 5000);
         for (size_t i = 0; i < countervalue; i++) {
             __NOP();
@@ -169,7 +192,54 @@ void os::ThisTask::exitCriticalSection(void)
     taskEXIT_CRITICAL();
 }
 
-extern "C" void vApplicationTickHook(void) {}
+#if defined(portGET_CYCLE_COUNTER_VALUE)
+static os::RunTimeCounter<configRUN_TIME_COUNTER_SHIFT> g_RunTimeCounter;
+
+extern "C" uint32_t ulGetRunTimeCounterValue(void)
+{
+    return g_RunTimeCounter.get([] {
+        return portGET_CYCLE_COUNTER_VALUE();
+    });
+}
+#endif
+
+extern "C" void vApplicationTickHook(void)
+{
+#if defined(portGET_CYCLE_COUNTER_VALUE)
+    // at least once per wrap of the cycle counter
+    g_RunTimeCounter.sample(portGET_CYCLE_COUNTER_VALUE());
+#endif
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+/*-----------------------------------------------------------*/
+extern "C" void vApplicationGetIdleTaskMemory(StaticTask_t** ppxIdleTaskTCBBuffer,
+                                              StackType_t**  ppxIdleTaskStackBuffer,
+                                              uint32_t*      pulIdleTaskStackSize)
+{
+    static StaticTask_t idleTaskTCB;
+    static StackType_t idleTaskStack[configMINIMAL_STACK_SIZE];
+
+    *ppxIdleTaskTCBBuffer = &idleTaskTCB;
+    *ppxIdleTaskStackBuffer = idleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+#if configUSE_TIMERS == 1
+/*-----------------------------------------------------------*/
+extern "C" void vApplicationGetTimerTaskMemory(StaticTask_t** ppxTimerTaskTCBBuffer,
+                                               StackType_t**  ppxTimerTaskStackBuffer,
+                                               uint32_t*      pulTimerTaskStackSize)
+{
+    static StaticTask_t timerTaskTCB;
+    static StackType_t timerTaskStack[configTIMER_TASK_STACK_DEPTH];
+
+    *ppxTimerTaskTCBBuffer = &timerTaskTCB;
+    *ppxTimerTaskStackBuffer = timerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+#endif
+#endif
 
 /*-----------------------------------------------------------*/
 extern "C" void vApplicationMallocFailedHook(void)
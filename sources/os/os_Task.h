@@ -11,6 +11,11 @@
 #include <functional>
 #include <chrono>
 
+#if tskKERNEL_VERSION_MAJOR < 9
+/* kernels before V9 know no static allocation, only the pointer type is needed */
+typedef struct xSTATIC_TCB StaticTask_t;
+#endif
+
 namespace os
 {
 class Task
@@ -36,7 +41,8 @@ public:
     };
 
     Task(char const* const name, const uint16_t stackSize, const os::Task::Priority priority,
-         const std::function<void(const bool&)> function);
+         const std::function<void(const bool&)> function,
+         StackType_t* const stack = nullptr, StaticTask_t* const taskBuffer = nullptr);
     Task(const Task&) = delete;
     Task(Task&&) = delete;
     Task& operator=(const Task&) = delete;
@@ -0,0 +1,549 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "unittest.h"
+#include "TaskInterruptable.h"
+#include "os_Queue.h"
+#include "os_StreamBuffer.h"
+#include "os_SpscRing.h"
+#include "Semaphore.h"
+#include "Mutex.h"
+#include "EventGroup.h"
+#include "Timer.h"
+#include "WorkQueue.h"
+#include "TaskNotifier.h"
+
+#define NUM_TEST_LOOPS 255
+
+static const int __attribute__((unused)) g_DebugZones = ZONE_ERROR | ZONE_WARNING | ZONE_VERBOSE | ZONE_INFO;
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t STACKSIZE = 1024;
+static constexpr const size_t STREAM_BYTES = 4 * 1024 * 1024;
+static constexpr const size_t ECHO_LOOPS = 100;
+static constexpr const EventBits_t SEND_EVENT = 1 << 0;
+static constexpr const EventBits_t RECEIVE_EVENT = 1 << 1;
+
+/*
+ * Echo through the structure of the modem socket loop: the application writes
+ * into the send buffer, the service task forwards it to the modem, the modem
+ * answers with a URC carrying the number of bytes, the service task fetches
+ * them into the receive buffer. Returns the mean round trip in microseconds.
+ */
+static double socketEcho(const bool eventDriven)
+{
+    os::StreamBuffer<char, 512> sendBuffer;
+    os::StreamBuffer<char, 512> receiveBuffer;
+    os::StreamBuffer<char, 512> modemTx;
+    os::StreamBuffer<char, 512> modemRx;
+    os::Queue<size_t, 1> numberOfBytesForReceive;
+    os::EventGroup events;
+    std::atomic<bool> running {true};
+
+    os::TaskInterruptable modem("Modem", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        std::array<char, 64> data;
+        while (running) {
+            const size_t length = modemTx.receive(data.data(), data.size(), std::chrono::milliseconds(100));
+            if (length) {
+                modemRx.send(data.data(), length);
+                numberOfBytesForReceive.overwrite(length);
+                events.set(RECEIVE_EVENT);
+            }
+        }
+    });
+
+    os::TaskInterruptable service("Service", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        std::array<char, 64> data;
+        while (running) {
+            if (sendBuffer.bytesAvailable()) {
+                const size_t length = sendBuffer.receive(data.data(), data.size(), std::chrono::milliseconds(0));
+                modemTx.send(data.data(), length);
+            }
+
+            size_t bytes = 0;
+            if (numberOfBytesForReceive.receive(bytes, std::chrono::milliseconds(eventDriven ? 0 : 10))) {
+                const size_t length = modemRx.receive(data.data(), bytes, std::chrono::milliseconds(0));
+                receiveBuffer.send(data.data(), length);
+            }
+
+            if (eventDriven) {
+                events.waitAny(SEND_EVENT | RECEIVE_EVENT, std::chrono::milliseconds(100));
+            }
+        }
+    });
+
+    std::array<char, 16> rx;
+    const std::array<char, 16> tx {"0123456789abcde"};
+    size_t failed = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < ECHO_LOOPS; i++) {
+        sendBuffer.send(tx.data(), tx.size());
+        events.set(SEND_EVENT);
+        size_t received = 0;
+        while (received < rx.size()) {
+            const size_t length = receiveBuffer.receive(rx.data() + received, rx.size() - received,
+                                                        std::chrono::milliseconds(1000));
+            if (length == 0) {
+                break;
+            }
+            received += length;
+        }
+        if ((received != rx.size()) || (rx != tx)) {
+            failed++;
+        }
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    running = false;
+    events.set(SEND_EVENT);
+    service.join();
+    modem.join();
+    return failed ? -1 : static_cast<double>(us) / ECHO_LOOPS;
+}
+
+//-------------------------TESTCASES-------------------------
+
+/*
+ * Blocking transfer through the structure of the Dma drivers: the task arms
+ * the completion, starts the transfer and blocks, the Dma interrupt signals
+ * the completion. Returns the mean round trip in microseconds.
+ */
+static double transferRoundTrip(const bool notification)
+{
+    os::Semaphore semaphore;
+    os::TaskNotifier notifier;
+    std::atomic<bool> started {false};
+    std::atomic<bool> running {true};
+
+    // a plain thread plays the Dma interrupt
+    std::thread dma([&] {
+        while (running) {
+            if (!started.exchange(false)) {
+                std::this_thread::yield();
+            } else if (notification) {
+                notifier.notifyFromISR();
+            } else {
+                semaphore.giveFromISR();
+            }
+        }
+    });
+
+    size_t completed = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < NUM_TEST_LOOPS * 100; i++) {
+        if (notification) {
+            notifier.prepare();
+            started = true;
+            completed += notifier.wait(std::chrono::milliseconds(1000));
+        } else {
+            semaphore.take(std::chrono::milliseconds(0));
+            started = true;
+            completed += semaphore.take(std::chrono::milliseconds(1000));
+        }
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    running = false;
+    dma.join();
+    return completed == NUM_TEST_LOOPS * 100 ? static_cast<double>(us) / completed : -1;
+}
+
+int ut_QueueRoundTrip(void)
+{
+    TestCaseBegin();
+    os::Queue<uint32_t, 4> request;
+    os::Queue<uint32_t, 4> response;
+
+    os::TaskInterruptable echo("Echo", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        for (size_t i = 0; i < NUM_TEST_LOOPS * 100; i++) {
+            uint32_t value;
+            request.receive(value);
+            value++;
+            response.sendBack(value);
+        }
+    });
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < NUM_TEST_LOOPS * 100; i++) {
+        uint32_t value = i;
+        CHECK(request.sendBack(value));
+        CHECK(response.receive(value, std::chrono::milliseconds(1000)));
+        CHECK(value == i + 1);
+    }
+    echo.join();
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("Queue round trip: %.2f us\n", static_cast<double>(us) / (NUM_TEST_LOOPS * 100));
+    TestCaseEnd();
+}
+
+int ut_StreamBufferThroughput(void)
+{
+    TestCaseBegin();
+    os::StreamBuffer<uint8_t, 1024> stream;
+
+    os::TaskInterruptable producer("Producer", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        std::array<uint8_t, 64> chunk;
+        uint8_t value = 0;
+        for (size_t sent = 0; sent < STREAM_BYTES; sent += chunk.size()) {
+            for (auto& element : chunk) {
+                element = value++;
+            }
+            stream.send(chunk.data(), chunk.size());
+        }
+    });
+
+    std::array<uint8_t, 256> rx;
+    uint8_t expected = 0;
+    size_t received = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    while (received < STREAM_BYTES) {
+        const size_t length = stream.receive(rx.data(), rx.size(), std::chrono::milliseconds(1000));
+        if (length == 0) {
+            break;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (rx[i] != expected++) {
+                errors++;
+            }
+        }
+        received += length;
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    producer.join();
+    CHECK(received == STREAM_BYTES);
+    printf("StreamBuffer: %u MiB in %lld us\n", static_cast<unsigned>(STREAM_BYTES >> 20),
+           static_cast<long long>(us));
+    TestCaseEnd();
+}
+
+int ut_SemaphoreAndMutex(void)
+{
+    TestCaseBegin();
+    os::Semaphore done;
+    os::Mutex mutex;
+    size_t counter = 0;
+
+    os::TaskInterruptable worker("Worker", STACKSIZE, os::Task::Priority::MEDIUM, [&](const bool&) {
+        for (size_t i = 0; i < NUM_TEST_LOOPS * 100; i++) {
+            mutex.take();
+            counter++;
+            mutex.give();
+        }
+        done.give();
+    });
+
+    for (size_t i = 0; i < NUM_TEST_LOOPS * 100; i++) {
+        mutex.take();
+        counter++;
+        mutex.give();
+    }
+    CHECK(done.take(std::chrono::milliseconds(1000)));
+    worker.join();
+    CHECK(counter == 2 * NUM_TEST_LOOPS * 100);
+
+    const uint32_t before = os::Task::getTickCount();
+    CHECK(done.take(std::chrono::milliseconds(20)) == false);
+    CHECK(os::Task::getTickCount() - before >= 20);
+    TestCaseEnd();
+}
+
+int ut_NotifyFromInterrupt(void)
+{
+    TestCaseBegin();
+    static os::SpscRing<uint32_t, 64> ring;
+    std::atomic<uint32_t> sum {0};
+    os::Semaphore done;
+
+    os::TaskInterruptable consumer("Consumer", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        ring.registerConsumerTask();
+        done.give();
+        std::array<uint32_t, 16> rx;
+        uint32_t received = 0;
+        while (received < NUM_TEST_LOOPS) {
+            const size_t length = ring.pop(rx.data(), rx.size(), std::chrono::milliseconds(1000));
+            for (size_t i = 0; i < length; i++) {
+                sum += rx[i];
+            }
+            received += length;
+        }
+        done.give();
+    });
+    CHECK(done.take(std::chrono::milliseconds(1000)));
+
+    // a plain thread plays the interrupt
+    std::thread interrupt([] {
+        for (uint32_t i = 0; i < NUM_TEST_LOOPS; i++) {
+            while (!ring.pushFromISR(i)) {}
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        }
+    });
+    interrupt.join();
+
+    CHECK(done.take(std::chrono::milliseconds(1000)));
+    consumer.join();
+    CHECK(sum == NUM_TEST_LOOPS * (NUM_TEST_LOOPS - 1) / 2);
+    TestCaseEnd();
+}
+
+int ut_EventGroupWaitAny(void)
+{
+    TestCaseBegin();
+    os::EventGroup events;
+    os::Semaphore done;
+
+    CHECK(events.waitAny(SEND_EVENT, std::chrono::milliseconds(5)) == 0);
+
+    os::TaskInterruptable producer("Producer", STACKSIZE, os::Task::Priority::HIGH, [&](const bool&) {
+        os::ThisTask::sleep(std::chrono::milliseconds(5));
+        events.set(RECEIVE_EVENT);
+        done.take(std::chrono::milliseconds(1000));
+        events.set(SEND_EVENT);
+        events.set(RECEIVE_EVENT);
+    });
+
+    CHECK(events.waitAny(SEND_EVENT | RECEIVE_EVENT, std::chrono::milliseconds(1000)) == RECEIVE_EVENT);
+    CHECK(events.get() == 0);
+    done.give();
+    CHECK(events.waitAll(SEND_EVENT | RECEIVE_EVENT, std::chrono::milliseconds(1000)) ==
+          (SEND_EVENT | RECEIVE_EVENT));
+    producer.join();
+    CHECK(events.get() == 0);
+
+    // bits raised while nobody waits are kept for the next wait
+    events.set(SEND_EVENT);
+    CHECK(events.waitAny(SEND_EVENT | RECEIVE_EVENT, std::chrono::milliseconds(0)) == SEND_EVENT);
+    CHECK(events.clear(RECEIVE_EVENT) == 0);
+    TestCaseEnd();
+}
+
+int ut_SocketEchoLatency(void)
+{
+    TestCaseBegin();
+    const double polling = socketEcho(false);
+    const double eventDriven = socketEcho(true);
+
+    CHECK(polling > 0);
+    CHECK(eventDriven > 0);
+    CHECK(eventDriven < polling);
+    printf("Socket echo: polling %.1f us, event group %.1f us\n", polling, eventDriven);
+    TestCaseEnd();
+}
+
+int ut_TimerOneShotAndPeriodic(void)
+{
+    TestCaseBegin();
+    os::Semaphore fired;
+    std::atomic<size_t> periodicRuns {0};
+    os::Timer oneShot("OneShot", std::chrono::milliseconds(5), os::Timer::Mode::ONE_SHOT, [&](void) {
+        fired.give();
+    });
+    os::Timer periodic("Periodic", std::chrono::milliseconds(2), os::Timer::Mode::PERIODIC, [&](void) {
+        periodicRuns++;
+    });
+
+    CHECK(!oneShot.isActive());
+    CHECK(oneShot.start());
+    CHECK(oneShot.isActive());
+    CHECK(fired.take(std::chrono::milliseconds(1000)));
+    CHECK(!oneShot.isActive());
+    CHECK(!fired.take(std::chrono::milliseconds(20)));
+
+    CHECK(periodic.start());
+    os::ThisTask::sleep(std::chrono::milliseconds(50));
+    CHECK(periodic.stop());
+    CHECK(!periodic.isActive());
+    os::ThisTask::sleep(std::chrono::milliseconds(5));
+    const size_t runs = periodicRuns;
+    CHECK(runs >= 5);
+    os::ThisTask::sleep(std::chrono::milliseconds(20));
+    CHECK(periodicRuns == runs);
+
+    // restarts the timer with the new period
+    CHECK(periodic.changePeriod(std::chrono::milliseconds(1)));
+    CHECK(periodic.isActive());
+    TestCaseEnd();
+}
+
+int ut_TimerDestructorWaitsForCallback(void)
+{
+    TestCaseBegin();
+    std::atomic<bool> started {false};
+    std::atomic<bool> finished {false};
+    auto timer = new os::Timer("Slow", std::chrono::milliseconds(1), os::Timer::Mode::ONE_SHOT, [&](void) {
+        started = true;
+        os::ThisTask::sleep(std::chrono::milliseconds(20));
+        finished = true;
+    });
+
+    CHECK(timer->start());
+    while (!started) {
+        os::ThisTask::sleep(std::chrono::milliseconds(1));
+    }
+    delete timer;
+    CHECK(finished);
+    TestCaseEnd();
+}
+
+int ut_WorkQueuePriorities(void)
+{
+    TestCaseBegin();
+    os::StaticWorkQueue<4> queue;
+    std::array<uint32_t, 8> order {};
+    size_t ran = 0;
+    const os::WorkQueue::Function record = [&](uint32_t payload) {order[ran++] = payload; };
+
+    CHECK(!queue.dispatch(0));
+    CHECK(queue.post(os::WorkQueue::LOW, record, 1));
+    CHECK(queue.post(os::WorkQueue::LOW, record, 2));
+    CHECK(queue.postFromISR(os::WorkQueue::HIGH, record, 3));
+    CHECK(queue.post(os::WorkQueue::LOW, record, 4));
+    CHECK(queue.post(os::WorkQueue::LOW, record, 5));
+    CHECK(!queue.postFromISR(os::WorkQueue::LOW, record, 6));
+
+    auto statistics = queue.getStatistics();
+    CHECK(statistics.depth == 5);
+    CHECK(statistics.maxDepth == 5);
+    CHECK(statistics.overflows == 1);
+
+    while (queue.dispatch(0)) {}
+    CHECK(ran == 5);
+    CHECK(order[0] == 3);
+    CHECK(order[1] == 1);
+    CHECK(order[4] == 5);
+
+    statistics = queue.getStatistics();
+    CHECK(statistics.depth == 0);
+    CHECK(statistics.dispatched == 5);
+    queue.resetStatistics();
+    CHECK(queue.getStatistics().maxDepth == 0);
+    TestCaseEnd();
+}
+
+int ut_WorkQueueWorkers(void)
+{
+    TestCaseBegin();
+    os::StaticWorkQueue<16> queue;
+    std::atomic<uint32_t> sum {0};
+    os::Semaphore done;
+    const os::WorkQueue::Function add = [&](uint32_t payload) {
+        sum += payload;
+        if (payload == NUM_TEST_LOOPS - 1) {
+            done.give();
+        }
+    };
+    auto worker = [&](const bool& join) {
+        while (!join) {
+            queue.dispatch(std::chrono::milliseconds(10));
+        }
+    };
+    os::TaskInterruptable worker1("Worker1", STACKSIZE, os::Task::Priority::HIGH, worker);
+    os::TaskInterruptable worker2("Worker2", STACKSIZE, os::Task::Priority::HIGH, worker);
+
+    // simulated interrupt
+    std::thread isr([&] {
+        for (uint32_t i = 0; i < NUM_TEST_LOOPS; i++) {
+            while (!queue.postFromISR(os::WorkQueue::HIGH, add, i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    isr.join();
+
+    CHECK(done.take(std::chrono::milliseconds(1000)));
+    worker1.join();
+    worker2.join();
+    CHECK(sum == NUM_TEST_LOOPS * (NUM_TEST_LOOPS - 1) / 2);
+
+    const auto statistics = queue.getStatistics();
+    CHECK(statistics.dispatched == NUM_TEST_LOOPS);
+    CHECK(statistics.depth == 0);
+    CHECK(statistics.maxDepth <= 16);
+    CHECK(statistics.maxLatency < 100);
+    printf("Work queue: max depth %zu, max latency %u ticks, %u overflows\n", statistics.maxDepth,
+           static_cast<unsigned>(statistics.maxLatency), static_cast<unsigned>(statistics.overflows));
+    TestCaseEnd();
+}
+
+int ut_TaskNotifier(void)
+{
+    TestCaseBegin();
+    os::TaskNotifier notifier;
+
+    // nobody waits, the notification is dropped
+    CHECK(notifier.notify() == false);
+    notifier.prepare();
+    CHECK(notifier.wait(std::chrono::milliseconds(5)) == false);
+
+    // only the first notification after prepare reaches the task
+    notifier.prepare();
+    CHECK(notifier.notifyFromISR());
+    CHECK(notifier.notifyFromISR() == false);
+    CHECK(notifier.wait(std::chrono::milliseconds(0)));
+    CHECK(notifier.wait(std::chrono::milliseconds(5)) == false);
+
+    // a late notification of a timed out wait doesn't reach the task
+    notifier.prepare();
+    CHECK(notifier.wait(std::chrono::milliseconds(1)) == false);
+    CHECK(notifier.notify() == false);
+    CHECK(notifier.notifyFromISR() == false);
+    CHECK(notifier.wait(std::chrono::milliseconds(5)) == false);
+    TestCaseEnd();
+}
+
+int ut_TransferCompletionLatency(void)
+{
+    TestCaseBegin();
+    const double semaphore = transferRoundTrip(false);
+    const double notification = transferRoundTrip(true);
+    CHECK(semaphore > 0);
+    CHECK(notification > 0);
+
+    printf("Transfer completion: semaphore %.2f us, task notification %.2f us\n", semaphore, notification);
+    TestCaseEnd();
+}
+
+int ut_SleepAndTicks(void)
+{
+    TestCaseBegin();
+    const uint32_t before = os::Task::getTickCount();
+    os::ThisTask::sleep(std::chrono::milliseconds(20));
+    CHECK(os::Task::getTickCount() - before >= 20);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    std::thread scheduler(os::Task::startScheduler);
+
+    RunTest(true, ut_QueueRoundTrip);
+    RunTest(true, ut_StreamBufferThroughput);
+    RunTest(true, ut_SemaphoreAndMutex);
+    RunTest(true, ut_NotifyFromInterrupt);
+    RunTest(true, ut_EventGroupWaitAny);
+    RunTest(true, ut_SocketEchoLatency);
+    RunTest(true, ut_TimerOneShotAndPeriodic);
+    RunTest(true, ut_TimerDestructorWaitsForCallback);
+    RunTest(true, ut_WorkQueuePriorities);
+    RunTest(true, ut_WorkQueueWorkers);
+    RunTest(true, ut_TaskNotifier);
+    RunTest(true, ut_TransferCompletionLatency);
+    RunTest(true, ut_SleepAndTicks);
+
+    os::Task::endScheduler();
+    scheduler.join();
+    UnitTestMainEnd();
+}
@@ -0,0 +1,1129 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <pthread.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "event_groups.h"
+#include "timers.h"
+
+/*
+ * FreeRTOS kernel API on top of pthreads. Every task is a thread, all kernel
+ * objects are guarded by one recursive lock which also serves as the interrupt
+ * mask of critical sections. Blocked tasks wait on one condition variable that
+ * is broadcast on every state change. Tasks run truly parallel, priorities are
+ * stored but not enforced. Threads calling the API without being created by
+ * xTaskCreate() (main, simulated interrupts) are adopted as tasks on first use.
+ */
+
+struct tskTaskControlBlock {
+    char name[configMAX_TASK_NAME_LEN];
+    TaskFunction_t function = nullptr;
+    void* parameters = nullptr;
+    UBaseType_t priority = 0;
+    bool adopted = false;
+    bool suspended = false;
+    bool deleted = false;
+    bool notificationPending = false;
+    uint32_t notificationValue = 0;
+    UBaseType_t waitingForNotification = 0;
+};
+
+struct QueueDefinition {
+    uint8_t type;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::vector<uint8_t> storage;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+    UBaseType_t waiting = 0;
+    TaskHandle_t holder = nullptr;
+    UBaseType_t recursion = 0;
+};
+
+struct StreamBufferDef_t {
+    std::vector<uint8_t> storage;
+    size_t head = 0;
+    size_t count = 0;
+    size_t triggerLevel = 1;
+    UBaseType_t waiting = 0;
+};
+
+struct EventGroupDef_t {
+    EventBits_t bits = 0;
+};
+
+struct tmrTimerControl {
+    const char* name;
+    TickType_t period;
+    bool autoReload;
+    void* id;
+    TimerCallbackFunction_t callback;
+    bool active = false;
+    bool deleted = false;
+    std::chrono::steady_clock::time_point expiry;
+};
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using Lock = std::unique_lock<std::recursive_mutex>;
+
+struct Kernel {
+    std::recursive_mutex mutex;
+    std::condition_variable_any event;
+    const Clock::time_point start = Clock::now();
+    std::set<TaskHandle_t> tasks;
+    std::set<TimerHandle_t> timers;
+    TimerHandle_t runningTimer = nullptr;
+    std::deque<std::pair<PendedFunction_t, std::pair<void*, uint32_t> > > pendedCalls;
+    bool schedulerStarted = false;
+    bool schedulerEnded = false;
+};
+
+thread_local TaskHandle_t t_currentTask = nullptr;
+
+/*
+ * Function local so objects with static storage may use the kernel during their
+ * construction. Never destroyed, detached task threads may still wait on it at exit.
+ */
+Kernel& kernel(void)
+{
+    static Kernel& k = *new Kernel;
+    return k;
+}
+
+TaskHandle_t currentTask(void)
+{
+    if (t_currentTask == nullptr) {
+        t_currentTask = new tskTaskControlBlock;
+        std::strncpy(t_currentTask->name, "host", sizeof(t_currentTask->name));
+        t_currentTask->adopted = true;
+    }
+    return t_currentTask;
+}
+
+void exitTask(Lock& lock, TaskHandle_t task)
+{
+    kernel().tasks.erase(task);
+    if (task->adopted) {
+        return;
+    }
+    lock.unlock();
+    pthread_exit(nullptr);
+}
+
+/* blocks the calling task until ready() holds, the timeout expires or the task gets deleted */
+template<typename Predicate>
+bool waitFor(Lock& lock, const TickType_t ticksToWait, UBaseType_t& waiting, Predicate ready)
+{
+    TaskHandle_t self = currentTask();
+    auto wakeup = [&] {return ready() || self->deleted; };
+
+    if (!wakeup() && (ticksToWait != 0)) {
+        waiting++;
+        if (ticksToWait == portMAX_DELAY) {
+            kernel().event.wait(lock, wakeup);
+        } else {
+            kernel().event.wait_for(lock, std::chrono::milliseconds(ticksToWait * portTICK_PERIOD_MS), wakeup);
+        }
+        waiting--;
+    }
+    if (self->deleted) {
+        exitTask(lock, self);
+    }
+    return ready();
+}
+
+template<typename Predicate>
+bool waitFor(Lock& lock, const TickType_t ticksToWait, Predicate ready)
+{
+    UBaseType_t waiting = 0;
+    return waitFor(lock, ticksToWait, waiting, ready);
+}
+
+void* taskEntry(void* parameters)
+{
+    TaskHandle_t self = static_cast<TaskHandle_t>(parameters);
+    t_currentTask = self;
+
+    struct Reaper {
+        TaskHandle_t task;
+        ~Reaper(void)
+        {
+            Lock lock(kernel().mutex);
+            kernel().tasks.erase(task);
+            delete task;
+        }
+    } reaper {self};
+
+    {
+        Lock lock(kernel().mutex);
+        waitFor(lock, portMAX_DELAY, [] {return kernel().schedulerStarted; });
+    }
+    self->function(self->parameters);
+    vTaskDelete(nullptr);
+    return nullptr;
+}
+
+/* timer service task, callbacks run without the kernel lock like on the target */
+void timerTask(void* parameters)
+{
+    (void)parameters;
+    Lock lock(kernel().mutex);
+    TaskHandle_t self = currentTask();
+
+    while (!self->deleted) {
+        if (!kernel().pendedCalls.empty()) {
+            const auto call = kernel().pendedCalls.front();
+            kernel().pendedCalls.pop_front();
+            lock.unlock();
+            call.first(call.second.first, call.second.second);
+            lock.lock();
+            continue;
+        }
+
+        TimerHandle_t next = nullptr;
+        for (auto timer : kernel().timers) {
+            if (timer->active && ((next == nullptr) || (timer->expiry < next->expiry))) {
+                next = timer;
+            }
+        }
+
+        if (next == nullptr) {
+            kernel().event.wait(lock);
+        } else if (next->expiry > Clock::now()) {
+            // by value, the timer may be deleted while this task waits
+            const Clock::time_point expiry = next->expiry;
+            kernel().event.wait_until(lock, expiry);
+        } else {
+            next->active = next->autoReload;
+            next->expiry += std::chrono::milliseconds(next->period * portTICK_PERIOD_MS);
+            kernel().runningTimer = next;
+            lock.unlock();
+            next->callback(next);
+            lock.lock();
+            kernel().runningTimer = nullptr;
+            if (next->deleted) {
+                delete next;
+            }
+        }
+    }
+    exitTask(lock, self);
+}
+
+void setWoken(BaseType_t* const woken, const UBaseType_t waiting)
+{
+    if (woken != nullptr) {
+        *woken = waiting != 0 ? pdTRUE : pdFALSE;
+    }
+}
+
+QueueHandle_t createQueue(const UBaseType_t length, const UBaseType_t itemSize, const uint8_t type)
+{
+    auto queue = new QueueDefinition {type, length, itemSize, std::vector<uint8_t>(length * itemSize)};
+    return queue;
+}
+
+BaseType_t queueSend(QueueHandle_t queue, const void* item, const TickType_t ticksToWait,
+                     const BaseType_t position, BaseType_t* const woken)
+{
+    Lock lock(kernel().mutex);
+
+    const bool overwrite = (position == queueOVERWRITE) && (queue->count == queue->length);
+    if (!overwrite && !waitFor(lock, ticksToWait, queue->waiting, [queue] {return queue->count < queue->length; })) {
+        return errQUEUE_FULL;
+    }
+
+    UBaseType_t slot;
+    if (overwrite) {
+        slot = queue->head;
+    } else if (position == queueSEND_TO_FRONT) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+        queue->count++;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+        queue->count++;
+    }
+    if (queue->itemSize != 0) {
+        std::memcpy(queue->storage.data() + slot * queue->itemSize, item, queue->itemSize);
+    }
+    if ((queue->type == queueQUEUE_TYPE_MUTEX) || (queue->type == queueQUEUE_TYPE_RECURSIVE_MUTEX)) {
+        queue->holder = nullptr;
+    }
+    setWoken(woken, queue->waiting);
+    kernel().event.notify_all();
+    return pdPASS;
+}
+
+BaseType_t queueReceive(QueueHandle_t queue, void* const buffer, const TickType_t ticksToWait, const bool remove,
+                        BaseType_t* const woken)
+{
+    Lock lock(kernel().mutex);
+
+    if (!waitFor(lock, ticksToWait, queue->waiting, [queue] {return queue->count != 0; })) {
+        return errQUEUE_EMPTY;
+    }
+    if ((buffer != nullptr) && (queue->itemSize != 0)) {
+        std::memcpy(buffer, queue->storage.data() + queue->head * queue->itemSize, queue->itemSize);
+    }
+    if (remove) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        if ((queue->type == queueQUEUE_TYPE_MUTEX) || (queue->type == queueQUEUE_TYPE_RECURSIVE_MUTEX)) {
+            queue->holder = currentTask();
+        }
+        setWoken(woken, queue->waiting);
+        kernel().event.notify_all();
+    }
+    return pdPASS;
+}
+
+size_t streamBufferSpace(StreamBufferHandle_t buffer)
+{
+    return buffer->storage.size() - buffer->count;
+}
+
+size_t streamBufferSend(StreamBufferHandle_t buffer, const void* data, const size_t length,
+                        const TickType_t ticksToWait, BaseType_t* const woken)
+{
+    Lock lock(kernel().mutex);
+
+    const size_t required = std::min(length, buffer->storage.size());
+    waitFor(lock, ticksToWait, buffer->waiting, [buffer, required] {return streamBufferSpace(buffer) >= required; });
+
+    const size_t count = std::min(length, streamBufferSpace(buffer));
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < count; i++) {
+        buffer->storage[(buffer->head + buffer->count + i) % buffer->storage.size()] = bytes[i];
+    }
+    buffer->count += count;
+    setWoken(woken, buffer->waiting);
+    kernel().event.notify_all();
+    return count;
+}
+
+size_t streamBufferReceive(StreamBufferHandle_t buffer, void* data, const size_t length,
+                           const TickType_t ticksToWait, BaseType_t* const woken)
+{
+    Lock lock(kernel().mutex);
+
+    if (buffer->count == 0) {
+        waitFor(lock, ticksToWait, buffer->waiting, [buffer] {return buffer->count >= buffer->triggerLevel; });
+    }
+
+    const size_t count = std::min(length, buffer->count);
+    auto bytes = static_cast<uint8_t*>(data);
+    for (size_t i = 0; i < count; i++) {
+        bytes[i] = buffer->storage[(buffer->head + i) % buffer->storage.size()];
+    }
+    buffer->head = (buffer->head + count) % buffer->storage.size();
+    buffer->count -= count;
+    setWoken(woken, buffer->waiting);
+    kernel().event.notify_all();
+    return count;
+}
+
+BaseType_t notify(TaskHandle_t task, const uint32_t value, const eNotifyAction action,
+                  uint32_t* const previousValue, BaseType_t* const woken)
+{
+    Lock lock(kernel().mutex);
+
+    if (previousValue != nullptr) {
+        *previousValue = task->notificationValue;
+    }
+    switch (action) {
+    case eSetBits:
+        task->notificationValue |= value;
+        break;
+
+    case eIncrement:
+        task->notificationValue++;
+        break;
+
+    case eSetValueWithOverwrite:
+        task->notificationValue = value;
+        break;
+
+    case eSetValueWithoutOverwrite:
+        if (task->notificationPending) {
+            return pdFAIL;
+        }
+        task->notificationValue = value;
+        break;
+
+    case eNoAction:
+    default:
+        break;
+    }
+    task->notificationPending = true;
+    setWoken(woken, task->waitingForNotification);
+    kernel().event.notify_all();
+    return pdPASS;
+}
+}
+
+/*-----------------------------------------------------------*/
+/* port */
+
+extern "C" void vPortYield(void)
+{
+    std::this_thread::yield();
+}
+
+extern "C" void vPortEnterCritical(void)
+{
+    kernel().mutex.lock();
+}
+
+extern "C" void vPortExitCritical(void)
+{
+    kernel().mutex.unlock();
+}
+
+extern "C" UBaseType_t uxPortSetInterruptMask(void)
+{
+    vPortEnterCritical();
+    return 0;
+}
+
+extern "C" void vPortClearInterruptMask(UBaseType_t uxMask)
+{
+    (void)uxMask;
+    vPortExitCritical();
+}
+
+void* pvPortMalloc(size_t xSize)
+{
+    return std::malloc(xSize);
+}
+
+void vPortFree(void* pv)
+{
+    std::free(pv);
+}
+
+/*-----------------------------------------------------------*/
+/* tasks */
+
+BaseType_t xTaskCreate(TaskFunction_t              pxTaskCode,
+                       const char* const           pcName,
+                       const configSTACK_DEPTH_TYPE usStackDepth,
+                       void* const                 pvParameters,
+                       UBaseType_t                 uxPriority,
+                       TaskHandle_t* const         pxCreatedTask)
+{
+    (void)usStackDepth;
+    auto task = new tskTaskControlBlock;
+    std::strncpy(task->name, pcName, sizeof(task->name) - 1);
+    task->name[sizeof(task->name) - 1] = '\0';
+    task->function = pxTaskCode;
+    task->parameters = pvParameters;
+    task->priority = uxPriority;
+
+    Lock lock(kernel().mutex);
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, taskEntry, task) != 0) {
+        delete task;
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    pthread_detach(thread);
+    kernel().tasks.insert(task);
+    if (pxCreatedTask != nullptr) {
+        *pxCreatedTask = task;
+    }
+    return pdPASS;
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+TaskHandle_t xTaskCreateStatic(TaskFunction_t      pxTaskCode,
+                               const char* const   pcName,
+                               const uint32_t      ulStackDepth,
+                               void* const         pvParameters,
+                               UBaseType_t         uxPriority,
+                               StackType_t* const  puxStackBuffer,
+                               StaticTask_t* const pxTaskBuffer)
+{
+    (void)puxStackBuffer;
+    (void)pxTaskBuffer;
+    TaskHandle_t task = nullptr;
+    xTaskCreate(pxTaskCode, pcName, ulStackDepth, pvParameters, uxPriority, &task);
+    return task;
+}
+#endif
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    Lock lock(kernel().mutex);
+    TaskHandle_t task = xTaskToDelete != nullptr ? xTaskToDelete : currentTask();
+
+    if (task == t_currentTask) {
+        exitTask(lock, task);
+    } else if (kernel().tasks.count(task) != 0) {
+        // the thread leaves at its next kernel call and releases its control block
+        task->deleted = true;
+        kernel().tasks.erase(task);
+        kernel().event.notify_all();
+    }
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    Lock lock(kernel().mutex);
+    waitFor(lock, xTicksToDelay, [] {return false; });
+}
+
+void vTaskDelayUntil(TickType_t* const pxPreviousWakeTime, const TickType_t xTimeIncrement)
+{
+    const TickType_t wakeTime = *pxPreviousWakeTime + xTimeIncrement;
+    const TickType_t now = xTaskGetTickCount();
+
+    *pxPreviousWakeTime = wakeTime;
+    if (static_cast<int32_t>(wakeTime - now) > 0) {
+        vTaskDelay(wakeTime - now);
+    }
+}
+
+UBaseType_t uxTaskPriorityGet(const TaskHandle_t xTask)
+{
+    Lock lock(kernel().mutex);
+    return (xTask != nullptr ? xTask : currentTask())->priority;
+}
+
+UBaseType_t uxTaskPriorityGetFromISR(const TaskHandle_t xTask)
+{
+    return uxTaskPriorityGet(xTask);
+}
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority)
+{
+    Lock lock(kernel().mutex);
+    (xTask != nullptr ? xTask : currentTask())->priority = uxNewPriority;
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend)
+{
+    Lock lock(kernel().mutex);
+    TaskHandle_t task = xTaskToSuspend != nullptr ? xTaskToSuspend : currentTask();
+
+    task->suspended = true;
+    if (task == t_currentTask) {
+        waitFor(lock, portMAX_DELAY, [task] {return !task->suspended; });
+    }
+}
+
+void vTaskResume(TaskHandle_t xTaskToResume)
+{
+    Lock lock(kernel().mutex);
+    xTaskToResume->suspended = false;
+    kernel().event.notify_all();
+}
+
+BaseType_t xTaskResumeFromISR(TaskHandle_t xTaskToResume)
+{
+    Lock lock(kernel().mutex);
+    const BaseType_t wasSuspended = xTaskToResume->suspended ? pdTRUE : pdFALSE;
+    vTaskResume(xTaskToResume);
+    return wasSuspended;
+}
+
+void vTaskStartScheduler(void)
+{
+    Lock lock(kernel().mutex);
+#if configUSE_TIMERS == 1
+    xTaskCreate(timerTask, "Tmr Svc", configTIMER_TASK_STACK_DEPTH, nullptr,
+                configTIMER_TASK_PRIORITY, nullptr);
+#endif
+    kernel().schedulerStarted = true;
+    kernel().schedulerEnded = false;
+    kernel().event.notify_all();
+    kernel().event.wait(lock, [] {return kernel().schedulerEnded; });
+}
+
+void vTaskEndScheduler(void)
+{
+    Lock lock(kernel().mutex);
+    for (auto task : kernel().tasks) {
+        task->deleted = true;
+    }
+    kernel().tasks.clear();
+    kernel().schedulerStarted = false;
+    kernel().schedulerEnded = true;
+    kernel().event.notify_all();
+}
+
+void vTaskSuspendAll(void)
+{
+    vPortEnterCritical();
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    vPortExitCritical();
+    return pdFALSE;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+    Lock lock(kernel().mutex);
+    return kernel().schedulerStarted ? taskSCHEDULER_RUNNING : taskSCHEDULER_NOT_STARTED;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - kernel().start);
+    return static_cast<TickType_t>(elapsed.count() / portTICK_PERIOD_MS);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    Lock lock(kernel().mutex);
+    return kernel().tasks.size();
+}
+
+char* pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+    return (xTaskToQuery != nullptr ? xTaskToQuery : currentTask())->name;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return currentTask();
+}
+
+/*-----------------------------------------------------------*/
+/* task notifications */
+
+BaseType_t xTaskGenericNotify(TaskHandle_t  xTaskToNotify,
+                              uint32_t      ulValue,
+                              eNotifyAction eAction,
+                              uint32_t*     pulPreviousNotificationValue)
+{
+    return notify(xTaskToNotify, ulValue, eAction, pulPreviousNotificationValue, nullptr);
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t  xTaskToNotify,
+                                     uint32_t      ulValue,
+                                     eNotifyAction eAction,
+                                     uint32_t*     pulPreviousNotificationValue,
+                                     BaseType_t*   pxHigherPriorityTaskWoken)
+{
+    return notify(xTaskToNotify, ulValue, eAction, pulPreviousNotificationValue, pxHigherPriorityTaskWoken);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken)
+{
+    notify(xTaskToNotify, 0, eIncrement, nullptr, pxHigherPriorityTaskWoken);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    Lock lock(kernel().mutex);
+    TaskHandle_t self = currentTask();
+
+    waitFor(lock, xTicksToWait, self->waitingForNotification, [self] {return self->notificationValue != 0; });
+
+    const uint32_t value = self->notificationValue;
+    if (value != 0) {
+        self->notificationValue = xClearCountOnExit != pdFALSE ? 0 : value - 1;
+    }
+    self->notificationPending = false;
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t  ulBitsToClearOnEntry,
+                           uint32_t  ulBitsToClearOnExit,
+                           uint32_t* pulNotificationValue,
+                           TickType_t xTicksToWait)
+{
+    Lock lock(kernel().mutex);
+    TaskHandle_t self = currentTask();
+
+    if (!self->notificationPending) {
+        self->notificationValue &= ~ulBitsToClearOnEntry;
+    }
+    const bool received = waitFor(lock, xTicksToWait, self->waitingForNotification,
+                                  [self] {return self->notificationPending; });
+    if (pulNotificationValue != nullptr) {
+        *pulNotificationValue = self->notificationValue;
+    }
+    if (received) {
+        self->notificationValue &= ~ulBitsToClearOnExit;
+    }
+    self->notificationPending = false;
+    return received ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+/* queues and semaphores */
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize,
+                                  const uint8_t ucQueueType)
+{
+    return createQueue(uxQueueLength, uxItemSize, ucQueueType);
+}
+
+QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType)
+{
+    QueueHandle_t mutex = createQueue(1, 0, ucQueueType);
+    mutex->count = 1;
+    return mutex;
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount)
+{
+    QueueHandle_t semaphore = createQueue(uxMaxCount, 0, queueQUEUE_TYPE_COUNTING_SEMAPHORE);
+    semaphore->count = uxInitialCount;
+    return semaphore;
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+QueueHandle_t xQueueGenericCreateStatic(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize,
+                                        uint8_t* pucQueueStorage, StaticQueue_t* pxStaticQueue,
+                                        const uint8_t ucQueueType)
+{
+    (void)pucQueueStorage;
+    (void)pxStaticQueue;
+    return xQueueGenericCreate(uxQueueLength, uxItemSize, ucQueueType);
+}
+
+QueueHandle_t xQueueCreateMutexStatic(const uint8_t ucQueueType, StaticQueue_t* pxStaticQueue)
+{
+    (void)pxStaticQueue;
+    return xQueueCreateMutex(ucQueueType);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphoreStatic(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount,
+                                                  StaticQueue_t* pxStaticQueue)
+{
+    (void)pxStaticQueue;
+    return xQueueCreateCountingSemaphore(uxMaxCount, uxInitialCount);
+}
+#endif
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    Lock lock(kernel().mutex);
+    delete xQueue;
+}
+
+BaseType_t xQueueGenericReset(QueueHandle_t xQueue, BaseType_t xNewQueue)
+{
+    (void)xNewQueue;
+    Lock lock(kernel().mutex);
+    xQueue->head = 0;
+    xQueue->count = 0;
+    kernel().event.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void* const pvItemToQueue, TickType_t xTicksToWait,
+                             const BaseType_t xCopyPosition)
+{
+    return queueSend(xQueue, pvItemToQueue, xTicksToWait, xCopyPosition, nullptr);
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void* const pvItemToQueue,
+                                    BaseType_t* const pxHigherPriorityTaskWoken, const BaseType_t xCopyPosition)
+{
+    return queueSend(xQueue, pvItemToQueue, 0, xCopyPosition, pxHigherPriorityTaskWoken);
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t* const pxHigherPriorityTaskWoken)
+{
+    return queueSend(xQueue, nullptr, 0, queueSEND_TO_BACK, pxHigherPriorityTaskWoken);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait)
+{
+    return queueReceive(xQueue, pvBuffer, xTicksToWait, true, nullptr);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void* const pvBuffer,
+                                BaseType_t* const pxHigherPriorityTaskWoken)
+{
+    return queueReceive(xQueue, pvBuffer, 0, true, pxHigherPriorityTaskWoken);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait)
+{
+    return queueReceive(xQueue, pvBuffer, xTicksToWait, false, nullptr);
+}
+
+BaseType_t xQueuePeekFromISR(QueueHandle_t xQueue, void* const pvBuffer)
+{
+    return queueReceive(xQueue, pvBuffer, 0, false, nullptr);
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+    return queueReceive(xQueue, nullptr, xTicksToWait, true, nullptr);
+}
+
+BaseType_t xQueueTakeMutexRecursive(QueueHandle_t xMutex, TickType_t xTicksToWait)
+{
+    Lock lock(kernel().mutex);
+
+    if (xMutex->holder == currentTask()) {
+        xMutex->recursion++;
+        return pdPASS;
+    }
+    if (!waitFor(lock, xTicksToWait, xMutex->waiting, [xMutex] {return xMutex->count != 0; })) {
+        return pdFAIL;
+    }
+    xMutex->count = 0;
+    xMutex->holder = currentTask();
+    xMutex->recursion = 1;
+    return pdPASS;
+}
+
+BaseType_t xQueueGiveMutexRecursive(QueueHandle_t xMutex)
+{
+    Lock lock(kernel().mutex);
+
+    if (xMutex->holder != currentTask()) {
+        return pdFAIL;
+    }
+    if (--xMutex->recursion == 0) {
+        xMutex->count = 1;
+        xMutex->holder = nullptr;
+        kernel().event.notify_all();
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xQueueGetMutexHolder(QueueHandle_t xSemaphore)
+{
+    Lock lock(kernel().mutex);
+    return xSemaphore->holder;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+    Lock lock(kernel().mutex);
+    return xQueue->count;
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue)
+{
+    return uxQueueMessagesWaiting(xQueue);
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue)
+{
+    Lock lock(kernel().mutex);
+    return xQueue->length - xQueue->count;
+}
+
+/*-----------------------------------------------------------*/
+/* stream buffers */
+
+StreamBufferHandle_t xStreamBufferGenericCreate(size_t xBufferSizeBytes, size_t xTriggerLevelBytes,
+                                                BaseType_t xIsMessageBuffer)
+{
+    configASSERT(xIsMessageBuffer == pdFALSE);
+    auto buffer = new StreamBufferDef_t;
+    buffer->storage.resize(xBufferSizeBytes);
+    buffer->triggerLevel = std::max<size_t>(xTriggerLevelBytes, 1);
+    return buffer;
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+StreamBufferHandle_t xStreamBufferGenericCreateStatic(size_t                      xBufferSizeBytes,
+                                                      size_t                      xTriggerLevelBytes,
+                                                      BaseType_t                  xIsMessageBuffer,
+                                                      uint8_t* const              pucStreamBufferStorageArea,
+                                                      StaticStreamBuffer_t* const pxStaticStreamBuffer)
+{
+    (void)pucStreamBufferStorageArea;
+    (void)pxStaticStreamBuffer;
+    // like the kernel, one byte of the static storage area is never used
+    return xStreamBufferGenericCreate(xBufferSizeBytes - 1, xTriggerLevelBytes, xIsMessageBuffer);
+}
+#endif
+
+void vStreamBufferDelete(StreamBufferHandle_t xStreamBuffer)
+{
+    Lock lock(kernel().mutex);
+    delete xStreamBuffer;
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer, const void* pvTxData, size_t xDataLengthBytes,
+                         TickType_t xTicksToWait)
+{
+    return streamBufferSend(xStreamBuffer, pvTxData, xDataLengthBytes, xTicksToWait, nullptr);
+}
+
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t xStreamBuffer, const void* pvTxData, size_t xDataLengthBytes,
+                                BaseType_t* const pxHigherPriorityTaskWoken)
+{
+    return streamBufferSend(xStreamBuffer, pvTxData, xDataLengthBytes, 0, pxHigherPriorityTaskWoken);
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void* pvRxData, size_t xBufferLengthBytes,
+                            TickType_t xTicksToWait)
+{
+    return streamBufferReceive(xStreamBuffer, pvRxData, xBufferLengthBytes, xTicksToWait, nullptr);
+}
+
+size_t xStreamBufferReceiveFromISR(StreamBufferHandle_t xStreamBuffer, void* pvRxData, size_t xBufferLengthBytes,
+                                   BaseType_t* const pxHigherPriorityTaskWoken)
+{
+    return streamBufferReceive(xStreamBuffer, pvRxData, xBufferLengthBytes, 0, pxHigherPriorityTaskWoken);
+}
+
+BaseType_t xStreamBufferIsFull(StreamBufferHandle_t xStreamBuffer)
+{
+    Lock lock(kernel().mutex);
+    return streamBufferSpace(xStreamBuffer) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t xStreamBuffer)
+{
+    Lock lock(kernel().mutex);
+    return xStreamBuffer->count == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t xStreamBuffer)
+{
+    Lock lock(kernel().mutex);
+    if (xStreamBuffer->waiting != 0) {
+        return pdFAIL;
+    }
+    xStreamBuffer->head = 0;
+    xStreamBuffer->count = 0;
+    return pdPASS;
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+    Lock lock(kernel().mutex);
+    return streamBufferSpace(xStreamBuffer);
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+    Lock lock(kernel().mutex);
+    return xStreamBuffer->count;
+}
+
+BaseType_t xStreamBufferSetTriggerLevel(StreamBufferHandle_t xStreamBuffer, size_t xTriggerLevel)
+{
+    Lock lock(kernel().mutex);
+    if (xTriggerLevel > xStreamBuffer->storage.size()) {
+        return pdFALSE;
+    }
+    xStreamBuffer->triggerLevel = std::max<size_t>(xTriggerLevel, 1);
+    return pdTRUE;
+}
+
+BaseType_t xStreamBufferSendCompletedFromISR(StreamBufferHandle_t xStreamBuffer,
+                                             BaseType_t*          pxHigherPriorityTaskWoken)
+{
+    Lock lock(kernel().mutex);
+    setWoken(pxHigherPriorityTaskWoken, xStreamBuffer->waiting);
+    kernel().event.notify_all();
+    return xStreamBuffer->waiting != 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xStreamBufferReceiveCompletedFromISR(StreamBufferHandle_t xStreamBuffer,
+                                                BaseType_t*          pxHigherPriorityTaskWoken)
+{
+    return xStreamBufferSendCompletedFromISR(xStreamBuffer, pxHigherPriorityTaskWoken);
+}
+
+/*-----------------------------------------------------------*/
+/* event groups */
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return new EventGroupDef_t;
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* pxEventGroupBuffer)
+{
+    (void)pxEventGroupBuffer;
+    return xEventGroupCreate();
+}
+#endif
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    Lock lock(kernel().mutex);
+    delete xEventGroup;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    Lock lock(kernel().mutex);
+    xEventGroup->bits |= uxBitsToSet;
+    kernel().event.notify_all();
+    return xEventGroup->bits;
+}
+
+/* xEventGroupSetBitsFromISR() pends this to the timer task */
+void vEventGroupSetBitsCallback(void* pvEventGroup, const uint32_t ulBitsToSet)
+{
+    xEventGroupSetBits(static_cast<EventGroupHandle_t>(pvEventGroup), ulBitsToSet);
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    Lock lock(kernel().mutex);
+    const EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    return bits;
+}
+
+EventBits_t xEventGroupGetBitsFromISR(EventGroupHandle_t xEventGroup)
+{
+    Lock lock(kernel().mutex);
+    return xEventGroup->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait)
+{
+    Lock lock(kernel().mutex);
+
+    auto ready = [xEventGroup, uxBitsToWaitFor, xWaitForAllBits] {
+        const EventBits_t set = xEventGroup->bits & uxBitsToWaitFor;
+        return xWaitForAllBits ? set == uxBitsToWaitFor : set != 0;
+    };
+    const bool satisfied = waitFor(lock, xTicksToWait, ready);
+    const EventBits_t bits = xEventGroup->bits;
+    if (satisfied && xClearOnExit) {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    return bits;
+}
+
+/*-----------------------------------------------------------*/
+/* software timers, commands are executed immediately instead of being queued */
+
+TimerHandle_t xTimerCreate(const char* const pcTimerName, const TickType_t xTimerPeriodInTicks,
+                           const UBaseType_t uxAutoReload, void* const pvTimerID,
+                           TimerCallbackFunction_t pxCallbackFunction)
+{
+    if (xTimerPeriodInTicks == 0) {
+        return nullptr;
+    }
+    auto timer = new tmrTimerControl {pcTimerName, xTimerPeriodInTicks, uxAutoReload != pdFALSE, pvTimerID,
+                                      pxCallbackFunction};
+
+    Lock lock(kernel().mutex);
+    kernel().timers.insert(timer);
+    return timer;
+}
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+TimerHandle_t xTimerCreateStatic(const char* const pcTimerName, const TickType_t xTimerPeriodInTicks,
+                                 const UBaseType_t uxAutoReload, void* const pvTimerID,
+                                 TimerCallbackFunction_t pxCallbackFunction, StaticTimer_t* pxTimerBuffer)
+{
+    (void)pxTimerBuffer;
+    return xTimerCreate(pcTimerName, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction);
+}
+#endif
+
+BaseType_t xTimerGenericCommand(TimerHandle_t xTimer, const BaseType_t xCommandID, const TickType_t xOptionalValue,
+                                BaseType_t* const pxHigherPriorityTaskWoken, const TickType_t xTicksToWait)
+{
+    (void)xTicksToWait;
+    setWoken(pxHigherPriorityTaskWoken, 0);
+
+    Lock lock(kernel().mutex);
+    const BaseType_t command = xCommandID >= tmrFIRST_FROM_ISR_COMMAND ?
+                               xCommandID - (tmrFIRST_FROM_ISR_COMMAND - tmrCOMMAND_START) : xCommandID;
+    switch (command) {
+    case tmrCOMMAND_CHANGE_PERIOD:
+        if (xOptionalValue == 0) {
+            return pdFAIL;
+        }
+        xTimer->period = xOptionalValue;
+    /* fall through */
+    case tmrCOMMAND_START:
+    case tmrCOMMAND_RESET:
+        xTimer->active = true;
+        xTimer->expiry = Clock::now() + std::chrono::milliseconds(xTimer->period * portTICK_PERIOD_MS);
+        break;
+
+    case tmrCOMMAND_STOP:
+        xTimer->active = false;
+        break;
+
+    case tmrCOMMAND_DELETE:
+        kernel().timers.erase(xTimer);
+        if (kernel().runningTimer == xTimer) {
+            // released by the timer task once the callback returned
+            xTimer->active = false;
+            xTimer->deleted = true;
+        } else {
+            delete xTimer;
+        }
+        break;
+
+    default:
+        return pdFAIL;
+    }
+    kernel().event.notify_all();
+    return pdPASS;
+}
+
+/* runs in the timer task after the callbacks and pended calls before it */
+BaseType_t xTimerPendFunctionCall(PendedFunction_t xFunctionToPend, void* pvParameter1, uint32_t ulParameter2,
+                                  TickType_t xTicksToWait)
+{
+    (void)xTicksToWait;
+    Lock lock(kernel().mutex);
+    kernel().pendedCalls.emplace_back(xFunctionToPend, std::make_pair(pvParameter1, ulParameter2));
+    kernel().event.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xTimerPendFunctionCallFromISR(PendedFunction_t xFunctionToPend, void* pvParameter1,
+                                         uint32_t ulParameter2, BaseType_t* pxHigherPriorityTaskWoken)
+{
+    setWoken(pxHigherPriorityTaskWoken, 0);
+    return xTimerPendFunctionCall(xFunctionToPend, pvParameter1, ulParameter2, 0);
+}
+
+void* pvTimerGetTimerID(const TimerHandle_t xTimer)
+{
+    Lock lock(kernel().mutex);
+    return xTimer->id;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+{
+    Lock lock(kernel().mutex);
+    return xTimer->active ? pdTRUE : pdFALSE;
+}
+
+const char* pcTimerGetName(TimerHandle_t xTimer)
+{
+    return xTimer->name;
+}
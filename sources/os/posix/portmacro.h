@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host port of the FreeRTOS API used by sources/os. Every task runs in its own
+ * pthread, see port.cpp. Selected by putting sources/os/posix in front of the
+ * ARM port on the include path.
+ */
+#define portHOST_POSIX 1
+
+/* Type definitions. */
+#define portCHAR char
+#define portFLOAT float
+#define portDOUBLE double
+#define portLONG long
+#define portSHORT short
+#define portSTACK_TYPE uint32_t
+#define portBASE_TYPE long
+#define portPOINTER_SIZE_TYPE size_t
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY (TickType_t)0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH (-1)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT 8
+#define portNOP()
+
+/* Scheduler utilities. */
+extern void vPortYield(void);
+#define portYIELD() vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired) if ((xSwitchRequired) != pdFALSE) { portYIELD(); }
+#define portYIELD_FROM_ISR(x) portEND_SWITCHING_ISR(x)
+
+/* Critical section management, one recursive kernel lock stands in for the interrupt mask. */
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+extern UBaseType_t uxPortSetInterruptMask(void);
+extern void vPortClearInterruptMask(UBaseType_t uxMask);
+#define portSET_INTERRUPT_MASK_FROM_ISR() uxPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) vPortClearInterruptMask(x)
+#define portDISABLE_INTERRUPTS()
+#define portENABLE_INTERRUPTS()
+#define portENTER_CRITICAL() vPortEnterCritical()
+#define portEXIT_CRITICAL() vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void* pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters) void vFunction(void* pvParameters)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
@@ -41,6 +41,7 @@ extern "C" {
 #include <stdint.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <malloc.h>
 
 #if defined (STM32F303xC) || defined (STM32F334x8) || defined (STM32F302x8) || defined (STM32F303xE)
 #include "stm32f30x.h"
@@ -352,11 +353,12 @@ ssize_t _read_r(struct _reent* r, int file, void* buf, size_t nbyte)
 * \return pointer to new data space.
 *//*-------------------------------------------------------------------------*/
 
+extern char __heap_start;                   // imported from linker script
+extern char __heap_end;                     // imported from linker script
+static char* current_heap_end = &__heap_start;
+
 caddr_t _sbrk_r(struct _reent* r, int size)
 {
-    extern char __heap_start;               // imported from linker script
-    extern char __heap_end;                 // imported from linker script
-    static char* current_heap_end = &__heap_start;
     char* previous_heap_end;
 
     r = r;                                  // suppress warning
@@ -373,6 +375,20 @@ caddr_t _sbrk_r(struct _reent* r, int size)
     return (caddr_t)previous_heap_end;      // return requested data space
 }
 
+/*------------------------------------------------------------------------*//**
+* \brief Free heap space.
+* \details heap_3 forwards to malloc(), which has no xPortGetFreeHeapSize().
+* The free space is the part of the heap area not yet claimed by _sbrk_r()
+* plus the free chunks malloc() holds.
+*
+* \return free heap space in bytes.
+*//*-------------------------------------------------------------------------*/
+
+size_t xPortGetFreeHeapSize(void)
+{
+    return (&__heap_end - current_heap_end) + mallinfo().fordblks;
+}
+
 #endif
 
 #if SYSCALLS_HAVE_STAT_R == 1
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <algorithm>
+
+/*
+ * Received frame as stored in the ring, 16 bytes instead of the 20 of a
+ * CanRxMsg. mTimestamp is the TIME field of the bxCAN, the value of its 16 bit
+ * bit time counter at the start of frame. It stays 0 unless the time
+ * triggered communication mode (TTCM) is enabled.
+ */
+struct CanFrame {
+    static constexpr const uint32_t EXTENDED = 0x80000000;
+    static constexpr const uint32_t REMOTE = 0x40000000;
+    static constexpr const uint32_t IDMASK = 0x1FFFFFFF;
+
+    uint32_t mId;
+    uint16_t mTimestamp;
+    uint8_t mLength;
+    uint8_t mFilter;
+    std::array<uint8_t, 8> mData;
+
+    uint32_t getId(void) const {return mId & IDMASK; }
+    bool isExtended(void) const {return mId & EXTENDED; }
+    bool isRemote(void) const {return mId & REMOTE; }
+};
+static_assert(sizeof(CanFrame) == 16, "CanFrame isn't compact");
+
+/*
+ * Software receive ring of a bxCAN. The receive interrupt calls drain() for
+ * both hardware fifos. It empties the three mailboxes of a fifo in one go,
+ * so the ring takes the bursts a task sleeping between its reads would miss.
+ * The task takes whole batches with receive().
+ *
+ * A frame is lost either in the hardware, if the fifo overran before the
+ * interrupt was served, or because the ring was full. Both are counted per
+ * fifo, a frame that doesn't fit into the ring is still released from the
+ * hardware.
+ *
+ * drain() takes the registers as template parameter, CAN_TypeDef on the
+ * target and a mock in the unittest. Single producer (the interrupt) and
+ * single consumer (one task).
+ */
+class CanRxRing
+{
+public:
+    static constexpr const size_t NUMBER_OF_FIFOS = 2;
+
+    template<size_t n>
+    CanRxRing(std::array<CanFrame, n>& buffer) : mBuffer(buffer.data()), mMask(n - 1)
+    {
+        static_assert((n & (n - 1)) == 0, "CanRxRing size has to be a power of two");
+        resetCounters();
+    }
+
+    CanRxRing(const CanRxRing&) = delete;
+    CanRxRing(CanRxRing&&) = delete;
+    CanRxRing& operator=(const CanRxRing&) = delete;
+    CanRxRing& operator=(CanRxRing&&) = delete;
+
+    /* moves all frames pending in fifo into the ring, returns how many were stored */
+    template<typename Registers>
+    size_t drain(Registers& can, const uint8_t fifo);
+
+    /* copies the frame at the head of fifo and releases its mailbox, false if the fifo is empty */
+    template<typename Registers>
+    static bool readMailbox(Registers& can, const uint8_t fifo, CanFrame& frame);
+
+    size_t receive(CanFrame* const frames, const size_t length);
+
+    size_t size(void) const {return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire); }
+    size_t capacity(void) const {return mMask + 1; }
+
+    size_t getDropped(const uint8_t fifo) const {return mDropped[fifo]; }
+    size_t getOverruns(const uint8_t fifo) const {return mOverruns[fifo]; }
+    size_t getPeakFillLevel(void) const {return mPeakFillLevel; }
+    void resetCounters(void);
+
+private:
+    // bxCAN register bits, RM0008 24.9
+    static constexpr const uint32_t RFR_FMP = 0x03;
+    static constexpr const uint32_t RFR_FOVR = 0x10;
+    static constexpr const uint32_t RFR_RFOM = 0x20;
+    static constexpr const uint32_t RIR_IDE = 0x04;
+    static constexpr const uint32_t RIR_RTR = 0x02;
+    static constexpr const uint32_t RDTR_DLC = 0x0F;
+
+    CanFrame* const mBuffer;
+    const size_t mMask;
+    std::atomic<size_t> mHead {0};
+    std::atomic<size_t> mTail {0};
+
+    std::array<size_t, NUMBER_OF_FIFOS> mDropped;
+    std::array<size_t, NUMBER_OF_FIFOS> mOverruns;
+    size_t mPeakFillLevel;
+
+    template<typename Registers>
+    static auto& fifoRegister(Registers& can, const uint8_t fifo) {return fifo ? can.RF1R : can.RF0R; }
+};
+
+template<typename Registers>
+size_t CanRxRing::drain(Registers& can, const uint8_t fifo)
+{
+    auto& rfr = fifoRegister(can, fifo);
+    if (rfr & RFR_FOVR) {
+        mOverruns[fifo]++;
+        rfr = RFR_FOVR;
+    }
+
+    size_t head = mHead.load(std::memory_order_relaxed);
+    const size_t tail = mTail.load(std::memory_order_acquire);
+    size_t stored = 0;
+    while (rfr & RFR_FMP) {
+        if (head - tail > mMask) {
+            CanFrame discarded;
+            readMailbox(can, fifo, discarded);
+            mDropped[fifo]++;
+            continue;
+        }
+        readMailbox(can, fifo, mBuffer[head & mMask]);
+        head++;
+        stored++;
+    }
+    mHead.store(head, std::memory_order_release);
+    mPeakFillLevel = std::max(mPeakFillLevel, head - tail);
+    return stored;
+}
+
+template<typename Registers>
+bool CanRxRing::readMailbox(Registers& can, const uint8_t fifo, CanFrame& frame)
+{
+    auto& rfr = fifoRegister(can, fifo);
+    if ((rfr & RFR_FMP) == 0) {
+        return false;
+    }
+
+    const auto& mailbox = can.sFIFOMailBox[fifo];
+    const uint32_t rir = mailbox.RIR;
+    const uint32_t rdtr = mailbox.RDTR;
+    const uint32_t rdlr = mailbox.RDLR;
+    const uint32_t rdhr = mailbox.RDHR;
+    rfr = RFR_RFOM;
+
+    if (rir & RIR_IDE) {
+        frame.mId = ((rir >> 3) & CanFrame::IDMASK) | CanFrame::EXTENDED;
+    } else {
+        frame.mId = rir >> 21;
+    }
+    if (rir & RIR_RTR) {
+        frame.mId |= CanFrame::REMOTE;
+    }
+    frame.mTimestamp = rdtr >> 16;
+    frame.mLength = std::min<uint8_t>(rdtr & RDTR_DLC, frame.mData.size());
+    frame.mFilter = rdtr >> 8;
+    for (size_t i = 0; i < 4; i++) {
+        frame.mData[i] = rdlr >> (8 * i);
+        frame.mData[i + 4] = rdhr >> (8 * i);
+    }
+    return true;
+}
+
+inline size_t CanRxRing::receive(CanFrame* const frames, const size_t length)
+{
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    const size_t head = mHead.load(std::memory_order_acquire);
+    const size_t count = std::min(length, head - tail);
+
+    for (size_t i = 0; i < count; i++) {
+        frames[i] = mBuffer[(tail + i) & mMask];
+    }
+    mTail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+inline void CanRxRing::resetCounters(void)
+{
+    mDropped.fill(0);
+    mOverruns.fill(0);
+    mPeakFillLevel = 0;
+}
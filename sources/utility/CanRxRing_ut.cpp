@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <deque>
+#include <cstdio>
+
+#include "unittest.h"
+#include "CanRxRing.h"
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t RINGSIZE = 8;
+
+//--------------------------MOCKING--------------------------
+
+/*
+ * Stands in for the receive side of the bxCAN registers. Every fifo holds
+ * three mailboxes, sFIFOMailBox shows the oldest one. Writing RFOM releases
+ * it, writing FOVR clears the overrun flag, like the rc_w1 bits of RFxR.
+ */
+struct MockBxCan {
+    struct Mailbox {
+        uint32_t RIR;
+        uint32_t RDTR;
+        uint32_t RDLR;
+        uint32_t RDHR;
+    };
+
+    static constexpr const size_t DEPTH = 3;
+
+    struct FifoRegister {
+        MockBxCan& mCan;
+        const uint8_t mFifo;
+
+        operator uint32_t() const
+        {
+            const size_t pending = mCan.mPending[mFifo].size();
+            return pending | ((pending == DEPTH) << 3) | (mCan.mOverrun[mFifo] << 4);
+        }
+
+        FifoRegister& operator=(const uint32_t value)
+        {
+            if (value & 0x10) {
+                mCan.mOverrun[mFifo] = false;
+            }
+            if ((value & 0x20) && !mCan.mPending[mFifo].empty()) {
+                mCan.mPending[mFifo].pop_front();
+                mCan.update(mFifo);
+            }
+            return *this;
+        }
+    };
+
+    FifoRegister RF0R {*this, 0};
+    FifoRegister RF1R {*this, 1};
+    std::array<Mailbox, 2> sFIFOMailBox {};
+
+    std::array<std::deque<Mailbox>, 2> mPending;
+    std::array<bool, 2> mOverrun {};
+    size_t mLost = 0;
+
+    /* a frame arriving at a full fifo is lost and sets FOVR */
+    void arrive(const uint8_t fifo, const Mailbox& mailbox)
+    {
+        if (mPending[fifo].size() == DEPTH) {
+            mOverrun[fifo] = true;
+            mLost++;
+            return;
+        }
+        mPending[fifo].push_back(mailbox);
+        update(fifo);
+    }
+
+    void update(const uint8_t fifo)
+    {
+        sFIFOMailBox[fifo] = mPending[fifo].empty() ? Mailbox {} : mPending[fifo].front();
+    }
+};
+
+static MockBxCan::Mailbox standardFrame(const uint32_t id, const uint16_t time = 0)
+{
+    return MockBxCan::Mailbox {id << 21, (static_cast<uint32_t>(time) << 16) | 8, id, ~id};
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_DecodesMailbox(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    CanFrame frame;
+
+    CHECK(!CanRxRing::readMailbox(can, 0, frame));
+
+    can.arrive(0, MockBxCan::Mailbox {0x123u << 21, 0xBEEF0305, 0x44332211, 0x88776655});
+    can.arrive(1, MockBxCan::Mailbox {(0x1ABCDEF0u << 3) | 0x04 | 0x02, 0x00010C00, 0, 0});
+
+    CHECK(CanRxRing::readMailbox(can, 0, frame));
+    CHECK(frame.getId() == 0x123);
+    CHECK(!frame.isExtended());
+    CHECK(!frame.isRemote());
+    CHECK(frame.mTimestamp == 0xBEEF);
+    CHECK(frame.mFilter == 3);
+    CHECK(frame.mLength == 5);
+    for (size_t i = 0; i < frame.mData.size(); i++) {
+        CHECK(frame.mData[i] == 0x11 * (i + 1));
+    }
+    // released
+    CHECK(can.mPending[0].empty());
+
+    CHECK(CanRxRing::readMailbox(can, 1, frame));
+    CHECK(frame.getId() == 0x1ABCDEF0);
+    CHECK(frame.isExtended());
+    CHECK(frame.isRemote());
+    CHECK(frame.mTimestamp == 1);
+    CHECK(frame.mFilter == 0x0C);
+    CHECK(frame.mLength == 0);
+
+    // a DLC above 8 still means 8 bytes
+    can.arrive(0, MockBxCan::Mailbox {0, 0x0F, 0, 0});
+    CHECK(CanRxRing::readMailbox(can, 0, frame));
+    CHECK(frame.mLength == 8);
+    TestCaseEnd();
+}
+
+int ut_ReceivesBatches(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    std::array<CanFrame, RINGSIZE> buffer;
+    CanRxRing ring(buffer);
+    std::array<CanFrame, RINGSIZE> frames;
+
+    CHECK(ring.capacity() == RINGSIZE);
+    CHECK(ring.drain(can, 0) == 0);
+    CHECK(ring.receive(frames.data(), frames.size()) == 0);
+
+    uint32_t id = 0;
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t k = 0; k < MockBxCan::DEPTH; k++) {
+            can.arrive(0, standardFrame(++id));
+        }
+        CHECK(ring.drain(can, 0) == MockBxCan::DEPTH);
+        CHECK(can.mPending[0].empty());
+    }
+    CHECK(ring.size() == 6);
+
+    CHECK(ring.receive(frames.data(), 4) == 4);
+    CHECK(ring.receive(frames.data() + 4, frames.size()) == 2);
+    for (size_t i = 0; i < 6; i++) {
+        CHECK(frames[i].getId() == i + 1);
+        CHECK(frames[i].mData[0] == i + 1);
+    }
+    CHECK(ring.size() == 0);
+
+    // wraps around
+    for (size_t k = 0; k < MockBxCan::DEPTH; k++) {
+        can.arrive(1, standardFrame(++id));
+    }
+    CHECK(ring.drain(can, 1) == MockBxCan::DEPTH);
+    CHECK(ring.receive(frames.data(), frames.size()) == MockBxCan::DEPTH);
+    CHECK(frames[0].getId() == 7);
+    CHECK(frames[2].getId() == 9);
+    CHECK(ring.getPeakFillLevel() == 6);
+    TestCaseEnd();
+}
+
+int ut_CountsLossesPerFifo(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    std::array<CanFrame, RINGSIZE> buffer;
+    CanRxRing ring(buffer);
+
+    // the fourth frame overruns fifo 0
+    for (uint32_t id = 1; id <= 4; id++) {
+        can.arrive(0, standardFrame(id));
+    }
+    CHECK(ring.drain(can, 0) == MockBxCan::DEPTH);
+    CHECK(ring.getOverruns(0) == 1);
+    CHECK(ring.getOverruns(1) == 0);
+    CHECK(!can.mOverrun[0]);
+
+    // only two of these fit into the ring, the others are released anyway
+    for (uint32_t id = 5; id <= 7; id++) {
+        can.arrive(1, standardFrame(id));
+    }
+    CHECK(ring.drain(can, 1) == 3);
+    for (uint32_t id = 8; id <= 10; id++) {
+        can.arrive(1, standardFrame(id));
+    }
+    CHECK(ring.drain(can, 1) == 2);
+    CHECK(can.mPending[1].empty());
+    CHECK(ring.getDropped(0) == 0);
+    CHECK(ring.getDropped(1) == 1);
+    CHECK(ring.size() == RINGSIZE);
+
+    std::array<CanFrame, RINGSIZE> frames;
+    CHECK(ring.receive(frames.data(), frames.size()) == RINGSIZE);
+    CHECK(frames[RINGSIZE - 1].getId() == 9);
+
+    ring.resetCounters();
+    CHECK(ring.getOverruns(0) == 0);
+    CHECK(ring.getDropped(1) == 0);
+    CHECK(ring.getPeakFillLevel() == 0);
+    TestCaseEnd();
+}
+
+/*
+ * One second of a 1 Mbit/s bus fully loaded with 8 byte standard frames,
+ * one every 135 us, all filtered into fifo 0. The consumer wakes every 5 ms
+ * like DashBoardRx. Without the ring it takes one frame per wake from the
+ * hardware fifo, with the ring the interrupt drains the fifo on every frame
+ * and the consumer takes everything in the ring.
+ */
+template<size_t n>
+static size_t lostFrames(const bool buffered, size_t& counted)
+{
+    static constexpr const uint32_t FRAMETIMEUS = 135;
+    static constexpr const uint32_t WAKEUPUS = 5000;
+    static constexpr const uint32_t DURATIONUS = 1000000;
+
+    MockBxCan can;
+    std::array<CanFrame, n> buffer;
+    CanRxRing ring(buffer);
+    std::array<CanFrame, n> frames;
+
+    size_t sent = 0;
+    size_t received = 0;
+    uint32_t nextWakeup = WAKEUPUS;
+    for (uint32_t now = 0; now < DURATIONUS; now += FRAMETIMEUS) {
+        can.arrive(0, standardFrame(sent++ & 0x7FF, now));
+        if (buffered) {
+            ring.drain(can, 0);
+        }
+
+        if (now >= nextWakeup) {
+            nextWakeup += WAKEUPUS;
+            if (buffered) {
+                received += ring.receive(frames.data(), frames.size());
+            } else {
+                received += CanRxRing::readMailbox(can, 0, frames[0]);
+            }
+        }
+    }
+    received += ring.receive(frames.data(), frames.size());
+    while (CanRxRing::readMailbox(can, 0, frames[0])) {
+        received++;
+    }
+
+    counted = buffered ? ring.getOverruns(0) + ring.getDropped(0) : can.mLost;
+    return sent - received;
+}
+
+int ut_LossAtFullBusLoad(void)
+{
+    TestCaseBegin();
+    size_t counted;
+    const size_t polled = lostFrames<1>(false, counted);
+    CHECK(polled == counted);
+    const size_t ring16 = lostFrames<16>(true, counted);
+    CHECK(ring16 == counted);
+    const size_t ring64 = lostFrames<64>(true, counted);
+    CHECK(ring64 == counted);
+
+    CHECK(polled > 7000);
+    CHECK(ring16 < polled);
+    CHECK(ring64 == 0);
+    printf("Frames lost of 7408 at 1 Mbit/s with a 5 ms consumer: polled %zu, 16 frame ring %zu, 64 frame ring %zu\n",
+           polled, ring16, ring64);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_DecodesMailbox);
+    RunTest(true, ut_ReceivesBatches);
+    RunTest(true, ut_CountsLossesPerFifo);
+    RunTest(true, ut_LossAtFullBusLoad);
+    UnitTestMainEnd();
+}
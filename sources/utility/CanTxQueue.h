@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include "InplaceFunction.h"
+#include "CanRxRing.h"
+
+/*
+ * Transmit queue of a bxCAN, ordered like the bus arbitration orders the
+ * frames. The transmit interrupt (RQCP of a mailbox) takes the completed
+ * frames out and loads the best queued ones into the free mailboxes, so all
+ * three stay loaded as long as there is something to send. Frames of the
+ * same priority leave in the order they were queued.
+ *
+ * The bxCAN sends the pending mailbox with the lowest identifier first and
+ * frames with equal identifiers from the lower mailbox number. To keep the
+ * order of a stream, a frame isn't loaded while another one with its
+ * identifier is in a mailbox. If a frame is queued that beats the worst one
+ * in the mailboxes while none is free, the worst one is aborted and queued
+ * again. It keeps a slot in the queue until its interrupt puts it back, so
+ * a full queue doesn't abort. A frame already on the bus completes anyway.
+ *
+ * The completion is called from the interrupt with the TIME field of the
+ * mailbox, the bit time counter at the start of frame if TTCM is enabled.
+ * enqueue has to be called with the transmit interrupt masked.
+ */
+class CanTxQueue
+{
+public:
+    static constexpr const size_t NUMBER_OF_MAILBOXES = 3;
+
+    using Completion = util::InplaceFunction<void (const bool sent, const uint16_t timestamp)>;
+
+    struct Entry {
+        CanFrame mFrame;
+        Completion mCompletion;
+        uint32_t mKey;
+        uint32_t mSequence;
+    };
+
+    template<size_t n>
+    CanTxQueue(std::array<Entry, n>& buffer) : mEntries(buffer.data()), mCapacity(n) {}
+
+    CanTxQueue(const CanTxQueue&) = delete;
+    CanTxQueue(CanTxQueue&&) = delete;
+    CanTxQueue& operator=(const CanTxQueue&) = delete;
+    CanTxQueue& operator=(CanTxQueue&&) = delete;
+
+    /* returns false without blocking if the queue is full */
+    template<typename Registers>
+    bool enqueue(Registers& can, const CanFrame& frame, Completion completion = nullptr);
+    template<typename Registers>
+    void onTransmitInterrupt(Registers& can);
+
+    /* copies frame into mailbox and requests its transmission */
+    template<typename Registers>
+    static void writeMailbox(Registers& can, const uint8_t mailbox, const CanFrame& frame);
+
+    /* the lower the key, the earlier the frame wins the arbitration */
+    static uint32_t getArbitrationKey(const CanFrame& frame);
+
+    size_t pending(void) const {return mCount; }
+    size_t inFlight(void) const;
+    size_t aborting(void) const;
+    size_t spacesAvailable(void) const {return mCapacity - mCount - aborting(); }
+
+    size_t getRejectedCount(void) const {return mRejected; }
+    size_t getCompletedCount(void) const {return mCompleted; }
+    size_t getAbortedCount(void) const {return mAborted; }
+    size_t getPeakFillLevel(void) const {return mPeakFillLevel; }
+
+private:
+    // bxCAN register bits, RM0008 24.9, the TSR bits repeat every 8 bits per mailbox
+    static constexpr const uint32_t TSR_RQCP = 0x01;
+    static constexpr const uint32_t TSR_TXOK = 0x02;
+    static constexpr const uint32_t TSR_ABRQ = 0x80;
+    static constexpr const uint32_t TSR_TME = 0x04000000;
+    static constexpr const uint32_t TIR_TXRQ = 0x01;
+    static constexpr const uint32_t TIR_RTR = 0x02;
+    static constexpr const uint32_t TIR_IDE = 0x04;
+
+    struct Mailbox {
+        Entry mEntry;
+        bool mBusy = false;
+        bool mAborting = false;
+    };
+
+    Entry* const mEntries;
+    const size_t mCapacity;
+    // sorted, the best entry is the last one
+    size_t mCount = 0;
+    uint32_t mSequence = 0;
+    std::array<Mailbox, NUMBER_OF_MAILBOXES> mMailboxes;
+
+    size_t mRejected = 0;
+    size_t mCompleted = 0;
+    size_t mAborted = 0;
+    size_t mPeakFillLevel = 0;
+
+    static bool isBetter(const Entry& a, const Entry& b);
+    void insert(const Entry& entry);
+    bool isInFlight(const CanFrame& frame) const;
+    template<typename Registers>
+    void refill(Registers& can);
+    template<typename Registers>
+    void preempt(Registers& can);
+};
+
+template<typename Registers>
+bool CanTxQueue::enqueue(Registers& can, const CanFrame& frame, Completion completion)
+{
+    if (spacesAvailable() == 0) {
+        mRejected++;
+        return false;
+    }
+
+    Entry entry {frame, completion, getArbitrationKey(frame), mSequence++};
+    insert(entry);
+    mPeakFillLevel = std::max(mPeakFillLevel, mCount);
+
+    refill(can);
+    preempt(can);
+    return true;
+}
+
+template<typename Registers>
+void CanTxQueue::onTransmitInterrupt(Registers& can)
+{
+    std::array<Completion, NUMBER_OF_MAILBOXES> completions;
+    std::array<bool, NUMBER_OF_MAILBOXES> sent {};
+    std::array<uint16_t, NUMBER_OF_MAILBOXES> timestamps {};
+
+    const uint32_t tsr = can.TSR;
+    for (uint8_t i = 0; i < NUMBER_OF_MAILBOXES; i++) {
+        const uint32_t status = tsr >> (8 * i);
+        if ((status & TSR_RQCP) == 0) {
+            continue;
+        }
+        // clears RQCP, TXOK, ALST and TERR of the mailbox
+        can.TSR = TSR_RQCP << (8 * i);
+
+        Mailbox& mailbox = mMailboxes[i];
+        if (!mailbox.mBusy) {
+            // loaded before the queue took over the mailboxes
+            continue;
+        }
+        mailbox.mBusy = false;
+
+        if (!(status & TSR_TXOK) && mailbox.mAborting) {
+            mailbox.mAborting = false;
+            mAborted++;
+            insert(mailbox.mEntry);
+            continue;
+        }
+        mailbox.mAborting = false;
+        mCompleted += (status & TSR_TXOK) ? 1 : 0;
+        sent[i] = status & TSR_TXOK;
+        timestamps[i] = can.sTxMailBox[i].TDTR >> 16;
+        completions[i] = mailbox.mEntry.mCompletion;
+        mailbox.mEntry.mCompletion = nullptr;
+    }
+
+    // keep the bus busy first, the completions may take a while
+    refill(can);
+    for (uint8_t i = 0; i < NUMBER_OF_MAILBOXES; i++) {
+        if (completions[i]) {
+            completions[i](sent[i], timestamps[i]);
+        }
+    }
+}
+
+template<typename Registers>
+void CanTxQueue::writeMailbox(Registers& can, const uint8_t mailbox, const CanFrame& frame)
+{
+    auto& registers = can.sTxMailBox[mailbox];
+    uint32_t tir = frame.isRemote() ? TIR_RTR : 0;
+    if (frame.isExtended()) {
+        tir |= (frame.getId() << 3) | TIR_IDE;
+    } else {
+        tir |= frame.getId() << 21;
+    }
+
+    registers.TDTR = frame.mLength;
+    registers.TDLR = frame.mData[0] | (frame.mData[1] << 8) | (frame.mData[2] << 16) |
+                     (static_cast<uint32_t>(frame.mData[3]) << 24);
+    registers.TDHR = frame.mData[4] | (frame.mData[5] << 8) | (frame.mData[6] << 16) |
+                     (static_cast<uint32_t>(frame.mData[7]) << 24);
+    registers.TIR = tir | TIR_TXRQ;
+}
+
+/*
+ * An extended frame sends the 11 most significant bits of its identifier
+ * like a standard one, followed by the recessive SRR and IDE bits, so it
+ * loses against a standard frame with the same base identifier, even a
+ * remote one.
+ */
+inline uint32_t CanTxQueue::getArbitrationKey(const CanFrame& frame)
+{
+    const uint32_t rtr = frame.isRemote() ? 1 : 0;
+    if (frame.isExtended()) {
+        return ((frame.getId() >> 18) << 21) | (1 << 20) | (1 << 19) | ((frame.getId() & 0x3FFFF) << 1) | rtr;
+    }
+    return (frame.getId() << 21) | (rtr << 20);
+}
+
+inline size_t CanTxQueue::inFlight(void) const
+{
+    return std::count_if(mMailboxes.begin(), mMailboxes.end(), [](const Mailbox& mailbox) {
+        return mailbox.mBusy;
+    });
+}
+
+inline size_t CanTxQueue::aborting(void) const
+{
+    return std::count_if(mMailboxes.begin(), mMailboxes.end(), [](const Mailbox& mailbox) {
+        return mailbox.mAborting;
+    });
+}
+
+inline bool CanTxQueue::isBetter(const Entry& a, const Entry& b)
+{
+    if (a.mKey != b.mKey) {
+        return a.mKey < b.mKey;
+    }
+    return static_cast<int32_t>(a.mSequence - b.mSequence) < 0;
+}
+
+inline void CanTxQueue::insert(const Entry& entry)
+{
+    size_t i = mCount++;
+    for ( ; (i > 0) && isBetter(mEntries[i - 1], entry); i--) {
+        mEntries[i] = mEntries[i - 1];
+    }
+    mEntries[i] = entry;
+}
+
+inline bool CanTxQueue::isInFlight(const CanFrame& frame) const
+{
+    return std::any_of(mMailboxes.begin(), mMailboxes.end(), [&frame](const Mailbox& mailbox) {
+        return mailbox.mBusy && (((mailbox.mEntry.mFrame.mId ^ frame.mId) & ~CanFrame::REMOTE) == 0);
+    });
+}
+
+template<typename Registers>
+void CanTxQueue::refill(Registers& can)
+{
+    const uint32_t tsr = can.TSR;
+    for (uint8_t i = 0; i < NUMBER_OF_MAILBOXES; i++) {
+        // a mailbox waiting for its interrupt isn't free, even though it's empty
+        if (mMailboxes[i].mBusy || !(tsr & (TSR_TME << i)) || (tsr & (TSR_RQCP << (8 * i)))) {
+            continue;
+        }
+
+        size_t k = mCount;
+        while ((k > 0) && isInFlight(mEntries[k - 1].mFrame)) {
+            k--;
+        }
+        if (k == 0) {
+            return;
+        }
+
+        mMailboxes[i].mEntry = mEntries[k - 1];
+        mMailboxes[i].mBusy = true;
+        for ( ; k < mCount; k++) {
+            mEntries[k - 1] = mEntries[k];
+        }
+        mCount--;
+        writeMailbox(can, i, mMailboxes[i].mEntry.mFrame);
+    }
+}
+
+template<typename Registers>
+void CanTxQueue::preempt(Registers& can)
+{
+    // the aborted frame needs a slot to come back to
+    if ((mCount == 0) || (spacesAvailable() == 0) || (inFlight() < NUMBER_OF_MAILBOXES)) {
+        return;
+    }
+
+    const Entry& best = mEntries[mCount - 1];
+    if (isInFlight(best.mFrame)) {
+        return;
+    }
+
+    Mailbox* worst = nullptr;
+    uint8_t index = 0;
+    for (uint8_t i = 0; i < NUMBER_OF_MAILBOXES; i++) {
+        Mailbox& mailbox = mMailboxes[i];
+        if (mailbox.mAborting) {
+            // one abort at a time is enough, it frees a mailbox for the best entry
+            return;
+        }
+        if (!worst || isBetter(worst->mEntry, mailbox.mEntry)) {
+            worst = &mailbox;
+            index = i;
+        }
+    }
+
+    if (isBetter(best, worst->mEntry)) {
+        worst->mAborting = true;
+        can.TSR = TSR_ABRQ << (8 * index);
+    }
+}
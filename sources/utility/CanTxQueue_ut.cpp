@@ -0,0 +1,416 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <vector>
+#include <cstdio>
+
+#include "unittest.h"
+#include "CanTxQueue.h"
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t QUEUELENGTH = 16;
+// an 8 byte standard frame at 1 Mbit/s with some stuff bits
+static constexpr const uint32_t FRAMETIMEUS = 135;
+static constexpr const uint32_t ISRLATENCYUS = 2;
+static constexpr const uint32_t NONE = UINT32_MAX;
+
+//--------------------------MOCKING--------------------------
+
+/*
+ * Stands in for the transmit side of the bxCAN registers and the bus behind
+ * it. The pending mailbox of the lowest identifier is sent first, the lower
+ * mailbox number on equal identifiers. A completed or aborted request sets
+ * RQCP, which raises the transmit interrupt ISRLATENCYUS later.
+ */
+struct MockBxCan {
+    struct Mailbox {
+        uint32_t TIR;
+        uint32_t TDTR;
+        uint32_t TDLR;
+        uint32_t TDHR;
+    };
+
+    struct StatusRegister {
+        MockBxCan& mCan;
+
+        operator uint32_t() const
+        {
+            uint32_t tsr = 0;
+            for (size_t i = 0; i < CanTxQueue::NUMBER_OF_MAILBOXES; i++) {
+                tsr |= mCan.mStatus[i] << (8 * i);
+                if (!(mCan.sTxMailBox[i].TIR & 0x01) && (mCan.mTransmitting != static_cast<int>(i))) {
+                    tsr |= 0x04000000 << i;
+                }
+            }
+            return tsr;
+        }
+
+        StatusRegister& operator=(const uint32_t value)
+        {
+            for (size_t i = 0; i < CanTxQueue::NUMBER_OF_MAILBOXES; i++) {
+                if (value & (0x01 << (8 * i))) {
+                    mCan.mStatus[i] = 0;
+                }
+                if ((value & (0x80 << (8 * i))) && (mCan.sTxMailBox[i].TIR & 0x01) &&
+                    (mCan.mTransmitting != static_cast<int>(i)))
+                {
+                    mCan.sTxMailBox[i].TIR &= ~0x01;
+                    mCan.complete(i, 0x01);
+                }
+            }
+            return *this;
+        }
+    };
+
+    StatusRegister TSR {*this};
+    std::array<Mailbox, CanTxQueue::NUMBER_OF_MAILBOXES> sTxMailBox {};
+
+    std::array<uint32_t, CanTxQueue::NUMBER_OF_MAILBOXES> mStatus {};
+    int mTransmitting = -1;
+    uint32_t mStartUs = 0;
+    uint32_t mNow = 0;
+    uint32_t mInterruptAt = NONE;
+    std::vector<CanFrame> mBus;
+
+    static CanFrame decode(const Mailbox& mailbox)
+    {
+        CanFrame frame {};
+        if (mailbox.TIR & 0x04) {
+            frame.mId = (mailbox.TIR >> 3) | CanFrame::EXTENDED;
+        } else {
+            frame.mId = mailbox.TIR >> 21;
+        }
+        if (mailbox.TIR & 0x02) {
+            frame.mId |= CanFrame::REMOTE;
+        }
+        frame.mTimestamp = mailbox.TDTR >> 16;
+        frame.mLength = mailbox.TDTR & 0x0F;
+        for (size_t i = 0; i < 4; i++) {
+            frame.mData[i] = mailbox.TDLR >> (8 * i);
+            frame.mData[i + 4] = mailbox.TDHR >> (8 * i);
+        }
+        return frame;
+    }
+
+    void complete(const size_t mailbox, const uint32_t status)
+    {
+        mStatus[mailbox] = status;
+        if (mInterruptAt == NONE) {
+            mInterruptAt = mNow + ISRLATENCYUS;
+        }
+    }
+
+    /* advances the bus to now */
+    void tick(const uint32_t now)
+    {
+        mNow = now;
+        if ((mTransmitting >= 0) && (now >= mStartUs + FRAMETIMEUS)) {
+            Mailbox& mailbox = sTxMailBox[mTransmitting];
+            mailbox.TIR &= ~0x01;
+            mailbox.TDTR = (mailbox.TDTR & 0xFFFF) | (mStartUs << 16);
+            mBus.push_back(decode(mailbox));
+            complete(mTransmitting, 0x03);
+            mTransmitting = -1;
+        }
+
+        if (mTransmitting < 0) {
+            for (size_t i = 0; i < CanTxQueue::NUMBER_OF_MAILBOXES; i++) {
+                if ((sTxMailBox[i].TIR & 0x01) &&
+                    ((mTransmitting < 0) ||
+                     (CanTxQueue::getArbitrationKey(decode(sTxMailBox[i])) <
+                      CanTxQueue::getArbitrationKey(decode(sTxMailBox[mTransmitting])))))
+                {
+                    mTransmitting = i;
+                    mStartUs = now;
+                }
+            }
+        }
+    }
+
+    /* like CAN_Transmit, the first empty mailbox takes the frame */
+    bool transmit(const CanFrame& frame)
+    {
+        const uint32_t tsr = TSR;
+        for (uint8_t i = 0; i < CanTxQueue::NUMBER_OF_MAILBOXES; i++) {
+            if (tsr & (0x04000000 << i)) {
+                CanTxQueue::writeMailbox(*this, i, frame);
+                mStatus[i] = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static CanFrame frame(const uint32_t id, const uint8_t data = 0)
+{
+    CanFrame frame {};
+    frame.mId = id;
+    frame.mLength = 8;
+    frame.mData.fill(data);
+    return frame;
+}
+
+/* runs the bus and the transmit interrupt until nothing is left to send */
+static void run(MockBxCan& can, CanTxQueue& queue)
+{
+    for (uint32_t now = can.mNow; (now < can.mNow + 1000000); now++) {
+        can.tick(now);
+        if (now >= can.mInterruptAt) {
+            can.mInterruptAt = NONE;
+            queue.onTransmitInterrupt(can);
+        }
+        if ((can.mTransmitting < 0) && (can.mInterruptAt == NONE) && (queue.pending() == 0) &&
+            (queue.inFlight() == 0))
+        {
+            return;
+        }
+    }
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_ArbitrationKey(void)
+{
+    TestCaseBegin();
+    const auto key = [](const uint32_t id) {
+        return CanTxQueue::getArbitrationKey(frame(id));
+    };
+
+    CHECK(key(0x100) < key(0x101));
+    CHECK(key(0x7FF) < key(CanFrame::EXTENDED | 0x1FFFFFFF));
+    // the base identifier decides first
+    CHECK(key(CanFrame::EXTENDED | (0x0FF << 18) | 0x3FFFF) < key(0x100));
+    // on equal base identifiers the standard frame wins, even a remote one
+    CHECK(key(0x100) < key(CanFrame::EXTENDED | (0x100 << 18)));
+    CHECK(key(CanFrame::REMOTE | 0x100) < key(CanFrame::EXTENDED | (0x100 << 18)));
+    CHECK(key(0x100) < key(CanFrame::REMOTE | 0x100));
+    CHECK(key(CanFrame::EXTENDED | 0x100) < key(CanFrame::EXTENDED | CanFrame::REMOTE | 0x100));
+    TestCaseEnd();
+}
+
+int ut_MailboxRoundTrip(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    CanFrame sent = frame(CanFrame::EXTENDED | CanFrame::REMOTE | 0x1ABCDEF0);
+    sent.mLength = 3;
+    for (size_t i = 0; i < sent.mData.size(); i++) {
+        sent.mData[i] = 0xF0 + i;
+    }
+
+    CanTxQueue::writeMailbox(can, 2, sent);
+    CHECK(can.sTxMailBox[2].TIR & 0x01);
+    CHECK(can.sTxMailBox[2].TDLR == 0xF3F2F1F0);
+    CHECK(can.sTxMailBox[2].TDHR == 0xF7F6F5F4);
+    const CanFrame received = MockBxCan::decode(can.sTxMailBox[2]);
+    CHECK(received.mId == sent.mId);
+    CHECK(received.mLength == 3);
+    CHECK(received.mData == sent.mData);
+
+    CanTxQueue::writeMailbox(can, 0, frame(0x7FF));
+    CHECK((can.sTxMailBox[0].TIR >> 21) == 0x7FF);
+    CHECK(!(can.sTxMailBox[0].TIR & 0x06));
+    TestCaseEnd();
+}
+
+int ut_SendsInPriorityOrder(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    std::array<CanTxQueue::Entry, QUEUELENGTH> buffer;
+    CanTxQueue queue(buffer);
+
+    CHECK(queue.enqueue(can, frame(0x500)));
+    CHECK(queue.enqueue(can, frame(0x400)));
+    CHECK(queue.enqueue(can, frame(0x300)));
+    CHECK(queue.inFlight() == 3);
+    CHECK(queue.pending() == 0);
+
+    CHECK(queue.enqueue(can, frame(0x600)));
+    CHECK(queue.getAbortedCount() == 0);
+    // beats 0x500 in the mailboxes, which is aborted for it
+    CHECK(queue.enqueue(can, frame(0x100)));
+    CHECK(queue.enqueue(can, frame(0x200)));
+    run(can, queue);
+
+    CHECK(queue.getAbortedCount() == 1);
+    CHECK(queue.getCompletedCount() == 6);
+    CHECK(can.mBus.size() == 6);
+    // 0x300 won the arbitration before the interrupt loaded 0x100, without the abort 0x400 would have been next
+    const std::array<uint32_t, 6> expected {0x300, 0x100, 0x200, 0x400, 0x500, 0x600};
+    for (size_t i = 0; i < expected.size(); i++) {
+        CHECK(can.mBus[i].getId() == expected[i]);
+    }
+    TestCaseEnd();
+}
+
+int ut_KeepsStreamOrder(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    std::array<CanTxQueue::Entry, QUEUELENGTH> buffer;
+    CanTxQueue queue(buffer);
+
+    // a stream like the consecutive frames of an ISO-TP transfer
+    for (uint8_t i = 1; i <= 5; i++) {
+        CHECK(queue.enqueue(can, frame(0x050, i)));
+    }
+    CHECK(queue.enqueue(can, frame(0x600)));
+    CHECK(queue.enqueue(can, frame(0x051)));
+    // one mailbox for the stream, the others for everything else
+    CHECK(queue.inFlight() == 3);
+    CHECK(queue.pending() == 4);
+    run(can, queue);
+
+    CHECK(can.mBus.size() == 7);
+    uint8_t expected = 1;
+    for (const auto& sent : can.mBus) {
+        if (sent.getId() == 0x050) {
+            CHECK(sent.mData[0] == expected++);
+        }
+    }
+    CHECK(expected == 6);
+    TestCaseEnd();
+}
+
+int ut_PreemptsWithinCapacity(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    // an entry written behind the queue overwrites the canary
+    struct {
+        std::array<CanTxQueue::Entry, 4> entries;
+        uint32_t canary;
+    } storage {};
+    storage.canary = 0xDEADBEEF;
+    CanTxQueue queue(storage.entries);
+
+    CHECK(queue.enqueue(can, frame(0x500)));
+    CHECK(queue.enqueue(can, frame(0x400)));
+    CHECK(queue.enqueue(can, frame(0x300)));
+    CHECK(queue.enqueue(can, frame(0x600)));
+    CHECK(queue.enqueue(can, frame(0x601)));
+    // 0x500 is aborted and keeps its slot until the interrupt puts it back
+    CHECK(queue.enqueue(can, frame(0x100)));
+    CHECK(queue.spacesAvailable() == 0);
+    CHECK(!queue.enqueue(can, frame(0x602)));
+    can.mInterruptAt = NONE;
+    queue.onTransmitInterrupt(can);
+    CHECK(queue.getAbortedCount() == 1);
+    CHECK(queue.pending() == 3);
+
+    // beats 0x400 in the mailboxes, but the queue is full now
+    CHECK(queue.enqueue(can, frame(0x050)));
+    CHECK(queue.pending() == 4);
+    CHECK(can.mInterruptAt == NONE);
+    run(can, queue);
+
+    CHECK(can.mBus.size() == 7);
+    CHECK(queue.getAbortedCount() == 1);
+    CHECK(queue.getCompletedCount() == 7);
+    CHECK(storage.canary == 0xDEADBEEF);
+    TestCaseEnd();
+}
+
+int ut_CompletesWithTimestamp(void)
+{
+    TestCaseBegin();
+    MockBxCan can;
+    std::array<CanTxQueue::Entry, 4> buffer;
+    CanTxQueue queue(buffer);
+    struct {
+        std::array<uint16_t, 8> timestamps;
+        size_t count;
+        size_t failed;
+    } completed {};
+
+    for (size_t i = 0; i < buffer.size(); i++) {
+        CHECK(queue.enqueue(can, frame(0x100 + i), [&completed](const bool sent, const uint16_t timestamp) {
+            completed.failed += sent ? 0 : 1;
+            completed.timestamps[completed.count++] = timestamp;
+        }));
+    }
+    CHECK(queue.pending() == 1);
+    CHECK(queue.enqueue(can, frame(0x200)));
+    CHECK(queue.enqueue(can, frame(0x201)));
+    CHECK(queue.enqueue(can, frame(0x202)));
+    // full, doesn't block
+    CHECK(!queue.enqueue(can, frame(0x203)));
+    CHECK(queue.getRejectedCount() == 1);
+    CHECK(queue.getPeakFillLevel() == 4);
+    CHECK(queue.spacesAvailable() == 0);
+
+    run(can, queue);
+    CHECK(completed.count == 4);
+    CHECK(completed.failed == 0);
+    for (size_t i = 0; i < completed.count; i++) {
+        CHECK(completed.timestamps[i] == can.mBus[i].mTimestamp);
+        CHECK(completed.timestamps[i] == i * FRAMETIMEUS);
+    }
+    TestCaseEnd();
+}
+
+/*
+ * Three tasks send their own identifier, they wake every millisecond and
+ * send until nothing is accepted anymore. With Can::send() that is one
+ * frame per mailbox, then the mailboxes run empty until the next wakeup.
+ * With the queue the transmit interrupt refills them.
+ */
+static size_t framesPerSecond(const bool queued)
+{
+    static constexpr const uint32_t WAKEUPUS = 1000;
+    static constexpr const uint32_t DURATIONUS = 1000000;
+    static constexpr const std::array<uint32_t, 3> ids {0x100, 0x200, 0x300};
+
+    MockBxCan can;
+    std::array<CanTxQueue::Entry, QUEUELENGTH> buffer;
+    CanTxQueue queue(buffer);
+
+    for (uint32_t now = 0; now < DURATIONUS; now++) {
+        can.tick(now);
+        if (now >= can.mInterruptAt) {
+            can.mInterruptAt = NONE;
+            if (queued) {
+                queue.onTransmitInterrupt(can);
+            }
+        }
+
+        if (now % WAKEUPUS == 0) {
+            for (const auto id : ids) {
+                while (queued ? queue.enqueue(can, frame(id)) : can.transmit(frame(id))) {}
+            }
+        }
+    }
+    return can.mBus.size();
+}
+
+int ut_FramesPerSecond(void)
+{
+    TestCaseBegin();
+    const size_t single = framesPerSecond(false);
+    const size_t queued = framesPerSecond(true);
+
+    CHECK(single <= 3000);
+    // the first task fills the queue with its stream, that only loses the interrupt latency per frame
+    CHECK(queued * 100 >= 95 * (1000000 / FRAMETIMEUS));
+    printf("Frames per second at 1 Mbit/s from 3 tasks waking every ms: send %zu, queue %zu (bus limit %u)\n",
+           single, queued, 1000000 / FRAMETIMEUS);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_ArbitrationKey);
+    RunTest(true, ut_MailboxRoundTrip);
+    RunTest(true, ut_SendsInPriorityOrder);
+    RunTest(true, ut_KeepsStreamOrder);
+    RunTest(true, ut_PreemptsWithinCapacity);
+    RunTest(true, ut_CompletesWithTimestamp);
+    RunTest(true, ut_FramesPerSecond);
+    UnitTestMainEnd();
+}
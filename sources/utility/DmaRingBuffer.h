@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <atomic>
+#include <algorithm>
+
+/*
+ * Consumer side of a DMA channel running in circular mode over mBuffer.
+ * The interrupt handlers (HT, TC, receive timeout) only publish the new
+ * write index, which is derived from the DMA data counter. Because HT and
+ * TC fire at least every n / 2 bytes, the distance between two published
+ * indices is always unambiguous. The consumer reads whole contiguous chunks.
+ */
+template<size_t n>
+class DmaRingBuffer
+{
+    static_assert(n >= 2, "DmaRingBuffer needs at least two elements");
+    static_assert((n & (n - 1)) == 0, "DmaRingBuffer size has to be a power of two");
+
+    std::array<uint8_t, n> mBuffer;
+    size_t mWriteIndex = 0;
+    std::atomic<size_t> mPublished {0};
+    std::atomic<size_t> mConsumed {0};
+    size_t mOverruns = 0;
+
+public:
+    DmaRingBuffer(void) = default;
+    DmaRingBuffer(const DmaRingBuffer&) = delete;
+    DmaRingBuffer(DmaRingBuffer&&) = delete;
+    DmaRingBuffer& operator=(const DmaRingBuffer&) = delete;
+    DmaRingBuffer& operator=(DmaRingBuffer&&) = delete;
+
+    uint8_t* data(void) {return mBuffer.data(); }
+    static constexpr size_t size(void) {return n; }
+
+    void publish(const size_t writeIndex);
+    void publishDataCounter(const size_t remainingDataCounter);
+
+    size_t bytesAvailable(void) const;
+    uint8_t const* peek(size_t& length);
+    void release(const size_t length);
+    size_t read(uint8_t* const data, const size_t length);
+
+    size_t getOverrunCount(void) const {return mOverruns; }
+    void reset(void);
+};
+
+template<size_t n>
+void DmaRingBuffer<n>::publish(const size_t writeIndex)
+{
+    const size_t index = writeIndex & (n - 1);
+    const size_t delta = (index - mWriteIndex) & (n - 1);
+
+    mWriteIndex = index;
+    mPublished.store(mPublished.load(std::memory_order_relaxed) + delta, std::memory_order_release);
+}
+
+template<size_t n>
+void DmaRingBuffer<n>::publishDataCounter(const size_t remainingDataCounter)
+{
+    publish(n - remainingDataCounter);
+}
+
+template<size_t n>
+size_t DmaRingBuffer<n>::bytesAvailable(void) const
+{
+    return mPublished.load(std::memory_order_acquire) - mConsumed.load(std::memory_order_relaxed);
+}
+
+template<size_t n>
+uint8_t const* DmaRingBuffer<n>::peek(size_t& length)
+{
+    size_t available = bytesAvailable();
+
+    if (available > n) {
+        // DMA lapped the consumer, everything in the ring is stale
+        mConsumed.store(mPublished.load(std::memory_order_acquire), std::memory_order_relaxed);
+        mOverruns++;
+        available = 0;
+    }
+
+    const size_t readIndex = mConsumed.load(std::memory_order_relaxed) & (n - 1);
+    length = std::min(available, n - readIndex);
+    return mBuffer.data() + readIndex;
+}
+
+template<size_t n>
+void DmaRingBuffer<n>::release(const size_t length)
+{
+    const size_t consumed = mConsumed.load(std::memory_order_relaxed);
+    mConsumed.store(consumed + std::min(length, bytesAvailable()), std::memory_order_release);
+}
+
+template<size_t n>
+size_t DmaRingBuffer<n>::read(uint8_t* const data, const size_t length)
+{
+    if (data == nullptr) {
+        return 0;
+    }
+
+    size_t bytesRead = 0;
+    while (bytesRead < length) {
+        size_t chunkLength = 0;
+        uint8_t const* const chunk = peek(chunkLength);
+        if (chunkLength == 0) {
+            break;
+        }
+        chunkLength = std::min(chunkLength, length - bytesRead);
+        std::memcpy(data + bytesRead, chunk, chunkLength);
+        release(chunkLength);
+        bytesRead += chunkLength;
+    }
+    return bytesRead;
+}
+
+template<size_t n>
+void DmaRingBuffer<n>::reset(void)
+{
+    mWriteIndex = 0;
+    mPublished.store(0);
+    mConsumed.store(0);
+    mOverruns = 0;
+}
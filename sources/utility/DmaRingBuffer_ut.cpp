@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <cstring>
+
+#include "unittest.h"
+#include "DmaRingBuffer.h"
+
+#define NUM_TEST_LOOPS 255
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t RINGSIZE = 64;
+
+//--------------------------MOCKING--------------------------
+
+/* Simulates a circular DMA channel: writes bytes into the ring and decrements
+ * the data counter like the hardware does, reloading it on wraparound. */
+struct DmaCounterSimulation {
+    DmaRingBuffer<RINGSIZE>& mRing;
+    size_t mDataCounter = RINGSIZE;
+    uint8_t mNextValue = 0;
+
+    DmaCounterSimulation(DmaRingBuffer<RINGSIZE>& ring) : mRing(ring) {}
+
+    void transfer(const size_t length)
+    {
+        for (size_t i = 0; i < length; i++) {
+            mRing.data()[RINGSIZE - mDataCounter] = mNextValue++;
+            mDataCounter--;
+            if (mDataCounter == 0) {
+                mDataCounter = RINGSIZE;
+            }
+        }
+    }
+
+    /* reports the counter like the HT, TC or receive timeout interrupt */
+    void interrupt(void)
+    {
+        mRing.publishDataCounter(mDataCounter);
+    }
+
+    /* transfers length bytes and raises HT/TC on the way, like the hardware */
+    void transferWithInterrupts(const size_t length)
+    {
+        for (size_t i = 0; i < length; i++) {
+            transfer(1);
+            if ((mDataCounter == RINGSIZE) || (mDataCounter == RINGSIZE / 2)) {
+                interrupt();
+            }
+        }
+    }
+};
+
+//-------------------------TESTCASES-------------------------
+
+int ut_PublishAndRead(void)
+{
+    TestCaseBegin();
+    DmaRingBuffer<RINGSIZE> ring;
+    DmaCounterSimulation dma(ring);
+    std::array<uint8_t, RINGSIZE> rx;
+
+    dma.transfer(10);
+    CHECK(ring.bytesAvailable() == 0);
+    dma.interrupt();
+    CHECK(ring.bytesAvailable() == 10);
+
+    CHECK(ring.read(rx.data(), rx.size()) == 10);
+    for (size_t i = 0; i < 10; i++) {
+        CHECK(rx[i] == i);
+    }
+    CHECK(ring.bytesAvailable() == 0);
+    TestCaseEnd();
+}
+
+int ut_Wraparound(void)
+{
+    TestCaseBegin();
+    DmaRingBuffer<RINGSIZE> ring;
+    DmaCounterSimulation dma(ring);
+    std::array<uint8_t, RINGSIZE> rx;
+    uint8_t expected = 0;
+
+    for (size_t loop = 0; loop < NUM_TEST_LOOPS; loop++) {
+        const size_t chunk = 1 + (loop * 7) % (RINGSIZE - 1);
+        dma.transferWithInterrupts(chunk);
+        dma.interrupt();
+        CHECK(ring.bytesAvailable() == chunk);
+
+        const size_t received = ring.read(rx.data(), rx.size());
+        CHECK(received == chunk);
+        for (size_t i = 0; i < received; i++) {
+            CHECK(rx[i] == expected++);
+        }
+    }
+    CHECK(ring.getOverrunCount() == 0);
+    TestCaseEnd();
+}
+
+int ut_ContiguousChunks(void)
+{
+    TestCaseBegin();
+    DmaRingBuffer<RINGSIZE> ring;
+    DmaCounterSimulation dma(ring);
+    size_t length = 0;
+
+    dma.transferWithInterrupts(RINGSIZE - 8);
+    dma.interrupt();
+    ring.release(RINGSIZE - 8);
+
+    dma.transferWithInterrupts(20);
+    dma.interrupt();
+    CHECK(ring.bytesAvailable() == 20);
+
+    uint8_t const* chunk = ring.peek(length);
+    CHECK(length == 8);
+    CHECK(chunk == ring.data() + RINGSIZE - 8);
+    ring.release(length);
+
+    chunk = ring.peek(length);
+    CHECK(length == 12);
+    CHECK(chunk == ring.data());
+    CHECK(chunk[0] == RINGSIZE);
+    ring.release(length);
+
+    CHECK(ring.bytesAvailable() == 0);
+    TestCaseEnd();
+}
+
+int ut_Overrun(void)
+{
+    TestCaseBegin();
+    DmaRingBuffer<RINGSIZE> ring;
+    DmaCounterSimulation dma(ring);
+    size_t length = 0;
+
+    dma.transferWithInterrupts(RINGSIZE + RINGSIZE / 2);
+    CHECK(ring.bytesAvailable() == RINGSIZE + RINGSIZE / 2);
+
+    ring.peek(length);
+    CHECK(length == 0);
+    CHECK(ring.getOverrunCount() == 1);
+    CHECK(ring.bytesAvailable() == 0);
+
+    dma.transferWithInterrupts(4);
+    dma.interrupt();
+    CHECK(ring.bytesAvailable() == 4);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_PublishAndRead);
+    RunTest(true, ut_Wraparound);
+    RunTest(true, ut_ContiguousChunks);
+    RunTest(true, ut_Overrun);
+    UnitTestMainEnd();
+}
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include "InplaceFunction.h"
+
+/*
+ * Queue of Tx descriptors for a Dma channel. The transfer complete interrupt
+ * starts the next descriptor itself, so several frames go out back-to-back
+ * without a task wakeup in between. A frame can be split over several
+ * descriptors (scatter-gather), only the descriptors with a completion
+ * callback report back.
+ *
+ * enqueue has to be called with the Dma interrupt masked, onTransferComplete
+ * is called from the transfer complete interrupt.
+ */
+template<typename DmaType, size_t n>
+class DmaTxQueue
+{
+public:
+    using CompletionCallback = util::InplaceFunction<void (void)>;
+
+    struct Descriptor {
+        uint8_t const* data;
+        size_t length;
+        CompletionCallback completion;
+    };
+
+    DmaTxQueue(void) = default;
+    DmaTxQueue(const DmaTxQueue&) = delete;
+    DmaTxQueue(DmaTxQueue&&) = delete;
+    DmaTxQueue& operator=(const DmaTxQueue&) = delete;
+    DmaTxQueue& operator=(DmaTxQueue&&) = delete;
+
+    bool enqueue(const DmaType&     dma,
+                 uint8_t const*     data,
+                 const size_t       length,
+                 CompletionCallback completion = nullptr);
+    void onTransferComplete(const DmaType& dma);
+
+    size_t spacesAvailable(void) const {return n - mCount; }
+    size_t pending(void) const {return mCount; }
+    bool isActive(void) const {return mActive; }
+
+    size_t getRejectedCount(void) const {return mRejected; }
+    size_t getCompletedCount(void) const {return mCompleted; }
+    size_t getPeakFillLevel(void) const {return mPeakFillLevel; }
+
+private:
+    std::array<Descriptor, n> mDescriptors;
+    size_t mHead = 0;
+    size_t mCount = 0;
+    bool mActive = false;
+
+    size_t mRejected = 0;
+    size_t mCompleted = 0;
+    size_t mPeakFillLevel = 0;
+
+    void startTransfer(const DmaType& dma);
+};
+
+template<typename DmaType, size_t n>
+bool DmaTxQueue<DmaType, n>::enqueue(const DmaType&     dma,
+                                     uint8_t const*     data,
+                                     const size_t       length,
+                                     CompletionCallback completion)
+{
+    if ((data == nullptr) || (length == 0)) {
+        return false;
+    }
+
+    if (mCount == n) {
+        mRejected++;
+        return false;
+    }
+
+    mDescriptors[(mHead + mCount) % n] = Descriptor {data, length, completion};
+    mCount++;
+
+    if (mCount > mPeakFillLevel) {
+        mPeakFillLevel = mCount;
+    }
+
+    if (!mActive) {
+        startTransfer(dma);
+    }
+    return true;
+}
+
+template<typename DmaType, size_t n>
+void DmaTxQueue<DmaType, n>::onTransferComplete(const DmaType& dma)
+{
+    if (!mActive || (mCount == 0)) {
+        return;
+    }
+
+    dma.disable();
+
+    const CompletionCallback completion = mDescriptors[mHead].completion;
+    mDescriptors[mHead].completion = nullptr;
+    mHead = (mHead + 1) % n;
+    mCount--;
+    mCompleted++;
+
+    if (mCount != 0) {
+        startTransfer(dma);
+    } else {
+        mActive = false;
+    }
+
+    if (completion) {
+        completion();
+    }
+}
+
+template<typename DmaType, size_t n>
+void DmaTxQueue<DmaType, n>::startTransfer(const DmaType& dma)
+{
+    const Descriptor& desc = mDescriptors[mHead];
+
+    mActive = true;
+    dma.setupTransfer(desc.data, desc.length);
+    dma.enable();
+}
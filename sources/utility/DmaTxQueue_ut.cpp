@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+
+#include "unittest.h"
+#include "DmaTxQueue.h"
+
+#define NUM_TEST_LOOPS 255
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t QUEUELENGTH = 4;
+
+//--------------------------MOCKING--------------------------
+
+/* Stands in for hal::Dma. Records every transfer on a simulated wire. */
+struct MockDma {
+    mutable std::string mWire;
+    mutable uint8_t const* mData = nullptr;
+    mutable size_t mLength = 0;
+    mutable bool mEnabled = false;
+    mutable size_t mNumberOfTransfers = 0;
+
+    void setupTransfer(uint8_t const* const data, const size_t length, const bool repeat = false) const
+    {
+        mData = data;
+        mLength = length;
+    }
+
+    void enable(void) const
+    {
+        mEnabled = true;
+        mNumberOfTransfers++;
+    }
+
+    void disable(void) const
+    {
+        mEnabled = false;
+    }
+
+    /* moves the pending transfer onto the wire */
+    void completeTransfer(void) const
+    {
+        mWire.append(reinterpret_cast<const char*>(mData), mLength);
+    }
+};
+
+using Queue = DmaTxQueue<MockDma, QUEUELENGTH>;
+
+static const uint8_t* bytes(const char* str)
+{
+    return reinterpret_cast<const uint8_t*>(str);
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_Ordering(void)
+{
+    TestCaseBegin();
+    MockDma dma;
+    Queue queue;
+    std::vector<int> completions;
+
+    CHECK(queue.enqueue(dma, bytes("AT+USOWR="), 9));
+    CHECK(queue.enqueue(dma, bytes("0,5\r"), 4, [&] {completions.push_back(1); }));
+    CHECK(queue.enqueue(dma, bytes("hello"), 5, [&] {completions.push_back(2); }));
+    CHECK(dma.mNumberOfTransfers == 1);
+    CHECK(queue.pending() == 3);
+
+    while (queue.isActive()) {
+        dma.completeTransfer();
+        queue.onTransferComplete(dma);
+    }
+
+    CHECK(dma.mWire == "AT+USOWR=0,5\rhello");
+    CHECK(dma.mNumberOfTransfers == 3);
+    CHECK(completions.size() == 2);
+    CHECK(completions[0] == 1);
+    CHECK(completions[1] == 2);
+    CHECK(dma.mEnabled == false);
+    TestCaseEnd();
+}
+
+int ut_ChainedInInterrupt(void)
+{
+    TestCaseBegin();
+    MockDma dma;
+    Queue queue;
+
+    queue.enqueue(dma, bytes("ab"), 2);
+    queue.enqueue(dma, bytes("cd"), 2);
+
+    dma.completeTransfer();
+    queue.onTransferComplete(dma);
+
+    // next descriptor is already running without a call from the task
+    CHECK(dma.mEnabled == true);
+    CHECK(dma.mData != nullptr && std::memcmp(dma.mData, "cd", 2) == 0);
+    TestCaseEnd();
+}
+
+int ut_BackPressure(void)
+{
+    TestCaseBegin();
+    MockDma dma;
+    Queue queue;
+
+    for (size_t i = 0; i < QUEUELENGTH; i++) {
+        CHECK(queue.enqueue(dma, bytes("x"), 1));
+    }
+    CHECK(queue.spacesAvailable() == 0);
+    CHECK(queue.enqueue(dma, bytes("y"), 1) == false);
+    CHECK(queue.getRejectedCount() == 1);
+    CHECK(queue.getPeakFillLevel() == QUEUELENGTH);
+
+    dma.completeTransfer();
+    queue.onTransferComplete(dma);
+    CHECK(queue.spacesAvailable() == 1);
+    CHECK(queue.enqueue(dma, bytes("y"), 1));
+
+    CHECK(queue.enqueue(dma, nullptr, 1) == false);
+    CHECK(queue.enqueue(dma, bytes("z"), 0) == false);
+    TestCaseEnd();
+}
+
+int ut_Throughput(void)
+{
+    TestCaseBegin();
+    MockDma dma;
+    Queue queue;
+    size_t completed = 0;
+    const char* frame = "0123456789abcdef";
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (size_t loop = 0; loop < NUM_TEST_LOOPS * 1000; loop++) {
+        while (queue.enqueue(dma, bytes(frame), 16, [&] {completed++; })) {}
+        queue.onTransferComplete(dma);
+    }
+    while (queue.isActive()) {
+        queue.onTransferComplete(dma);
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    CHECK(completed == queue.getCompletedCount());
+    CHECK(queue.getRejectedCount() == NUM_TEST_LOOPS * 1000);
+
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    printf("DmaTxQueue: %zu descriptors in %lld us\n", completed, static_cast<long long>(us));
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_Ordering);
+    RunTest(true, ut_ChainedInInterrupt);
+    RunTest(true, ut_BackPressure);
+    RunTest(true, ut_Throughput);
+    UnitTestMainEnd();
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace util
+{
+template<typename Signature, size_t Bytes = 2 * sizeof(void*)>
+class InplaceFunction;
+
+/*
+ * Fixed capacity replacement for std::function. The callable is stored inside
+ * the object, it never allocates. A call is one indirect call through the
+ * invoker. Callables which do not fit into Bytes are rejected at compile time.
+ *
+ * Copy, move and destruction of trivial callables (function pointers, lambdas
+ * capturing pointers or references) are plain memory copies.
+ */
+template<typename R, typename ... Args, size_t Bytes>
+class InplaceFunction<R(Args...), Bytes>
+{
+    using Storage = typename std::aligned_storage<Bytes, alignof(std::max_align_t)>::type;
+    using Invoker = R (*)(void*, Args ...);
+
+    enum class Operation {
+        COPY, MOVE, DESTROY
+    };
+    using Manager = void (*)(const Operation, void*, void*);
+
+    template<typename F>
+    using EnableIfCallable = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, InplaceFunction>::value &&
+        std::is_convertible<decltype(std::declval<typename std::decay<F>::type&>()(std::declval<Args>()...)),
+                            R>::value>::type;
+
+    Storage mStorage;
+    Invoker mInvoker = nullptr;
+    Manager mManager = nullptr;
+
+    template<typename F>
+    static R invoke(void* storage, Args ... args)
+    {
+        return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+    }
+
+    template<typename F>
+    static void manage(const Operation operation, void* destination, void* source)
+    {
+        switch (operation) {
+        case Operation::COPY:
+            new (destination) F(*static_cast<F const*>(source));
+            break;
+
+        case Operation::MOVE:
+            new (destination) F(std::move(*static_cast<F*>(source)));
+            static_cast<F*>(source)->~F();
+            break;
+
+        case Operation::DESTROY:
+            static_cast<F*>(destination)->~F();
+            break;
+        }
+    }
+
+    template<typename F>
+    static bool isNull(const F&) {return false; }
+
+    template<typename Ret, typename ... Params>
+    static bool isNull(Ret (* const function)(Params ...)) {return function == nullptr; }
+
+    void copyFrom(const InplaceFunction& other)
+    {
+        if (other.mManager) {
+            other.mManager(Operation::COPY, &mStorage, const_cast<Storage*>(&other.mStorage));
+        } else {
+            std::memcpy(&mStorage, &other.mStorage, sizeof(mStorage));
+        }
+        mInvoker = other.mInvoker;
+        mManager = other.mManager;
+    }
+
+    void moveFrom(InplaceFunction& other)
+    {
+        if (other.mManager) {
+            other.mManager(Operation::MOVE, &mStorage, &other.mStorage);
+        } else {
+            std::memcpy(&mStorage, &other.mStorage, sizeof(mStorage));
+        }
+        mInvoker = other.mInvoker;
+        mManager = other.mManager;
+        other.mInvoker = nullptr;
+        other.mManager = nullptr;
+    }
+
+public:
+    template<typename F>
+    static constexpr bool fits(void)
+    {
+        return (sizeof(F) <= Bytes) && (alignof(F) <= alignof(Storage));
+    }
+
+    InplaceFunction(void) = default;
+    InplaceFunction(std::nullptr_t) {}
+
+    template<typename F, typename = EnableIfCallable<F> >
+    InplaceFunction(F&& function)
+    {
+        using Fn = typename std::decay<F>::type;
+        static_assert(sizeof(Fn) <= Bytes, "Callable is too large for this InplaceFunction, raise its capacity");
+        static_assert(alignof(Fn) <= alignof(Storage), "Callable alignment is not supported by InplaceFunction");
+
+        new (&mStorage) Fn(std::forward<F>(function));
+        if (isNull(*reinterpret_cast<Fn*>(&mStorage))) {
+            return;
+        }
+        mInvoker = &invoke<Fn>;
+        if (!std::is_trivially_copyable<Fn>::value || !std::is_trivially_destructible<Fn>::value) {
+            mManager = &manage<Fn>;
+        }
+    }
+
+    InplaceFunction(const InplaceFunction& other)
+    {
+        copyFrom(other);
+    }
+
+    InplaceFunction(InplaceFunction&& other)
+    {
+        moveFrom(other);
+    }
+
+    ~InplaceFunction(void)
+    {
+        reset();
+    }
+
+    InplaceFunction& operator=(const InplaceFunction& other)
+    {
+        if (this != &other) {
+            reset();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other)
+    {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+
+    template<typename F, typename = EnableIfCallable<F> >
+    InplaceFunction& operator=(F&& function)
+    {
+        return *this = InplaceFunction(std::forward<F>(function));
+    }
+
+    void reset(void)
+    {
+        if (mManager) {
+            mManager(Operation::DESTROY, &mStorage, nullptr);
+        }
+        mInvoker = nullptr;
+        mManager = nullptr;
+    }
+
+    explicit operator bool(void) const {return mInvoker != nullptr; }
+
+    friend bool operator==(const InplaceFunction& function, std::nullptr_t) {return !function; }
+    friend bool operator!=(const InplaceFunction& function, std::nullptr_t) {return static_cast<bool>(function); }
+
+    R operator()(Args ... args) const
+    {
+        return mInvoker(const_cast<Storage*>(&mStorage), std::forward<Args>(args)...);
+    }
+};
+}
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * Copyright (c) 2014-2018 Nils Weiss
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "unittest.h"
+#include "InplaceFunction.h"
+
+#define NUM_TEST_LOOPS 255
+
+//--------------------------BUFFERS--------------------------
+static constexpr const size_t BENCHMARK_CALLS = 16 * 1024 * 1024;
+static size_t g_numberOfAllocations = 0;
+static volatile uint32_t g_sink = 0;
+
+struct Counted {
+    static int alive;
+    int value;
+
+    Counted(const int v) : value(v) {alive++; }
+    Counted(const Counted& other) : value(other.value) {alive++; }
+    ~Counted(void) {alive--; }
+};
+int Counted::alive = 0;
+
+//--------------------------MOCKING--------------------------
+
+void* operator new(size_t size)
+{
+    g_numberOfAllocations++;
+    return std::malloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+#endif
+}
+
+__attribute__((noinline)) static void isr(uint8_t value)
+{
+    g_sink += value;
+}
+
+//-------------------------TESTCASES-------------------------
+
+int ut_Invoke(void)
+{
+    TestCaseBegin();
+    int counter = 0;
+    util::InplaceFunction<void(void)> empty;
+    util::InplaceFunction<void(void)> lambda = [&counter] {counter++; };
+    util::InplaceFunction<int(int, int)> add = [](int a, int b) {return a + b; };
+    util::InplaceFunction<void(uint8_t)> pointer = isr;
+    util::InplaceFunction<void(uint8_t)> nullPointer = static_cast<void (*)(uint8_t)>(nullptr);
+
+    CHECK(!empty);
+    CHECK(!nullPointer);
+    CHECK(static_cast<bool>(lambda));
+
+    for (size_t i = 0; i < NUM_TEST_LOOPS; i++) {
+        lambda();
+    }
+    CHECK(counter == NUM_TEST_LOOPS);
+    CHECK(add(3, 4) == 7);
+
+    g_sink = 0;
+    pointer(5);
+    CHECK(g_sink == 5);
+
+    lambda = nullptr;
+    CHECK(!lambda);
+    TestCaseEnd();
+}
+
+int ut_CopyMoveDestroy(void)
+{
+    TestCaseBegin();
+    {
+        Counted counted(42);
+        util::InplaceFunction<int(void)> a = [counted] {return counted.value; };
+        CHECK(Counted::alive == 2);
+
+        util::InplaceFunction<int(void)> b = a;
+        CHECK(Counted::alive == 3);
+        CHECK(b() == 42);
+
+        util::InplaceFunction<int(void)> c = std::move(a);
+        CHECK(Counted::alive == 3);
+        CHECK(!a);
+        CHECK(c() == 42);
+
+        b = nullptr;
+        CHECK(Counted::alive == 2);
+
+        c = [] {return 7; };
+        CHECK(Counted::alive == 1);
+        CHECK(c() == 7);
+    }
+    CHECK(Counted::alive == 0);
+    TestCaseEnd();
+}
+
+int ut_NoAllocation(void)
+{
+    TestCaseBegin();
+    std::array<uint32_t, 2> capture {{1, 2}};
+    std::array<util::InplaceFunction<uint32_t(void)>, 8> table;
+
+    const size_t before = g_numberOfAllocations;
+    for (auto& entry : table) {
+        entry = [capture] {return capture[0] + capture[1]; };
+    }
+    auto copy = table;
+    CHECK(copy[7]() == 3);
+    CHECK(g_numberOfAllocations == before);
+
+    // too large captures are a compile error, fits() reports it upfront
+    std::array<uint8_t, 64> large {};
+    auto tooLarge = [large] {return large[0]; };
+    CHECK(!util::InplaceFunction<uint8_t(void)>::fits<decltype(tooLarge)>());
+    CHECK((util::InplaceFunction<uint8_t(void), 64>::fits<decltype(tooLarge)>()));
+    TestCaseEnd();
+}
+
+int ut_BenchmarkAgainstStdFunction(void)
+{
+    TestCaseBegin();
+    uint8_t* const context = reinterpret_cast<uint8_t*>(std::malloc(1));
+    *context = 1;
+
+    // callback tables like the ones the interrupt handlers dispatch through
+    static std::array<std::function<void(uint8_t)>, 4> stdTable;
+    static std::array<util::InplaceFunction<void(uint8_t)>, 4> inplaceTable;
+    for (size_t i = 0; i < stdTable.size(); i++) {
+        stdTable[i] = [context](uint8_t value) {g_sink += value + *context; };
+        inplaceTable[i] = [context](uint8_t value) {g_sink += value + *context; };
+    }
+
+    g_sink = 0;
+    uint64_t start = cycles();
+    for (size_t i = 0; i < BENCHMARK_CALLS; i++) {
+        stdTable[i & 3](static_cast<uint8_t>(i));
+    }
+    const uint64_t stdCycles = cycles() - start;
+    const uint32_t stdSum = g_sink;
+
+    g_sink = 0;
+    start = cycles();
+    for (size_t i = 0; i < BENCHMARK_CALLS; i++) {
+        inplaceTable[i & 3](static_cast<uint8_t>(i));
+    }
+    const uint64_t inplaceCycles = cycles() - start;
+
+    CHECK(stdSum == g_sink);
+    printf("%u calls: std::function %.2f cycles/call, InplaceFunction %.2f cycles/call\n",
+           static_cast<unsigned>(BENCHMARK_CALLS),
+           static_cast<double>(stdCycles) / BENCHMARK_CALLS,
+           static_cast<double>(inplaceCycles) / BENCHMARK_CALLS);
+    std::free(context);
+    TestCaseEnd();
+}
+
+int main(int argc, const char* argv[])
+{
+    UnitTestMainBegin();
+    RunTest(true, ut_Invoke);
+    RunTest(true, ut_CopyMoveDestroy);
+    RunTest(true, ut_NoAllocation);
+    RunTest(true, ut_BenchmarkAgainstStdFunction);
+    UnitTestMainEnd();
+}
@@ -108,7 +108,7 @@ typename std::enable_if_t<is_fixed_stl_container<V>::value> hexlify(V& dest, con
 {
     const char hex[] = "0123456789ABCDEF";
 
-    static_assert(dest.size() == src.size() * 2);
+    static_assert(std::tuple_size<V>::value == std::tuple_size<W>::value * 2);
 
     auto destIt = dest.begin();
 
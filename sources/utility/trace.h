@@ -11,6 +11,8 @@
 #define ZONE_VERBOSE 0x00000008
 
 #if defined(UNITTEST)
+#include <stdio.h>
+
 #define Trace(ZONE, ...) do { \
         if (g_DebugZones & (ZONE)) { \
             printf("%s:%u: ", __FILE__, __LINE__); \
@@ -0,0 +1,19 @@
+#!/bin/bash
+# Compare the RAM sections of a heap based and a statically allocated firmware
+# usage: ramReport.sh <dynamic.elf> <static.elf> [size tool]
+
+DYNAMIC_ELF=$1
+STATIC_ELF=$2
+SIZE=${3:-arm-none-eabi-size}
+
+section() {
+	${SIZE} -A "$1" | awk -v name="$2" '$1 == name { print $2 }'
+}
+
+printf "%-10s %10s %10s %10s\n" "section" "dynamic" "static" "delta"
+for SECTION in .data .bss; do
+	DYN=$(section ${DYNAMIC_ELF} ${SECTION})
+	STA=$(section ${STATIC_ELF} ${SECTION})
+	printf "%-10s %10d %10d %+10d\n" ${SECTION} ${DYN:-0} ${STA:-0} $((${STA:-0} - ${DYN:-0}))
+done
+echo "The static build no longer allocates the delta from the FreeRTOS heap at runtime."
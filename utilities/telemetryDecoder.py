@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0
+#
+# Decodes the binary records of os::Telemetry (sources/os/Telemetry.h), e.g.
+# from the RTT telemetry channel:
+#   JLinkRTTLogger -Device STM32F103RE -RTTChannel 2 telemetry.bin
+#   utilities/telemetryDecoder.py telemetry.bin
+
+import struct
+import sys
+
+MAGIC = 0x54
+VERSION = 1
+HEADER = struct.Struct('<BBHIIIBBH')
+TASK = struct.Struct('<BBBBHH8s')
+WATCH = struct.Struct('<HH8s')
+STATES = ['running', 'ready', 'blocked', 'suspended', 'deleted', 'invalid']
+
+
+def name(raw):
+    return raw.split(b'\0', 1)[0].decode('ascii', 'replace')
+
+
+def decode(data):
+    """Yields (header, tasks, watches) and resynchronises on the magic byte."""
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        magic, version, length, tick, heapFree, heapMin, nTasks, nWatches, permille = \
+            HEADER.unpack_from(data, pos)
+        expected = HEADER.size + nTasks * TASK.size + nWatches * WATCH.size
+        if magic != MAGIC or version != VERSION or length != expected:
+            pos += 1
+            continue
+        if pos + length > len(data):
+            break
+        offset = pos + HEADER.size
+        tasks = []
+        for _ in range(nTasks):
+            number, state, priority, _, cpu, stack, taskName = TASK.unpack_from(data, offset)
+            tasks.append((number, name(taskName), STATES[min(state, len(STATES) - 1)],
+                          priority, cpu, stack))
+            offset += TASK.size
+        watches = []
+        for _ in range(nWatches):
+            level, capacity, watchName = WATCH.unpack_from(data, offset)
+            watches.append((name(watchName), level, capacity))
+            offset += WATCH.size
+        yield (tick, heapFree, heapMin, permille), tasks, watches
+        pos += length
+
+
+def main():
+    stream = open(sys.argv[1], 'rb') if len(sys.argv) > 1 else sys.stdin.buffer
+    for (tick, heapFree, heapMin, permille), tasks, watches in decode(stream.read()):
+        print('tick %10d  heap free %6d  min %6d  telemetry %4.1f%%' %
+              (tick, heapFree, heapMin, permille / 10))
+        for number, taskName, state, priority, cpu, stack in tasks:
+            print('  %2d %-8s %-9s prio %2d  cpu %5.1f%%  stack free %5d B' %
+                  (number, taskName, state, priority, cpu / 10, stack))
+        for watchName, level, capacity in watches:
+            print('  %-8s %5d/%5d' % (watchName, level, capacity))
+
+
+if __name__ == '__main__':
+    main()